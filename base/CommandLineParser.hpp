@@ -24,6 +24,7 @@ public:
 	};
 	std::unordered_map<std::string, CommandLineOption> options;
 
+	// Options added after parsing (e.g. by an example after the base class has parsed the command line) are looked up in the parsed arguments right away
 	void add(std::string name, std::vector<std::string> commands, bool hasValue, std::string help)
 	{
 		options[name].commands = commands;
@@ -31,6 +32,9 @@ public:
 		options[name].set = false;
 		options[name].hasValue = hasValue;
 		options[name].value = "";
+		if (parsed && !parseOption(options[name])) {
+			options["help"].set = true;
+		}
 	}
 
 	void printHelp()
@@ -51,25 +55,13 @@ public:
 
 	void parse(std::vector<const char*> arguments)
 	{
+		this->arguments.assign(arguments.begin(), arguments.end());
+		parsed = true;
 		bool printHelp = false;
 		// Known arguments
 		for (auto& option : options) {
-			for (auto& command : option.second.commands) {
-				for (size_t i = 0; i < arguments.size(); i++) {
-					if (strcmp(arguments[i], command.c_str()) == 0) {
-						option.second.set = true;
-						// Get value
-						if (option.second.hasValue) {
-							if (arguments.size() > i + 1) {
-								option.second.value = arguments[i + 1];
-							}
-							if (option.second.value == "") {
-								printHelp = true;
-								break;
-							}
-						}
-					}
-				}
+			if (!parseOption(option.second)) {
+				printHelp = true;
 			}
 		}
 		// Print help for unknown arguments or missing argument values
@@ -114,4 +106,29 @@ public:
 		return int32_t();
 	}
 
+private:
+	std::vector<std::string> arguments;
+	bool parsed = false;
+
+	// Returns false if the option is missing its value
+	bool parseOption(CommandLineOption& option)
+	{
+		for (auto& command : option.commands) {
+			for (size_t i = 0; i < arguments.size(); i++) {
+				if (arguments[i] == command) {
+					option.set = true;
+					// Get value
+					if (option.hasValue) {
+						if (arguments.size() > i + 1) {
+							option.value = arguments[i + 1];
+						}
+						if (option.value == "") {
+							return false;
+						}
+					}
+				}
+			}
+		}
+		return true;
+	}
 };
\ No newline at end of file
@@ -22,6 +22,16 @@ namespace vks
 	*/
 	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
+		if (allocator)
+		{
+			// Host visible memory from the allocator is persistently mapped
+			if (!allocation.mapped)
+			{
+				return VK_ERROR_MEMORY_MAP_FAILED;
+			}
+			mapped = static_cast<uint8_t*>(allocation.mapped) + offset;
+			return VK_SUCCESS;
+		}
 		return vkMapMemory(device, memory, offset, size, 0, &mapped);
 	}
 
@@ -34,7 +44,10 @@ namespace vks
 	{
 		if (mapped)
 		{
-			vkUnmapMemory(device, memory);
+			if (!allocator)
+			{
+				vkUnmapMemory(device, memory);
+			}
 			mapped = nullptr;
 		}
 	}
@@ -48,7 +61,7 @@ namespace vks
 	*/
 	VkResult Buffer::bind(VkDeviceSize offset)
 	{
-		return vkBindBufferMemory(device, buffer, memory, offset);
+		return vkBindBufferMemory(device, buffer, memory, allocation.offset + offset);
 	}
 
 	/**
@@ -82,6 +95,8 @@ namespace vks
 	* Flush a memory range of the buffer to make it visible to the device
 	*
 	* @note Only required for non-coherent memory
+	* @note Offsets are relative to the buffer's memory range, which may be sub-allocated from a larger memory block
+	* @note Ranges of sub-allocated buffers are widened to multiples of nonCoherentAtomSize
 	*
 	* @param size (Optional) Size of the memory range to flush. Pass VK_WHOLE_SIZE to flush the complete buffer range.
 	* @param offset (Optional) Byte offset from beginning
@@ -90,6 +105,12 @@ namespace vks
 	*/
 	VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset)
 	{
+		if (allocator)
+		{
+			// Sub-allocated ranges have to be aligned to nonCoherentAtomSize by hand, VK_WHOLE_SIZE would refer to the whole memory block
+			VkMappedMemoryRange mappedRange = allocator->getMappedRange(allocation, size, offset);
+			return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
+		}
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
@@ -110,6 +131,12 @@ namespace vks
 	*/
 	VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 	{
+		if (allocator)
+		{
+			// Sub-allocated ranges have to be aligned to nonCoherentAtomSize by hand, VK_WHOLE_SIZE would refer to the whole memory block
+			VkMappedMemoryRange mappedRange = allocator->getMappedRange(allocation, size, offset);
+			return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
+		}
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
@@ -127,9 +154,17 @@ namespace vks
 		{
 			vkDestroyBuffer(device, buffer, nullptr);
 		}
-		if (memory)
+		if (allocator)
+		{
+			allocator->free(allocation);
+		}
+		else if (memory)
 		{
 			vkFreeMemory(device, memory, nullptr);
 		}
+		buffer = VK_NULL_HANDLE;
+		memory = VK_NULL_HANDLE;
+		mapped = nullptr;
+		allocator = nullptr;
 	}
 };
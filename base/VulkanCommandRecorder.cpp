@@ -0,0 +1,146 @@
+/*
+ * Vulkan parallel command recorder
+ *
+ * Records secondary command buffers for ranges of a draw list on multiple threads
+ *
+ * Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#include "VulkanCommandRecorder.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+
+#include <algorithm>
+
+namespace vks
+{
+	/**
+	* Start the recorder's worker threads
+	*
+	* @param device Device to create the command pools on
+	* @param queueFamilyIndex Queue family the command buffers are submitted to
+	* @param threadCount Number of threads recording command buffers, including the calling thread (which records while waiting for the workers)
+	*/
+	void ParallelCommandRecorder::create(VulkanDevice *device, uint32_t queueFamilyIndex, uint32_t threadCount)
+	{
+		this->device = device;
+		this->queueFamilyIndex = queueFamilyIndex;
+		jobSystem.setThreadCount(std::max(threadCount, 1u) - 1);
+		slots.clear();
+		currentSlot = 0;
+	}
+
+	void ParallelCommandRecorder::destroy()
+	{
+		if (!device)
+		{
+			return;
+		}
+		for (auto &slot : slots)
+		{
+			for (auto &thread : slot)
+			{
+				// Destroying the pool frees all of its command buffers
+				vkDestroyCommandPool(device->logicalDevice, thread.commandPool, nullptr);
+			}
+		}
+		slots.clear();
+		device = nullptr;
+	}
+
+	bool ParallelCommandRecorder::enabled() const
+	{
+		return device != nullptr;
+	}
+
+	/** @brief Number of threads recording command buffers, including the calling thread */
+	uint32_t ParallelCommandRecorder::getThreadCount() const
+	{
+		return jobSystem.getThreadCount() + 1;
+	}
+
+	/**
+	* Select the slot that following calls record into and recycle all command buffers previously recorded for it
+	*
+	* @param slot Index of the slot, slots are created on first use
+	*/
+	void ParallelCommandRecorder::beginSlot(uint32_t slot)
+	{
+		assert(device);
+		const uint32_t threadCount = getThreadCount();
+		while (slots.size() <= slot)
+		{
+			std::vector<ThreadCommandPool> pools(threadCount);
+			for (auto &thread : pools)
+			{
+				// Command buffers are only reset together with their pool, which is cheaper than resetting them individually
+				VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+				cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+				cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+				VK_CHECK_RESULT(vkCreateCommandPool(device->logicalDevice, &cmdPoolInfo, nullptr, &thread.commandPool));
+			}
+			slots.push_back(std::move(pools));
+		}
+		currentSlot = slot;
+		for (auto &thread : slots[slot])
+		{
+			if (thread.usedCommandBuffers > 0)
+			{
+				VK_CHECK_RESULT(vkResetCommandPool(device->logicalDevice, thread.commandPool, 0));
+				thread.usedCommandBuffers = 0;
+			}
+		}
+	}
+
+	/**
+	* Begin a secondary command buffer from the calling thread's pool of the current slot
+	*
+	* @param inheritanceInfo Render pass (and optionally framebuffer) the command buffer is executed in
+	*
+	* @return Command buffer in the recording state, to be ended by the caller
+	*/
+	VkCommandBuffer ParallelCommandRecorder::begin(const VkCommandBufferInheritanceInfo &inheritanceInfo)
+	{
+		ThreadCommandPool &thread = slots[currentSlot][jobSystem.currentThreadIndex()];
+		if (thread.usedCommandBuffers == thread.commandBuffers.size())
+		{
+			// Allocate in batches, the command buffers are kept for later frames
+			const uint32_t count = std::max(static_cast<uint32_t>(thread.commandBuffers.size()), 4u);
+			VkCommandBufferAllocateInfo allocateInfo = vks::initializers::commandBufferAllocateInfo(thread.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, count);
+			thread.commandBuffers.resize(thread.commandBuffers.size() + count);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device->logicalDevice, &allocateInfo, thread.commandBuffers.data() + thread.usedCommandBuffers));
+		}
+		VkCommandBuffer commandBuffer = thread.commandBuffers[thread.usedCommandBuffers++];
+		VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+		return commandBuffer;
+	}
+
+	/**
+	* Split count items into ranges of equal size, one per thread
+	*
+	* @param count Number of items
+	* @param minItemsPerRange Smaller draw lists are split into fewer ranges, as each secondary command buffer adds some overhead
+	*/
+	std::vector<ParallelCommandRecorder::Range> ParallelCommandRecorder::partition(uint32_t count, uint32_t minItemsPerRange) const
+	{
+		const uint32_t rangeCount = getRangeCount(count, minItemsPerRange);
+		std::vector<Range> ranges(rangeCount);
+		for (uint32_t i = 0; i < rangeCount; i++)
+		{
+			ranges[i].first = static_cast<uint32_t>((static_cast<uint64_t>(count) * i) / rangeCount);
+			ranges[i].last = static_cast<uint32_t>((static_cast<uint64_t>(count) * (i + 1)) / rangeCount);
+		}
+		return ranges;
+	}
+
+	uint32_t ParallelCommandRecorder::getRangeCount(uint32_t count, uint32_t minItemsPerRange) const
+	{
+		minItemsPerRange = std::max(minItemsPerRange, 1u);
+		return std::min(getThreadCount(), (count + minItemsPerRange - 1) / minItemsPerRange);
+	}
+}
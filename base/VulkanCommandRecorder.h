@@ -0,0 +1,101 @@
+/*
+ * Vulkan parallel command recorder
+ *
+ * Records secondary command buffers for ranges of a draw list on multiple threads
+ *
+ * Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "jobsystem.hpp"
+
+namespace vks
+{
+struct VulkanDevice;
+
+/*
+	Command pools must only be used by one thread at a time, so every thread gets its own pool for each slot
+	A slot is a set of command buffers that is in use by the GPU at the same time, e.g. one per swap chain image
+	for pre-recorded command buffers or one per frame in flight for command buffers recorded every frame
+	Resetting a slot resets all of its pools at once, the secondary command buffers allocated from them are recycled
+
+	Usage (inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS):
+		parallelRecorder.beginSlot(i);		(the GPU must have finished the command buffers last recorded for this slot)
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		...
+		std::vector<VkCommandBuffer> secondaries;
+		parallelRecorder.record(inheritanceInfo, parallelRecorder.partition(drawCount, 64), [&](VkCommandBuffer cb, uint32_t first, uint32_t last) {
+			// Record draws [first, last), no state is inherited from the primary command buffer
+		}, secondaries);
+		vkCmdExecuteCommands(primary, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+*/
+class ParallelCommandRecorder
+{
+public:
+	/** @brief Range of items [first, last) recorded into a single secondary command buffer */
+	struct Range
+	{
+		uint32_t first;
+		uint32_t last;
+	};
+
+	void create(VulkanDevice *device, uint32_t queueFamilyIndex, uint32_t threadCount);
+	void destroy();
+	bool enabled() const;
+	uint32_t getThreadCount() const;
+	void beginSlot(uint32_t slot);
+	VkCommandBuffer begin(const VkCommandBufferInheritanceInfo &inheritanceInfo);
+
+	std::vector<Range> partition(uint32_t count, uint32_t minItemsPerRange) const;
+
+	/**
+	* Record each range into its own secondary command buffer, distributed across all threads
+	*
+	* @param inheritanceInfo Render pass (and optionally framebuffer) the secondary command buffers are executed in
+	* @param ranges Item ranges, e.g. from partition()
+	* @param recordRange Called as recordRange(commandBuffer, first, last) on any of the threads to record the items of a range
+	* @param commandBuffers The command buffers are appended in the order of the ranges
+	*/
+	template <typename F>
+	void record(const VkCommandBufferInheritanceInfo &inheritanceInfo, const std::vector<Range> &ranges, const F &recordRange, std::vector<VkCommandBuffer> &commandBuffers)
+	{
+		const size_t offset = commandBuffers.size();
+		commandBuffers.resize(offset + ranges.size());
+		VkCommandBuffer *output = commandBuffers.data() + offset;
+		auto recordJob = [&](uint32_t index) {
+			VKS_TRACE_ZONE("Record secondary command buffer");
+			VkCommandBuffer commandBuffer = begin(inheritanceInfo);
+			recordRange(commandBuffer, ranges[index].first, ranges[index].last);
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+			output[index] = commandBuffer;
+		};
+		// The calling thread records ranges too while it waits for the workers
+		jobSystem.parallelFor(static_cast<uint32_t>(ranges.size()), 1, recordJob);
+	}
+
+private:
+	struct ThreadCommandPool
+	{
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> commandBuffers;
+		// Number of command buffers handed out since the pool was last reset
+		uint32_t usedCommandBuffers = 0;
+	};
+
+	VulkanDevice *device = nullptr;
+	uint32_t queueFamilyIndex = 0;
+	JobSystem jobSystem;
+	// Pools of each slot, one per thread (worker threads followed by the thread that created the recorder)
+	std::vector<std::vector<ThreadCommandPool>> slots;
+	uint32_t currentSlot = 0;
+
+	uint32_t getRangeCount(uint32_t count, uint32_t minItemsPerRange) const;
+};
+}        // namespace vks
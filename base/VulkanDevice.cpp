@@ -64,6 +64,8 @@ namespace vks
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
+		stagingRing.destroy();
+		memoryAllocator.destroy();
 		if (commandPool)
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
@@ -301,6 +303,9 @@ namespace vks
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		stagingRing.create(this);
+		memoryAllocator.create(this);
+
 		return result;
 	}
 
@@ -377,48 +382,69 @@ namespace vks
 	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data)
 	{
 		buffer->device = logicalDevice;
+		buffer->allocator = &memoryAllocator;
 
-		// Create the buffer handle
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
-		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
+		// Create the buffer handle and sub-allocate the memory backing it up
+		VK_CHECK_RESULT(createBuffer(usageFlags, memoryPropertyFlags, size, &buffer->buffer, &buffer->allocation, data));
+		buffer->memory = buffer->allocation.memory;
 
-		// Create the memory backing up the buffer handle
 		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
-		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
-
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
 		buffer->usageFlags = usageFlags;
 		buffer->memoryPropertyFlags = memoryPropertyFlags;
 
-		// If a pointer to the buffer data has been passed, map the buffer and copy over the data
+		// Initialize a default descriptor that covers the whole buffer size
+		buffer->setupDescriptor();
+
+		return VK_SUCCESS;
+	}
+
+	/**
+	* Create a buffer on the device with memory from the device's memory allocator
+	*
+	* @param usageFlags Usage flag bit mask for the buffer (i.e. index, vertex, uniform buffer)
+	* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
+	* @param size Size of the buffer in bytes
+	* @param buffer Pointer to the buffer handle acquired by the function
+	* @param allocation Pointer to the memory allocation acquired by the function, has to be released with memoryAllocator.free
+	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param strategy (Optional) Sub-allocation strategy, use MemoryAllocator::Strategy::Linear for buffers that live as long as the resources loaded with them (defaults to MemoryAllocator::Strategy::Buddy)
+	*
+	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
+	*/
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, MemoryAllocator::Allocation *allocation, void *data, MemoryAllocator::Strategy strategy)
+	{
+		// Create the buffer handle
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
+
+		// Sub-allocate the memory backing up the buffer handle
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(logicalDevice, *buffer, &memReqs);
+		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
+		const VkMemoryAllocateFlags allocateFlags = (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR : 0;
+		VK_CHECK_RESULT(memoryAllocator.allocate(memReqs, memoryPropertyFlags, MemoryAllocator::ResourceType::Linear, allocation, strategy, allocateFlags));
+
+		// If a pointer to the buffer data has been passed, copy it over using the allocator's persistent mapping
 		if (data != nullptr)
 		{
-			VK_CHECK_RESULT(buffer->map());
-			memcpy(buffer->mapped, data, size);
+			assert(allocation->mapped);
+			memcpy(allocation->mapped, data, size);
+			// If host coherency hasn't been requested, do a manual flush to make writes visible
 			if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
-				buffer->flush();
-
-			buffer->unmap();
+			{
+				VkMappedMemoryRange mappedRange = memoryAllocator.getMappedRange(*allocation);
+				vkFlushMappedMemoryRanges(logicalDevice, 1, &mappedRange);
+			}
 		}
 
-		// Initialize a default descriptor that covers the whole buffer size
-		buffer->setupDescriptor();
-
 		// Attach the memory to the buffer object
-		return buffer->bind();
+		VK_CHECK_RESULT(vkBindBufferMemory(logicalDevice, *buffer, allocation->memory, allocation->offset));
+
+		return VK_SUCCESS;
 	}
 
 	/**
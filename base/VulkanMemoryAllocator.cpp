@@ -0,0 +1,429 @@
+/*
+ * Vulkan device memory allocator
+ *
+ * Sub-allocates buffers and images from large device memory blocks instead of doing one vkAllocateMemory per resource
+ *
+ * Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#include "VulkanMemoryAllocator.h"
+#include "VulkanDevice.h"
+
+#include <set>
+#include <iostream>
+#include <iomanip>
+
+namespace vks
+{
+	// Smallest range handed out by buddy blocks (256 bytes), which also covers the usual alignment requirements of uniform and storage buffers
+	static const uint32_t minBuddyOrder = 8;
+
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (alignment > 1) ? ((value + alignment - 1) / alignment) * alignment : value;
+	}
+
+	static uint32_t ceilLog2(VkDeviceSize value)
+	{
+		uint32_t order = 0;
+		while ((VkDeviceSize(1) << order) < value)
+		{
+			order++;
+		}
+		return order;
+	}
+
+	struct MemoryAllocator::Block
+	{
+		VkDeviceMemory memory          = VK_NULL_HANDLE;
+		VkDeviceSize   size            = 0;
+		uint8_t       *mapped          = nullptr;
+		uint32_t       memoryTypeIndex = 0;
+		uint32_t       poolIndex       = 0;
+		Strategy       strategy        = Strategy::Buddy;
+		uint32_t       allocationCount = 0;
+		VkDeviceSize   usedBytes       = 0;
+		// Buddy: Offsets of the free ranges, indexed by the range's order (log2 of its size)
+		std::vector<std::set<VkDeviceSize>> freeRanges;
+		// Linear: Start of the unused remainder of the block
+		VkDeviceSize   linearOffset    = 0;
+
+		Block(Strategy strategy, VkDeviceSize size) : size(size), strategy(strategy)
+		{
+			if (strategy == Strategy::Buddy)
+			{
+				// Buddy blocks are always a power of two in size and start out as one free range
+				const uint32_t maxOrder = ceilLog2(size);
+				freeRanges.resize(maxOrder + 1);
+				freeRanges[maxOrder].insert(0);
+			}
+		}
+
+		bool allocate(VkDeviceSize allocationSize, VkDeviceSize alignment, VkDeviceSize &offset, uint32_t &order, VkDeviceSize &rangeSize)
+		{
+			if (strategy == Strategy::Linear)
+			{
+				offset = alignUp(linearOffset, alignment);
+				if (offset + allocationSize > size)
+				{
+					return false;
+				}
+				rangeSize = offset + allocationSize - linearOffset;
+				linearOffset = offset + allocationSize;
+				order = 0;
+			}
+			else
+			{
+				// Ranges are aligned to their size, so the alignment requirement is met by picking a range that's at least as large
+				order = std::max(minBuddyOrder, ceilLog2(std::max(allocationSize, alignment)));
+				uint32_t freeOrder = order;
+				while ((freeOrder < freeRanges.size()) && freeRanges[freeOrder].empty())
+				{
+					freeOrder++;
+				}
+				if (freeOrder >= freeRanges.size())
+				{
+					return false;
+				}
+				offset = *freeRanges[freeOrder].begin();
+				freeRanges[freeOrder].erase(freeRanges[freeOrder].begin());
+				// Split the range down to the requested size, the upper halves become free ranges
+				while (freeOrder > order)
+				{
+					freeOrder--;
+					freeRanges[freeOrder].insert(offset + (VkDeviceSize(1) << freeOrder));
+				}
+				rangeSize = VkDeviceSize(1) << order;
+			}
+			allocationCount++;
+			usedBytes += rangeSize;
+			return true;
+		}
+
+		void free(VkDeviceSize offset, uint32_t order, VkDeviceSize rangeSize)
+		{
+			assert(allocationCount > 0);
+			allocationCount--;
+			usedBytes -= rangeSize;
+			if (strategy == Strategy::Linear)
+			{
+				// Linear blocks are reset as a whole once they're empty
+				if (allocationCount == 0)
+				{
+					linearOffset = 0;
+					usedBytes = 0;
+				}
+				return;
+			}
+			// Merge with the buddy range as long as that one is free too
+			while (order + 1 < freeRanges.size())
+			{
+				const VkDeviceSize buddy = offset ^ (VkDeviceSize(1) << order);
+				auto it = freeRanges[order].find(buddy);
+				if (it == freeRanges[order].end())
+				{
+					break;
+				}
+				freeRanges[order].erase(it);
+				offset = std::min(offset, buddy);
+				order++;
+			}
+			freeRanges[order].insert(offset);
+		}
+	};
+
+	MemoryAllocator::MemoryAllocator()
+	{
+	}
+
+	MemoryAllocator::~MemoryAllocator()
+	{
+	}
+
+	/**
+	* Set up the allocator for a device, blocks are allocated on demand
+	*
+	* @param device Device to allocate memory from
+	*/
+	void MemoryAllocator::create(VulkanDevice *device)
+	{
+		this->device = device;
+		pools.resize(device->memoryProperties.memoryTypeCount * 4);
+		heapStatistics.resize(device->memoryProperties.memoryHeapCount);
+	}
+
+	/**
+	* Free all memory blocks
+	*
+	* @note All resources using memory from the allocator must have been destroyed before
+	*/
+	void MemoryAllocator::destroy()
+	{
+		if (!device)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &pool : pools)
+		{
+			for (auto &block : pool)
+			{
+				if (block->allocationCount > 0)
+				{
+					std::cerr << "Memory block of memory type " << block->memoryTypeIndex << " is destroyed with " << block->allocationCount << " allocations left\n";
+				}
+				vkFreeMemory(device->logicalDevice, block->memory, nullptr);
+			}
+			pool.clear();
+		}
+		device = nullptr;
+	}
+
+	/**
+	* Allocate device memory for a resource
+	*
+	* @param memoryRequirements Memory requirements of the buffer or image (from vkGet*MemoryRequirements)
+	* @param memoryPropertyFlags Memory properties the allocation's memory type needs to have
+	* @param resourceType Type of the resource the memory is bound to, used to honor the device's bufferImageGranularity
+	* @param allocation Pointer to the allocation that is filled by this function
+	* @param (Optional) strategy Sub-allocation strategy (defaults to Strategy::Buddy)
+	* @param (Optional) allocateFlags Flags for VkMemoryAllocateFlagsInfo, allocations with flags always get dedicated memory (defaults to 0)
+	*
+	* @return VK_SUCCESS if the memory has been allocated, the memory and offset to bind the resource to are stored in the allocation
+	*/
+	VkResult MemoryAllocator::allocate(const VkMemoryRequirements &memoryRequirements, VkMemoryPropertyFlags memoryPropertyFlags, ResourceType resourceType, Allocation *allocation, Strategy strategy, VkMemoryAllocateFlags allocateFlags)
+	{
+		assert(device);
+		std::lock_guard<std::mutex> lock(mutex);
+
+		const uint32_t memoryTypeIndex = device->getMemoryType(memoryRequirements.memoryTypeBits, memoryPropertyFlags);
+		const VkMemoryPropertyFlags typeFlags = device->memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		VkDeviceSize size = memoryRequirements.size;
+		VkDeviceSize alignment = memoryRequirements.alignment;
+		// Mapped memory ranges are flushed and invalidated in multiples of nonCoherentAtomSize, so host visible sub-allocations must not share an atom (see getMappedRange)
+		// This also applies to coherent memory, as the range alignment is required even though flushing it has no effect
+		if (typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			const VkDeviceSize atomSize = device->properties.limits.nonCoherentAtomSize;
+			alignment = std::max(alignment, atomSize);
+			size = alignUp(size, atomSize);
+		}
+
+		*allocation = Allocation();
+		allocation->memoryTypeIndex = memoryTypeIndex;
+		allocation->size = size;
+
+		const VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+		const bool dedicated = (allocateFlags != 0) || (size > blockSize / 2) || ((resourceType == ResourceType::Optimal) && (size >= dedicatedImageSize));
+		if (!dedicated)
+		{
+			std::vector<std::unique_ptr<Block>> &pool = pools[getPoolIndex(memoryTypeIndex, resourceType, strategy)];
+			Block *block = nullptr;
+			VkDeviceSize rangeSize = 0;
+			for (auto &poolBlock : pool)
+			{
+				if (poolBlock->allocate(size, alignment, allocation->offset, allocation->order, rangeSize))
+				{
+					block = poolBlock.get();
+					break;
+				}
+			}
+			if (!block)
+			{
+				std::unique_ptr<Block> newBlock(new Block(strategy, blockSize));
+				newBlock->memoryTypeIndex = memoryTypeIndex;
+				newBlock->poolIndex = getPoolIndex(memoryTypeIndex, resourceType, strategy);
+				void *mapped = nullptr;
+				// If the heap can't fit another block anymore, try a dedicated allocation of the requested size instead
+				if (allocateDeviceMemory(blockSize, memoryTypeIndex, 0, &newBlock->memory, &mapped) == VK_SUCCESS)
+				{
+					newBlock->mapped = static_cast<uint8_t *>(mapped);
+					newBlock->allocate(size, alignment, allocation->offset, allocation->order, rangeSize);
+					block = newBlock.get();
+					pool.push_back(std::move(newBlock));
+					HeapStatistics &statistics = heapStatistics[device->memoryProperties.memoryTypes[memoryTypeIndex].heapIndex];
+					statistics.blockCount++;
+					statistics.blockBytes += blockSize;
+					statistics.peakBytes = std::max(statistics.peakBytes, statistics.blockBytes + statistics.dedicatedBytes);
+				}
+			}
+			if (block)
+			{
+				HeapStatistics &statistics = heapStatistics[device->memoryProperties.memoryTypes[memoryTypeIndex].heapIndex];
+				statistics.allocationCount++;
+				statistics.usedBytes += rangeSize;
+				allocation->memory = block->memory;
+				allocation->mapped = block->mapped ? block->mapped + allocation->offset : nullptr;
+				allocation->block = block;
+				return VK_SUCCESS;
+			}
+		}
+
+		allocation->size = memoryRequirements.size;
+		VkResult result = allocateDeviceMemory(memoryRequirements.size, memoryTypeIndex, allocateFlags, &allocation->memory, &allocation->mapped);
+		if (result == VK_SUCCESS)
+		{
+			HeapStatistics &statistics = heapStatistics[device->memoryProperties.memoryTypes[memoryTypeIndex].heapIndex];
+			statistics.dedicatedAllocationCount++;
+			statistics.dedicatedBytes += memoryRequirements.size;
+			statistics.peakBytes = std::max(statistics.peakBytes, statistics.blockBytes + statistics.dedicatedBytes);
+		}
+		return result;
+	}
+
+	/**
+	* Release an allocation, the allocation is reset afterwards
+	*
+	* @note Empty blocks are freed, unless it's the last block of its pool
+	*/
+	void MemoryAllocator::free(Allocation &allocation)
+	{
+		if (allocation.memory == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		HeapStatistics &statistics = heapStatistics[device->memoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex];
+		if (!allocation.block)
+		{
+			statistics.dedicatedAllocationCount--;
+			statistics.dedicatedBytes -= allocation.size;
+			vkFreeMemory(device->logicalDevice, allocation.memory, nullptr);
+			allocation = Allocation();
+			return;
+		}
+
+		Block *block = allocation.block;
+		const VkDeviceSize usedBytes = block->usedBytes;
+		// Linear blocks don't track the size of single ranges, their memory is only given back once they're empty
+		const VkDeviceSize rangeSize = (block->strategy == Strategy::Buddy) ? (VkDeviceSize(1) << allocation.order) : 0;
+		block->free(allocation.offset, allocation.order, rangeSize);
+		statistics.usedBytes -= usedBytes - block->usedBytes;
+		statistics.allocationCount--;
+		if (block->allocationCount == 0)
+		{
+			std::vector<std::unique_ptr<Block>> &pool = pools[block->poolIndex];
+			if (pool.size() > 1)
+			{
+				for (auto it = pool.begin(); it != pool.end(); ++it)
+				{
+					if (it->get() == block)
+					{
+						vkFreeMemory(device->logicalDevice, block->memory, nullptr);
+						statistics.blockCount--;
+						statistics.blockBytes -= block->size;
+						pool.erase(it);
+						break;
+					}
+				}
+			}
+		}
+		allocation = Allocation();
+	}
+
+	/**
+	* Get the memory range to flush or invalidate for a range of a host visible allocation
+	*
+	* @param allocation Allocation the range belongs to
+	* @param size Size of the range, VK_WHOLE_SIZE for the rest of the allocation
+	* @param offset Byte offset from the beginning of the allocation
+	*
+	* @return Range with offset and size aligned to nonCoherentAtomSize, clamped to the end of the allocation
+	*/
+	VkMappedMemoryRange MemoryAllocator::getMappedRange(const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) const
+	{
+		const VkDeviceSize atomSize = device->properties.limits.nonCoherentAtomSize;
+		const VkDeviceSize allocationEnd = allocation.offset + allocation.size;
+		const VkDeviceSize end = (size == VK_WHOLE_SIZE) ? allocationEnd : std::min(allocation.offset + offset + size, allocationEnd);
+		VkMappedMemoryRange mappedRange{};
+		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		mappedRange.memory = allocation.memory;
+		// Host visible allocations start and end at multiples of the atom size (see allocate), so the aligned range stays inside the allocation
+		mappedRange.offset = ((allocation.offset + offset) / atomSize) * atomSize;
+		mappedRange.size = std::min(alignUp(end, atomSize), allocationEnd) - mappedRange.offset;
+		return mappedRange;
+	}
+
+	/**
+	* Get the current usage of all memory heaps
+	*
+	* @return Statistics indexed by memory heap
+	*/
+	std::vector<MemoryAllocator::HeapStatistics> MemoryAllocator::getStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return heapStatistics;
+	}
+
+	/**
+	* Print the usage of all memory heaps that have memory allocated from them
+	*/
+	void MemoryAllocator::printStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const double megabyte = 1024.0 * 1024.0;
+		for (size_t i = 0; i < heapStatistics.size(); i++)
+		{
+			const HeapStatistics &statistics = heapStatistics[i];
+			if (statistics.peakBytes == 0)
+			{
+				continue;
+			}
+			std::cout << std::fixed << std::setprecision(1) << "Memory heap " << i << ": "
+				<< statistics.allocationCount << " allocations in " << statistics.blockCount << " blocks (" << statistics.usedBytes / megabyte << " of " << statistics.blockBytes / megabyte << " MB used), "
+				<< statistics.dedicatedAllocationCount << " dedicated allocations (" << statistics.dedicatedBytes / megabyte << " MB), peak " << statistics.peakBytes / megabyte << " MB\n";
+		}
+	}
+
+	uint32_t MemoryAllocator::getPoolIndex(uint32_t memoryTypeIndex, ResourceType resourceType, Strategy strategy) const
+	{
+		// Without a granularity restriction buffers and images can share blocks
+		const uint32_t resourceIndex = ((device->properties.limits.bufferImageGranularity > 1) && (resourceType == ResourceType::Optimal)) ? 1 : 0;
+		const uint32_t strategyIndex = (strategy == Strategy::Linear) ? 1 : 0;
+		return memoryTypeIndex * 4 + resourceIndex * 2 + strategyIndex;
+	}
+
+	VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const
+	{
+		const VkDeviceSize heapSize = device->memoryProperties.memoryHeaps[device->memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+		if (heapSize > 1024 * 1024 * 1024)
+		{
+			return preferredBlockSize;
+		}
+		// Small heaps (e.g. the host visible part of device local memory) use blocks of an eighth of the heap, rounded down to a power of two for the buddy strategy
+		VkDeviceSize blockSize = VkDeviceSize(1) << minBuddyOrder;
+		while (blockSize * 2 <= heapSize / 8)
+		{
+			blockSize *= 2;
+		}
+		return blockSize;
+	}
+
+	VkResult MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkMemoryAllocateFlags allocateFlags, VkDeviceMemory *memory, void **mapped)
+	{
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+		if (allocateFlags != 0)
+		{
+			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
+			allocFlagsInfo.flags = allocateFlags;
+			memAlloc.pNext = &allocFlagsInfo;
+		}
+		VkResult result = vkAllocateMemory(device->logicalDevice, &memAlloc, nullptr, memory);
+		if (result != VK_SUCCESS)
+		{
+			return result;
+		}
+		*mapped = nullptr;
+		if (device->memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			// Host visible memory stays mapped until it's freed
+			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, *memory, 0, VK_WHOLE_SIZE, 0, mapped));
+		}
+		return VK_SUCCESS;
+	}
+}        // namespace vks
@@ -0,0 +1,115 @@
+/*
+ * Vulkan device memory allocator
+ *
+ * Sub-allocates buffers and images from large device memory blocks instead of doing one vkAllocateMemory per resource
+ *
+ * Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+struct VulkanDevice;
+
+/*
+	Memory is allocated in blocks per memory type, with the block size depending on the size of the type's heap
+	Blocks use one of two sub-allocation strategies:
+		Buddy: Power of two sized ranges that are merged again when freed, for resources that are created and destroyed at runtime
+		Linear: Tightly packed ranges, a block is only reused once all of its allocations have been freed, for resources that are loaded once (e.g. glTF models)
+	Host visible blocks stay mapped for their whole lifetime, so allocations from such blocks come with a pointer to their memory
+	If the device's bufferImageGranularity is larger than one, buffers (and linear images) and optimal tiled images are placed in separate blocks so they never share a page
+	Large allocations, large images and allocations that need allocation flags (e.g. device addresses) get their own dedicated device memory
+
+	Usage:
+		vks::MemoryAllocator::Allocation allocation;
+		VK_CHECK_RESULT(device->memoryAllocator.allocate(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vks::MemoryAllocator::ResourceType::Optimal, &allocation));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, allocation.memory, allocation.offset));
+		...
+		device->memoryAllocator.free(allocation);
+
+	The allocator is thread safe
+*/
+class MemoryAllocator
+{
+private:
+	struct Block;
+
+public:
+	enum class ResourceType
+	{
+		// Buffers and linear tiled images
+		Linear,
+		// Optimal tiled images
+		Optimal
+	};
+
+	enum class Strategy
+	{
+		Buddy,
+		Linear
+	};
+
+	struct Allocation
+	{
+		VkDeviceMemory memory          = VK_NULL_HANDLE;
+		VkDeviceSize   offset          = 0;
+		VkDeviceSize   size            = 0;
+		// Points to the start of the allocation if it's host visible
+		void          *mapped          = nullptr;
+		uint32_t       memoryTypeIndex = 0;
+		// Block the allocation was made from, or nullptr for dedicated allocations
+		Block         *block           = nullptr;
+		uint32_t       order           = 0;
+	};
+
+	/** @brief Live usage of a memory heap */
+	struct HeapStatistics
+	{
+		uint32_t     blockCount               = 0;
+		uint32_t     allocationCount          = 0;
+		uint32_t     dedicatedAllocationCount = 0;
+		// Device memory allocated for blocks
+		VkDeviceSize blockBytes               = 0;
+		// Part of the blocks in use by allocations (including padding and unused parts of buddy ranges)
+		VkDeviceSize usedBytes                = 0;
+		VkDeviceSize dedicatedBytes           = 0;
+		// Highest amount of device memory allocated from this heap at once (blocks and dedicated allocations)
+		VkDeviceSize peakBytes                = 0;
+	};
+
+	/** @brief Preferred size of a memory block, heaps of up to 1 GB use an eighth of their size instead */
+	VkDeviceSize preferredBlockSize = 256 * 1024 * 1024;
+	/** @brief Optimal tiled images of at least this size get a dedicated allocation */
+	VkDeviceSize dedicatedImageSize = 32 * 1024 * 1024;
+
+	MemoryAllocator();
+	~MemoryAllocator();
+	void                        create(VulkanDevice *device);
+	void                        destroy();
+	VkResult                    allocate(const VkMemoryRequirements &memoryRequirements, VkMemoryPropertyFlags memoryPropertyFlags, ResourceType resourceType, Allocation *allocation, Strategy strategy = Strategy::Buddy, VkMemoryAllocateFlags allocateFlags = 0);
+	void                        free(Allocation &allocation);
+	VkMappedMemoryRange         getMappedRange(const Allocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) const;
+	std::vector<HeapStatistics> getStatistics() const;
+	void                        printStatistics() const;
+
+private:
+	VulkanDevice *device = nullptr;
+	// Indexed by memory type, resource type and strategy (see getPoolIndex)
+	std::vector<std::vector<std::unique_ptr<Block>>> pools;
+	std::vector<HeapStatistics> heapStatistics;
+	mutable std::mutex mutex;
+
+	uint32_t     getPoolIndex(uint32_t memoryTypeIndex, ResourceType resourceType, Strategy strategy) const;
+	VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+	VkResult     allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkMemoryAllocateFlags allocateFlags, VkDeviceMemory *memory, void **mapped);
+};
+}        // namespace vks
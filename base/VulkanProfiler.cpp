@@ -0,0 +1,338 @@
+/*
+ * Vulkan GPU profiler
+ *
+ * Scoped GPU timings (and optional pipeline statistics) for named passes recorded into command buffers
+ *
+ * Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#include "VulkanProfiler.h"
+#include "VulkanDevice.h"
+#include "VulkanDebug.h"
+
+namespace vks
+{
+	/**
+	* Create the query pools for all command buffers that can be profiled at the same time
+	*
+	* @param device Device to create the query pools on
+	* @param queue Queue used to initially reset all queries
+	* @param timestampValidBits Valid timestamp bits of the queue family the profiled command buffers are submitted to, the profiler stays disabled if timestamps are not supported
+	* @param pipelineStatistics Also collect pipeline statistics for top level markers (requires the pipelineStatisticsQuery feature to be enabled)
+	*/
+	void GpuProfiler::create(VulkanDevice *device, VkQueue queue, uint32_t timestampValidBits, bool pipelineStatistics)
+	{
+		if (timestampValidBits == 0)
+		{
+			return;
+		}
+		this->device = device;
+		validBitsMask = (timestampValidBits >= 64) ? ~0ULL : ((1ULL << timestampValidBits) - 1);
+		timestampPeriod = device->properties.limits.timestampPeriod;
+
+		// Two timestamps (start and end) per marker
+		VkQueryPoolCreateInfo queryPoolCI{};
+		queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCI.queryCount = maxFrames * maxMarkers * 2;
+		VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolCI, nullptr, &timestampPool));
+		timestamps.resize(maxMarkers * 2);
+
+		if (pipelineStatistics)
+		{
+			statisticFlags =
+				VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+			queryPoolCI.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			queryPoolCI.pipelineStatistics = statisticFlags;
+			queryPoolCI.queryCount = maxFrames * maxMarkers;
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolCI, nullptr, &statisticsPool));
+			statisticValues.resize(maxMarkers * StatisticCount);
+		}
+
+		// Queries have to be reset before their results can be read, otherwise polling command buffers that have not been executed yet would be undefined
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdResetQueryPool(commandBuffer, timestampPool, 0, maxFrames * maxMarkers * 2);
+		if (statisticsPool != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(commandBuffer, statisticsPool, 0, maxFrames * maxMarkers);
+		}
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		frames.resize(maxFrames);
+	}
+
+	void GpuProfiler::destroy()
+	{
+		if (!device)
+		{
+			return;
+		}
+		vkDestroyQueryPool(device->logicalDevice, timestampPool, nullptr);
+		if (statisticsPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device->logicalDevice, statisticsPool, nullptr);
+		}
+		timestampPool = VK_NULL_HANDLE;
+		statisticsPool = VK_NULL_HANDLE;
+		frames.clear();
+		device = nullptr;
+	}
+
+	/** @brief Returns false if the device doesn't support timestamps (all marker functions are no-ops then) */
+	bool GpuProfiler::enabled() const
+	{
+		return timestampPool != VK_NULL_HANDLE;
+	}
+
+	/**
+	* Start profiling a command buffer, must be called outside of a render pass before any markers are recorded
+	*
+	* @param commandBuffer Command buffer in recording state
+	*
+	* @note Re-recording a command buffer reuses its query range, the results of its last execution are resolved first
+	*/
+	void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer)
+	{
+		if (!enabled())
+		{
+			return;
+		}
+		Frame *frame = findFrame(commandBuffer);
+		if (!frame)
+		{
+			frame = &frames[0];
+			for (auto &candidate : frames)
+			{
+				if (candidate.recordIndex < frame->recordIndex)
+				{
+					frame = &candidate;
+				}
+			}
+		}
+		// The command buffer (or the one previously using the range) is not pending anymore, so anything it wrote is final
+		resolveFrame(*frame);
+
+		const uint32_t frameIndex = static_cast<uint32_t>(frame - frames.data());
+		frame->commandBuffer = commandBuffer;
+		frame->markers.clear();
+		frame->openMarkers.clear();
+		frame->statisticsQueryCount = 0;
+		frame->recordIndex = ++recordCounter;
+		frame->recording = true;
+		vkCmdResetQueryPool(commandBuffer, timestampPool, frameIndex * maxMarkers * 2, maxMarkers * 2);
+		if (statisticsPool != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(commandBuffer, statisticsPool, frameIndex * maxMarkers, maxMarkers);
+		}
+	}
+
+	/**
+	* Finish profiling a command buffer, markers that are still open are ended
+	*
+	* @param commandBuffer Command buffer in recording state
+	*/
+	void GpuProfiler::endFrame(VkCommandBuffer commandBuffer)
+	{
+		Frame *frame = findFrame(commandBuffer);
+		if (!frame || !frame->recording)
+		{
+			return;
+		}
+		while (!frame->openMarkers.empty())
+		{
+			end(commandBuffer);
+		}
+		frame->recording = false;
+	}
+
+	/**
+	* Begin a named marker
+	*
+	* @param commandBuffer Command buffer in recording state that has been passed to beginFrame
+	* @param name Name of the pass, shown nested below the name of the enclosing marker
+	*/
+	void GpuProfiler::begin(VkCommandBuffer commandBuffer, const std::string &name)
+	{
+		Frame *frame = findFrame(commandBuffer);
+		if (!frame || !frame->recording)
+		{
+			return;
+		}
+		const bool parentDropped = !frame->openMarkers.empty() && (frame->openMarkers.back() < 0);
+		if ((frame->markers.size() >= maxMarkers) || parentDropped)
+		{
+			frame->openMarkers.push_back(-1);
+			return;
+		}
+
+		const uint32_t frameIndex = static_cast<uint32_t>(frame - frames.data());
+		Marker marker;
+		marker.name = name;
+		marker.depth = static_cast<uint32_t>(frame->openMarkers.size());
+		marker.path = frame->openMarkers.empty() ? name : frame->markers[frame->openMarkers.back()].path + "/" + name;
+		marker.statisticsQuery = -1;
+		if ((statisticsPool != VK_NULL_HANDLE) && (marker.depth == 0))
+		{
+			marker.statisticsQuery = static_cast<int32_t>(frame->statisticsQueryCount++);
+			vkCmdBeginQuery(commandBuffer, statisticsPool, frameIndex * maxMarkers + marker.statisticsQuery, 0);
+		}
+		const uint32_t markerIndex = static_cast<uint32_t>(frame->markers.size());
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, frameIndex * maxMarkers * 2 + markerIndex * 2);
+		// Also shows up in graphics debuggers
+		vks::debugutils::cmdBeginLabel(commandBuffer, name, glm::vec4(1.0f));
+		frame->markers.push_back(marker);
+		frame->openMarkers.push_back(static_cast<int32_t>(markerIndex));
+	}
+
+	/**
+	* End the most recently begun marker
+	*
+	* @param commandBuffer Command buffer in recording state that has been passed to beginFrame
+	*/
+	void GpuProfiler::end(VkCommandBuffer commandBuffer)
+	{
+		Frame *frame = findFrame(commandBuffer);
+		if (!frame || !frame->recording || frame->openMarkers.empty())
+		{
+			return;
+		}
+		const int32_t markerIndex = frame->openMarkers.back();
+		frame->openMarkers.pop_back();
+		if (markerIndex < 0)
+		{
+			return;
+		}
+		const uint32_t frameIndex = static_cast<uint32_t>(frame - frames.data());
+		const Marker &marker = frame->markers[markerIndex];
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, frameIndex * maxMarkers * 2 + markerIndex * 2 + 1);
+		if (marker.statisticsQuery >= 0)
+		{
+			vkCmdEndQuery(commandBuffer, statisticsPool, frameIndex * maxMarkers + marker.statisticsQuery);
+		}
+		vks::debugutils::cmdEndLabel(commandBuffer);
+	}
+
+	/**
+	* Read back the results of all command buffers the GPU has finished since the last call without waiting
+	*
+	* @note Updates the passes and appends new timings to results
+	*/
+	void GpuProfiler::resolve()
+	{
+		for (auto &frame : frames)
+		{
+			resolveFrame(frame);
+		}
+	}
+
+	const char *GpuProfiler::statisticName(Statistic statistic)
+	{
+		switch (statistic)
+		{
+			case InputAssemblyVertices:
+				return "Input assembly vertices";
+			case InputAssemblyPrimitives:
+				return "Input assembly primitives";
+			case VertexShaderInvocations:
+				return "Vertex shader invocations";
+			case ClippingPrimitives:
+				return "Clipping primitives";
+			case FragmentShaderInvocations:
+				return "Fragment shader invocations";
+			case ComputeShaderInvocations:
+				return "Compute shader invocations";
+			default:
+				return "";
+		}
+	}
+
+	GpuProfiler::Frame *GpuProfiler::findFrame(VkCommandBuffer commandBuffer)
+	{
+		for (auto &frame : frames)
+		{
+			if (frame.commandBuffer == commandBuffer)
+			{
+				return &frame;
+			}
+		}
+		return nullptr;
+	}
+
+	// Returns true if all timestamps of the frame are available, i.e. the GPU has finished the command buffer
+	bool GpuProfiler::readTimestamps(const Frame &frame)
+	{
+		const uint32_t frameIndex = static_cast<uint32_t>(&frame - frames.data());
+		const uint32_t queryCount = static_cast<uint32_t>(frame.markers.size()) * 2;
+		VkResult result = vkGetQueryPoolResults(device->logicalDevice, timestampPool, frameIndex * maxMarkers * 2, queryCount, queryCount * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		return result == VK_SUCCESS;
+	}
+
+	void GpuProfiler::resolveFrame(Frame &frame)
+	{
+		if ((frame.commandBuffer == VK_NULL_HANDLE) || frame.recording || frame.markers.empty() || !readTimestamps(frame))
+		{
+			return;
+		}
+		// Pre-recorded command buffers are executed many times, a new execution always starts at a new timestamp
+		const uint64_t start = timestamps[0] & validBitsMask;
+		if (start == frame.lastStart)
+		{
+			return;
+		}
+		frame.lastStart = start;
+
+		const uint32_t frameIndex = static_cast<uint32_t>(&frame - frames.data());
+		bool hasStatistics = false;
+		if (frame.statisticsQueryCount > 0)
+		{
+			// All timestamps are available, so the statistics queries (which end before the last timestamp) are only waited on very briefly, if at all
+			const VkDeviceSize stride = StatisticCount * sizeof(uint64_t);
+			VkResult result = vkGetQueryPoolResults(device->logicalDevice, statisticsPool, frameIndex * maxMarkers, frame.statisticsQueryCount, frame.statisticsQueryCount * stride, statisticValues.data(), stride, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+			hasStatistics = (result == VK_SUCCESS);
+		}
+
+		for (size_t i = 0; i < frame.markers.size(); i++)
+		{
+			const Marker &marker = frame.markers[i];
+			const uint64_t markerStart = timestamps[i * 2] & validBitsMask;
+			const uint64_t markerEnd = timestamps[i * 2 + 1] & validBitsMask;
+			const double time = (markerEnd > markerStart) ? double(markerEnd - markerStart) * timestampPeriod / 1000000.0 : 0.0;
+			Pass &pass = getPass(marker);
+			pass.time = time;
+			pass.averageTime = (pass.averageTime == 0.0) ? time : pass.averageTime * 0.95 + time * 0.05;
+			if (hasStatistics && (marker.statisticsQuery >= 0))
+			{
+				pass.hasStatistics = true;
+				for (uint32_t s = 0; s < StatisticCount; s++)
+				{
+					pass.statistics[s] = statisticValues[marker.statisticsQuery * StatisticCount + s];
+				}
+			}
+			results.push_back({ marker.path, time });
+		}
+	}
+
+	GpuProfiler::Pass &GpuProfiler::getPass(const Marker &marker)
+	{
+		for (auto &pass : passes)
+		{
+			if (pass.path == marker.path)
+			{
+				return pass;
+			}
+		}
+		Pass pass;
+		pass.path = marker.path;
+		pass.name = marker.name;
+		pass.depth = marker.depth;
+		passes.push_back(pass);
+		return passes.back();
+	}
+}
@@ -0,0 +1,157 @@
+/*
+ * Vulkan GPU profiler
+ *
+ * Scoped GPU timings (and optional pipeline statistics) for named passes recorded into command buffers
+ *
+ * Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <array>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+struct VulkanDevice;
+
+/*
+	Each command buffer that contains markers gets its own range of timestamp (and pipeline statistics) queries
+	The ranges form a ring that is shared by all command buffers, so pre-recorded command buffers (one per swap chain image)
+	and command buffers recorded every frame (one per frame in flight) can both be profiled
+
+	Usage:
+		gpuProfiler.beginFrame(commandBuffer);		(outside of a render pass, resets the command buffer's queries)
+		gpuProfiler.begin(commandBuffer, "G-Buffer");
+		...
+		gpuProfiler.end(commandBuffer);
+		gpuProfiler.endFrame(commandBuffer);
+
+	Markers can be nested, a nested marker is shown as a child of the enclosing one
+	Pipeline statistics are only collected for top level markers, as queries of the same type can't be nested
+	Results are read back without waiting, once the GPU has finished a command buffer its timings show up in the next call to resolve()
+	The profiler is not thread safe and has to be used from a single thread only
+*/
+class GpuProfiler
+{
+public:
+	// Order matches the bits of statisticFlags, as pipeline statistics results are returned in bit order
+	enum Statistic
+	{
+		InputAssemblyVertices = 0,
+		InputAssemblyPrimitives,
+		VertexShaderInvocations,
+		ClippingPrimitives,
+		FragmentShaderInvocations,
+		ComputeShaderInvocations,
+		StatisticCount
+	};
+
+	/** @brief Timings of a pass accumulated over all resolved frames */
+	struct Pass
+	{
+		// Full name including all parent markers, e.g. "Offscreen/Blur"
+		std::string path;
+		std::string name;
+		uint32_t depth = 0;
+		// Time of the last resolved frame and a moving average over recent frames (in ms)
+		double time = 0.0;
+		double averageTime = 0.0;
+		bool hasStatistics = false;
+		std::array<uint64_t, StatisticCount> statistics{};
+	};
+
+	/** @brief Single pass timing of a resolved frame */
+	struct Result
+	{
+		std::string path;
+		double time;
+	};
+
+	/** @brief Maximum number of command buffers that can be profiled at the same time */
+	uint32_t maxFrames = 16;
+	/** @brief Maximum number of markers per command buffer */
+	uint32_t maxMarkers = 32;
+
+	/** @brief Passes in order of their first appearance */
+	std::vector<Pass> passes;
+	/** @brief Timings resolved since the results were last cleared (e.g. for benchmark reports) */
+	std::vector<Result> results;
+
+	void create(VulkanDevice *device, VkQueue queue, uint32_t timestampValidBits, bool pipelineStatistics);
+	void destroy();
+	bool enabled() const;
+	void beginFrame(VkCommandBuffer commandBuffer);
+	void endFrame(VkCommandBuffer commandBuffer);
+	void begin(VkCommandBuffer commandBuffer, const std::string &name);
+	void end(VkCommandBuffer commandBuffer);
+	void resolve();
+	static const char *statisticName(Statistic statistic);
+
+	/** @brief Begins a marker on construction and ends it when going out of scope */
+	class Scope
+	{
+	public:
+		Scope(GpuProfiler &profiler, VkCommandBuffer commandBuffer, const std::string &name) : profiler(profiler), commandBuffer(commandBuffer)
+		{
+			profiler.begin(commandBuffer, name);
+		}
+		~Scope()
+		{
+			profiler.end(commandBuffer);
+		}
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+	private:
+		GpuProfiler &profiler;
+		VkCommandBuffer commandBuffer;
+	};
+
+private:
+	struct Marker
+	{
+		std::string path;
+		std::string name;
+		uint32_t depth;
+		// Index into the pipeline statistics queries of the frame, -1 for nested markers
+		int32_t statisticsQuery;
+	};
+
+	// Query range of a single command buffer
+	struct Frame
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		std::vector<Marker> markers;
+		// Indices of the markers that are still open while recording (including markers dropped for exceeding maxMarkers, stored as -1)
+		std::vector<int32_t> openMarkers;
+		uint32_t statisticsQueryCount = 0;
+		// Start timestamp of the last resolved execution, used to detect if the command buffer has been executed again
+		uint64_t lastStart = 0;
+		// Recording order, used to reuse the least recently recorded range if all ranges are taken
+		uint64_t recordIndex = 0;
+		bool recording = false;
+	};
+
+	VulkanDevice *device = nullptr;
+	VkQueryPool timestampPool = VK_NULL_HANDLE;
+	VkQueryPool statisticsPool = VK_NULL_HANDLE;
+	VkQueryPipelineStatisticFlags statisticFlags = 0;
+	uint64_t validBitsMask = 0;
+	float timestampPeriod = 1.0f;
+	uint64_t recordCounter = 0;
+	std::vector<Frame> frames;
+	std::vector<uint64_t> timestamps;
+	std::vector<uint64_t> statisticValues;
+
+	Frame *findFrame(VkCommandBuffer commandBuffer);
+	bool   readTimestamps(const Frame &frame);
+	void   resolveFrame(Frame &frame);
+	Pass  &getPass(const Marker &marker);
+};
+}        // namespace vks
@@ -0,0 +1,261 @@
+/*
+ * Vulkan staging ring buffer
+ *
+ * Persistently mapped host visible buffer that is sub-allocated for all staging uploads of a device
+ *
+ * Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#include "VulkanStagingRing.h"
+#include "VulkanDevice.h"
+
+#include <iostream>
+#include <iomanip>
+
+namespace vks
+{
+	/**
+	* Set up the ring for a device, the ring buffer itself is created on the first allocation
+	*
+	* @param device Device the ring allocates from and submits to
+	*/
+	void StagingRing::create(VulkanDevice *device)
+	{
+		this->device = device;
+	}
+
+	/**
+	* Wait for all outstanding uploads and release the ring buffer
+	*/
+	void StagingRing::destroy()
+	{
+		if (!device)
+		{
+			return;
+		}
+		submitBatch();
+		while (!submittedBatches.empty())
+		{
+			retireBatch();
+		}
+		if (buffer)
+		{
+			vkDestroyBuffer(device->logicalDevice, buffer, nullptr);
+			vkFreeMemory(device->logicalDevice, memory, nullptr);
+			buffer = VK_NULL_HANDLE;
+			memory = VK_NULL_HANDLE;
+			mapped = nullptr;
+		}
+		device = nullptr;
+	}
+
+	/**
+	* Allocate staging memory for an upload of the current batch
+	*
+	* @param allocationSize Size of the data to upload
+	* @param alignment (Optional) Alignment of the allocation's offset, must be a power of two (defaults to 16, which fits all texel block sizes)
+	*
+	* @note Waits for previously submitted batches if the ring is full, and may submit the current batch to free up space
+	* @note The allocation is owned by the batch of the next call to commandBuffer, so allocations can be recorded together
+	*
+	* @return Buffer and offset to copy from, and a pointer to the mapped memory the data has to be written to
+	*/
+	StagingRing::Allocation StagingRing::allocate(VkDeviceSize allocationSize, VkDeviceSize alignment)
+	{
+		assert(device);
+		if (!buffer)
+		{
+			// Keep the ring mapped for its whole lifetime
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size, &buffer, &memory));
+			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, memory, 0, VK_WHOLE_SIZE, 0, (void **)&mapped));
+		}
+		currentBatch.bytes += allocationSize;
+
+		// Data that doesn't fit into the ring gets a dedicated buffer
+		if (allocationSize > size)
+		{
+			return allocateDedicated(allocationSize);
+		}
+
+		VkDeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+		// Allocations have to be contiguous, so skip the remainder of the ring if the allocation would wrap around
+		if ((offset % size) + allocationSize > size)
+		{
+			offset = (offset / size + 1) * size;
+		}
+		while (offset + allocationSize - tail > size)
+		{
+			if (tail == head)
+			{
+				// Nothing is in use, so the skipped remainder can be reclaimed as well
+				tail = offset;
+			}
+			else if (!submittedBatches.empty())
+			{
+				retireBatch();
+			}
+			else if (currentBatch.commandBuffer != VK_NULL_HANDLE)
+			{
+				submitBatch();
+			}
+			else
+			{
+				// The ring is held by allocations that have no copies recorded yet
+				return allocateDedicated(allocationSize);
+			}
+		}
+		head = offset + allocationSize;
+
+		Allocation allocation{};
+		allocation.buffer = buffer;
+		allocation.offset = offset % size;
+		allocation.data = mapped + allocation.offset;
+		return allocation;
+	}
+
+	/**
+	* Get the command buffer of the current batch, copies from staging allocations are recorded into it
+	*
+	* @param queue Queue the batch is submitted to, the batch is submitted first if it was started for another queue
+	*
+	* @note Command buffers are allocated from the device's default command pool, so the queue must be of the graphics queue family
+	*
+	* @return Command buffer in recording state
+	*/
+	VkCommandBuffer StagingRing::commandBuffer(VkQueue queue)
+	{
+		if ((currentBatch.commandBuffer != VK_NULL_HANDLE) && (currentBatch.queue != queue))
+		{
+			submitBatch();
+		}
+		if (currentBatch.commandBuffer == VK_NULL_HANDLE)
+		{
+			currentBatch.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			currentBatch.queue = queue;
+		}
+		// All allocations made so far are copied from by this batch
+		currentBatch.end = head;
+		currentBatch.dedicatedBuffers.insert(currentBatch.dedicatedBuffers.end(), unrecordedBuffers.begin(), unrecordedBuffers.end());
+		unrecordedBuffers.clear();
+		return currentBatch.commandBuffer;
+	}
+
+	/**
+	* Start a batch, uploads until the matching endBatch are submitted together instead of one by one
+	*
+	* @note Batches may be nested
+	*/
+	void StagingRing::beginBatch()
+	{
+		batchDepth++;
+	}
+
+	/**
+	* End a batch, submits all of its uploads and waits for them to finish once the outermost batch is ended
+	*/
+	void StagingRing::endBatch()
+	{
+		assert(batchDepth > 0);
+		batchDepth--;
+		flush();
+	}
+
+	/**
+	* Submit all recorded uploads and wait for them to finish, unless called within a batch
+	*
+	* @note Waiting keeps the semantics of the former one-off upload command buffers, uploaded resources can be used on any queue afterwards
+	*/
+	void StagingRing::flush()
+	{
+		if (batchDepth > 0)
+		{
+			return;
+		}
+		submitBatch();
+		while (!submittedBatches.empty())
+		{
+			retireBatch();
+		}
+	}
+
+	/**
+	* Print the amount of data uploaded through the ring and the resulting upload bandwidth
+	*/
+	void StagingRing::printStatistics() const
+	{
+		if (statistics.submits == 0)
+		{
+			return;
+		}
+		const double megabytes = static_cast<double>(statistics.bytes) / (1024.0 * 1024.0);
+		std::cout << std::fixed << std::setprecision(1) << "Staging: uploaded " << megabytes << " MB in " << statistics.submits << " submits";
+		if (statistics.milliseconds > 0.0)
+		{
+			std::cout << " (" << megabytes / (statistics.milliseconds / 1000.0) << " MB/s)";
+		}
+		std::cout << "\n";
+	}
+
+	void StagingRing::submitBatch()
+	{
+		if (currentBatch.commandBuffer == VK_NULL_HANDLE)
+		{
+			// Nothing has been recorded, so the allocations can be reused right away
+			for (auto &dedicatedBuffer : unrecordedBuffers)
+			{
+				vkDestroyBuffer(device->logicalDevice, dedicatedBuffer.first, nullptr);
+				vkFreeMemory(device->logicalDevice, dedicatedBuffer.second, nullptr);
+			}
+			unrecordedBuffers.clear();
+			if (submittedBatches.empty())
+			{
+				tail = head;
+			}
+			currentBatch = Batch();
+			return;
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(currentBatch.commandBuffer));
+		VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(0);
+		VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &currentBatch.fence));
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &currentBatch.commandBuffer;
+		currentBatch.submitTime = std::chrono::high_resolution_clock::now();
+		VK_CHECK_RESULT(vkQueueSubmit(currentBatch.queue, 1, &submitInfo, currentBatch.fence));
+		// A batch without ring allocations must not move the tail back when it's retired
+		currentBatch.end = std::max(currentBatch.end, submittedBatches.empty() ? tail : submittedBatches.back().end);
+		statistics.bytes += currentBatch.bytes;
+		statistics.submits++;
+		submittedBatches.push_back(currentBatch);
+		currentBatch = Batch();
+	}
+
+	StagingRing::Allocation StagingRing::allocateDedicated(VkDeviceSize allocationSize)
+	{
+		Allocation allocation{};
+		VkDeviceMemory dedicatedMemory;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, allocationSize, &allocation.buffer, &dedicatedMemory));
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, dedicatedMemory, 0, VK_WHOLE_SIZE, 0, &allocation.data));
+		unrecordedBuffers.push_back(std::make_pair(allocation.buffer, dedicatedMemory));
+		return allocation;
+	}
+
+	void StagingRing::retireBatch()
+	{
+		assert(!submittedBatches.empty());
+		Batch &batch = submittedBatches.front();
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+		statistics.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - batch.submitTime).count();
+		vkDestroyFence(device->logicalDevice, batch.fence, nullptr);
+		vkFreeCommandBuffers(device->logicalDevice, device->commandPool, 1, &batch.commandBuffer);
+		for (auto &dedicatedBuffer : batch.dedicatedBuffers)
+		{
+			vkDestroyBuffer(device->logicalDevice, dedicatedBuffer.first, nullptr);
+			vkFreeMemory(device->logicalDevice, dedicatedBuffer.second, nullptr);
+		}
+		tail = batch.end;
+		submittedBatches.pop_front();
+	}
+}        // namespace vks
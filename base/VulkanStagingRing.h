@@ -0,0 +1,100 @@
+/*
+ * Vulkan staging ring buffer
+ *
+ * Persistently mapped host visible buffer that is sub-allocated for all staging uploads of a device
+ *
+ * Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <chrono>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+struct VulkanDevice;
+
+/*
+	Uploads allocate staging memory from the ring and record their copies into the command buffer of the current batch
+	Batches are submitted with a fence, and the ring memory they use is reclaimed once that fence has been signaled
+	Allocations that don't fit into the ring get a dedicated buffer that is released along with its batch
+
+	Usage:
+		StagingRing::Allocation staging = device->stagingRing.allocate(size);
+		memcpy(staging.data, ...);
+		VkCommandBuffer copyCmd = device->stagingRing.commandBuffer(queue);
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, ...); (with offsets relative to staging.offset)
+		device->stagingRing.flush();
+
+	Allocating may submit the current batch, so always get the command buffer after allocating and record the copies into that one
+	Uploads done between beginBatch and endBatch are submitted together, e.g. all textures and models loaded by an example's loadAssets
+	The ring is not thread safe and has to be used from a single thread only
+*/
+class StagingRing
+{
+public:
+	struct Allocation
+	{
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		void *data;
+	};
+
+	/** @brief Size of the ring buffer, the buffer is created on the first allocation */
+	VkDeviceSize size = 32 * 1024 * 1024;
+
+	/** @brief Upload statistics */
+	struct Statistics
+	{
+		VkDeviceSize bytes = 0;
+		uint32_t submits = 0;
+		// Time from submitting the batches until their fences were signaled
+		double milliseconds = 0.0;
+	} statistics;
+
+	void            create(VulkanDevice *device);
+	void            destroy();
+	Allocation      allocate(VkDeviceSize allocationSize, VkDeviceSize alignment = 16);
+	VkCommandBuffer commandBuffer(VkQueue queue);
+	void            beginBatch();
+	void            endBatch();
+	void            flush();
+	void            printStatistics() const;
+
+private:
+	struct Batch
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkQueue         queue         = VK_NULL_HANDLE;
+		VkFence         fence         = VK_NULL_HANDLE;
+		// Ring position after the last allocation copied from by this batch
+		VkDeviceSize    end           = 0;
+		VkDeviceSize    bytes         = 0;
+		std::vector<std::pair<VkBuffer, VkDeviceMemory>> dedicatedBuffers;
+		std::chrono::high_resolution_clock::time_point submitTime;
+	};
+
+	VulkanDevice  *device  = nullptr;
+	VkBuffer       buffer  = VK_NULL_HANDLE;
+	VkDeviceMemory memory  = VK_NULL_HANDLE;
+	uint8_t       *mapped  = nullptr;
+	// Monotonically increasing ring positions, allocations are made at head and memory up to tail has been reclaimed
+	VkDeviceSize   head    = 0;
+	VkDeviceSize   tail    = 0;
+	uint32_t       batchDepth = 0;
+	Batch          currentBatch;
+	// Dedicated buffers of allocations made since the last call to commandBuffer
+	std::vector<std::pair<VkBuffer, VkDeviceMemory>> unrecordedBuffers;
+	std::deque<Batch> submittedBatches;
+
+	Allocation allocateDedicated(VkDeviceSize allocationSize);
+	void       submitBatch();
+	void       retireBatch();
+};
+}        // namespace vks
@@ -76,13 +76,9 @@ void VulkanSwapChain::initSurface(uint32_t width, uint32_t height)
 	surfaceCreateInfo.window = window;
 	err = vkCreateXcbSurfaceKHR(instance, &surfaceCreateInfo, nullptr, &surface);
 #elif defined(VK_USE_PLATFORM_HEADLESS_EXT)
-	VkHeadlessSurfaceCreateInfoEXT surfaceCreateInfo = {};
-	surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
-	PFN_vkCreateHeadlessSurfaceEXT fpCreateHeadlessSurfaceEXT = (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT");
-	if (!fpCreateHeadlessSurfaceEXT){
-		vks::tools::exitFatal("Could not fetch function pointer for the headless extension!", -1);
-	}
-	err = fpCreateHeadlessSurfaceEXT(instance, &surfaceCreateInfo, nullptr, &surface);
+	// No surface is created for headless rendering, so this also works with implementations that don't support any window system (e.g. lavapipe)
+	initOffscreen();
+	return;
 #endif
 
 	if (err != VK_SUCCESS) {
@@ -204,9 +200,18 @@ void VulkanSwapChain::connect(VkInstance instance, VkPhysicalDevice physicalDevi
 * @param width Pointer to the width of the swapchain (may be adjusted to fit the requirements of the swapchain)
 * @param height Pointer to the height of the swapchain (may be adjusted to fit the requirements of the swapchain)
 * @param vsync (Optional) Can be used to force vsync-ed rendering (by using VK_PRESENT_MODE_FIFO_KHR as presentation mode)
+* @param fullscreen (Optional) Selects the image count used with vsync (ignored in headless builds)
 */
+#if defined(VK_USE_PLATFORM_HEADLESS_EXT)
+void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool /*vsync*/, bool /*fullscreen*/)
+{
+	// Offscreen images have no present mode or image count to select
+	createOffscreenImages(*width, *height);
+}
+#else
 void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool fullscreen)
 {
+
 	// Store the current swap chain handle so we can use it later on to ease up recreation
 	VkSwapchainKHR oldSwapchain = swapChain;
 
@@ -386,6 +391,7 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 		VK_CHECK_RESULT(vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view));
 	}
 }
+#endif
 
 /** 
 * Acquires the next image in the swap chain
@@ -399,6 +405,18 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 */
 VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t *imageIndex)
 {
+#if defined(VK_USE_PLATFORM_HEADLESS_EXT)
+	// Images are used in order, an empty submission signals the semaphore the same way a presentation engine would
+	currentImage = (currentImage + 1) % imageCount;
+	*imageIndex = currentImage;
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	if (presentCompleteSemaphore != VK_NULL_HANDLE) {
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &presentCompleteSemaphore;
+	}
+	return vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+#endif
 	// By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
 	// With that we don't have to handle VK_NOT_READY
 	return vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence)nullptr, imageIndex);
@@ -415,6 +433,19 @@ VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore,
 */
 VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore)
 {
+#if defined(VK_USE_PLATFORM_HEADLESS_EXT)
+	// Nothing is presented, but the wait semaphore still needs to be consumed so it can be signaled again by the next frame
+	if (waitSemaphore == VK_NULL_HANDLE) {
+		return VK_SUCCESS;
+	}
+	const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.pWaitSemaphores = &waitSemaphore;
+	submitInfo.pWaitDstStageMask = &waitStageMask;
+	return vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+#endif
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.pNext = NULL;
@@ -436,6 +467,10 @@ VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSem
 */
 void VulkanSwapChain::cleanup()
 {
+#if defined(VK_USE_PLATFORM_HEADLESS_EXT)
+	destroyOffscreenImages();
+	return;
+#endif
 	if (swapChain != VK_NULL_HANDLE)
 	{
 		for (uint32_t i = 0; i < imageCount; i++)
@@ -452,6 +487,147 @@ void VulkanSwapChain::cleanup()
 	swapChain = VK_NULL_HANDLE;
 }
 
+#if defined(VK_USE_PLATFORM_HEADLESS_EXT)
+/**
+* Select the queue and color format for headless rendering without a surface
+*/
+void VulkanSwapChain::initOffscreen()
+{
+	surface = VK_NULL_HANDLE;
+
+	uint32_t queueCount;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, NULL);
+	std::vector<VkQueueFamilyProperties> queueProps(queueCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, queueProps.data());
+	for (uint32_t i = 0; i < queueCount; i++)
+	{
+		if ((queueProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0)
+		{
+			queueNodeIndex = i;
+			break;
+		}
+	}
+	if (queueNodeIndex == UINT32_MAX)
+	{
+		vks::tools::exitFatal("Could not find a graphics queue!", -1);
+	}
+
+	// Use the same formats a surface would usually offer, so examples behave like they do with a window
+	std::vector<VkFormat> preferredImageFormats = {
+		VK_FORMAT_B8G8R8A8_UNORM,
+		VK_FORMAT_R8G8B8A8_UNORM,
+		VK_FORMAT_A8B8G8R8_UNORM_PACK32
+	};
+	colorFormat = VK_FORMAT_UNDEFINED;
+	for (auto& format : preferredImageFormats)
+	{
+		VkFormatProperties formatProps;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProps);
+		if (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)
+		{
+			colorFormat = format;
+			break;
+		}
+	}
+	if (colorFormat == VK_FORMAT_UNDEFINED)
+	{
+		vks::tools::exitFatal("Could not find a supported color format for headless rendering!", -1);
+	}
+	colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+}
+
+/**
+* Create the offscreen images that replace the swap chain images in headless builds
+*/
+void VulkanSwapChain::createOffscreenImages(uint32_t width, uint32_t height)
+{
+	destroyOffscreenImages();
+
+	vkGetDeviceQueue(device, queueNodeIndex, 0, &queue);
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	// Same image count and usage a swap chain would typically provide
+	imageCount = 3;
+	images.resize(imageCount);
+	imageMemory.resize(imageCount);
+	buffers.resize(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkImageCreateInfo imageCI = {};
+		imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = colorFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &images[i]));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, images[i], &memReqs);
+		uint32_t memoryTypeIndex = UINT32_MAX;
+		for (uint32_t j = 0; j < memoryProperties.memoryTypeCount; j++)
+		{
+			if ((memReqs.memoryTypeBits & (1 << j)) == 0)
+			{
+				continue;
+			}
+			if (memoryProperties.memoryTypes[j].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+			{
+				memoryTypeIndex = j;
+				break;
+			}
+			if (memoryTypeIndex == UINT32_MAX)
+			{
+				memoryTypeIndex = j;
+			}
+		}
+		VkMemoryAllocateInfo memAlloc = {};
+		memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &imageMemory[i]));
+		VK_CHECK_RESULT(vkBindImageMemory(device, images[i], imageMemory[i], 0));
+
+		VkImageViewCreateInfo colorAttachmentView = {};
+		colorAttachmentView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		colorAttachmentView.format = colorFormat;
+		colorAttachmentView.components = {
+			VK_COMPONENT_SWIZZLE_R,
+			VK_COMPONENT_SWIZZLE_G,
+			VK_COMPONENT_SWIZZLE_B,
+			VK_COMPONENT_SWIZZLE_A
+		};
+		colorAttachmentView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		colorAttachmentView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		colorAttachmentView.image = images[i];
+		buffers[i].image = images[i];
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view));
+	}
+	currentImage = imageCount - 1;
+}
+
+void VulkanSwapChain::destroyOffscreenImages()
+{
+	for (uint32_t i = 0; i < images.size(); i++)
+	{
+		vkDestroyImageView(device, buffers[i].view, nullptr);
+		vkDestroyImage(device, images[i], nullptr);
+		vkFreeMemory(device, imageMemory[i], nullptr);
+	}
+	images.clear();
+	imageMemory.clear();
+	buffers.clear();
+	imageCount = 0;
+}
+#endif
+
 #if defined(_DIRECT2DISPLAY)
 /**
 * Create direct to display surface
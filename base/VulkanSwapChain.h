@@ -48,6 +48,17 @@ public:
 	std::vector<VkImage> images;
 	std::vector<SwapChainBuffer> buffers;
 	uint32_t queueNodeIndex = UINT32_MAX;
+#if defined(VK_USE_PLATFORM_HEADLESS_EXT)
+private:
+	// Headless builds have no surface to present to, the swap chain is replaced by a ring of offscreen images
+	std::vector<VkDeviceMemory> imageMemory;
+	VkQueue queue = VK_NULL_HANDLE;
+	uint32_t currentImage = 0;
+	void initOffscreen();
+	void createOffscreenImages(uint32_t width, uint32_t height);
+	void destroyOffscreenImages();
+public:
+#endif
 
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
 	void initSurface(void* platformHandle, void* platformWindow);
@@ -41,6 +41,8 @@ class Texture
 	uint32_t              layerCount;
 	VkDescriptorImageInfo descriptor;
 	VkSampler             sampler;
+	/** @brief Sub-allocation backing the image if it was created by one of the loaders, deviceMemory then refers to a block shared with other resources */
+	MemoryAllocator::Allocation allocation;
 
 	void      updateDescriptor();
 	void      destroy();
@@ -173,8 +173,20 @@ namespace vks
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 
+		// Geometry buffer with room for a typical UI, cleared so command buffers recorded before the first update draw nothing
+		createGeometryBuffer(8192, 16384);
+		vkCmdFillBuffer(copyCmd, geometryBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+		addGeometryBarrier(copyCmd);
+
 		device->flushCommandBuffer(copyCmd, queue, true);
 
+		// Staging slices are allocated on first use, each frame in flight uploads its geometry with its own command buffer
+		commandPool = device->createCommandPool(device->queueFamilyIndices.graphics);
+		frameSlices.resize(frameCount);
+		for (auto& slice : frameSlices) {
+			slice.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, false);
+		}
+
 		stagingBuffer.destroy();
 
 		// Font texture Sampler
@@ -310,70 +322,216 @@ namespace vks
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 	}
 
-	/** Update vertex and index buffer containing the imGui elements when required */
-	bool UIOverlay::update()
+	VkDeviceSize UIOverlay::indexOffset() const
 	{
-		ImDrawData* imDrawData = ImGui::GetDrawData();
-		bool updateCmdBuffers = false;
+		return vertexCapacity * sizeof(ImDrawVert);
+	}
 
-		if (!imDrawData) { return false; };
+	VkDeviceSize UIOverlay::drawCommandOffset() const
+	{
+		return indexOffset() + indexCapacity * sizeof(uint32_t);
+	}
+
+	/** Create the device local buffer holding vertices, indices and the indirect draw command of the UI */
+	void UIOverlay::createGeometryBuffer(uint32_t vertexCapacity, uint32_t indexCapacity)
+	{
+		this->vertexCapacity = vertexCapacity;
+		this->indexCapacity = indexCapacity;
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&geometryBuffer,
+			drawCommandOffset() + sizeof(VkDrawIndexedIndirectCommand)));
+	}
 
-		// Note: Alignment is done inside buffer creation
-		VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
-		VkDeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
+	/** Make transfer writes to the geometry buffer visible to the draws that follow */
+	void UIOverlay::addGeometryBarrier(const VkCommandBuffer commandBuffer)
+	{
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
 
-		// Update buffers only if vertex or index count has been changed compared to current buffer size
-		if ((vertexBufferSize == 0) || (indexBufferSize == 0)) {
-			return false;
+	/** Append a triangle clipped against an ImGui clip rectangle to the geometry of the current update */
+	void UIOverlay::addClippedTriangle(const ImDrawVert* listVertices, const ImDrawIdx* triangle, uint32_t vertexBase, const ImVec4& clipRect)
+	{
+		bool inside = true;
+		for (uint32_t i = 0; i < 3; i++) {
+			const ImVec2& pos = listVertices[triangle[i]].pos;
+			inside &= (pos.x >= clipRect.x) && (pos.x <= clipRect.z) && (pos.y >= clipRect.y) && (pos.y <= clipRect.w);
+		}
+		// Most triangles are not clipped at all and can reference the list's vertices
+		if (inside) {
+			for (uint32_t i = 0; i < 3; i++) {
+				indices.push_back(vertexBase + triangle[i]);
+			}
+			return;
 		}
 
-		// Vertex buffer
-		if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
-			vertexBuffer.unmap();
-			vertexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vertexBuffer, vertexBufferSize));
-			vertexCount = imDrawData->TotalVtxCount;
-			vertexBuffer.unmap();
-			vertexBuffer.map();
-			updateCmdBuffers = true;
+		// Sutherland-Hodgman against the four edges of the clip rectangle, each edge adds at most one vertex
+		auto lerp = [](const ImDrawVert& a, const ImDrawVert& b, float t) -> ImDrawVert {
+			ImDrawVert v;
+			v.pos = ImVec2(a.pos.x + (b.pos.x - a.pos.x) * t, a.pos.y + (b.pos.y - a.pos.y) * t);
+			v.uv = ImVec2(a.uv.x + (b.uv.x - a.uv.x) * t, a.uv.y + (b.uv.y - a.uv.y) * t);
+			v.col = 0;
+			for (uint32_t shift = 0; shift < 32; shift += 8) {
+				const float ca = (float)((a.col >> shift) & 0xFF);
+				const float cb = (float)((b.col >> shift) & 0xFF);
+				v.col |= (ImU32)(ca + (cb - ca) * t + 0.5f) << shift;
+			}
+			return v;
+		};
+		const float edges[4] = { clipRect.x, clipRect.y, clipRect.z, clipRect.w };
+		ImDrawVert polygons[2][7];
+		uint32_t count = 3;
+		uint32_t current = 0;
+		for (uint32_t i = 0; i < 3; i++) {
+			polygons[current][i] = listVertices[triangle[i]];
 		}
+		for (uint32_t edge = 0; (edge < 4) && (count > 0); edge++) {
+			const ImDrawVert* input = polygons[current];
+			ImDrawVert* output = polygons[1 - current];
+			// Signed distance to the edge, positive on the inner side
+			auto distance = [&](const ImDrawVert& v) -> float {
+				const float d = ((edge % 2 == 0) ? v.pos.x : v.pos.y) - edges[edge];
+				return (edge < 2) ? d : -d;
+			};
+			uint32_t outputCount = 0;
+			for (uint32_t i = 0; i < count; i++) {
+				const ImDrawVert& a = input[i];
+				const ImDrawVert& b = input[(i + 1) % count];
+				const float da = distance(a);
+				const float db = distance(b);
+				if (da >= 0.0f) {
+					output[outputCount++] = a;
+				}
+				if ((da >= 0.0f) != (db >= 0.0f)) {
+					output[outputCount++] = lerp(a, b, da / (da - db));
+				}
+			}
+			count = outputCount;
+			current = 1 - current;
+		}
+		if (count < 3) {
+			return;
+		}
+		const uint32_t first = static_cast<uint32_t>(vertices.size());
+		vertices.insert(vertices.end(), polygons[current], polygons[current] + count);
+		for (uint32_t i = 1; i + 1 < count; i++) {
+			indices.push_back(first);
+			indices.push_back(first + i);
+			indices.push_back(first + i + 1);
+		}
+	}
 
-		// Index buffer
-		if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
-			indexBuffer.unmap();
-			indexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &indexBuffer, indexBufferSize));
-			indexCount = imDrawData->TotalIdxCount;
-			indexBuffer.map();
+	/**
+	* Upload the geometry of the current ImGui frame for the given frame in flight
+	*
+	* The copy is submitted to the overlay's queue ahead of the frame, so it must only be called once that frame's previous submission has completed
+	*
+	* @return True if the geometry buffer had to grow and command buffers need to be rebuilt
+	*/
+	bool UIOverlay::update(uint32_t frame)
+	{
+		ImDrawData* imDrawData = ImGui::GetDrawData();
+		bool updateCmdBuffers = false;
+
+		// Command buffers have been rebuilt after the update that replaced this buffer, and all frames using it have completed
+		retiredGeometryBuffer.destroy();
+
+		vertices.clear();
+		indices.clear();
+		if (imDrawData) {
+			for (int32_t i = 0; i < imDrawData->CmdListsCount; i++) {
+				const ImDrawList* cmd_list = imDrawData->CmdLists[i];
+				const uint32_t vertexBase = static_cast<uint32_t>(vertices.size());
+				vertices.insert(vertices.end(), cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Data + cmd_list->VtxBuffer.Size);
+				uint32_t listIndexOffset = 0;
+				for (int32_t j = 0; j < cmd_list->CmdBuffer.Size; j++) {
+					const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[j];
+					if ((pcmd->ClipRect.z > pcmd->ClipRect.x) && (pcmd->ClipRect.w > pcmd->ClipRect.y)) {
+						for (uint32_t k = 0; k + 2 < pcmd->ElemCount; k += 3) {
+							addClippedTriangle(cmd_list->VtxBuffer.Data, &cmd_list->IdxBuffer.Data[listIndexOffset + k], vertexBase, pcmd->ClipRect);
+						}
+					}
+					listIndexOffset += pcmd->ElemCount;
+				}
+			}
+		}
+		const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+		const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+		// Capacities grow geometrically, so a slowly growing UI only causes a few reallocations
+		if ((vertexCount > vertexCapacity) || (indexCount > indexCapacity)) {
+			auto grow = [](uint32_t capacity, uint32_t count) -> uint32_t {
+				return (count <= capacity) ? capacity : std::max(count, capacity * 2);
+			};
+			// The current buffer is bound by command buffers of frames that may still be in flight
+			retiredGeometryBuffer = geometryBuffer;
+			geometryBuffer = vks::Buffer();
+			createGeometryBuffer(grow(vertexCapacity, vertexCount), grow(indexCapacity, indexCount));
 			updateCmdBuffers = true;
 		}
 
-		// Upload data
-		ImDrawVert* vtxDst = (ImDrawVert*)vertexBuffer.mapped;
-		ImDrawIdx* idxDst = (ImDrawIdx*)indexBuffer.mapped;
+		const VkDeviceSize vertexBytes = vertexCount * sizeof(ImDrawVert);
+		const VkDeviceSize indexBytes = indexCount * sizeof(uint32_t);
+		const VkDeviceSize stagingSize = vertexBytes + indexBytes + sizeof(VkDrawIndexedIndirectCommand);
+		FrameSlice& slice = frameSlices[frame];
+		if ((slice.staging.buffer == VK_NULL_HANDLE) || (slice.staging.size < stagingSize)) {
+			// The slice's previous copy has completed, so it can be replaced right away
+			const VkDeviceSize size = std::max(stagingSize, (slice.staging.buffer != VK_NULL_HANDLE) ? slice.staging.size * 2 : drawCommandOffset() + sizeof(VkDrawIndexedIndirectCommand));
+			slice.staging.destroy();
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &slice.staging, size));
+			VK_CHECK_RESULT(slice.staging.map());
+		}
 
-		for (int n = 0; n < imDrawData->CmdListsCount; n++) {
-			const ImDrawList* cmd_list = imDrawData->CmdLists[n];
-			memcpy(vtxDst, cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
-			memcpy(idxDst, cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
-			vtxDst += cmd_list->VtxBuffer.Size;
-			idxDst += cmd_list->IdxBuffer.Size;
+		uint8_t* data = (uint8_t*)slice.staging.mapped;
+		if (vertexCount > 0) {
+			memcpy(data, vertices.data(), vertexBytes);
+		}
+		if (indexCount > 0) {
+			memcpy(data + vertexBytes, indices.data(), indexBytes);
+		}
+		VkDrawIndexedIndirectCommand drawCommand{};
+		drawCommand.indexCount = indexCount;
+		drawCommand.instanceCount = 1;
+		memcpy(data + vertexBytes + indexBytes, &drawCommand, sizeof(drawCommand));
+		slice.staging.flush();
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(slice.commandBuffer, &cmdBufInfo));
+		// Previous frames may still be drawing from the geometry buffer
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(slice.commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		VkBufferCopy copyRegions[3];
+		uint32_t regionCount = 0;
+		if (vertexBytes > 0) {
+			copyRegions[regionCount++] = { 0, 0, vertexBytes };
+		}
+		if (indexBytes > 0) {
+			copyRegions[regionCount++] = { vertexBytes, indexOffset(), indexBytes };
 		}
+		copyRegions[regionCount++] = { vertexBytes + indexBytes, drawCommandOffset(), sizeof(VkDrawIndexedIndirectCommand) };
+		vkCmdCopyBuffer(slice.commandBuffer, slice.staging.buffer, geometryBuffer.buffer, regionCount, copyRegions);
+		addGeometryBarrier(slice.commandBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(slice.commandBuffer));
 
-		// Flush to make writes visible to GPU
-		vertexBuffer.flush();
-		indexBuffer.flush();
+		// No fence required, the fence of the frame this slice belongs to is signaled after the copy
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &slice.commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		return updateCmdBuffers;
 	}
 
 	void UIOverlay::draw(const VkCommandBuffer commandBuffer)
 	{
-		ImDrawData* imDrawData = ImGui::GetDrawData();
-		int32_t vertexOffset = 0;
-		int32_t indexOffset = 0;
-
-		if ((!imDrawData) || (imDrawData->CmdListsCount == 0)) {
+		if (geometryBuffer.buffer == VK_NULL_HANDLE) {
 			return;
 		}
 
@@ -386,27 +544,11 @@ namespace vks
 		pushConstBlock.translate = glm::vec2(-1.0f);
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
+		// The draw's index count is written by update, so the recorded draw stays valid while the UI changes
 		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-
-		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
-		{
-			const ImDrawList* cmd_list = imDrawData->CmdLists[i];
-			for (int32_t j = 0; j < cmd_list->CmdBuffer.Size; j++)
-			{
-				const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[j];
-				VkRect2D scissorRect;
-				scissorRect.offset.x = std::max((int32_t)(pcmd->ClipRect.x), 0);
-				scissorRect.offset.y = std::max((int32_t)(pcmd->ClipRect.y), 0);
-				scissorRect.extent.width = (uint32_t)(pcmd->ClipRect.z - pcmd->ClipRect.x);
-				scissorRect.extent.height = (uint32_t)(pcmd->ClipRect.w - pcmd->ClipRect.y);
-				vkCmdSetScissor(commandBuffer, 0, 1, &scissorRect);
-				vkCmdDrawIndexed(commandBuffer, pcmd->ElemCount, 1, indexOffset, vertexOffset, 0);
-				indexOffset += pcmd->ElemCount;
-			}
-			vertexOffset += cmd_list->VtxBuffer.Size;
-		}
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &geometryBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, geometryBuffer.buffer, indexOffset(), VK_INDEX_TYPE_UINT32);
+		vkCmdDrawIndexedIndirect(commandBuffer, geometryBuffer.buffer, drawCommandOffset(), 1, sizeof(VkDrawIndexedIndirectCommand));
 	}
 
 	void UIOverlay::resize(uint32_t width, uint32_t height)
@@ -417,8 +559,12 @@ namespace vks
 
 	void UIOverlay::freeResources()
 	{
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		geometryBuffer.destroy();
+		retiredGeometryBuffer.destroy();
+		for (auto& slice : frameSlices) {
+			slice.staging.destroy();
+		}
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
 		vkDestroyImageView(device->logicalDevice, fontView, nullptr);
 		vkDestroyImage(device->logicalDevice, fontImage, nullptr);
 		vkFreeMemory(device->logicalDevice, fontMemory, nullptr);
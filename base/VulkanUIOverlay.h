@@ -39,10 +39,17 @@ namespace vks
 		VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 		uint32_t subpass = 0;
 
-		vks::Buffer vertexBuffer;
-		vks::Buffer indexBuffer;
-		int32_t vertexCount = 0;
-		int32_t indexCount = 0;
+		/*
+			Vertices, indices and the draw command of the UI share one device local buffer that is drawn with a single indirect draw,
+			so recorded command buffers stay valid while the UI changes. Each frame in flight copies its geometry from its own
+			persistently mapped staging slice, and both grow geometrically, so nothing is reallocated once the UI has reached its size.
+			The overlay pipeline has no per-draw scissors, so ImGui's clip rectangles are applied to the triangles on the CPU instead.
+		*/
+		vks::Buffer geometryBuffer;
+		uint32_t vertexCapacity = 0;
+		uint32_t indexCapacity = 0;
+		// Number of frames in flight, set before prepareResources
+		uint32_t frameCount = 1;
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaders;
 
@@ -72,7 +79,7 @@ namespace vks
 		void preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat, const VkFormat depthFormat);
 		void prepareResources();
 
-		bool update();
+		bool update(uint32_t frame = 0);
 		void draw(const VkCommandBuffer commandBuffer);
 		void resize(uint32_t width, uint32_t height);
 
@@ -89,5 +96,23 @@ namespace vks
 		bool button(const char* caption);
 		bool colorPicker(const char* caption, float* color);
 		void text(const char* formatstr, ...);
+	private:
+		struct FrameSlice {
+			vks::Buffer staging;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		};
+		std::vector<FrameSlice> frameSlices;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		// Geometry buffer replaced by a larger one, kept until the command buffers using it have been rebuilt
+		vks::Buffer retiredGeometryBuffer;
+		// Clipped geometry of the current update, kept to avoid allocations in steady state
+		std::vector<ImDrawVert> vertices;
+		std::vector<uint32_t> indices;
+
+		VkDeviceSize indexOffset() const;
+		VkDeviceSize drawCommandOffset() const;
+		void createGeometryBuffer(uint32_t vertexCapacity, uint32_t indexCapacity);
+		void addGeometryBarrier(const VkCommandBuffer commandBuffer);
+		void addClippedTriangle(const ImDrawVert* listVertices, const ImDrawIdx* triangle, uint32_t vertexBase, const ImVec4& clipRect);
 	};
 }
@@ -0,0 +1,95 @@
+/*
+ * Vulkan uniform arena
+ *
+ * Persistently mapped uniform buffer that is bump allocated for dynamic uniform blocks written every frame
+ *
+ * Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#include "VulkanUniformArena.h"
+#include "VulkanDevice.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	/**
+	* Create the arena's buffer and keep it mapped for its whole lifetime
+	*
+	* @param device Device to create the buffer on
+	* @param frameSize Size of the region available to each frame
+	* @param frameCount Number of frames in flight, each one gets its own region
+	*/
+	void UniformArena::create(VulkanDevice *device, VkDeviceSize frameSize, uint32_t frameCount)
+	{
+		const VkPhysicalDeviceLimits &limits = device->properties.limits;
+		alignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 16);
+		this->frameSize = (frameSize + alignment - 1) & ~(alignment - 1);
+		maxRange = std::min<VkDeviceSize>(limits.maxUniformBufferRange, 65536);
+		// Dynamic offsets are 32 bit
+		assert(this->frameSize * frameCount + maxRange <= UINT32_MAX);
+		// Host coherent memory, so writes don't need to be flushed
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, this->frameSize * frameCount + maxRange));
+		VK_CHECK_RESULT(buffer.map());
+		frameStart = 0;
+		head = 0;
+	}
+
+	void UniformArena::destroy()
+	{
+		buffer.destroy();
+		frameSize = 0;
+	}
+
+	/**
+	* Start writing the blocks of a frame, all blocks previously allocated from the frame's region are discarded
+	*
+	* @param frame Index of the frame in flight, the GPU must have finished the frame that last used this index
+	*/
+	void UniformArena::beginFrame(uint32_t frame)
+	{
+		peakUsage = std::max(peakUsage, head);
+		frameStart = frame * frameSize;
+		head = 0;
+	}
+
+	/**
+	* Allocate a uniform block from the current frame's region
+	*
+	* @param size Size of the block
+	*
+	* @return Pointer to the mapped memory the block has to be written to and its dynamic offset
+	*/
+	UniformArena::Allocation UniformArena::allocate(VkDeviceSize size)
+	{
+		assert(buffer.mapped);
+		assert(size <= maxRange);
+		const VkDeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+		if (offset + size > frameSize)
+		{
+			vks::tools::exitFatal("Uniform arena exhausted, increase the uniform arena size of the example (currently " + std::to_string(frameSize) + " bytes per frame)", VK_ERROR_OUT_OF_DEVICE_MEMORY);
+		}
+		head = offset + size;
+		Allocation allocation{};
+		allocation.offset = static_cast<uint32_t>(frameStart + offset);
+		allocation.data = static_cast<uint8_t *>(buffer.mapped) + allocation.offset;
+		return allocation;
+	}
+
+	/**
+	* Get the descriptor for binding blocks of the arena as dynamic uniform buffers
+	*
+	* @param range Size of the uniform block(s) bound through the descriptor
+	*/
+	VkDescriptorBufferInfo UniformArena::descriptor(VkDeviceSize range) const
+	{
+		assert(range <= maxRange);
+		VkDescriptorBufferInfo descriptor{};
+		descriptor.buffer = buffer.buffer;
+		descriptor.offset = 0;
+		descriptor.range = range;
+		return descriptor;
+	}
+}
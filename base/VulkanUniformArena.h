@@ -0,0 +1,74 @@
+/*
+ * Vulkan uniform arena
+ *
+ * Persistently mapped uniform buffer that is bump allocated for dynamic uniform blocks written every frame
+ *
+ * Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#pragma once
+
+#include <cstring>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+struct VulkanDevice;
+
+/*
+	The arena's buffer is split into one region per frame in flight, blocks written for a frame are allocated from that frame's region
+	Allocating a block only bumps an offset, so any number of per-object or per-pass blocks can be written each frame
+	All blocks are accessed through a single VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor and selected with their dynamic offset
+
+	Usage:
+		Descriptor set (once):
+			VkDescriptorBufferInfo bufferInfo = uniformArena.descriptor(sizeof(UniformData));
+			writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &bufferInfo);
+		Each frame (after the frame's fence has been waited on, the base class resets the region in prepareFrame):
+			uint32_t offset = uniformArena.push(uniformData);
+			vkCmdBindDescriptorSets(..., 1, &offset);
+
+	Pre-recorded command buffers bake in their dynamic offsets, so they only see updated data if the same blocks are pushed in the same order every frame with a single frame in flight
+*/
+class UniformArena
+{
+public:
+	struct Allocation
+	{
+		void *data;
+		// Dynamic offset of the block
+		uint32_t offset;
+	};
+
+	/** @brief Largest number of bytes used within a single frame so far */
+	VkDeviceSize peakUsage = 0;
+
+	void                   create(VulkanDevice *device, VkDeviceSize frameSize, uint32_t frameCount);
+	void                   destroy();
+	void                   beginFrame(uint32_t frame);
+	Allocation             allocate(VkDeviceSize size);
+	VkDescriptorBufferInfo descriptor(VkDeviceSize range) const;
+
+	/** @brief Copies a uniform block into the current frame's region and returns its dynamic offset */
+	template <typename T>
+	uint32_t push(const T &data)
+	{
+		Allocation allocation = allocate(sizeof(T));
+		memcpy(allocation.data, &data, sizeof(T));
+		return allocation.offset;
+	}
+
+private:
+	vks::Buffer  buffer;
+	VkDeviceSize alignment  = 256;
+	VkDeviceSize frameSize  = 0;
+	// Blocks may be bound with a larger range than their own size, so the buffer is padded by the largest supported range
+	VkDeviceSize maxRange   = 0;
+	VkDeviceSize frameStart = 0;
+	VkDeviceSize head       = 0;
+};
+}        // namespace vks
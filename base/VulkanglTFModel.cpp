@@ -12,11 +12,33 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "VulkanglTFModel.h"
+#include "jobsystem.hpp"
+#include "mappedfile.hpp"
+#include "meshoptimizer.hpp"
+#include "tracer.hpp"
+
+#include <mutex>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <glm/gtc/packing.hpp>
+
+// Keyframes are blended with 4-wide vector instructions if they're enabled for the build
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VKGLTF_ANIMATION_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VKGLTF_ANIMATION_NEON
+#endif
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+std::string vkglTF::geometryCachePath = "";
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
@@ -39,6 +61,20 @@ bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::s
 	return true;
 }
 
+bool loadImageDataFuncDeferred(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
+{
+	// KTX files will be handled by our own code
+	if (image->uri.find_last_of(".") != std::string::npos) {
+		if (image->uri.substr(image->uri.find_last_of(".") + 1) == "ktx") {
+			return true;
+		}
+	}
+	// Keep the encoded image data, it's decoded on a worker thread when loading images asynchronously
+	image->image.assign(bytes, bytes + size);
+	image->as_is = true;
+	return true;
+}
+
 
 /*
 	glTF texture loading class
@@ -57,7 +93,7 @@ void vkglTF::Texture::destroy()
 	{
 		vkDestroyImageView(device->logicalDevice, view, nullptr);
 		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		device->memoryAllocator.free(allocation);
 		vkDestroySampler(device->logicalDevice, sampler, nullptr);
 	}
 }
@@ -115,29 +151,11 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
 
-		VkMemoryAllocateInfo memAllocInfo{};
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 		VkMemoryRequirements memReqs{};
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo{};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = bufferSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		// Copy the image data into the device's staging ring
+		vks::StagingRing::Allocation staging = device->stagingRing.allocate(bufferSize);
+		memcpy(staging.data, buffer, bufferSize);
 
 		VkImageCreateInfo imageCreateInfo{};
 		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -154,12 +172,13 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		// Model textures live as long as the model, so they're tightly packed into linear blocks
+		VK_CHECK_RESULT(device->memoryAllocator.allocate(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vks::MemoryAllocator::ResourceType::Optimal, &allocation, vks::MemoryAllocator::Strategy::Linear));
+		deviceMemory = allocation.memory;
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, allocation.offset));
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// Copy and mip chain generation are recorded into the current batch of the device's staging ring
+		VkCommandBuffer copyCmd = device->stagingRing.commandBuffer(copyQueue);
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -186,8 +205,9 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		bufferCopyRegion.imageExtent.width = width;
 		bufferCopyRegion.imageExtent.height = height;
 		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = staging.offset;
 
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
 		{
 			VkImageMemoryBarrier imageMemoryBarrier{};
@@ -201,13 +221,9 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 		}
 
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
 		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// The barrier above makes the copied base level available to the blits, so they can go into the same command buffer
+		VkCommandBuffer blitCmd = copyCmd;
 		for (uint32_t i = 1; i < mipLevels; i++) {
 			VkImageBlit imageBlit{};
 
@@ -277,7 +293,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
             delete[] buffer;
         }
 
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
+		device->stagingRing.flush();
 	}
 	else {
 		// Texture is stored in an external ktx file
@@ -320,29 +336,9 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		// Copy the texture data into the device's staging ring
+		vks::StagingRing::Allocation staging = device->stagingRing.allocate(ktxTextureSize);
+		memcpy(staging.data, ktxTextureData, ktxTextureSize);
 
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
 		for (uint32_t i = 0; i < mipLevels; i++)
@@ -358,7 +354,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 			bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
 			bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
 			bufferCopyRegion.imageExtent.depth = 1;
-			bufferCopyRegion.bufferOffset = offset;
+			bufferCopyRegion.bufferOffset = staging.offset + offset;
 			bufferCopyRegions.push_back(bufferCopyRegion);
 		}
 
@@ -376,11 +372,11 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
+		VkMemoryRequirements memReqs;
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		VK_CHECK_RESULT(device->memoryAllocator.allocate(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vks::MemoryAllocator::ResourceType::Optimal, &allocation, vks::MemoryAllocator::Strategy::Linear));
+		deviceMemory = allocation.memory;
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, allocation.offset));
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -388,18 +384,21 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		subresourceRange.levelCount = mipLevels;
 		subresourceRange.layerCount = 1;
 
+		VkCommandBuffer copyCmd = device->stagingRing.commandBuffer(copyQueue);
 		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
 		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		device->stagingRing.flush();
 		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
 		ktxTexture_Destroy(ktxTexture);
 	}
 
+	createSamplerAndView(format);
+}
+
+void vkglTF::Texture::createSamplerAndView(VkFormat format)
+{
 	VkSamplerCreateInfo samplerInfo{};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -435,6 +434,17 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 /*
 	glTF material
 */
+bool vkglTF::Material::isResident() const
+{
+	const vkglTF::Texture* materialTextures[] = { baseColorTexture, metallicRoughnessTexture, normalTexture, occlusionTexture, emissiveTexture };
+	for (const vkglTF::Texture* texture : materialTextures) {
+		if (texture && !texture->resident) {
+			return false;
+		}
+	}
+	return true;
+}
+
 void vkglTF::Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
 {
 	VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
@@ -493,29 +503,269 @@ vkglTF::Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix) {
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		sizeof(uniformBlock),
 		&uniformBuffer.buffer,
-		&uniformBuffer.memory,
-		&uniformBlock));
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
+		&uniformBuffer.allocation,
+		&uniformBlock,
+		vks::MemoryAllocator::Strategy::Linear));
+	uniformBuffer.memory = uniformBuffer.allocation.memory;
+	uniformBuffer.mapped = uniformBuffer.allocation.mapped;
 	uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
 };
 
 vkglTF::Mesh::~Mesh() {
 	vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
+	device->memoryAllocator.free(uniformBuffer.allocation);
     for(auto primitive : primitives)
     {
         delete primitive;
     }
 }
 
+/*
+	Flattened node transforms
+*/
+void vkglTF::NodeTransforms::build(const std::vector<Node*>& roots)
+{
+	nodes.clear();
+	parents.clear();
+	translations.clear();
+	rotations.clear();
+	scales.clear();
+	matrices.clear();
+	hasMatrix.clear();
+	// Depth-first pre-order keeps the nodes of a subtree next to each other
+	std::vector<Node*> stack(roots.rbegin(), roots.rend());
+	while (!stack.empty()) {
+		Node* node = stack.back();
+		stack.pop_back();
+		node->transforms = this;
+		node->transformIndex = static_cast<uint32_t>(nodes.size());
+		nodes.push_back(node);
+		parents.push_back(node->parent ? static_cast<int32_t>(node->parent->transformIndex) : -1);
+		translations.push_back(node->translation);
+		rotations.push_back(node->rotation);
+		scales.push_back(node->scale);
+		matrices.push_back(node->matrix);
+		hasMatrix.push_back(node->matrix != glm::mat4(1.0f) ? 1 : 0);
+		stack.insert(stack.end(), node->children.rbegin(), node->children.rend());
+	}
+	worldMatrices.resize(nodes.size());
+	dirty.assign(nodes.size(), 1);
+	updated.assign(nodes.size(), 0);
+	updatedCount = 0;
+	anyDirty = !nodes.empty();
+	update();
+}
+
+void vkglTF::NodeTransforms::setTranslation(uint32_t index, const glm::vec3& translation)
+{
+	translations[index] = translation;
+	dirty[index] = 1;
+	anyDirty = true;
+}
+
+void vkglTF::NodeTransforms::setRotation(uint32_t index, const glm::quat& rotation)
+{
+	rotations[index] = rotation;
+	dirty[index] = 1;
+	anyDirty = true;
+}
+
+void vkglTF::NodeTransforms::setScale(uint32_t index, const glm::vec3& scale)
+{
+	scales[index] = scale;
+	dirty[index] = 1;
+	anyDirty = true;
+}
+
+// Same as translate * rotate * scale * matrix, but without the full matrix products
+glm::mat4 vkglTF::NodeTransforms::localMatrix(uint32_t index) const
+{
+	glm::mat4 local = glm::mat4(rotations[index]);
+	local[0] *= scales[index].x;
+	local[1] *= scales[index].y;
+	local[2] *= scales[index].z;
+	local[3] = glm::vec4(translations[index], 1.0f);
+	return hasMatrix[index] ? local * matrices[index] : local;
+}
+
+void vkglTF::NodeTransforms::update()
+{
+	if (!anyDirty) {
+		return;
+	}
+	const size_t count = parents.size();
+	for (size_t i = 0; i < count; i++) {
+		const int32_t parent = parents[i];
+		// Parents are visited before their children, so a dirty parent marks its whole subtree
+		if ((parent >= 0) && dirty[parent]) {
+			dirty[i] = 1;
+		}
+		if (!dirty[i]) {
+			continue;
+		}
+		worldMatrices[i] = (parent >= 0) ? worldMatrices[parent] * localMatrix(static_cast<uint32_t>(i)) : localMatrix(static_cast<uint32_t>(i));
+		if (!updated[i]) {
+			updated[i] = 1;
+			updatedCount++;
+		}
+	}
+	std::fill(dirty.begin(), dirty.end(), 0);
+	anyDirty = false;
+}
+
+void vkglTF::NodeTransforms::clearUpdated()
+{
+	if (updatedCount > 0) {
+		std::fill(updated.begin(), updated.end(), 0);
+		updatedCount = 0;
+	}
+}
+
+/*
+	glTF animation
+*/
+
+// Weighted sum of keyframe outputs, count is 2 or 4
+static glm::vec4 blendKeys(const glm::vec4* values[4], const float weights[4], uint32_t count)
+{
+	glm::vec4 result;
+#if defined(VKGLTF_ANIMATION_SSE2)
+	__m128 sum = _mm_mul_ps(_mm_loadu_ps(&values[0]->x), _mm_set1_ps(weights[0]));
+	for (uint32_t i = 1; i < count; i++) {
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&values[i]->x), _mm_set1_ps(weights[i])));
+	}
+	_mm_storeu_ps(&result.x, sum);
+#elif defined(VKGLTF_ANIMATION_NEON)
+	float32x4_t sum = vmulq_n_f32(vld1q_f32(&values[0]->x), weights[0]);
+	for (uint32_t i = 1; i < count; i++) {
+		sum = vmlaq_n_f32(sum, vld1q_f32(&values[i]->x), weights[i]);
+	}
+	vst1q_f32(&result.x, sum);
+#else
+	result = *values[0] * weights[0];
+	for (uint32_t i = 1; i < count; i++) {
+		result += *values[i] * weights[i];
+	}
+#endif
+	return result;
+}
+
+bool vkglTF::AnimationSampler::valid() const
+{
+	const size_t outputsPerKey = (interpolation == InterpolationType::CUBICSPLINE) ? 3 : 1;
+	return (inputs.size() >= 2) && (outputsVec4.size() >= inputs.size() * outputsPerKey);
+}
+
+uint32_t vkglTF::AnimationSampler::findKey(float time, uint32_t& key) const
+{
+	const uint32_t lastKey = static_cast<uint32_t>(inputs.size()) - 2;
+	key = std::min(key, lastKey);
+	// During playback time advances by less than a keyframe interval most of the time, so the last key and its successor are checked first
+	if (time >= inputs[key]) {
+		if (time <= inputs[key + 1]) {
+			return key;
+		}
+		if ((key < lastKey) && (time <= inputs[key + 2])) {
+			return ++key;
+		}
+	}
+	// Seeks and loops use a binary search
+	const uint32_t upper = static_cast<uint32_t>(std::upper_bound(inputs.begin(), inputs.end(), time) - inputs.begin());
+	key = std::min((upper > 0) ? upper - 1 : 0, lastKey);
+	return key;
+}
+
+glm::vec4 vkglTF::AnimationSampler::evaluate(float time, uint32_t& key, bool rotation) const
+{
+	const uint32_t index = findKey(time, key);
+	const float interval = inputs[index + 1] - inputs[index];
+	const float u = (interval > 0.0f) ? std::min(std::max((time - inputs[index]) / interval, 0.0f), 1.0f) : 0.0f;
+	const glm::vec4* values[4];
+	float weights[4];
+	switch (interpolation) {
+	case InterpolationType::STEP:
+		return outputsVec4[index];
+	case InterpolationType::CUBICSPLINE: {
+		// Hermite spline with the out-tangent of the first and the in-tangent of the second keyframe scaled by the interval
+		const float u2 = u * u;
+		const float u3 = u2 * u;
+		values[0] = &outputsVec4[index * 3 + 1];
+		values[1] = &outputsVec4[index * 3 + 2];
+		values[2] = &outputsVec4[(index + 1) * 3 + 1];
+		values[3] = &outputsVec4[(index + 1) * 3];
+		weights[0] = 2.0f * u3 - 3.0f * u2 + 1.0f;
+		weights[1] = (u3 - 2.0f * u2 + u) * interval;
+		weights[2] = -2.0f * u3 + 3.0f * u2;
+		weights[3] = (u3 - u2) * interval;
+		const glm::vec4 value = blendKeys(values, weights, 4);
+		return rotation ? glm::normalize(value) : value;
+	}
+	default: {
+		values[0] = &outputsVec4[index];
+		values[1] = &outputsVec4[index + 1];
+		weights[0] = 1.0f - u;
+		weights[1] = u;
+		if (rotation) {
+			// Spherical interpolation along the shortest path, nearly parallel rotations are interpolated linearly
+			float cosTheta = glm::dot(*values[0], *values[1]);
+			const float sign = (cosTheta < 0.0f) ? -1.0f : 1.0f;
+			cosTheta *= sign;
+			if (cosTheta < 0.9995f) {
+				const float theta = acosf(cosTheta);
+				const float sinTheta = sinf(theta);
+				weights[0] = sinf((1.0f - u) * theta) / sinTheta;
+				weights[1] = sinf(u * theta) / sinTheta;
+			}
+			weights[1] *= sign;
+			return glm::normalize(blendKeys(values, weights, 2));
+		}
+		return blendKeys(values, weights, 2);
+	}
+	}
+}
+
+bool vkglTF::Animation::update(float time)
+{
+	bool updated = false;
+	for (auto& channel : channels) {
+		const AnimationSampler& sampler = samplers[channel.samplerIndex];
+		if (!sampler.valid() || (time < sampler.inputs.front()) || (time > sampler.inputs.back()) || !channel.node->transforms) {
+			continue;
+		}
+		const glm::vec4 value = sampler.evaluate(time, channel.key, channel.path == AnimationChannel::PathType::ROTATION);
+		NodeTransforms* transforms = channel.node->transforms;
+		switch (channel.path) {
+		case AnimationChannel::PathType::TRANSLATION:
+			transforms->setTranslation(channel.node->transformIndex, glm::vec3(value));
+			break;
+		case AnimationChannel::PathType::SCALE:
+			transforms->setScale(channel.node->transformIndex, glm::vec3(value));
+			break;
+		case AnimationChannel::PathType::ROTATION:
+			transforms->setRotation(channel.node->transformIndex, glm::make_quat(&value.x));
+			break;
+		}
+		updated = true;
+	}
+	return updated;
+}
+
 /*
 	glTF node
 */
 glm::mat4 vkglTF::Node::localMatrix() {
+	if (transforms) {
+		return transforms->localMatrix(transformIndex);
+	}
 	return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
 }
 
 glm::mat4 vkglTF::Node::getMatrix() {
+	// Nodes of flattened transforms use the cached world matrix instead of walking up the hierarchy
+	if (transforms) {
+		transforms->update();
+		return transforms->worldMatrices[transformIndex];
+	}
 	glm::mat4 m = localMatrix();
 	vkglTF::Node *p = parent;
 	while (p) {
@@ -525,7 +775,7 @@ glm::mat4 vkglTF::Node::getMatrix() {
 	return m;
 }
 
-void vkglTF::Node::update() {
+void vkglTF::Node::updateMesh() {
 	if (mesh) {
 		glm::mat4 m = getMatrix();
 		if (skin) {
@@ -544,7 +794,10 @@ void vkglTF::Node::update() {
 			memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
 		}
 	}
+}
 
+void vkglTF::Node::update() {
+	updateMesh();
 	for (auto& child : children) {
 		child->update();
 	}
@@ -614,6 +867,185 @@ VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputStat
 	return &pipelineVertexInputStateCreateInfo;
 }
 
+/*
+	Packed vertex layout
+*/
+
+namespace
+{
+	uint32_t packedFormatSize(VkFormat format)
+	{
+		switch (format) {
+			case VK_FORMAT_R32G32B32_SFLOAT:
+				return 12;
+			case VK_FORMAT_R16G16B16A16_UNORM:
+			case VK_FORMAT_R16G16B16A16_UINT:
+				return 8;
+			default:
+				return 4;
+		}
+	}
+}
+
+void vkglTF::VertexLayout::prepare(const Vertex* vertices, size_t vertexCount)
+{
+	const bool quantize = quantizePositions && (std::find(components.begin(), components.end(), VertexComponent::Position) != components.end());
+	const bool hasJoints = std::find(components.begin(), components.end(), VertexComponent::Joint0) != components.end();
+	glm::vec3 posMin(std::numeric_limits<float>::max());
+	glm::vec3 posMax(-std::numeric_limits<float>::max());
+	float maxJoint = 0.0f;
+	for (size_t i = 0; i < vertexCount; i++) {
+		if (quantize) {
+			posMin = glm::min(posMin, vertices[i].pos);
+			posMax = glm::max(posMax, vertices[i].pos);
+		}
+		if (hasJoints) {
+			const glm::vec4& joint = vertices[i].joint0;
+			maxJoint = std::max(maxJoint, std::max(std::max(joint.x, joint.y), std::max(joint.z, joint.w)));
+		}
+	}
+
+	// Positions are quantized with the same scale for all axes, so the dequantization doesn't distort normals
+	dequantizationMatrix = glm::mat4(1.0f);
+	if (quantize && (vertexCount > 0)) {
+		const glm::vec3 extent = posMax - posMin;
+		float scale = std::max(std::max(extent.x, extent.y), extent.z);
+		if (scale <= 0.0f) {
+			scale = 1.0f;
+		}
+		dequantizationMatrix = glm::scale(glm::translate(glm::mat4(1.0f), posMin), glm::vec3(scale));
+	}
+
+	formats.clear();
+	offsets.clear();
+	stride = 0;
+	for (VertexComponent component : components) {
+		VkFormat format;
+		switch (component) {
+			case VertexComponent::Position:
+				format = quantizePositions ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+				break;
+			case VertexComponent::Normal:
+			case VertexComponent::Tangent:
+				format = VK_FORMAT_R8G8B8A8_SNORM;
+				break;
+			case VertexComponent::UV:
+				format = VK_FORMAT_R16G16_SFLOAT;
+				break;
+			case VertexComponent::Joint0:
+				format = (maxJoint < 256.0f) ? VK_FORMAT_R8G8B8A8_UINT : VK_FORMAT_R16G16B16A16_UINT;
+				break;
+			default:
+				format = VK_FORMAT_R8G8B8A8_UNORM;
+		}
+		formats.push_back(format);
+		offsets.push_back(stride);
+		stride += packedFormatSize(format);
+	}
+}
+
+void vkglTF::VertexLayout::pack(const Vertex* vertices, size_t vertexCount, void* dst) const
+{
+	VKS_TRACE_ZONE("vkglTF::VertexLayout::pack");
+	const glm::vec3 positionOffset = glm::vec3(dequantizationMatrix[3]);
+	const float positionScale = 1.0f / dequantizationMatrix[0][0];
+	uint8_t* packed = static_cast<uint8_t*>(dst);
+	for (size_t i = 0; i < vertexCount; i++) {
+		const Vertex& vertex = vertices[i];
+		for (size_t c = 0; c < components.size(); c++) {
+			uint8_t* attribute = packed + offsets[c];
+			switch (components[c]) {
+				case VertexComponent::Position:
+					if (quantizePositions) {
+						const glm::vec3 position = glm::clamp((vertex.pos - positionOffset) * positionScale, 0.0f, 1.0f);
+						const uint64_t value = glm::packUnorm4x16(glm::vec4(position, 1.0f));
+						memcpy(attribute, &value, sizeof(value));
+					} else {
+						memcpy(attribute, &vertex.pos, sizeof(glm::vec3));
+					}
+					break;
+				case VertexComponent::Normal: {
+					const uint32_t value = glm::packSnorm4x8(glm::vec4(vertex.normal, 0.0f));
+					memcpy(attribute, &value, sizeof(value));
+					break;
+				}
+				case VertexComponent::UV: {
+					const uint32_t value = glm::packHalf2x16(vertex.uv);
+					memcpy(attribute, &value, sizeof(value));
+					break;
+				}
+				case VertexComponent::Color: {
+					const uint32_t value = glm::packUnorm4x8(vertex.color);
+					memcpy(attribute, &value, sizeof(value));
+					break;
+				}
+				case VertexComponent::Tangent: {
+					const uint32_t value = glm::packSnorm4x8(vertex.tangent);
+					memcpy(attribute, &value, sizeof(value));
+					break;
+				}
+				case VertexComponent::Joint0:
+					for (uint32_t j = 0; j < 4; j++) {
+						if (formats[c] == VK_FORMAT_R8G8B8A8_UINT) {
+							attribute[j] = static_cast<uint8_t>(vertex.joint0[j]);
+						} else {
+							const uint16_t joint = static_cast<uint16_t>(vertex.joint0[j]);
+							memcpy(attribute + j * sizeof(uint16_t), &joint, sizeof(uint16_t));
+						}
+					}
+					break;
+				case VertexComponent::Weight0: {
+					// Rounding errors are added to the largest weight, so the weights still sum up to one
+					int32_t weights[4];
+					int32_t sum = 0;
+					uint32_t largest = 0;
+					for (uint32_t j = 0; j < 4; j++) {
+						weights[j] = static_cast<int32_t>(glm::clamp(vertex.weight0[j], 0.0f, 1.0f) * 255.0f + 0.5f);
+						sum += weights[j];
+						largest = (weights[j] > weights[largest]) ? j : largest;
+					}
+					if (sum > 0) {
+						weights[largest] = glm::clamp(weights[largest] + 255 - sum, 0, 255);
+					}
+					for (uint32_t j = 0; j < 4; j++) {
+						attribute[j] = static_cast<uint8_t>(weights[j]);
+					}
+					break;
+				}
+			}
+		}
+		packed += stride;
+	}
+}
+
+VkVertexInputBindingDescription vkglTF::VertexLayout::inputBindingDescription(uint32_t binding) const
+{
+	return VkVertexInputBindingDescription({ binding, stride, VK_VERTEX_INPUT_RATE_VERTEX });
+}
+
+std::vector<VkVertexInputAttributeDescription> vkglTF::VertexLayout::inputAttributeDescriptions(uint32_t binding) const
+{
+	std::vector<VkVertexInputAttributeDescription> result;
+	for (uint32_t location = 0; location < static_cast<uint32_t>(formats.size()); location++) {
+		result.push_back(VkVertexInputAttributeDescription({ location, binding, formats[location], offsets[location] }));
+	}
+	return result;
+}
+
+VkPipelineVertexInputStateCreateInfo* vkglTF::VertexLayout::getPipelineVertexInputState()
+{
+	assert(stride > 0);
+	vertexInputBindingDescription = inputBindingDescription(0);
+	vertexInputAttributeDescriptions = inputAttributeDescriptions(0);
+	pipelineVertexInputStateCreateInfo = {};
+	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &vertexInputBindingDescription;
+	pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributeDescriptions.size());
+	pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexInputAttributeDescriptions.data();
+	return &pipelineVertexInputStateCreateInfo;
+}
+
 vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
 {
 
@@ -632,31 +1064,8 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	emptyTexture.mipLevels = 1;
 
 	size_t bufferSize = emptyTexture.width * emptyTexture.height * 4;
-	unsigned char* buffer = new unsigned char[bufferSize];
-	memset(buffer, 0, bufferSize);
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingMemory;
-	VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-	bufferCreateInfo.size = bufferSize;
-	// This buffer is used as a transfer source for the buffer copy
-	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-	VkMemoryRequirements memReqs;
-	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-	// Copy texture data into staging buffer
-	uint8_t* data;
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-	memcpy(data, buffer, bufferSize);
-	vkUnmapMemory(device->logicalDevice, stagingMemory);
+	vks::StagingRing::Allocation staging = device->stagingRing.allocate(bufferSize);
+	memset(staging.data, 0, bufferSize);
 
 	VkBufferImageCopy bufferCopyRegion = {};
 	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -664,6 +1073,7 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	bufferCopyRegion.imageExtent.width = emptyTexture.width;
 	bufferCopyRegion.imageExtent.height = emptyTexture.height;
 	bufferCopyRegion.imageExtent.depth = 1;
+	bufferCopyRegion.bufferOffset = staging.offset;
 
 	// Create optimal tiled target image
 	VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -679,11 +1089,11 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &emptyTexture.image));
 
+	VkMemoryRequirements memReqs;
 	vkGetImageMemoryRequirements(device->logicalDevice, emptyTexture.image, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &emptyTexture.deviceMemory));
-	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, emptyTexture.image, emptyTexture.deviceMemory, 0));
+	VK_CHECK_RESULT(device->memoryAllocator.allocate(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vks::MemoryAllocator::ResourceType::Optimal, &emptyTexture.allocation, vks::MemoryAllocator::Strategy::Linear));
+	emptyTexture.deviceMemory = emptyTexture.allocation.memory;
+	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, emptyTexture.image, emptyTexture.deviceMemory, emptyTexture.allocation.offset));
 
 	VkImageSubresourceRange subresourceRange{};
 	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -691,17 +1101,13 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	subresourceRange.levelCount = 1;
 	subresourceRange.layerCount = 1;
 
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	VkCommandBuffer copyCmd = device->stagingRing.commandBuffer(transferQueue);
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+	vkCmdCopyBufferToImage(copyCmd, staging.buffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-	device->flushCommandBuffer(copyCmd, transferQueue);
+	device->stagingRing.flush();
 	emptyTexture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	// Clean up staging resources
-	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
 	VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
 	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
 	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
@@ -726,15 +1132,212 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	emptyTexture.descriptor.sampler = emptyTexture.sampler;
 }
 
+/*
+	Asynchronous image loading
+	Images are decoded (and their mip chains generated) on worker threads, which also create the staging buffers and target images
+	The main thread submits all images prepared since its last update with a single command buffer and a fence (see Model::updateAsyncLoading)
+*/
+struct vkglTF::AsyncImageLoader {
+	struct PreparedImage {
+		uint32_t index;
+		vkglTF::Texture texture;
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingMemory;
+		std::vector<VkBufferImageCopy> copyRegions;
+	};
+	struct UploadBatch {
+		VkCommandBuffer commandBuffer;
+		VkFence fence;
+		std::vector<PreparedImage> images;
+	};
+
+	vks::VulkanDevice* device;
+	VkQueue transferQueue;
+	std::string path;
+	// Taken over from the tinygltf model, as that only lives until loading has finished
+	std::vector<tinygltf::Image> images;
+	uint32_t pendingImages = 0;
+
+	vks::JobSystem jobSystem;
+	vks::TaskGroup jobs;
+	std::mutex preparedImagesMutex;
+	std::vector<PreparedImage> preparedImages;
+	std::vector<UploadBatch> uploadBatches;
+
+	// Box filters the next smaller mip level of an RGBA8 image
+	static void downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight)
+	{
+		for (uint32_t y = 0; y < dstHeight; y++) {
+			const uint8_t* row0 = src + std::min(y * 2, srcHeight - 1) * srcWidth * 4;
+			const uint8_t* row1 = src + std::min(y * 2 + 1, srcHeight - 1) * srcWidth * 4;
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				const uint32_t x0 = std::min(x * 2, srcWidth - 1) * 4;
+				const uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+				for (uint32_t c = 0; c < 4; c++) {
+					*dst++ = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+				}
+			}
+		}
+	}
+
+	// Called on a worker thread
+	void prepareImage(uint32_t index)
+	{
+		VKS_TRACE_ZONE("vkglTF::prepareImage");
+		tinygltf::Image& gltfimage = images[index];
+		PreparedImage prepared{};
+		prepared.index = index;
+		vkglTF::Texture& texture = prepared.texture;
+		texture.device = device;
+		texture.layerCount = 1;
+
+		const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		bool isKtx = false;
+		if (gltfimage.uri.find_last_of(".") != std::string::npos) {
+			isKtx = (gltfimage.uri.substr(gltfimage.uri.find_last_of(".") + 1) == "ktx");
+		}
+
+		if (!isKtx) {
+			int width, height, components;
+			stbi_uc* pixels = stbi_load_from_memory(gltfimage.image.data(), static_cast<int>(gltfimage.image.size()), &width, &height, &components, 4);
+			if (!pixels) {
+				vks::tools::exitFatal("Could not decode image \"" + gltfimage.uri + "\" of " + path, -1);
+			}
+			std::vector<unsigned char>().swap(gltfimage.image);
+
+			// glTF uses jpg and png, so the mip chain is generated here instead of blitting on the GPU
+			texture.width = static_cast<uint32_t>(width);
+			texture.height = static_cast<uint32_t>(height);
+			texture.mipLevels = static_cast<uint32_t>(floor(log2(std::max(texture.width, texture.height))) + 1.0);
+			VkDeviceSize bufferSize = 0;
+			for (uint32_t i = 0; i < texture.mipLevels; i++) {
+				VkBufferImageCopy bufferCopyRegion{};
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = i;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = std::max(1u, texture.width >> i);
+				bufferCopyRegion.imageExtent.height = std::max(1u, texture.height >> i);
+				bufferCopyRegion.imageExtent.depth = 1;
+				bufferCopyRegion.bufferOffset = bufferSize;
+				prepared.copyRegions.push_back(bufferCopyRegion);
+				bufferSize += bufferCopyRegion.imageExtent.width * bufferCopyRegion.imageExtent.height * 4;
+			}
+			std::vector<uint8_t> buffer(static_cast<size_t>(bufferSize));
+			memcpy(buffer.data(), pixels, texture.width * texture.height * 4);
+			stbi_image_free(pixels);
+			for (uint32_t i = 1; i < texture.mipLevels; i++) {
+				const VkBufferImageCopy& src = prepared.copyRegions[i - 1];
+				const VkBufferImageCopy& dst = prepared.copyRegions[i];
+				downsample(&buffer[static_cast<size_t>(src.bufferOffset)], src.imageExtent.width, src.imageExtent.height, &buffer[static_cast<size_t>(dst.bufferOffset)], dst.imageExtent.width, dst.imageExtent.height);
+			}
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, bufferSize, &prepared.stagingBuffer, &prepared.stagingMemory, buffer.data()));
+		}
+		else {
+			// Texture is stored in an external ktx file
+			std::string filename = path + "/" + gltfimage.uri;
+			ktxTexture* ktxTexture;
+			ktxResult result = KTX_SUCCESS;
+#if defined(__ANDROID__)
+			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+			if (!asset) {
+				vks::tools::exitFatal("Could not load texture from " + filename + "\n\nMake sure the assets submodule has been checked out and is up-to-date.", -1);
+			}
+			size_t size = AAsset_getLength(asset);
+			assert(size > 0);
+			ktx_uint8_t* textureData = new ktx_uint8_t[size];
+			AAsset_read(asset, textureData, size);
+			AAsset_close(asset);
+			result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+			delete[] textureData;
+#else
+			if (!vks::tools::fileExists(filename)) {
+				vks::tools::exitFatal("Could not load texture from " + filename + "\n\nMake sure the assets submodule has been checked out and is up-to-date.", -1);
+			}
+			result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+#endif
+			assert(result == KTX_SUCCESS);
+
+			texture.width = ktxTexture->baseWidth;
+			texture.height = ktxTexture->baseHeight;
+			texture.mipLevels = ktxTexture->numLevels;
+			for (uint32_t i = 0; i < texture.mipLevels; i++) {
+				ktx_size_t offset;
+				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
+				assert(result == KTX_SUCCESS);
+				VkBufferImageCopy bufferCopyRegion{};
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = i;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = std::max(1u, texture.width >> i);
+				bufferCopyRegion.imageExtent.height = std::max(1u, texture.height >> i);
+				bufferCopyRegion.imageExtent.depth = 1;
+				bufferCopyRegion.bufferOffset = offset;
+				prepared.copyRegions.push_back(bufferCopyRegion);
+			}
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ktxTexture_GetSize(ktxTexture), &prepared.stagingBuffer, &prepared.stagingMemory, ktxTexture_GetData(ktxTexture)));
+			ktxTexture_Destroy(ktxTexture);
+		}
+
+		// Create optimal tiled target image
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = texture.mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { texture.width, texture.height, 1 };
+		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &texture.image));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, texture.image, &memReqs);
+		// The allocator is thread safe, so worker threads can sub-allocate directly
+		VK_CHECK_RESULT(device->memoryAllocator.allocate(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vks::MemoryAllocator::ResourceType::Optimal, &texture.allocation, vks::MemoryAllocator::Strategy::Linear));
+		texture.deviceMemory = texture.allocation.memory;
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, texture.image, texture.deviceMemory, texture.allocation.offset));
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		texture.createSamplerAndView(format);
+
+		std::lock_guard<std::mutex> lock(preparedImagesMutex);
+		preparedImages.push_back(std::move(prepared));
+	}
+
+	void destroyStagingBuffer(PreparedImage& image)
+	{
+		vkDestroyBuffer(device->logicalDevice, image.stagingBuffer, nullptr);
+		vkFreeMemory(device->logicalDevice, image.stagingMemory, nullptr);
+	}
+};
+
+void vkglTF::Model::destroyAsyncImageLoader()
+{
+	AsyncImageLoader& loader = *asyncImageLoader;
+	// Help the workers finish outstanding jobs, so nothing touches the loader after it has been deleted
+	loader.jobSystem.wait(loader.jobs);
+	for (auto& batch : loader.uploadBatches) {
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+		vkDestroyFence(device->logicalDevice, batch.fence, nullptr);
+		vkFreeCommandBuffers(device->logicalDevice, device->commandPool, 1, &batch.commandBuffer);
+		loader.preparedImages.insert(loader.preparedImages.end(), batch.images.begin(), batch.images.end());
+	}
+	for (auto& image : loader.preparedImages) {
+		loader.destroyStagingBuffer(image);
+		image.texture.destroy();
+	}
+	delete asyncImageLoader;
+	asyncImageLoader = nullptr;
+}
+
 /*
 	glTF model loading and rendering class
 */
 vkglTF::Model::~Model()
 {
-	vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	if (asyncImageLoader) {
+		destroyAsyncImageLoader();
+	}
 	for (auto texture : textures) {
 		texture.destroy();
 	}
@@ -744,6 +1347,15 @@ vkglTF::Model::~Model()
     for (auto skin : skins) {
         delete skin;
     }
+	emptyTexture.destroy();
+	// Models that have been set up without loading a file (e.g. for benchmarks) don't own any Vulkan resources
+	if (!device) {
+		return;
+	}
+	vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
+	device->memoryAllocator.free(vertices.allocation);
+	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
+	device->memoryAllocator.free(indices.allocation);
 	if (descriptorSetLayoutUbo != VK_NULL_HANDLE) {
 		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutUbo, nullptr);
 		descriptorSetLayoutUbo = VK_NULL_HANDLE;
@@ -753,7 +1365,6 @@ vkglTF::Model::~Model()
 		descriptorSetLayoutImage = VK_NULL_HANDLE;
 	}
 	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
-	emptyTexture.destroy();
 }
 
 void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale)
@@ -941,6 +1552,9 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 					return;
 				}
 			}
+			if ((fileLoadingFlags & FileLoadingFlags::OptimizeMeshes) && (primitive.mode == TINYGLTF_MODE_TRIANGLES) && (indexCount % 3 == 0)) {
+				vertexCount = optimizePrimitive(indexBuffer, vertexBuffer, indexStart, vertexStart);
+			}
 			Primitive *newPrimitive = new Primitive(indexStart, indexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
 			newPrimitive->firstVertex = vertexStart;
 			newPrimitive->vertexCount = vertexCount;
@@ -957,6 +1571,45 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 	linearNodes.push_back(newNode);
 }
 
+/*
+	Optimizes the primitive at the end of the index and vertex buffers in place and returns its new vertex count
+	Duplicate vertices are merged, triangles are reordered for the post-transform vertex cache and then in clusters against overdraw,
+	and the vertices are finally sorted by their first use
+*/
+uint32_t vkglTF::Model::optimizePrimitive(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, uint32_t firstIndex, uint32_t firstVertex)
+{
+	VKS_TRACE_ZONE("vkglTF::Model::optimizePrimitive");
+	if (indexBuffer.size() == firstIndex) {
+		return static_cast<uint32_t>(vertexBuffer.size() - firstVertex);
+	}
+	std::vector<Vertex> vertices(vertexBuffer.begin() + firstVertex, vertexBuffer.end());
+	std::vector<uint32_t> indices(indexBuffer.begin() + firstIndex, indexBuffer.end());
+	for (auto& index : indices) {
+		index -= firstVertex;
+	}
+
+	const vks::MeshOptimizer::VertexCacheStatistics before = vks::MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+	vks::MeshOptimizer::deduplicateVertices(vertices, indices);
+	vks::MeshOptimizer::optimizeVertexCache(indices, vertices.size());
+	vks::MeshOptimizer::optimizeOverdraw(indices, &vertices[0].pos, sizeof(Vertex), vertices.size());
+	vks::MeshOptimizer::optimizeVertexFetch(vertices, indices);
+	const vks::MeshOptimizer::VertexCacheStatistics after = vks::MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+
+	meshOptimizationStatistics.primitiveCount++;
+	meshOptimizationStatistics.triangleCount += before.triangleCount;
+	meshOptimizationStatistics.vertexCountBefore += before.vertexCount;
+	meshOptimizationStatistics.vertexCountAfter += after.vertexCount;
+	meshOptimizationStatistics.cacheMissesBefore += before.cacheMisses;
+	meshOptimizationStatistics.cacheMissesAfter += after.cacheMisses;
+
+	vertexBuffer.resize(firstVertex);
+	vertexBuffer.insert(vertexBuffer.end(), vertices.begin(), vertices.end());
+	for (size_t i = 0; i < indices.size(); i++) {
+		indexBuffer[firstIndex + i] = indices[i] + firstVertex;
+	}
+	return static_cast<uint32_t>(vertices.size());
+}
+
 void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 {
 	for (tinygltf::Skin &source : gltfModel.skins) {
@@ -991,6 +1644,7 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 
 void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
 {
+	VKS_TRACE_ZONE("vkglTF::loadImages");
 	for (tinygltf::Image &image : gltfModel.images) {
 		vkglTF::Texture texture;
 		texture.fromglTfImage(image, path, device, transferQueue);
@@ -1000,16 +1654,121 @@ void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *de
 	createEmptyTexture(transferQueue);
 }
 
-void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
+void vkglTF::Model::loadImagesAsync(tinygltf::Model &gltfModel, VkQueue transferQueue)
 {
-	for (tinygltf::Material &mat : gltfModel.materials) {
-		vkglTF::Material material(device);
-		if (mat.values.find("baseColorTexture") != mat.values.end()) {
-			material.baseColorTexture = getTexture(gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()].source);
-		}
-		// Metallic roughness workflow
-		if (mat.values.find("metallicRoughnessTexture") != mat.values.end()) {
-			material.metallicRoughnessTexture = getTexture(gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()].source);
+	// Materials use the empty texture until their images are resident
+	createEmptyTexture(transferQueue);
+	const uint32_t imageCount = static_cast<uint32_t>(gltfModel.images.size());
+	textures.resize(imageCount);
+	for (auto& texture : textures) {
+		texture.descriptor = emptyTexture.descriptor;
+		texture.resident = false;
+	}
+	if (imageCount == 0) {
+		return;
+	}
+
+	asyncImageLoader = new AsyncImageLoader();
+	asyncImageLoader->device = device;
+	asyncImageLoader->transferQueue = transferQueue;
+	asyncImageLoader->path = path;
+	asyncImageLoader->images = std::move(gltfModel.images);
+	asyncImageLoader->pendingImages = imageCount;
+	const uint32_t threadCount = std::thread::hardware_concurrency();
+	asyncImageLoader->jobSystem.setThreadCount(threadCount > 1 ? threadCount - 1 : 1);
+	AsyncImageLoader* loader = asyncImageLoader;
+	for (uint32_t i = 0; i < imageCount; i++) {
+		loader->jobSystem.run(loader->jobs, [loader, i] { loader->prepareImage(i); });
+	}
+}
+
+bool vkglTF::Model::updateAsyncLoading()
+{
+	if (!asyncImageLoader) {
+		return false;
+	}
+	AsyncImageLoader& loader = *asyncImageLoader;
+
+	// Images of finished batches become resident, descriptor sets of materials that have all of their images now are recreated
+	// Sets are never updated in place, as they may still be used by command buffers in flight
+	bool materialsChanged = false;
+	for (auto batch = loader.uploadBatches.begin(); batch != loader.uploadBatches.end();) {
+		if (vkWaitForFences(device->logicalDevice, 1, &batch->fence, VK_TRUE, 0) != VK_SUCCESS) {
+			++batch;
+			continue;
+		}
+		std::vector<vkglTF::Texture*> residentTextures;
+		for (auto& image : batch->images) {
+			loader.destroyStagingBuffer(image);
+			textures[image.index] = image.texture;
+			residentTextures.push_back(&textures[image.index]);
+		}
+		for (auto& material : materials) {
+			if ((material.descriptorSet == VK_NULL_HANDLE) || !material.isResident()) {
+				continue;
+			}
+			const vkglTF::Texture* materialTextures[] = { material.baseColorTexture, material.metallicRoughnessTexture, material.normalTexture, material.occlusionTexture, material.emissiveTexture };
+			for (const vkglTF::Texture* texture : materialTextures) {
+				if (std::find(residentTextures.begin(), residentTextures.end(), texture) != residentTextures.end()) {
+					material.createDescriptorSet(descriptorPool, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
+					materialsChanged = true;
+					break;
+				}
+			}
+		}
+		loader.pendingImages -= static_cast<uint32_t>(batch->images.size());
+		vkDestroyFence(device->logicalDevice, batch->fence, nullptr);
+		vkFreeCommandBuffers(device->logicalDevice, device->commandPool, 1, &batch->commandBuffer);
+		batch = loader.uploadBatches.erase(batch);
+	}
+
+	// Upload all images prepared since the last update with a single submission
+	std::vector<AsyncImageLoader::PreparedImage> preparedImages;
+	{
+		std::lock_guard<std::mutex> lock(loader.preparedImagesMutex);
+		preparedImages.swap(loader.preparedImages);
+	}
+	if (!preparedImages.empty()) {
+		AsyncImageLoader::UploadBatch batch{};
+		batch.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (auto& image : preparedImages) {
+			VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, image.texture.mipLevels, 0, 1 };
+			vks::tools::setImageLayout(batch.commandBuffer, image.texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+			vkCmdCopyBufferToImage(batch.commandBuffer, image.stagingBuffer, image.texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(image.copyRegions.size()), image.copyRegions.data());
+			vks::tools::setImageLayout(batch.commandBuffer, image.texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(batch.commandBuffer));
+		VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(0);
+		VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &batch.fence));
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(loader.transferQueue, 1, &submitInfo, batch.fence));
+		batch.images = std::move(preparedImages);
+		loader.uploadBatches.push_back(std::move(batch));
+	}
+
+	if (loader.pendingImages == 0) {
+		destroyAsyncImageLoader();
+	}
+	return materialsChanged;
+}
+
+bool vkglTF::Model::imagesResident() const
+{
+	return asyncImageLoader == nullptr;
+}
+
+void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
+{
+	for (tinygltf::Material &mat : gltfModel.materials) {
+		vkglTF::Material material(device);
+		if (mat.values.find("baseColorTexture") != mat.values.end()) {
+			material.baseColorTexture = getTexture(gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()].source);
+		}
+		// Metallic roughness workflow
+		if (mat.values.find("metallicRoughnessTexture") != mat.values.end()) {
+			material.metallicRoughnessTexture = getTexture(gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()].source);
 		}
 		if (mat.values.find("roughnessFactor") != mat.values.end()) {
 			material.roughnessFactor = static_cast<float>(mat.values["roughnessFactor"].Factor());
@@ -1166,10 +1925,13 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 
 void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
 {
+	VKS_TRACE_ZONE("vkglTF::Model::loadFromFile");
 	tinygltf::Model gltfModel;
 	tinygltf::TinyGLTF gltfContext;
 	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
 		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
+	} else if (fileLoadingFlags & FileLoadingFlags::LoadImagesAsync) {
+		gltfContext.SetImageLoader(loadImageDataFuncDeferred, nullptr);
 	} else {
 		gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
 	}
@@ -1184,116 +1946,140 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	std::string error, warning;
 
 	this->device = device;
+	this->fileLoadingFlags = fileLoadingFlags;
 
 #if defined(__ANDROID__)
 	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
 	// We let tinygltf handle this, by passing the asset manager of our app
 	tinygltf::asset_manager = androidApp->activity->assetManager;
 #endif
-	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
-
 	std::vector<uint32_t> indexBuffer;
 	std::vector<Vertex> vertexBuffer;
-
-	if (fileLoaded) {
-		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
-			loadImages(gltfModel, device, transferQueue);
-		}
-		loadMaterials(gltfModel);
-		const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
-		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-			loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
-		}
-		if (gltfModel.animations.size() > 0) {
-			loadAnimations(gltfModel);
+	// Vertex and index data to upload, either from the buffers above or from the memory mapped geometry cache
+	const void* vertexData = nullptr;
+	const void* indexData = nullptr;
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+
+	// Images and geometry are uploaded with as few submits as possible, the batch is ended after the geometry upload
+	device->stagingRing.beginBatch();
+
+	// A valid geometry cache replaces parsing the glTF file and preparing the vertices
+	const std::string cacheFileName = getGeometryCacheFileName(filename, fileLoadingFlags, scale);
+	vks::MappedFile cacheFile;
+	const bool cacheLoaded = !cacheFileName.empty() && loadGeometryCache(cacheFileName, filename, transferQueue, scale, cacheFile, vertexData, vertexCount, indexData, indexCount);
+
+	if (!cacheLoaded) {
+		bool fileLoaded;
+		{
+			VKS_TRACE_ZONE("tinygltf::LoadASCIIFromFile");
+			fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
 		}
-		loadSkins(gltfModel);
 
-		for (auto node : linearNodes) {
-			// Assign skins
-			if (node->skinIndex > -1) {
-				node->skin = skins[node->skinIndex];
+		if (fileLoaded) {
+			if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+				if (fileLoadingFlags & FileLoadingFlags::LoadImagesAsync) {
+					loadImagesAsync(gltfModel, transferQueue);
+				} else {
+					loadImages(gltfModel, device, transferQueue);
+				}
+			}
+			loadMaterials(gltfModel);
+			const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+			for (size_t i = 0; i < scene.nodes.size(); i++) {
+				const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
+				loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
 			}
-			// Initial pose
-			if (node->mesh) {
-				node->update();
+			if (gltfModel.animations.size() > 0) {
+				loadAnimations(gltfModel);
 			}
+			loadSkins(gltfModel);
+		}
+		else {
+			// TODO: throw
+			vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
+			return;
 		}
-	}
-	else {
-		// TODO: throw
-		vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
-		return;
-	}
 
-	// Pre-Calculations for requested features
-	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
-		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
-		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
-		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
-		for (Node* node : linearNodes) {
-			if (node->mesh) {
-				const glm::mat4 localMatrix = node->getMatrix();
-				for (Primitive* primitive : node->mesh->primitives) {
-					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
-						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
-						// Pre-transform vertex positions by node-hierarchy
-						if (preTransform) {
-							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
-							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
-						}
-						// Flip Y-Axis of vertex positions
-						if (flipY) {
-							vertex.pos.y *= -1.0f;
-							vertex.normal.y *= -1.0f;
-						}
-						// Pre-Multiply vertex colors with material base color
-						if (preMultiplyColor) {
-							vertex.color = primitive->material.baseColorFactor * vertex.color;
+		// Pre-Calculations for requested features
+		if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
+			const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+			const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
+			const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+			for (Node* node : linearNodes) {
+				if (node->mesh) {
+					const glm::mat4 localMatrix = node->getMatrix();
+					for (Primitive* primitive : node->mesh->primitives) {
+						for (uint32_t i = 0; i < primitive->vertexCount; i++) {
+							Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
+							// Pre-transform vertex positions by node-hierarchy
+							if (preTransform) {
+								vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
+								vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
+							}
+							// Flip Y-Axis of vertex positions
+							if (flipY) {
+								vertex.pos.y *= -1.0f;
+								vertex.normal.y *= -1.0f;
+							}
+							// Pre-Multiply vertex colors with material base color
+							if (preMultiplyColor) {
+								vertex.color = primitive->material.baseColorFactor * vertex.color;
+							}
 						}
 					}
 				}
 			}
 		}
+
+		for (auto extension : gltfModel.extensionsUsed) {
+			if (extension == "KHR_materials_pbrSpecularGlossiness") {
+				std::cout << "Required extension: " << extension;
+				metallicRoughnessWorkflow = false;
+			}
+		}
+
+		vertexData = vertexBuffer.data();
+		vertexCount = vertexBuffer.size();
+		indexData = indexBuffer.data();
+		indexCount = indexBuffer.size();
 	}
 
-	for (auto extension : gltfModel.extensionsUsed) {
-		if (extension == "KHR_materials_pbrSpecularGlossiness") {
-			std::cout << "Required extension: " << extension;
-			metallicRoughnessWorkflow = false;
+	// Assign skins
+	for (auto node : linearNodes) {
+		if (node->skinIndex > -1) {
+			node->skin = skins[node->skinIndex];
 		}
 	}
+	// Initial pose
+	transforms.build(nodes);
+	for (auto node : linearNodes) {
+		node->updateMesh();
+	}
+	transforms.clearUpdated();
 
-	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-	indices.count = static_cast<uint32_t>(indexBuffer.size());
-	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
+	// Vertices are packed while they're copied to the staging ring if the model uses a packed vertex layout
+	const bool packVertices = !vertexLayout.components.empty();
+	if (packVertices) {
+		vertexLayout.prepare(static_cast<const Vertex*>(vertexData), vertexCount);
+	}
+	size_t vertexBufferSize = vertexCount * (packVertices ? vertexLayout.stride : sizeof(Vertex));
+	size_t indexBufferSize = indexCount * sizeof(uint32_t);
+	indices.count = static_cast<uint32_t>(indexCount);
+	vertices.count = static_cast<uint32_t>(vertexCount);
 
 	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
 
-	struct StagingBuffer {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} vertexStaging, indexStaging;
-
-	// Create staging buffers
-	// Vertex data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize,
-		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
-	// Index data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indexBufferSize,
-		&indexStaging.buffer,
-		&indexStaging.memory,
-		indexBuffer.data()));
+	// Vertex and index data are copied through the device's staging ring
+	VKS_TRACE_ZONE("vkglTF::uploadGeometry");
+	vks::StagingRing::Allocation vertexStaging = device->stagingRing.allocate(vertexBufferSize);
+	if (packVertices) {
+		vertexLayout.pack(static_cast<const Vertex*>(vertexData), vertexCount, vertexStaging.data);
+	} else {
+		memcpy(vertexStaging.data, vertexData, vertexBufferSize);
+	}
+	vks::StagingRing::Allocation indexStaging = device->stagingRing.allocate(indexBufferSize);
+	memcpy(indexStaging.data, indexData, indexBufferSize);
 
 	// Create device local buffers
 	// Vertex buffer
@@ -1302,34 +2088,43 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		vertexBufferSize,
 		&vertices.buffer,
-		&vertices.memory));
+		&vertices.allocation,
+		nullptr,
+		vks::MemoryAllocator::Strategy::Linear));
+	vertices.memory = vertices.allocation.memory;
 	// Index buffer
 	VK_CHECK_RESULT(device->createBuffer(
 	    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		indexBufferSize,
 		&indices.buffer,
-		&indices.memory));
+		&indices.allocation,
+		nullptr,
+		vks::MemoryAllocator::Strategy::Linear));
+	indices.memory = indices.allocation.memory;
 
 	// Copy from staging buffers
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	VkCommandBuffer copyCmd = device->stagingRing.commandBuffer(transferQueue);
 
 	VkBufferCopy copyRegion = {};
 
+	copyRegion.srcOffset = vertexStaging.offset;
 	copyRegion.size = vertexBufferSize;
 	vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
 
+	copyRegion.srcOffset = indexStaging.offset;
 	copyRegion.size = indexBufferSize;
 	vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
 
-	device->flushCommandBuffer(copyCmd, transferQueue, true);
-
-	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+	device->stagingRing.endBatch();
 
 	getSceneDimensions();
+	buildBVH();
+
+	if (!cacheLoaded && !cacheFileName.empty()) {
+		writeGeometryCache(cacheFileName, filename, gltfModel, scale, vertexBuffer, indexBuffer);
+	}
+	cacheFile.close();
 
 	// Setup descriptors
 	uint32_t uboCount{ 0 };
@@ -1344,6 +2139,10 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 			imageCount++;
 		}
 	}
+	// Materials get a new descriptor set once their asynchronously loaded images are resident
+	if (asyncImageLoader) {
+		imageCount *= 2;
+	}
 	std::vector<VkDescriptorPoolSize> poolSizes = {
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
 	};
@@ -1405,6 +2204,659 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	}
 }
 
+/*
+	Binary geometry cache
+
+	Stores everything loadFromFile derives from a glTF file (prepared vertices and indices, nodes, meshes, materials, skins, animations and mesh optimization statistics) for one combination of file loading flags and scale
+	Vertex and index data are stored exactly as they are uploaded, so a cached model is loaded by memory mapping the cache and copying that data into the staging ring
+	A cache is only used if the hash of the glTF file and the size and modification time of its external buffers still match
+	Images are not part of the cache and are still loaded from their own files, so models with embedded images are not cached
+*/
+
+namespace
+{
+	// Has to be increased whenever the layout of the cache or of vkglTF::Vertex changes
+	const uint32_t geometryCacheVersion = 2;
+	const char geometryCacheMagic[8] = { 'V', 'K', 'G', 'L', 'T', 'F', 'C', 'H' };
+
+	struct GeometryCacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t vertexSize;
+		uint64_t sourceHash;
+		uint32_t fileLoadingFlags;
+		float scale;
+		uint64_t vertexOffset;
+		uint64_t vertexCount;
+		uint64_t indexOffset;
+		uint64_t indexCount;
+		uint64_t sceneOffset;
+		uint64_t sceneSize;
+	};
+
+	// 64 bit FNV-1a
+	uint64_t hashData(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	bool readFileData(const std::string& fileName, std::vector<uint8_t>& data)
+	{
+		std::ifstream is(fileName, std::ios::binary | std::ios::ate);
+		if (!is.is_open()) {
+			return false;
+		}
+		data.resize(static_cast<size_t>(is.tellg()));
+		is.seekg(0, std::ios::beg);
+		is.read(reinterpret_cast<char*>(data.data()), data.size());
+		return !is.fail();
+	}
+
+	// External buffers are identified by their size and modification time instead of hashing their (potentially large) contents
+	bool getFileInfo(const std::string& fileName, uint64_t& size, int64_t& modificationTime)
+	{
+		struct stat info;
+		if (stat(fileName.c_str(), &info) != 0) {
+			return false;
+		}
+		size = static_cast<uint64_t>(info.st_size);
+		modificationTime = static_cast<int64_t>(info.st_mtime);
+		return true;
+	}
+
+	bool isExternalUri(const std::string& uri)
+	{
+		return !uri.empty() && (uri.compare(0, 5, "data:") != 0);
+	}
+
+	struct CacheWriter {
+		std::vector<uint8_t> data;
+		void writeBytes(const void* src, size_t size)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(src);
+			data.insert(data.end(), bytes, bytes + size);
+		}
+		template<typename T> void write(const T& value)
+		{
+			writeBytes(&value, sizeof(T));
+		}
+		void writeString(const std::string& value)
+		{
+			write(static_cast<uint32_t>(value.size()));
+			writeBytes(value.data(), value.size());
+		}
+		template<typename T> void writeVector(const std::vector<T>& values)
+		{
+			write(static_cast<uint32_t>(values.size()));
+			if (!values.empty()) {
+				writeBytes(values.data(), values.size() * sizeof(T));
+			}
+		}
+		void align(size_t alignment)
+		{
+			data.resize((data.size() + alignment - 1) / alignment * alignment, 0);
+		}
+	};
+
+	// All reads are bounds checked, once a read fails the reader stays invalid
+	struct CacheReader {
+		const uint8_t* data;
+		size_t size;
+		size_t offset = 0;
+		bool valid = true;
+		CacheReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+		void readBytes(void* dst, size_t count)
+		{
+			if (!valid || (count > size - offset)) {
+				valid = false;
+				return;
+			}
+			if (count > 0) {
+				memcpy(dst, data + offset, count);
+			}
+			offset += count;
+		}
+		template<typename T> T read()
+		{
+			T value{};
+			readBytes(&value, sizeof(T));
+			return value;
+		}
+		std::string readString()
+		{
+			const uint32_t length = read<uint32_t>();
+			if (!valid || (length > size - offset)) {
+				valid = false;
+				return std::string();
+			}
+			std::string value(reinterpret_cast<const char*>(data + offset), length);
+			offset += length;
+			return value;
+		}
+		template<typename T> std::vector<T> readVector()
+		{
+			const uint32_t count = read<uint32_t>();
+			std::vector<T> values;
+			if (!valid || (count > (size - offset) / sizeof(T))) {
+				valid = false;
+				return values;
+			}
+			values.resize(count);
+			readBytes(values.data(), count * sizeof(T));
+			return values;
+		}
+	};
+
+	struct CachedMaterial {
+		int32_t alphaMode;
+		float alphaCutoff;
+		float metallicFactor;
+		float roughnessFactor;
+		glm::vec4 baseColorFactor;
+		// Image indices of the base color, metallic roughness, normal, occlusion and emissive textures (-1 for none, -2 for the empty texture)
+		int32_t textures[5];
+	};
+
+	struct CachedPrimitive {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t material;
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	struct CachedNode {
+		int32_t parent;
+		uint32_t index;
+		std::string name;
+		int32_t skinIndex;
+		glm::mat4 matrix;
+		glm::vec3 translation;
+		glm::quat rotation;
+		glm::vec3 scale;
+		std::vector<uint32_t> children;
+		bool hasMesh;
+		std::string meshName;
+		std::vector<CachedPrimitive> primitives;
+	};
+
+	struct CachedSkin {
+		std::string name;
+		int32_t skeletonRoot;
+		std::vector<uint32_t> joints;
+		std::vector<glm::mat4> inverseBindMatrices;
+	};
+
+	struct CachedChannel {
+		int32_t path;
+		uint32_t node;
+		uint32_t samplerIndex;
+	};
+}
+
+std::string vkglTF::Model::getGeometryCacheFileName(const std::string& filename, uint32_t fileLoadingFlags, float scale) const
+{
+	if (geometryCachePath.empty()) {
+		return "";
+	}
+	// The same file may be loaded with different flags, so each combination gets its own cache
+	uint64_t key = hashData(filename.data(), filename.size());
+	key = hashData(&fileLoadingFlags, sizeof(fileLoadingFlags), key);
+	key = hashData(&scale, sizeof(scale), key);
+	const size_t pathEnd = filename.find_last_of("/\\");
+	const std::string baseName = (pathEnd != std::string::npos) ? filename.substr(pathEnd + 1) : filename;
+	std::stringstream fileName;
+	fileName << geometryCachePath;
+	if ((geometryCachePath.back() != '/') && (geometryCachePath.back() != '\\')) {
+		fileName << "/";
+	}
+	fileName << baseName << "_" << std::hex << key << ".gltfcache";
+	return fileName.str();
+}
+
+bool vkglTF::Model::loadGeometryCache(const std::string& cacheFileName, const std::string& filename, VkQueue transferQueue, float scale, vks::MappedFile& cacheFile, const void*& vertexData, size_t& vertexCount, const void*& indexData, size_t& indexCount)
+{
+	VKS_TRACE_ZONE("vkglTF::Model::loadGeometryCache");
+	if (!cacheFile.open(cacheFileName)) {
+		return false;
+	}
+
+	// Validate the header and the files the cache was created from, nothing of the model is touched before the whole cache has been read
+	GeometryCacheHeader header{};
+	const uint64_t cacheSize = cacheFile.size();
+	bool valid = (cacheSize >= sizeof(header));
+	if (valid) {
+		memcpy(&header, cacheFile.data(), sizeof(header));
+		valid = (memcmp(header.magic, geometryCacheMagic, sizeof(header.magic)) == 0) &&
+			(header.version == geometryCacheVersion) &&
+			(header.vertexSize == sizeof(Vertex)) &&
+			(header.fileLoadingFlags == fileLoadingFlags) &&
+			(header.scale == scale) &&
+			(header.vertexOffset <= cacheSize) && (header.vertexCount <= (cacheSize - header.vertexOffset) / sizeof(Vertex)) &&
+			(header.indexOffset <= cacheSize) && (header.indexCount <= (cacheSize - header.indexOffset) / sizeof(uint32_t)) &&
+			(header.sceneOffset <= cacheSize) && (header.sceneSize <= cacheSize - header.sceneOffset);
+	}
+	std::vector<uint8_t> source;
+	valid = valid && readFileData(filename, source) && (hashData(source.data(), source.size()) == header.sourceHash);
+	if (!valid) {
+		cacheFile.close();
+		return false;
+	}
+
+	CacheReader reader(cacheFile.data() + header.sceneOffset, static_cast<size_t>(header.sceneSize));
+	const uint32_t dependencyCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; (i < dependencyCount) && reader.valid; i++) {
+		const std::string uri = reader.readString();
+		const uint64_t size = reader.read<uint64_t>();
+		const int64_t modificationTime = reader.read<int64_t>();
+		uint64_t currentSize;
+		int64_t currentModificationTime;
+		if (!getFileInfo(path + "/" + uri, currentSize, currentModificationTime) || (currentSize != size) || (currentModificationTime != modificationTime)) {
+			cacheFile.close();
+			return false;
+		}
+	}
+
+	const bool cachedMetallicRoughnessWorkflow = reader.read<uint8_t>() != 0;
+	std::vector<std::string> imageUris(reader.read<uint32_t>());
+	for (auto& uri : imageUris) {
+		uri = reader.readString();
+	}
+	std::vector<CachedMaterial> cachedMaterials = reader.readVector<CachedMaterial>();
+	std::vector<CachedNode> cachedNodes(reader.valid ? reader.read<uint32_t>() : 0);
+	for (auto& cachedNode : cachedNodes) {
+		cachedNode.parent = reader.read<int32_t>();
+		cachedNode.index = reader.read<uint32_t>();
+		cachedNode.name = reader.readString();
+		cachedNode.skinIndex = reader.read<int32_t>();
+		cachedNode.matrix = reader.read<glm::mat4>();
+		cachedNode.translation = reader.read<glm::vec3>();
+		cachedNode.rotation = reader.read<glm::quat>();
+		cachedNode.scale = reader.read<glm::vec3>();
+		cachedNode.children = reader.readVector<uint32_t>();
+		cachedNode.hasMesh = reader.read<uint8_t>() != 0;
+		if (cachedNode.hasMesh) {
+			cachedNode.meshName = reader.readString();
+			cachedNode.primitives = reader.readVector<CachedPrimitive>();
+		}
+		if (!reader.valid) {
+			break;
+		}
+	}
+	const std::vector<uint32_t> rootNodes = reader.readVector<uint32_t>();
+	std::vector<CachedSkin> cachedSkins(reader.valid ? reader.read<uint32_t>() : 0);
+	for (auto& cachedSkin : cachedSkins) {
+		cachedSkin.name = reader.readString();
+		cachedSkin.skeletonRoot = reader.read<int32_t>();
+		cachedSkin.joints = reader.readVector<uint32_t>();
+		cachedSkin.inverseBindMatrices = reader.readVector<glm::mat4>();
+	}
+	std::vector<Animation> cachedAnimations(reader.valid ? reader.read<uint32_t>() : 0);
+	std::vector<std::vector<CachedChannel>> cachedChannels(cachedAnimations.size());
+	for (size_t i = 0; (i < cachedAnimations.size()) && reader.valid; i++) {
+		Animation& animation = cachedAnimations[i];
+		animation.name = reader.readString();
+		animation.start = reader.read<float>();
+		animation.end = reader.read<float>();
+		animation.samplers.resize(reader.read<uint32_t>());
+		for (auto& sampler : animation.samplers) {
+			sampler.interpolation = static_cast<AnimationSampler::InterpolationType>(reader.read<int32_t>());
+			sampler.inputs = reader.readVector<float>();
+			sampler.outputsVec4 = reader.readVector<glm::vec4>();
+			if (!reader.valid) {
+				break;
+			}
+		}
+		cachedChannels[i] = reader.readVector<CachedChannel>();
+	}
+	const MeshOptimizationStatistics cachedOptimizationStatistics = reader.read<MeshOptimizationStatistics>();
+
+	// Check all references, so a damaged cache can't crash the loader
+	for (auto& cachedNode : cachedNodes) {
+		valid = valid && (cachedNode.parent < static_cast<int32_t>(cachedNodes.size()));
+		for (auto child : cachedNode.children) {
+			valid = valid && (child < cachedNodes.size());
+		}
+		for (auto& primitive : cachedNode.primitives) {
+			valid = valid && (primitive.material <= cachedMaterials.size());
+			valid = valid && (primitive.firstIndex <= header.indexCount) && (primitive.indexCount <= header.indexCount - primitive.firstIndex);
+		}
+		valid = valid && (cachedNode.skinIndex < static_cast<int32_t>(cachedSkins.size()));
+	}
+	for (auto root : rootNodes) {
+		valid = valid && (root < cachedNodes.size());
+	}
+	for (auto& cachedMaterial : cachedMaterials) {
+		for (auto texture : cachedMaterial.textures) {
+			valid = valid && (texture >= -2) && (texture < static_cast<int32_t>(imageUris.size()));
+		}
+	}
+	if (!reader.valid || !valid || cachedNodes.empty() || (header.vertexCount == 0) || (header.indexCount == 0)) {
+		std::cerr << "Ignoring damaged geometry cache \"" << cacheFileName << "\"\n";
+		cacheFile.close();
+		return false;
+	}
+
+	// Images are loaded from their files the same way tinygltf would have loaded them
+	if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+		tinygltf::Model imageModel;
+		imageModel.images.resize(imageUris.size());
+		for (size_t i = 0; i < imageUris.size(); i++) {
+			tinygltf::Image& image = imageModel.images[i];
+			image.uri = imageUris[i];
+			// KTX files are handled by the texture loading code
+			if (image.uri.substr(image.uri.find_last_of(".") + 1) == "ktx") {
+				continue;
+			}
+			std::vector<uint8_t> imageData;
+			if (!readFileData(path + "/" + image.uri, imageData)) {
+				vks::tools::exitFatal("Could not load texture from " + path + "/" + image.uri, -1);
+			}
+			std::string error, warning;
+			const bool decoded = (fileLoadingFlags & FileLoadingFlags::LoadImagesAsync) ?
+				loadImageDataFuncDeferred(&image, static_cast<int>(i), &error, &warning, 0, 0, imageData.data(), static_cast<int>(imageData.size()), nullptr) :
+				loadImageDataFunc(&image, static_cast<int>(i), &error, &warning, 0, 0, imageData.data(), static_cast<int>(imageData.size()), nullptr);
+			if (!decoded) {
+				vks::tools::exitFatal("Could not load texture from " + path + "/" + image.uri + ": " + error, -1);
+			}
+		}
+		if (fileLoadingFlags & FileLoadingFlags::LoadImagesAsync) {
+			loadImagesAsync(imageModel, transferQueue);
+		} else {
+			loadImages(imageModel, device, transferQueue);
+		}
+	}
+
+	auto getCachedTexture = [this](int32_t index) -> vkglTF::Texture* {
+		return (index == -2) ? &emptyTexture : ((index >= 0) ? getTexture(static_cast<uint32_t>(index)) : nullptr);
+	};
+	for (auto& cachedMaterial : cachedMaterials) {
+		vkglTF::Material material(device);
+		material.alphaMode = static_cast<Material::AlphaMode>(cachedMaterial.alphaMode);
+		material.alphaCutoff = cachedMaterial.alphaCutoff;
+		material.metallicFactor = cachedMaterial.metallicFactor;
+		material.roughnessFactor = cachedMaterial.roughnessFactor;
+		material.baseColorFactor = cachedMaterial.baseColorFactor;
+		material.baseColorTexture = getCachedTexture(cachedMaterial.textures[0]);
+		material.metallicRoughnessTexture = getCachedTexture(cachedMaterial.textures[1]);
+		material.normalTexture = getCachedTexture(cachedMaterial.textures[2]);
+		material.occlusionTexture = getCachedTexture(cachedMaterial.textures[3]);
+		material.emissiveTexture = getCachedTexture(cachedMaterial.textures[4]);
+		materials.push_back(material);
+	}
+	// Default material for meshes with no material assigned
+	materials.push_back(Material(device));
+
+	linearNodes.resize(cachedNodes.size());
+	for (size_t i = 0; i < cachedNodes.size(); i++) {
+		const CachedNode& cachedNode = cachedNodes[i];
+		Node* node = new Node{};
+		node->index = cachedNode.index;
+		node->name = cachedNode.name;
+		node->skinIndex = cachedNode.skinIndex;
+		node->matrix = cachedNode.matrix;
+		node->translation = cachedNode.translation;
+		node->rotation = cachedNode.rotation;
+		node->scale = cachedNode.scale;
+		if (cachedNode.hasMesh) {
+			node->mesh = new Mesh(device, node->matrix);
+			node->mesh->name = cachedNode.meshName;
+			for (auto& cachedPrimitive : cachedNode.primitives) {
+				Primitive* primitive = new Primitive(cachedPrimitive.firstIndex, cachedPrimitive.indexCount, materials[cachedPrimitive.material]);
+				primitive->firstVertex = cachedPrimitive.firstVertex;
+				primitive->vertexCount = cachedPrimitive.vertexCount;
+				primitive->setDimensions(cachedPrimitive.min, cachedPrimitive.max);
+				node->mesh->primitives.push_back(primitive);
+			}
+		}
+		linearNodes[i] = node;
+	}
+	for (size_t i = 0; i < cachedNodes.size(); i++) {
+		linearNodes[i]->parent = (cachedNodes[i].parent >= 0) ? linearNodes[cachedNodes[i].parent] : nullptr;
+		for (auto child : cachedNodes[i].children) {
+			linearNodes[i]->children.push_back(linearNodes[child]);
+		}
+	}
+	for (auto root : rootNodes) {
+		nodes.push_back(linearNodes[root]);
+	}
+
+	for (size_t i = 0; i < cachedAnimations.size(); i++) {
+		Animation& animation = cachedAnimations[i];
+		for (auto& cachedChannel : cachedChannels[i]) {
+			AnimationChannel channel{};
+			channel.path = static_cast<AnimationChannel::PathType>(cachedChannel.path);
+			channel.node = nodeFromIndex(cachedChannel.node);
+			channel.samplerIndex = cachedChannel.samplerIndex;
+			if (channel.node && (channel.samplerIndex < animation.samplers.size())) {
+				animation.channels.push_back(channel);
+			}
+		}
+		animations.push_back(animation);
+	}
+
+	for (auto& cachedSkin : cachedSkins) {
+		Skin* skin = new Skin{};
+		skin->name = cachedSkin.name;
+		if (cachedSkin.skeletonRoot > -1) {
+			skin->skeletonRoot = nodeFromIndex(static_cast<uint32_t>(cachedSkin.skeletonRoot));
+		}
+		for (auto joint : cachedSkin.joints) {
+			Node* node = nodeFromIndex(joint);
+			if (node) {
+				skin->joints.push_back(node);
+			}
+		}
+		skin->inverseBindMatrices = cachedSkin.inverseBindMatrices;
+		skins.push_back(skin);
+	}
+
+	metallicRoughnessWorkflow = cachedMetallicRoughnessWorkflow;
+	meshOptimizationStatistics = cachedOptimizationStatistics;
+
+	vertexData = cacheFile.data() + header.vertexOffset;
+	vertexCount = static_cast<size_t>(header.vertexCount);
+	indexData = cacheFile.data() + header.indexOffset;
+	indexCount = static_cast<size_t>(header.indexCount);
+	return true;
+}
+
+void vkglTF::Model::writeGeometryCache(const std::string& cacheFileName, const std::string& filename, const tinygltf::Model& gltfModel, float scale, const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indexBuffer)
+{
+	VKS_TRACE_ZONE("vkglTF::Model::writeGeometryCache");
+	// Images are loaded from their files on a cache hit, so embedded images can't be cached
+	for (auto& image : gltfModel.images) {
+		if (!isExternalUri(image.uri)) {
+			return;
+		}
+	}
+	std::vector<uint8_t> source;
+	if (!readFileData(filename, source)) {
+		return;
+	}
+
+	CacheWriter scene;
+	std::vector<const tinygltf::Buffer*> externalBuffers;
+	for (auto& buffer : gltfModel.buffers) {
+		if (isExternalUri(buffer.uri)) {
+			externalBuffers.push_back(&buffer);
+		}
+	}
+	scene.write(static_cast<uint32_t>(externalBuffers.size()));
+	for (auto buffer : externalBuffers) {
+		uint64_t size;
+		int64_t modificationTime;
+		if (!getFileInfo(path + "/" + buffer->uri, size, modificationTime)) {
+			return;
+		}
+		scene.writeString(buffer->uri);
+		scene.write(size);
+		scene.write(modificationTime);
+	}
+
+	scene.write(static_cast<uint8_t>(metallicRoughnessWorkflow ? 1 : 0));
+	scene.write(static_cast<uint32_t>(gltfModel.images.size()));
+	for (auto& image : gltfModel.images) {
+		scene.writeString(image.uri);
+	}
+
+	auto getTextureIndex = [this](const vkglTF::Texture* texture) -> int32_t {
+		if (texture == &emptyTexture) {
+			return -2;
+		}
+		return texture ? static_cast<int32_t>(texture - textures.data()) : -1;
+	};
+	// The default material at the end of the list is added again when loading
+	std::vector<CachedMaterial> cachedMaterials(materials.size() - 1);
+	for (size_t i = 0; i < cachedMaterials.size(); i++) {
+		const Material& material = materials[i];
+		CachedMaterial& cachedMaterial = cachedMaterials[i];
+		cachedMaterial.alphaMode = static_cast<int32_t>(material.alphaMode);
+		cachedMaterial.alphaCutoff = material.alphaCutoff;
+		cachedMaterial.metallicFactor = material.metallicFactor;
+		cachedMaterial.roughnessFactor = material.roughnessFactor;
+		cachedMaterial.baseColorFactor = material.baseColorFactor;
+		cachedMaterial.textures[0] = getTextureIndex(material.baseColorTexture);
+		cachedMaterial.textures[1] = getTextureIndex(material.metallicRoughnessTexture);
+		cachedMaterial.textures[2] = getTextureIndex(material.normalTexture);
+		cachedMaterial.textures[3] = getTextureIndex(material.occlusionTexture);
+		cachedMaterial.textures[4] = getTextureIndex(material.emissiveTexture);
+	}
+	scene.writeVector(cachedMaterials);
+
+	std::unordered_map<const Node*, uint32_t> linearIndices;
+	for (size_t i = 0; i < linearNodes.size(); i++) {
+		linearIndices[linearNodes[i]] = static_cast<uint32_t>(i);
+	}
+	scene.write(static_cast<uint32_t>(linearNodes.size()));
+	for (auto node : linearNodes) {
+		scene.write(node->parent ? static_cast<int32_t>(linearIndices[node->parent]) : -1);
+		scene.write(node->index);
+		scene.writeString(node->name);
+		scene.write(node->skinIndex);
+		scene.write(node->matrix);
+		scene.write(node->translation);
+		scene.write(node->rotation);
+		scene.write(node->scale);
+		std::vector<uint32_t> children;
+		for (auto child : node->children) {
+			children.push_back(linearIndices[child]);
+		}
+		scene.writeVector(children);
+		scene.write(static_cast<uint8_t>(node->mesh ? 1 : 0));
+		if (node->mesh) {
+			scene.writeString(node->mesh->name);
+			std::vector<CachedPrimitive> primitives;
+			for (auto primitive : node->mesh->primitives) {
+				CachedPrimitive cachedPrimitive;
+				cachedPrimitive.firstIndex = primitive->firstIndex;
+				cachedPrimitive.indexCount = primitive->indexCount;
+				cachedPrimitive.firstVertex = primitive->firstVertex;
+				cachedPrimitive.vertexCount = primitive->vertexCount;
+				cachedPrimitive.material = static_cast<uint32_t>(&primitive->material - materials.data());
+				cachedPrimitive.min = primitive->dimensions.min;
+				cachedPrimitive.max = primitive->dimensions.max;
+				primitives.push_back(cachedPrimitive);
+			}
+			scene.writeVector(primitives);
+		}
+	}
+	std::vector<uint32_t> rootNodes;
+	for (auto node : nodes) {
+		rootNodes.push_back(linearIndices[node]);
+	}
+	scene.writeVector(rootNodes);
+
+	scene.write(static_cast<uint32_t>(skins.size()));
+	for (auto skin : skins) {
+		scene.writeString(skin->name);
+		scene.write(skin->skeletonRoot ? static_cast<int32_t>(skin->skeletonRoot->index) : -1);
+		std::vector<uint32_t> joints;
+		for (auto joint : skin->joints) {
+			joints.push_back(joint->index);
+		}
+		scene.writeVector(joints);
+		scene.writeVector(skin->inverseBindMatrices);
+	}
+
+	scene.write(static_cast<uint32_t>(animations.size()));
+	for (auto& animation : animations) {
+		scene.writeString(animation.name);
+		scene.write(animation.start);
+		scene.write(animation.end);
+		scene.write(static_cast<uint32_t>(animation.samplers.size()));
+		for (auto& sampler : animation.samplers) {
+			scene.write(static_cast<int32_t>(sampler.interpolation));
+			scene.writeVector(sampler.inputs);
+			scene.writeVector(sampler.outputsVec4);
+		}
+		std::vector<CachedChannel> channels;
+		for (auto& channel : animation.channels) {
+			CachedChannel cachedChannel;
+			cachedChannel.path = static_cast<int32_t>(channel.path);
+			cachedChannel.node = channel.node->index;
+			cachedChannel.samplerIndex = channel.samplerIndex;
+			channels.push_back(cachedChannel);
+		}
+		scene.writeVector(channels);
+	}
+
+	scene.write(meshOptimizationStatistics);
+
+	// Vertex and index data are aligned, so they can be read directly from the mapped file
+	CacheWriter cache;
+	GeometryCacheHeader header{};
+	memcpy(header.magic, geometryCacheMagic, sizeof(header.magic));
+	header.version = geometryCacheVersion;
+	header.vertexSize = sizeof(Vertex);
+	header.sourceHash = hashData(source.data(), source.size());
+	header.fileLoadingFlags = fileLoadingFlags;
+	header.scale = scale;
+	cache.write(header);
+	cache.align(16);
+	header.vertexOffset = cache.data.size();
+	header.vertexCount = vertexBuffer.size();
+	cache.writeBytes(vertexBuffer.data(), vertexBuffer.size() * sizeof(Vertex));
+	cache.align(16);
+	header.indexOffset = cache.data.size();
+	header.indexCount = indexBuffer.size();
+	cache.writeBytes(indexBuffer.data(), indexBuffer.size() * sizeof(uint32_t));
+	cache.align(16);
+	header.sceneOffset = cache.data.size();
+	header.sceneSize = scene.data.size();
+	cache.writeBytes(scene.data.data(), scene.data.size());
+	memcpy(cache.data.data(), &header, sizeof(header));
+
+	// Write to a temporary file first and then replace the old cache, so an interrupted write never leaves a truncated cache behind
+	const std::string tempFileName = cacheFileName + ".tmp";
+	std::ofstream os(tempFileName, std::ios::binary | std::ios::trunc);
+	if (!os.is_open()) {
+		std::cerr << "Could not write geometry cache \"" << tempFileName << "\"\n";
+		return;
+	}
+	os.write(reinterpret_cast<const char*>(cache.data.data()), cache.data.size());
+	os.close();
+	if (os.fail()) {
+		std::remove(tempFileName.c_str());
+		return;
+	}
+#if defined(_WIN32)
+	const bool replaced = MoveFileExA(tempFileName.c_str(), cacheFileName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	const bool replaced = std::rename(tempFileName.c_str(), cacheFileName.c_str()) == 0;
+#endif
+	if (!replaced) {
+		std::cerr << "Could not replace geometry cache \"" << cacheFileName << "\"\n";
+		std::remove(tempFileName.c_str());
+	}
+}
+
 void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 {
 	const VkDeviceSize offsets[1] = {0};
@@ -1413,27 +2865,35 @@ void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 	buffersBound = true;
 }
 
+// Returns false if the primitive's material doesn't match the render flags
+bool vkglTF::Model::drawPrimitive(Primitive *primitive, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	bool skip = false;
+	const vkglTF::Material& material = primitive->material;
+	if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+		skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
+	}
+	if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+		skip = (material.alphaMode != Material::ALPHAMODE_MASK);
+	}
+	if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+		skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
+	}
+	if (skip) {
+		return false;
+	}
+	if (renderFlags & RenderFlags::BindImages) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+	}
+	vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+	return true;
+}
+
 void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
 {
 	if (node->mesh) {
 		for (Primitive* primitive : node->mesh->primitives) {
-			bool skip = false;
-			const vkglTF::Material& material = primitive->material;
-			if (renderFlags & RenderFlags::RenderOpaqueNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_MASK);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
-			}
-			if (!skip) {
-				if (renderFlags & RenderFlags::BindImages) {
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
-				}
-				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
-			}
+			drawPrimitive(primitive, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
 		}
 	}
 	for (auto& child : node->children) {
@@ -1453,6 +2913,192 @@ void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, Vk
 	}
 }
 
+void vkglTF::Model::drawBVHNode(uint32_t index, bool inside, const vks::Frustum &frustum, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	const BVHNode &node = bvh.nodes[index];
+	if (!inside) {
+		const vks::Frustum::intersection intersection = frustum.checkAABBIntersection(node.min, node.max);
+		if (intersection == vks::Frustum::OUTSIDE) {
+			cullingStatistics.culledPrimitives += node.primitiveCount;
+			return;
+		}
+		// Nothing below a node that's fully inside the frustum needs to be tested
+		inside = (intersection == vks::Frustum::INSIDE);
+	}
+	if (inside || (node.secondChild < 0)) {
+		for (uint32_t i = node.firstPrimitive; i < node.firstPrimitive + node.primitiveCount; i++) {
+			const BVHPrimitive &primitive = bvh.primitives[i];
+			if (!inside && !frustum.checkAABB(primitive.min, primitive.max)) {
+				cullingStatistics.culledPrimitives++;
+				continue;
+			}
+			if (drawPrimitive(primitive.primitive, commandBuffer, renderFlags, pipelineLayout, bindImageSet)) {
+				cullingStatistics.drawnPrimitives++;
+			}
+		}
+		return;
+	}
+	drawBVHNode(index + 1, false, frustum, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+	drawBVHNode(node.secondChild, false, frustum, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+}
+
+void vkglTF::Model::draw(VkCommandBuffer commandBuffer, const vks::Frustum &frustum, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	if (!buffersBound) {
+		const VkDeviceSize offsets[1] = {0};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+	cullingStatistics = {};
+	for (auto &primitive : bvh.unboundedPrimitives) {
+		if (drawPrimitive(primitive.primitive, commandBuffer, renderFlags, pipelineLayout, bindImageSet)) {
+			cullingStatistics.drawnPrimitives++;
+		}
+	}
+	if (!bvh.nodes.empty()) {
+		drawBVHNode(0, false, frustum, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+	}
+}
+
+/*
+	Bounding volume hierarchy
+*/
+
+// Model space bounds of a primitive, matching the vertex positions the shaders see after applying the node's matrix
+void vkglTF::Model::getPrimitiveBounds(Node *node, Primitive *primitive, glm::vec3 &min, glm::vec3 &max)
+{
+	const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+	const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+	glm::vec3 localMin = primitive->dimensions.min;
+	glm::vec3 localMax = primitive->dimensions.max;
+	// Without pre-transformation, the Y-Axis is flipped before the node's matrix is applied
+	if (flipY && !preTransform) {
+		const float y = localMin.y;
+		localMin.y = -localMax.y;
+		localMax.y = -y;
+	}
+	const glm::mat4 matrix = node->getMatrix();
+	min = glm::vec3(FLT_MAX);
+	max = glm::vec3(-FLT_MAX);
+	for (uint32_t i = 0; i < 8; i++) {
+		const glm::vec3 corner((i & 1) ? localMax.x : localMin.x, (i & 2) ? localMax.y : localMin.y, (i & 4) ? localMax.z : localMin.z);
+		const glm::vec3 transformed = glm::vec3(matrix * glm::vec4(corner, 1.0f));
+		min = glm::min(min, transformed);
+		max = glm::max(max, transformed);
+	}
+	if (flipY && preTransform) {
+		const float y = min.y;
+		min.y = -max.y;
+		max.y = -y;
+	}
+}
+
+// Recursively splits the primitive range at the median along the longest axis of the primitives' centers
+uint32_t vkglTF::Model::buildBVHNode(uint32_t firstPrimitive, uint32_t primitiveCount, int32_t parent)
+{
+	const uint32_t maxLeafPrimitives = 4;
+	const uint32_t index = static_cast<uint32_t>(bvh.nodes.size());
+	bvh.nodes.push_back(BVHNode());
+	BVHNode node{};
+	node.parent = parent;
+	node.secondChild = -1;
+	node.firstPrimitive = firstPrimitive;
+	node.primitiveCount = primitiveCount;
+	node.min = glm::vec3(FLT_MAX);
+	node.max = glm::vec3(-FLT_MAX);
+	glm::vec3 centerMin(FLT_MAX);
+	glm::vec3 centerMax(-FLT_MAX);
+	for (uint32_t i = firstPrimitive; i < firstPrimitive + primitiveCount; i++) {
+		node.min = glm::min(node.min, bvh.primitives[i].min);
+		node.max = glm::max(node.max, bvh.primitives[i].max);
+		const glm::vec3 center = (bvh.primitives[i].min + bvh.primitives[i].max) * 0.5f;
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+	if (primitiveCount <= maxLeafPrimitives) {
+		for (uint32_t i = firstPrimitive; i < firstPrimitive + primitiveCount; i++) {
+			bvh.primitives[i].leaf = index;
+		}
+		bvh.nodes[index] = node;
+		return index;
+	}
+	const glm::vec3 extent = centerMax - centerMin;
+	const uint32_t axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : ((extent.y > extent.z) ? 1 : 2);
+	const uint32_t half = primitiveCount / 2;
+	std::nth_element(bvh.primitives.begin() + firstPrimitive, bvh.primitives.begin() + firstPrimitive + half, bvh.primitives.begin() + firstPrimitive + primitiveCount, [axis](const BVHPrimitive &a, const BVHPrimitive &b) {
+		return (a.min[axis] + a.max[axis]) < (b.min[axis] + b.max[axis]);
+	});
+	buildBVHNode(firstPrimitive, half, index);
+	node.secondChild = static_cast<int32_t>(buildBVHNode(firstPrimitive + half, primitiveCount - half, index));
+	bvh.nodes[index] = node;
+	return index;
+}
+
+void vkglTF::Model::buildBVH()
+{
+	bvh.nodes.clear();
+	bvh.primitives.clear();
+	bvh.unboundedPrimitives.clear();
+	for (auto node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		for (Primitive *primitive : node->mesh->primitives) {
+			BVHPrimitive bvhPrimitive{};
+			bvhPrimitive.node = node;
+			bvhPrimitive.primitive = primitive;
+			if (node->skin) {
+				bvh.unboundedPrimitives.push_back(bvhPrimitive);
+				continue;
+			}
+			getPrimitiveBounds(node, primitive, bvhPrimitive.min, bvhPrimitive.max);
+			bvh.primitives.push_back(bvhPrimitive);
+		}
+	}
+	if (!bvh.primitives.empty()) {
+		bvh.nodes.reserve(2 * bvh.primitives.size());
+		buildBVHNode(0, static_cast<uint32_t>(bvh.primitives.size()), -1);
+	}
+}
+
+// Updates the bounds of all primitives whose node has moved since the last update and of the hierarchy nodes containing them, the hierarchy's layout stays the same
+void vkglTF::Model::refitBVH()
+{
+	if (bvh.nodes.empty() || (transforms.updatedCount == 0)) {
+		return;
+	}
+	std::vector<bool> dirty(bvh.nodes.size(), false);
+	for (auto &bvhPrimitive : bvh.primitives) {
+		if (!transforms.updated[bvhPrimitive.node->transformIndex]) {
+			continue;
+		}
+		getPrimitiveBounds(bvhPrimitive.node, bvhPrimitive.primitive, bvhPrimitive.min, bvhPrimitive.max);
+		for (int32_t index = static_cast<int32_t>(bvhPrimitive.leaf); index >= 0 && !dirty[index]; index = bvh.nodes[index].parent) {
+			dirty[index] = true;
+		}
+	}
+	// Children are always stored after their parents, so walking backwards refits them first
+	for (size_t i = bvh.nodes.size(); i-- > 0;) {
+		if (!dirty[i]) {
+			continue;
+		}
+		BVHNode &node = bvh.nodes[i];
+		if (node.secondChild < 0) {
+			node.min = glm::vec3(FLT_MAX);
+			node.max = glm::vec3(-FLT_MAX);
+			for (uint32_t j = node.firstPrimitive; j < node.firstPrimitive + node.primitiveCount; j++) {
+				node.min = glm::min(node.min, bvh.primitives[j].min);
+				node.max = glm::max(node.max, bvh.primitives[j].max);
+			}
+		} else {
+			const BVHNode &first = bvh.nodes[i + 1];
+			const BVHNode &second = bvh.nodes[node.secondChild];
+			node.min = glm::min(first.min, second.min);
+			node.max = glm::max(first.max, second.max);
+		}
+	}
+}
+
 void vkglTF::Model::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
 {
 	if (node->mesh) {
@@ -1490,55 +3136,54 @@ void vkglTF::Model::updateAnimation(uint32_t index, float time)
 		std::cout << "No animation with index " << index << std::endl;
 		return;
 	}
-	Animation &animation = animations[index];
+	if (animations[index].update(time)) {
+		updateNodes();
+	}
+}
 
-	bool updated = false;
-	for (auto& channel : animation.channels) {
-		vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
-			continue;
+void vkglTF::Model::updateAnimations(vks::JobSystem& jobSystem, const std::vector<AnimationUpdate>& updates)
+{
+	// Invalid indices are reported up front, so the jobs don't write to the console
+	for (auto& update : updates) {
+		if (update.animation >= static_cast<uint32_t>(update.model->animations.size())) {
+			std::cout << "No animation with index " << update.animation << std::endl;
 		}
+	}
+	// Models are independent of each other, so each one can be updated by a different thread
+	jobSystem.parallelFor(static_cast<uint32_t>(updates.size()), 4, [&updates](uint32_t i) {
+		Model* model = updates[i].model;
+		if ((updates[i].animation < static_cast<uint32_t>(model->animations.size())) && model->animations[updates[i].animation].update(updates[i].time)) {
+			model->updateNodes();
+		}
+	});
+}
 
-		for (auto i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					switch (channel.path) {
-					case vkglTF::AnimationChannel::PathType::TRANSLATION: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->translation = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::SCALE: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->scale = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::ROTATION: {
-						glm::quat q1;
-						q1.x = sampler.outputsVec4[i].x;
-						q1.y = sampler.outputsVec4[i].y;
-						q1.z = sampler.outputsVec4[i].z;
-						q1.w = sampler.outputsVec4[i].w;
-						glm::quat q2;
-						q2.x = sampler.outputsVec4[i + 1].x;
-						q2.y = sampler.outputsVec4[i + 1].y;
-						q2.z = sampler.outputsVec4[i + 1].z;
-						q2.w = sampler.outputsVec4[i + 1].w;
-						channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-						break;
-					}
-					}
-					updated = true;
+void vkglTF::Model::updateNodes()
+{
+	transforms.update();
+	if (transforms.updatedCount == 0) {
+		return;
+	}
+	for (auto node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		bool moved = transforms.updated[node->transformIndex];
+		// Skinned meshes also need new joint matrices if any of their joints has moved
+		if (!moved && node->skin) {
+			for (auto joint : node->skin->joints) {
+				if (transforms.updated[joint->transformIndex]) {
+					moved = true;
+					break;
 				}
 			}
 		}
-	}
-	if (updated) {
-		for (auto &node : nodes) {
-			node->update();
+		if (moved) {
+			node->updateMesh();
 		}
 	}
+	refitBVH();
+	transforms.clearUpdated();
 }
 
 /*
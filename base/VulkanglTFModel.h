@@ -15,6 +15,7 @@
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "frustum.hpp"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -35,6 +36,12 @@
 #include <android/asset_manager.h>
 #endif
 
+namespace vks
+{
+	class MappedFile;
+	class JobSystem;
+}
+
 namespace vkglTF
 {
 	enum DescriptorBindingFlags {
@@ -46,6 +53,8 @@ namespace vkglTF
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
 	extern uint32_t descriptorBindingFlags;
+	/** @brief Directory for the binary geometry caches of loaded glTF files, caching is disabled if empty */
+	extern std::string geometryCachePath;
 
 	struct Node;
 
@@ -63,8 +72,12 @@ namespace vkglTF
 		uint32_t layerCount;
 		VkDescriptorImageInfo descriptor;
 		VkSampler sampler;
+		vks::MemoryAllocator::Allocation allocation;
+		// False while the texture is a placeholder for an image that is still being loaded asynchronously
+		bool resident = true;
 		void updateDescriptor();
 		void destroy();
+		void createSamplerAndView(VkFormat format);
 		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
 	};
 
@@ -91,6 +104,8 @@ namespace vkglTF
 		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 
 		Material(vks::VulkanDevice* device) : device(device) {};
+		/** @brief Returns true if none of the material's textures is still being loaded asynchronously */
+		bool isResident() const;
 		void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
 	};
 
@@ -128,6 +143,7 @@ namespace vkglTF
 		struct UniformBuffer {
 			VkBuffer buffer;
 			VkDeviceMemory memory;
+			vks::MemoryAllocator::Allocation allocation;
 			VkDescriptorBufferInfo descriptor;
 			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 			void* mapped;
@@ -153,6 +169,40 @@ namespace vkglTF
 		std::vector<Node*> joints;
 	};
 
+	/*
+		Flattened node transforms
+		Local transforms and world matrices of all nodes of a hierarchy are stored as structure of arrays in topological order (parents before their children)
+		World matrices are cached and recalculated in a single linear pass for nodes whose local transform, or that of one of their ancestors, has changed
+	*/
+	struct NodeTransforms {
+		std::vector<Node*> nodes;
+		// Index of the parent node, -1 for root nodes
+		std::vector<int32_t> parents;
+		std::vector<glm::vec3> translations;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+		// Static matrices of nodes that define their transform as a matrix, only applied for nodes with hasMatrix set
+		std::vector<glm::mat4> matrices;
+		std::vector<uint8_t> hasMatrix;
+		std::vector<glm::mat4> worldMatrices;
+		// Set for nodes whose local transform has changed since the last update
+		std::vector<uint8_t> dirty;
+		// Set for nodes whose world matrix has been recalculated since the last call to clearUpdated
+		std::vector<uint8_t> updated;
+		uint32_t updatedCount = 0;
+		bool anyDirty = false;
+
+		/** @brief Flattens the hierarchies below the given root nodes, the nodes' current transforms are used as the initial local transforms */
+		void build(const std::vector<Node*>& roots);
+		void setTranslation(uint32_t index, const glm::vec3& translation);
+		void setRotation(uint32_t index, const glm::quat& rotation);
+		void setScale(uint32_t index, const glm::vec3& scale);
+		glm::mat4 localMatrix(uint32_t index) const;
+		/** @brief Recalculates the world matrices of all dirty nodes and their descendants */
+		void update();
+		void clearUpdated();
+	};
+
 	/*
 		glTF node
 	*/
@@ -165,11 +215,17 @@ namespace vkglTF
 		Mesh* mesh;
 		Skin* skin;
 		int32_t skinIndex = -1;
+		// Local transform as loaded from the file, once the node is part of flattened transforms the current transform is stored there
 		glm::vec3 translation{};
 		glm::vec3 scale{ 1.0f };
 		glm::quat rotation{};
+		NodeTransforms* transforms = nullptr;
+		uint32_t transformIndex = 0;
 		glm::mat4 localMatrix();
 		glm::mat4 getMatrix();
+		/** @brief Updates the uniform buffer of the node's mesh (if any) */
+		void updateMesh();
+		/** @brief Updates the uniform buffers of the meshes of the node and all of its descendants */
 		void update();
 		~Node();
 	};
@@ -182,6 +238,8 @@ namespace vkglTF
 		PathType path;
 		Node* node;
 		uint32_t samplerIndex;
+		// Keyframe of the last evaluation, where the search for the next one starts
+		uint32_t key = 0;
 	};
 
 	/*
@@ -191,7 +249,14 @@ namespace vkglTF
 		enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
 		InterpolationType interpolation;
 		std::vector<float> inputs;
+		// For cubic spline interpolation, each keyframe stores an in-tangent, the value and an out-tangent
 		std::vector<glm::vec4> outputsVec4;
+		/** @brief Returns true if there are at least two keyframes and an output for each of them */
+		bool valid() const;
+		/** @brief Returns the index of the keyframe at the start of the interval containing time, starting the search at the given key (which is updated) */
+		uint32_t findKey(float time, uint32_t& key) const;
+		/** @brief Interpolates the outputs at the given time, rotations are interpolated as normalized quaternions (x, y, z, w) */
+		glm::vec4 evaluate(float time, uint32_t& key, bool rotation) const;
 	};
 
 	/*
@@ -203,6 +268,8 @@ namespace vkglTF
 		std::vector<AnimationChannel> channels;
 		float start = std::numeric_limits<float>::max();
 		float end = std::numeric_limits<float>::min();
+		/** @brief Applies the animated values at the given time to the transforms of the target nodes, returns false if no channel has been updated */
+		bool update(float time);
 	};
 
 	/*
@@ -228,12 +295,48 @@ namespace vkglTF
 		static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
 	};
 
+	/*
+		Packed vertex layout that only stores the requested vertex components, in compact formats:
+			Position: 32 bit floats, or 16 bit unorm within the bounds of the model if quantized
+			Normal, Tangent: 8 bit snorm
+			UV: 16 bit floats
+			Color, Weight0: 8 bit unorm
+			Joint0: 8 bit unsigned integers, or 16 bit if the model uses more than 256 joints
+		All components except the joints are read as floats, so shaders written for vkglTF::Vertex work unchanged
+		Joints have to be declared as uvec4 instead
+	*/
+	struct VertexLayout {
+		std::vector<VertexComponent> components;
+		bool quantizePositions = false;
+		// Derived from the vertices of the model when they are packed
+		std::vector<VkFormat> formats;
+		std::vector<uint32_t> offsets;
+		uint32_t stride = 0;
+		/** @brief Maps quantized positions back to model space, has to be applied before any other transformation (e.g. as the model matrix for models loaded with FileLoadingFlags::PreTransformVertices) */
+		glm::mat4 dequantizationMatrix = glm::mat4(1.0f);
+		VkVertexInputBindingDescription vertexInputBindingDescription;
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescriptions;
+		VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo;
+		VertexLayout() {};
+		VertexLayout(const std::vector<VertexComponent> components, bool quantizePositions = false) : components(components), quantizePositions(quantizePositions) {};
+		/** @brief Selects the formats and the quantization for the given vertices */
+		void prepare(const Vertex* vertices, size_t vertexCount);
+		void pack(const Vertex* vertices, size_t vertexCount, void* dst) const;
+		VkVertexInputBindingDescription inputBindingDescription(uint32_t binding) const;
+		std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding) const;
+		/** @brief Returns the pipeline vertex input state create info structure for the packed vertices, only valid once the model has been loaded */
+		VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState();
+	};
+
 	enum FileLoadingFlags {
 		None = 0x00000000,
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		LoadImagesAsync = 0x00000010,
+		// Deduplicates vertices and reorders the indices and vertices of triangle list primitives for the vertex cache, overdraw and vertex fetch
+		OptimizeMeshes = 0x00000020
 	};
 
 	enum RenderFlags {
@@ -243,6 +346,8 @@ namespace vkglTF
 		RenderAlphaBlendedNodes = 0x00000008
 	};
 
+	struct AsyncImageLoader;
+
 	/*
 		glTF model loading and rendering class
 	*/
@@ -250,24 +355,41 @@ namespace vkglTF
 	private:
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
+		AsyncImageLoader* asyncImageLoader = nullptr;
 		void createEmptyTexture(VkQueue transferQueue);
+		void destroyAsyncImageLoader();
+		uint32_t fileLoadingFlags = 0;
+		bool drawPrimitive(Primitive* primitive, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet);
+		void getPrimitiveBounds(Node* node, Primitive* primitive, glm::vec3& min, glm::vec3& max);
+		uint32_t buildBVHNode(uint32_t firstPrimitive, uint32_t primitiveCount, int32_t parent);
+		void buildBVH();
+		void refitBVH();
+		void drawBVHNode(uint32_t index, bool inside, const vks::Frustum& frustum, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet);
+		std::string getGeometryCacheFileName(const std::string& filename, uint32_t fileLoadingFlags, float scale) const;
+		bool loadGeometryCache(const std::string& cacheFileName, const std::string& filename, VkQueue transferQueue, float scale, vks::MappedFile& cacheFile, const void*& vertexData, size_t& vertexCount, const void*& indexData, size_t& indexCount);
+		void writeGeometryCache(const std::string& cacheFileName, const std::string& filename, const tinygltf::Model& gltfModel, float scale, const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indexBuffer);
+		uint32_t optimizePrimitive(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, uint32_t firstIndex, uint32_t firstVertex);
 	public:
-		vks::VulkanDevice* device;
-		VkDescriptorPool descriptorPool;
+		vks::VulkanDevice* device = nullptr;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 
 		struct Vertices {
 			int count;
 			VkBuffer buffer;
 			VkDeviceMemory memory;
+			vks::MemoryAllocator::Allocation allocation;
 		} vertices;
 		struct Indices {
 			int count;
 			VkBuffer buffer;
 			VkDeviceMemory memory;
+			vks::MemoryAllocator::Allocation allocation;
 		} indices;
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
+		/** @brief Transforms of all nodes, changes are applied to the meshes by updateNodes */
+		NodeTransforms transforms;
 
 		std::vector<Skin*> skins;
 
@@ -283,6 +405,59 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		/*
+			Bounding volume hierarchy over the model space bounds of all primitives, used by the frustum culled draw
+			It's built at load time and refitted for the nodes moved by updateNodes
+			Primitives of skinned meshes are not part of the hierarchy and are always drawn, as their bounds depend on the joints
+		*/
+		struct BVHNode {
+			glm::vec3 min;
+			glm::vec3 max;
+			// The first child of an inner node directly follows it, so only the index of the second child is stored (-1 for leaves)
+			int32_t secondChild = -1;
+			int32_t parent = -1;
+			// Primitives of the node's subtree
+			uint32_t firstPrimitive;
+			uint32_t primitiveCount;
+		};
+		struct BVHPrimitive {
+			Node* node;
+			Primitive* primitive;
+			glm::vec3 min;
+			glm::vec3 max;
+			uint32_t leaf;
+		};
+		struct BVH {
+			std::vector<BVHNode> nodes;
+			std::vector<BVHPrimitive> primitives;
+			std::vector<BVHPrimitive> unboundedPrimitives;
+		} bvh;
+
+		/** @brief Primitive counts of the last frustum culled draw */
+		struct CullingStatistics {
+			uint32_t drawnPrimitives = 0;
+			uint32_t culledPrimitives = 0;
+		} cullingStatistics;
+
+		/** @brief Vertex cache efficiency of the primitives before and after optimization, only filled for models loaded with FileLoadingFlags::OptimizeMeshes */
+		struct MeshOptimizationStatistics {
+			uint32_t primitiveCount = 0;
+			uint32_t triangleCount = 0;
+			uint32_t vertexCountBefore = 0;
+			uint32_t vertexCountAfter = 0;
+			uint32_t cacheMissesBefore = 0;
+			uint32_t cacheMissesAfter = 0;
+			// Average cache miss ratio (vertex shader invocations per triangle)
+			float acmrBefore() const { return triangleCount > 0 ? (float)cacheMissesBefore / (float)triangleCount : 0.0f; }
+			float acmrAfter() const { return triangleCount > 0 ? (float)cacheMissesAfter / (float)triangleCount : 0.0f; }
+			// Average transformed vertex ratio (vertex shader invocations per vertex)
+			float atvrBefore() const { return vertexCountBefore > 0 ? (float)cacheMissesBefore / (float)vertexCountBefore : 0.0f; }
+			float atvrAfter() const { return vertexCountAfter > 0 ? (float)cacheMissesAfter / (float)vertexCountAfter : 0.0f; }
+		} meshOptimizationStatistics;
+
+		/** @brief If vertex components are set before loading, vertices are uploaded in this packed layout instead of vkglTF::Vertex */
+		VertexLayout vertexLayout;
+
 		bool metallicRoughnessWorkflow = true;
 		bool buffersBound = false;
 		std::string path;
@@ -292,15 +467,31 @@ namespace vkglTF
 		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
 		void loadSkins(tinygltf::Model& gltfModel);
 		void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
+		void loadImagesAsync(tinygltf::Model& gltfModel, VkQueue transferQueue);
+		/** @brief Submits images decoded by the loading threads and finishes completed uploads, returns true if material descriptor sets have changed (and command buffers need to be rebuilt) */
+		bool updateAsyncLoading();
+		/** @brief Returns true once all images of a model loaded with FileLoadingFlags::LoadImagesAsync are resident */
+		bool imagesResident() const;
 		void loadMaterials(tinygltf::Model& gltfModel);
 		void loadAnimations(tinygltf::Model& gltfModel);
 		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
 		void bindBuffers(VkCommandBuffer commandBuffer);
 		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
 		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		/** @brief Draws only the primitives whose bounds intersect the frustum, which has to be built from a matrix that includes the model matrix (e.g. projection * view * model) */
+		void draw(VkCommandBuffer commandBuffer, const vks::Frustum& frustum, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
+		struct AnimationUpdate {
+			Model* model;
+			uint32_t animation;
+			float time;
+		};
+		/** @brief Updates the animations of many models in parallel using the threads of the job system, each model must only be passed once */
+		static void updateAnimations(vks::JobSystem& jobSystem, const std::vector<AnimationUpdate>& updates);
+		/** @brief Applies changed node transforms to the world matrices, the mesh uniform buffers (including joint matrices) and the culling bounds of the moved nodes */
+		void updateNodes();
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
 		void prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout);
@@ -1,18 +1,24 @@
 /*
 * Benchmark class
 *
-* Copyright (C) 2016-2017 by Sascha Willems - www.saschawillems.de
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
 #include <vector>
+#include <deque>
 #include <string>
 #include <algorithm>
 #include <limits>
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <fstream>
+#include <numeric>
+#include <cmath>
+
+#include "json.hpp"
 
 namespace vks
 {
@@ -20,18 +26,303 @@ namespace vks
 	private:
 		FILE *stream;
 		VkPhysicalDeviceProperties deviceProps;
+
+		// GPU frame times are measured with two timestamps per frame (start and end), one pair per frame in flight
+		struct GpuTimer {
+			VkDevice device = VK_NULL_HANDLE;
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> beginCommandBuffers;
+			std::vector<VkCommandBuffer> endCommandBuffers;
+			// The swap chain image is acquired with these, so the start timestamp is written once the image is available
+			std::vector<VkSemaphore> acquireSemaphores;
+			std::vector<bool> begun;
+			// Frames whose timestamps have been submitted but not read back yet (oldest first)
+			std::deque<uint32_t> pendingFrames;
+			uint64_t validBitsMask = 0;
+			float timestampPeriod = 1.0f;
+			uint64_t lastEnd = 0;
+		} gpuTimer;
+		// Only frames of the benchmark phase (not the warm up phase) are added to the results
+		bool measuring = false;
+		double frameWaitTime = 0.0;
+
+		void resolveGpuFrame(uint32_t frame, bool wait)
+		{
+			uint64_t timestamps[2];
+			VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | (wait ? VK_QUERY_RESULT_WAIT_BIT : 0);
+			VkResult result = vkGetQueryPoolResults(gpuTimer.device, gpuTimer.queryPool, frame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), flags);
+			if (result != VK_SUCCESS) {
+				return;
+			}
+			uint64_t start = timestamps[0] & gpuTimer.validBitsMask;
+			uint64_t end = timestamps[1] & gpuTimer.validBitsMask;
+			// With multiple frames in flight, the start of a frame may be written while the previous frame is still executing
+			start = std::max(start, gpuTimer.lastEnd);
+			gpuTimer.lastEnd = end;
+			if (measuring && (end > start)) {
+				gpuFrameTimes.push_back(double(end - start) * gpuTimer.timestampPeriod / 1000000.0);
+			}
+		}
+
+		// Frames per second over the benchmark phase (0 if nothing was measured, as inf and nan are not valid JSON)
+		double getFps() const
+		{
+			return (runtime > 0.0) ? frameCount / (runtime / 1000.0) : 0.0;
+		}
+
+		static void writeStatisticsJson(std::ofstream &result, const std::string &name, const std::vector<double> &values, bool last)
+		{
+			Statistics stats = computeStatistics(values);
+			result << "\t\t\"" << name << "\": { ";
+			result << "\"min\": " << stats.min << ", \"max\": " << stats.max << ", \"mean\": " << stats.mean << ", \"stddev\": " << stats.stdDev << ", ";
+			result << "\"p50\": " << stats.p50 << ", \"p90\": " << stats.p90 << ", \"p99\": " << stats.p99 << ", \"p99.9\": " << stats.p999 << ", ";
+			result << "\"outliers\": " << stats.outliers << ", \"samples\": " << values.size() << " }" << (last ? "" : ",") << "\n";
+		}
+
+		static void writeValuesJson(std::ofstream &result, const std::string &name, const std::vector<double> &values, bool last)
+		{
+			result << "\t\t\"" << name << "\": [";
+			for (size_t i = 0; i < values.size(); i++) {
+				result << (i > 0 ? ", " : "") << values[i];
+			}
+			result << "]" << (last ? "" : ",") << "\n";
+		}
+
+		static void printStatistics(const std::string &name, const std::vector<double> &values)
+		{
+			if (values.empty()) {
+				return;
+			}
+			Statistics stats = computeStatistics(values);
+			std::cout << name << ": avg " << stats.mean << " ms, stddev " << stats.stdDev << " ms, p50 " << stats.p50 << " ms, p90 " << stats.p90 << " ms, p99 " << stats.p99 << " ms, p99.9 " << stats.p999 << " ms, outliers " << stats.outliers << "\n";
+		}
+
 	public:
+		struct Statistics {
+			double min = 0.0;
+			double max = 0.0;
+			double mean = 0.0;
+			double stdDev = 0.0;
+			double p50 = 0.0;
+			double p90 = 0.0;
+			double p99 = 0.0;
+			double p999 = 0.0;
+			// Number of values above the upper Tukey fence (third quartile + 1.5 * interquartile range)
+			uint32_t outliers = 0;
+		};
+
 		bool active = false;
 		bool outputFrameTimes = false;
 		int outputFrames = -1; // -1 means no frames limit
 		uint32_t warmup = 1;
 		uint32_t duration = 10;
+		// Wall clock time for each frame
 		std::vector<double> frameTimes;
+		// CPU time for each frame (wall clock time minus time spent waiting for the GPU)
+		std::vector<double> cpuFrameTimes;
+		// GPU time for each frame measured with timestamp queries (empty if timestamps are not supported)
+		std::vector<double> gpuFrameTimes;
+		// GPU times of the passes marked with the GPU profiler (in order of their first appearance)
+		std::vector<std::pair<std::string, std::vector<double>>> passTimes;
 		std::string filename = "";
+		std::string jsonFilename = "";
+		uint32_t framesInFlight = 1;
+		// Render the UI overlay during the benchmark (disabled by default)
+		bool overlay = false;
+
+		// Information about the benchmarked example for the JSON report
+		std::string exampleName = "";
+		uint32_t width = 0;
+		uint32_t height = 0;
 
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
+		// Calculates statistics for a list of frame times using the nearest rank method for percentiles
+		static Statistics computeStatistics(std::vector<double> values)
+		{
+			Statistics stats;
+			if (values.empty()) {
+				return stats;
+			}
+			std::sort(values.begin(), values.end());
+			const size_t count = values.size();
+			auto percentile = [&values, count](double p) {
+				size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * count));
+				return values[std::min(std::max(rank, (size_t)1), count) - 1];
+			};
+			stats.min = values.front();
+			stats.max = values.back();
+			stats.mean = std::accumulate(values.begin(), values.end(), 0.0) / count;
+			double variance = 0.0;
+			for (double value : values) {
+				variance += (value - stats.mean) * (value - stats.mean);
+			}
+			stats.stdDev = std::sqrt(variance / count);
+			stats.p50 = percentile(50.0);
+			stats.p90 = percentile(90.0);
+			stats.p99 = percentile(99.0);
+			stats.p999 = percentile(99.9);
+			const double q3 = percentile(75.0);
+			const double upperFence = q3 + 1.5 * (q3 - percentile(25.0));
+			stats.outliers = static_cast<uint32_t>(values.end() - std::upper_bound(values.begin(), values.end(), upperFence));
+			return stats;
+		}
+
+		// Creates the timestamp queries used to measure GPU frame times, called by the example base class
+		void prepareGpuTimer(VkDevice device, uint32_t queueFamilyIndex, uint32_t timestampValidBits, float timestampPeriod, uint32_t frameCount)
+		{
+			if (timestampValidBits == 0) {
+				std::cout << "Timestamp queries not supported by the graphics queue, GPU frame times won't be available\n";
+				return;
+			}
+			gpuTimer.device = device;
+			gpuTimer.validBitsMask = (timestampValidBits >= 64) ? ~0ULL : ((1ULL << timestampValidBits) - 1);
+			gpuTimer.timestampPeriod = timestampPeriod;
+			gpuTimer.begun.assign(frameCount, false);
+
+			VkQueryPoolCreateInfo queryPoolCI{};
+			queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolCI.queryCount = frameCount * 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &gpuTimer.queryPool));
+
+			VkCommandPoolCreateInfo commandPoolCI{};
+			commandPoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			commandPoolCI.queueFamilyIndex = queueFamilyIndex;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCI, nullptr, &gpuTimer.commandPool));
+
+			VkSemaphoreCreateInfo semaphoreCI{};
+			semaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			gpuTimer.acquireSemaphores.resize(frameCount);
+			for (auto& semaphore : gpuTimer.acquireSemaphores) {
+				VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCI, nullptr, &semaphore));
+			}
+
+			// The command buffers only write timestamps, so they're recorded once and submitted before and after each frame's work
+			gpuTimer.beginCommandBuffers.resize(frameCount);
+			gpuTimer.endCommandBuffers.resize(frameCount);
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = gpuTimer.commandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = frameCount;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, gpuTimer.beginCommandBuffers.data()));
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, gpuTimer.endCommandBuffers.data()));
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			for (uint32_t i = 0; i < frameCount; i++) {
+				VK_CHECK_RESULT(vkBeginCommandBuffer(gpuTimer.beginCommandBuffers[i], &beginInfo));
+				vkCmdResetQueryPool(gpuTimer.beginCommandBuffers[i], gpuTimer.queryPool, i * 2, 2);
+				// Written after the wait for the acquire semaphore (a top of pipe timestamp may be written before the wait has finished)
+				vkCmdWriteTimestamp(gpuTimer.beginCommandBuffers[i], VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, gpuTimer.queryPool, i * 2);
+				VK_CHECK_RESULT(vkEndCommandBuffer(gpuTimer.beginCommandBuffers[i]));
+				VK_CHECK_RESULT(vkBeginCommandBuffer(gpuTimer.endCommandBuffers[i], &beginInfo));
+				vkCmdWriteTimestamp(gpuTimer.endCommandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gpuTimer.queryPool, i * 2 + 1);
+				VK_CHECK_RESULT(vkEndCommandBuffer(gpuTimer.endCommandBuffers[i]));
+			}
+		}
+
+		void destroyGpuTimer()
+		{
+			if (gpuTimer.queryPool == VK_NULL_HANDLE) {
+				return;
+			}
+			for (auto& semaphore : gpuTimer.acquireSemaphores) {
+				vkDestroySemaphore(gpuTimer.device, semaphore, nullptr);
+			}
+			vkDestroyCommandPool(gpuTimer.device, gpuTimer.commandPool, nullptr);
+			vkDestroyQueryPool(gpuTimer.device, gpuTimer.queryPool, nullptr);
+			gpuTimer.queryPool = VK_NULL_HANDLE;
+		}
+
+		// Returns the semaphore the swap chain image of the frame has to be acquired with
+		// If GPU frame times are measured, the start timestamp submission waits on it and signals the frame's present complete semaphore instead
+		VkSemaphore getAcquireSemaphore(uint32_t frame, VkSemaphore presentComplete)
+		{
+			return (gpuTimer.queryPool != VK_NULL_HANDLE) ? gpuTimer.acquireSemaphores[frame] : presentComplete;
+		}
+
+		// Reads back the timestamps of the frame's previous use and submits the start timestamp (the frame's resources must no longer be in use)
+		// The submission waits until the image acquired with getAcquireSemaphore is available, so the GPU time doesn't include waiting for the presentation engine
+		void beginGpuFrame(VkQueue queue, uint32_t frame, VkSemaphore presentComplete)
+		{
+			if (gpuTimer.queryPool == VK_NULL_HANDLE) {
+				return;
+			}
+			// Frames are resolved in submission order, so lastEnd always refers to the previous frame
+			while (!gpuTimer.pendingFrames.empty()) {
+				uint32_t pendingFrame = gpuTimer.pendingFrames.front();
+				gpuTimer.pendingFrames.pop_front();
+				resolveGpuFrame(pendingFrame, false);
+				if (pendingFrame == frame) {
+					break;
+				}
+			}
+			const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &gpuTimer.acquireSemaphores[frame];
+			submitInfo.pWaitDstStageMask = &waitStageMask;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &gpuTimer.beginCommandBuffers[frame];
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &presentComplete;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			gpuTimer.begun[frame] = true;
+		}
+
+		// Used if acquiring the frame's image failed (e.g. VK_ERROR_OUT_OF_DATE_KHR), which leaves the acquire semaphore unsignaled
+		// The frame isn't timed, but presentComplete still has to be signaled as the example's submission waits on it
+		void skipGpuFrame(VkQueue queue, VkSemaphore presentComplete)
+		{
+			if (gpuTimer.queryPool == VK_NULL_HANDLE) {
+				return;
+			}
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &presentComplete;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		}
+
+		// Submits the end timestamp after all of the frame's work
+		void endGpuFrame(VkQueue queue, uint32_t frame)
+		{
+			if ((gpuTimer.queryPool == VK_NULL_HANDLE) || !gpuTimer.begun[frame]) {
+				return;
+			}
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &gpuTimer.endCommandBuffers[frame];
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			gpuTimer.begun[frame] = false;
+			gpuTimer.pendingFrames.push_back(frame);
+		}
+
+		// Adds the GPU time of a profiled pass, passes are identified by their full marker path
+		void addPassTime(const std::string &path, double milliseconds)
+		{
+			if (!measuring) {
+				return;
+			}
+			auto it = std::find_if(passTimes.begin(), passTimes.end(), [&path](const std::pair<std::string, std::vector<double>> &pass) { return pass.first == path; });
+			if (it == passTimes.end()) {
+				passTimes.push_back({ path, {} });
+				it = passTimes.end() - 1;
+			}
+			it->second.push_back(milliseconds);
+		}
+
+		// Adds time the CPU spent waiting for the GPU in the current frame, which is excluded from the CPU frame time
+		void addWaitTime(double milliseconds)
+		{
+			frameWaitTime += milliseconds;
+		}
+
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
 			this->deviceProps = deviceProps;
@@ -55,20 +346,37 @@ namespace vks
 
 			// Benchmark phase
 			{
+				measuring = true;
 				while (runtime < (duration * 1000.0)) {
+					frameWaitTime = 0.0;
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
+					cpuFrameTimes.push_back(std::max(tDiff - frameWaitTime, 0.0));
 					frameCount++;
 					if (outputFrames != -1 && outputFrames == frameCount) break;
 				};
+				// Read back the timestamps of the frames still in flight
+				while (!gpuTimer.pendingFrames.empty()) {
+					resolveGpuFrame(gpuTimer.pendingFrames.front(), true);
+					gpuTimer.pendingFrames.pop_front();
+				}
+				measuring = false;
 				std::cout << "Benchmark finished" << "\n";
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << "\n";
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
-				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				std::cout << "frames in flight: " << framesInFlight << "\n";
+				std::cout << "overlay: " << (overlay ? "on" : "off") << "\n";
+				std::cout << "fps    : " << getFps() << "\n";
+				printStatistics("frame", frameTimes);
+				printStatistics("cpu  ", cpuFrameTimes);
+				printStatistics("gpu  ", gpuFrameTimes);
+				for (auto &pass : passTimes) {
+					printStatistics("pass \"" + pass.first + "\"", pass.second);
+				}
 			}
 		}
 
@@ -77,8 +385,8 @@ namespace vks
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
 
-				result << "device,driverversion,duration (ms),frames,fps" << "\n";
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
+				result << "device,driverversion,duration (ms),frames,fps,frames in flight" << "\n";
+				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << getFps() << "," << framesInFlight << "\n";
 
 				if (outputFrameTimes) {
 					result << "\n" << "frame,ms" << "\n";
@@ -100,5 +408,53 @@ namespace vks
 #endif
 			}
 		}
+
+		// Writes a machine readable report with frame time statistics (and optionally all frame times)
+		void saveResultsJson() {
+			std::ofstream result(jsonFilename, std::ios::out);
+			if (!result.is_open()) {
+				std::cerr << "Could not write benchmark results to \"" << jsonFilename << "\"\n";
+				return;
+			}
+			result << std::fixed << std::setprecision(4);
+			result << "{\n";
+			result << "\t\"example\": \"" << json::escape(exampleName) << "\",\n";
+			result << "\t\"device\": \"" << json::escape(deviceProps.deviceName) << "\",\n";
+			result << "\t\"vendorid\": " << deviceProps.vendorID << ",\n";
+			result << "\t\"deviceid\": " << deviceProps.deviceID << ",\n";
+			result << "\t\"driverversion\": " << deviceProps.driverVersion << ",\n";
+			result << "\t\"apiversion\": \"" << VK_VERSION_MAJOR(deviceProps.apiVersion) << "." << VK_VERSION_MINOR(deviceProps.apiVersion) << "." << VK_VERSION_PATCH(deviceProps.apiVersion) << "\",\n";
+			result << "\t\"width\": " << width << ",\n";
+			result << "\t\"height\": " << height << ",\n";
+			result << "\t\"framesinflight\": " << framesInFlight << ",\n";
+			result << "\t\"overlay\": " << (overlay ? "true" : "false") << ",\n";
+			result << "\t\"warmup\": " << warmup << ",\n";
+			result << "\t\"runtime\": " << runtime << ",\n";
+			result << "\t\"frames\": " << frameCount << ",\n";
+			result << "\t\"fps\": " << getFps() << ",\n";
+			result << "\t\"statistics\": {\n";
+			writeStatisticsJson(result, "frame", frameTimes, false);
+			writeStatisticsJson(result, "cpu", cpuFrameTimes, gpuFrameTimes.empty());
+			if (!gpuFrameTimes.empty()) {
+				writeStatisticsJson(result, "gpu", gpuFrameTimes, true);
+			}
+			result << "\t}" << ((outputFrameTimes || !passTimes.empty()) ? "," : "") << "\n";
+			if (!passTimes.empty()) {
+				result << "\t\"passes\": {\n";
+				for (size_t i = 0; i < passTimes.size(); i++) {
+					writeStatisticsJson(result, json::escape(passTimes[i].first), passTimes[i].second, i + 1 == passTimes.size());
+				}
+				result << "\t}" << (outputFrameTimes ? "," : "") << "\n";
+			}
+			if (outputFrameTimes) {
+				result << "\t\"frametimes\": {\n";
+				writeValuesJson(result, "frame", frameTimes, false);
+				writeValuesJson(result, "cpu", cpuFrameTimes, false);
+				writeValuesJson(result, "gpu", gpuFrameTimes, true);
+				result << "\t}\n";
+			}
+			result << "}\n";
+			result.flush();
+		}
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,256 @@
+/*
+* Bounding volume hierarchy builder
+*
+* Builds a binned surface area heuristic (SAH) hierarchy over axis aligned bounding boxes on the CPU
+* and flattens it into a node array that can be uploaded to a storage buffer for GPU traversal
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <float.h>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/*
+		Nodes are stored in depth-first order, so the left child of an inner node always directly follows its parent
+		and only the index of the right child needs to be stored. Leaves reference a contiguous range of primitives,
+		the primitives should be reordered to match primitiveIndices before they're uploaded, so no indirection is required during traversal
+
+		Usage:
+			std::vector<vks::BVH::AABB> bounds(primitiveCount);
+			...
+			vks::BVH bvh;
+			bvh.build(bounds);
+			// Upload bvh.nodes and the primitives in the order of bvh.primitiveIndices
+	*/
+	class BVH
+	{
+	public:
+		struct AABB
+		{
+			glm::vec3 min = glm::vec3(FLT_MAX);
+			glm::vec3 max = glm::vec3(-FLT_MAX);
+
+			void grow(const glm::vec3 &point)
+			{
+				min = glm::min(min, point);
+				max = glm::max(max, point);
+			}
+
+			void grow(const AABB &aabb)
+			{
+				min = glm::min(min, aabb.min);
+				max = glm::max(max, aabb.max);
+			}
+
+			float area() const
+			{
+				const glm::vec3 extent = max - min;
+				return (extent.x < 0.0f) ? 0.0f : 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+			}
+		};
+
+		// 32 bytes, matches a std430 (and std140) structure of two vec4s, so two nodes share a 64 byte cache line
+		struct Node
+		{
+			glm::vec3 aabbMin;
+			// Inner nodes: index of the right child, leaves: index of the first primitive
+			uint32_t offset;
+			glm::vec3 aabbMax;
+			// Number of primitives in a leaf, 0 for inner nodes
+			uint32_t primitiveCount;
+		};
+
+		/** @brief Flattened hierarchy, the root is the first node */
+		std::vector<Node> nodes;
+		/** @brief Indices of the input primitives in the order they are referenced by the leaves */
+		std::vector<uint32_t> primitiveIndices;
+
+		/** @brief Nodes with up to this number of primitives are only split if it lowers the SAH cost */
+		uint32_t maxLeafSize = 4;
+		/** @brief Number of bins per axis the split candidates are evaluated at */
+		uint32_t binCount = 16;
+		/** @brief Maximum depth (number of nodes from the root to a leaf), bounds the traversal stack size of the shader */
+		uint32_t maxDepth = 32;
+		/** @brief Cost of traversing an inner node relative to intersecting a primitive */
+		float traversalCost = 1.0f;
+
+		/** @brief Depth of the deepest leaf of the last build */
+		uint32_t depth = 0;
+		/** @brief Number of leaves of the last build */
+		uint32_t leafCount = 0;
+
+		/** @brief Builds the hierarchy for the given primitive bounds, replaces the result of previous builds */
+		void build(const std::vector<AABB> &primitiveBounds)
+		{
+			nodes.clear();
+			primitiveIndices.resize(primitiveBounds.size());
+			bounds = &primitiveBounds;
+			centroids.resize(primitiveBounds.size());
+			for (uint32_t i = 0; i < static_cast<uint32_t>(primitiveBounds.size()); i++) {
+				primitiveIndices[i] = i;
+				centroids[i] = (primitiveBounds[i].min + primitiveBounds[i].max) * 0.5f;
+			}
+			depth = 0;
+			leafCount = 0;
+			if (primitiveBounds.empty()) {
+				return;
+			}
+			// A binary tree with leaves of at least one primitive has less than twice as many nodes as primitives
+			nodes.reserve(primitiveBounds.size() * 2);
+			buildNode(0, static_cast<uint32_t>(primitiveBounds.size()), 1);
+			nodes.shrink_to_fit();
+			bounds = nullptr;
+			centroids.clear();
+			centroids.shrink_to_fit();
+		}
+
+		/** @brief Expected cost of a random ray that hits the root node, in units of primitive intersections */
+		float cost() const
+		{
+			if (nodes.empty()) {
+				return 0.0f;
+			}
+			const float rootArea = nodeBounds(nodes[0]).area();
+			if (rootArea <= 0.0f) {
+				return static_cast<float>(primitiveIndices.size());
+			}
+			float sum = 0.0f;
+			for (auto& node : nodes) {
+				const float probability = nodeBounds(node).area() / rootArea;
+				sum += probability * ((node.primitiveCount > 0) ? static_cast<float>(node.primitiveCount) : traversalCost);
+			}
+			return sum;
+		}
+
+	private:
+		struct Bin
+		{
+			AABB bounds;
+			uint32_t count = 0;
+		};
+
+		const std::vector<AABB> *bounds = nullptr;
+		std::vector<glm::vec3> centroids;
+
+		static AABB nodeBounds(const Node &node)
+		{
+			AABB aabb;
+			aabb.min = node.aabbMin;
+			aabb.max = node.aabbMax;
+			return aabb;
+		}
+
+		uint32_t createLeaf(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t nodeDepth)
+		{
+			nodes[nodeIndex].offset = first;
+			nodes[nodeIndex].primitiveCount = count;
+			depth = std::max(depth, nodeDepth);
+			leafCount++;
+			return nodeIndex;
+		}
+
+		// Builds the subtree for the primitives [first, first + count) and returns the index of its root
+		uint32_t buildNode(uint32_t first, uint32_t count, uint32_t nodeDepth)
+		{
+			const uint32_t nodeIndex = static_cast<uint32_t>(nodes.size());
+			nodes.push_back(Node());
+
+			AABB aabb;
+			AABB centroidBounds;
+			for (uint32_t i = first; i < first + count; i++) {
+				aabb.grow((*bounds)[primitiveIndices[i]]);
+				centroidBounds.grow(centroids[primitiveIndices[i]]);
+			}
+			nodes[nodeIndex].aabbMin = aabb.min;
+			nodes[nodeIndex].aabbMax = aabb.max;
+
+			if ((count == 1) || (nodeDepth >= maxDepth)) {
+				return createLeaf(nodeIndex, first, count, nodeDepth);
+			}
+
+			// Find the split with the lowest SAH cost by sweeping over the bin boundaries of each axis
+			int32_t bestAxis = -1;
+			uint32_t bestSplit = 0;
+			float bestCost = FLT_MAX;
+			const glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+			std::vector<Bin> bins(binCount);
+			std::vector<float> rightCosts(binCount);
+			for (int32_t axis = 0; axis < 3; axis++) {
+				if (extent[axis] <= 0.0f) {
+					continue;
+				}
+				const float scale = static_cast<float>(binCount) / extent[axis];
+				std::fill(bins.begin(), bins.end(), Bin());
+				for (uint32_t i = first; i < first + count; i++) {
+					const uint32_t primitive = primitiveIndices[i];
+					const uint32_t bin = std::min(static_cast<uint32_t>((centroids[primitive][axis] - centroidBounds.min[axis]) * scale), binCount - 1);
+					bins[bin].count++;
+					bins[bin].bounds.grow((*bounds)[primitive]);
+				}
+				// Right side costs for splits after bin i, accumulated from the last bin
+				AABB rightBounds;
+				uint32_t rightCount = 0;
+				for (uint32_t i = binCount - 1; i > 0; i--) {
+					rightBounds.grow(bins[i].bounds);
+					rightCount += bins[i].count;
+					rightCosts[i - 1] = rightBounds.area() * static_cast<float>(rightCount);
+				}
+				AABB leftBounds;
+				uint32_t leftCount = 0;
+				for (uint32_t i = 0; i < binCount - 1; i++) {
+					leftBounds.grow(bins[i].bounds);
+					leftCount += bins[i].count;
+					if ((leftCount == 0) || (leftCount == count)) {
+						continue;
+					}
+					const float splitCost = leftBounds.area() * static_cast<float>(leftCount) + rightCosts[i];
+					if (splitCost < bestCost) {
+						bestCost = splitCost;
+						bestAxis = axis;
+						bestSplit = i;
+					}
+				}
+			}
+
+			uint32_t leftCount = 0;
+			if (bestAxis >= 0) {
+				// Small nodes are only split if the children are expected to be cheaper to intersect than the node's primitives
+				const float area = aabb.area();
+				const float splitCost = (area > 0.0f) ? traversalCost + bestCost / area : traversalCost;
+				if ((count <= maxLeafSize) && (splitCost >= static_cast<float>(count))) {
+					return createLeaf(nodeIndex, first, count, nodeDepth);
+				}
+				const float scale = static_cast<float>(binCount) / extent[bestAxis];
+				const float minCentroid = centroidBounds.min[bestAxis];
+				const uint32_t binLimit = binCount - 1;
+				auto middle = std::partition(primitiveIndices.begin() + first, primitiveIndices.begin() + first + count, [&](uint32_t primitive) {
+					return std::min(static_cast<uint32_t>((centroids[primitive][bestAxis] - minCentroid) * scale), binLimit) <= bestSplit;
+				});
+				leftCount = static_cast<uint32_t>(middle - (primitiveIndices.begin() + first));
+			} else {
+				// All centroids coincide, large nodes are split in the middle to keep the leaves small
+				if (count <= maxLeafSize) {
+					return createLeaf(nodeIndex, first, count, nodeDepth);
+				}
+				leftCount = count / 2;
+			}
+
+			// The left child is built first, so it directly follows this node
+			buildNode(first, leftCount, nodeDepth + 1);
+			const uint32_t rightChild = buildNode(first + leftCount, count - leftCount, nodeDepth + 1);
+			nodes[nodeIndex].offset = rightChild;
+			nodes[nodeIndex].primitiveCount = 0;
+			return nodeIndex;
+		}
+	};
+}
@@ -6,18 +6,70 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <array>
+#include <algorithm>
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 #include <glm/glm.hpp>
 
+// The batch culling kernel is selected at compile time from the instruction sets enabled for the build (e.g. -mavx2 or /arch:AVX2 for the AVX2 kernel)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VKS_FRUSTUM_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VKS_FRUSTUM_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VKS_FRUSTUM_NEON
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace vks
 {
 	class Frustum
 	{
 	public:
 		enum side { LEFT = 0, RIGHT = 1, TOP = 2, BOTTOM = 3, BACK = 4, FRONT = 5 };
+		enum intersection { OUTSIDE = 0, INTERSECTING = 1, INSIDE = 2 };
 		std::array<glm::vec4, 6> planes;
 
+		// Bounding spheres stored as structure of arrays for batch culling
+		struct SphereArrays
+		{
+			const float* x;
+			const float* y;
+			const float* z;
+			const float* radius;
+
+			SphereArrays offset(uint32_t first) const
+			{
+				return { x + first, y + first, z + first, radius + first };
+			}
+		};
+
+		// Axis aligned bounding boxes stored as structure of arrays for batch culling
+		struct AABBArrays
+		{
+			const float* minX;
+			const float* minY;
+			const float* minZ;
+			const float* maxX;
+			const float* maxY;
+			const float* maxZ;
+
+			AABBArrays offset(uint32_t first) const
+			{
+				return { minX + first, minY + first, minZ + first, maxX + first, maxY + first, maxZ + first };
+			}
+		};
+
 		void update(glm::mat4 matrix)
 		{
 			planes[LEFT].x = matrix[0].w + matrix[0].x;
@@ -56,8 +108,8 @@ namespace vks
 				planes[i] /= length;
 			}
 		}
-		
-		bool checkSphere(glm::vec3 pos, float radius)
+
+		bool checkSphere(glm::vec3 pos, float radius) const
 		{
 			for (auto i = 0; i < planes.size(); i++)
 			{
@@ -68,5 +120,285 @@ namespace vks
 			}
 			return true;
 		}
+
+		// An AABB is outside if the corner furthest along a plane's normal is behind that plane
+		bool checkAABB(glm::vec3 min, glm::vec3 max) const
+		{
+			for (auto i = 0; i < planes.size(); i++)
+			{
+				const float x = (planes[i].x >= 0.0f) ? max.x : min.x;
+				const float y = (planes[i].y >= 0.0f) ? max.y : min.y;
+				const float z = (planes[i].z >= 0.0f) ? max.z : min.z;
+				if ((planes[i].x * x) + (planes[i].y * y) + (planes[i].z * z) + planes[i].w < 0.0f)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Tells apart AABBs that are fully inside the frustum from those that intersect one of its planes, e.g. to skip testing the children of a bounding volume hierarchy node
+		intersection checkAABBIntersection(glm::vec3 min, glm::vec3 max) const
+		{
+			intersection result = INSIDE;
+			for (auto i = 0; i < planes.size(); i++)
+			{
+				const glm::vec3 positive((planes[i].x >= 0.0f) ? max.x : min.x, (planes[i].y >= 0.0f) ? max.y : min.y, (planes[i].z >= 0.0f) ? max.z : min.z);
+				const glm::vec3 negative((planes[i].x >= 0.0f) ? min.x : max.x, (planes[i].y >= 0.0f) ? min.y : max.y, (planes[i].z >= 0.0f) ? min.z : max.z);
+				if ((planes[i].x * positive.x) + (planes[i].y * positive.y) + (planes[i].z * positive.z) + planes[i].w < 0.0f)
+				{
+					return OUTSIDE;
+				}
+				if ((planes[i].x * negative.x) + (planes[i].y * negative.y) + (planes[i].z * negative.z) + planes[i].w < 0.0f)
+				{
+					result = INTERSECTING;
+				}
+			}
+			return result;
+		}
+
+		// Name of the batch culling kernel the build uses
+		static const char* kernelName()
+		{
+#if defined(VKS_FRUSTUM_AVX2)
+			return "AVX2";
+#elif defined(VKS_FRUSTUM_SSE2)
+			return "SSE2";
+#elif defined(VKS_FRUSTUM_NEON)
+			return "NEON";
+#else
+			return "scalar";
+#endif
+		}
+
+		/*
+			Batch culling
+			The visibility mask needs (count + 31) / 32 words, bit (i % 32) of word (i / 32) is set if bounds i are visible
+			The compacting versions write the indices of all visible bounds in ascending order and return their number
+			Results match checkSphere and checkAABB
+		*/
+
+		void cullSpheres(const SphereArrays& spheres, uint32_t count, uint32_t* visibilityMask) const
+		{
+			memset(visibilityMask, 0, ((count + 31) / 32) * sizeof(uint32_t));
+			uint32_t i = 0;
+#if defined(VKS_FRUSTUM_AVX2)
+			__m256 px[6], py[6], pz[6], pw[6];
+			loadPlanes(px, py, pz, pw);
+			for (; i + 8 <= count; i += 8)
+			{
+				const __m256 x = _mm256_loadu_ps(spheres.x + i);
+				const __m256 y = _mm256_loadu_ps(spheres.y + i);
+				const __m256 z = _mm256_loadu_ps(spheres.z + i);
+				const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius + i));
+				__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)), _mm256_add_ps(_mm256_mul_ps(pz[p], z), pw[p]));
+					visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, negRadius, _CMP_GT_OQ));
+				}
+				visibilityMask[i >> 5] |= static_cast<uint32_t>(_mm256_movemask_ps(visible)) << (i & 31);
+			}
+#elif defined(VKS_FRUSTUM_SSE2)
+			__m128 px[6], py[6], pz[6], pw[6];
+			loadPlanes(px, py, pz, pw);
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 x = _mm_loadu_ps(spheres.x + i);
+				const __m128 y = _mm_loadu_ps(spheres.y + i);
+				const __m128 z = _mm_loadu_ps(spheres.z + i);
+				const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius + i));
+				__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)), _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+					visible = _mm_and_ps(visible, _mm_cmpgt_ps(distance, negRadius));
+				}
+				visibilityMask[i >> 5] |= static_cast<uint32_t>(_mm_movemask_ps(visible)) << (i & 31);
+			}
+#elif defined(VKS_FRUSTUM_NEON)
+			float32x4_t px[6], py[6], pz[6], pw[6];
+			loadPlanes(px, py, pz, pw);
+			for (; i + 4 <= count; i += 4)
+			{
+				const float32x4_t x = vld1q_f32(spheres.x + i);
+				const float32x4_t y = vld1q_f32(spheres.y + i);
+				const float32x4_t z = vld1q_f32(spheres.z + i);
+				const float32x4_t negRadius = vnegq_f32(vld1q_f32(spheres.radius + i));
+				uint32x4_t visible = vdupq_n_u32(0xFFFFFFFF);
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					const float32x4_t distance = vmlaq_f32(vmlaq_f32(vmlaq_f32(pw[p], px[p], x), py[p], y), pz[p], z);
+					visible = vandq_u32(visible, vcgtq_f32(distance, negRadius));
+				}
+				visibilityMask[i >> 5] |= moveMask(visible) << (i & 31);
+			}
+#endif
+			for (; i < count; i++)
+			{
+				if (checkSphere(glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]))
+				{
+					visibilityMask[i >> 5] |= 1u << (i & 31);
+				}
+			}
+		}
+
+		void cullAABBs(const AABBArrays& boxes, uint32_t count, uint32_t* visibilityMask) const
+		{
+			memset(visibilityMask, 0, ((count + 31) / 32) * sizeof(uint32_t));
+			uint32_t i = 0;
+#if defined(VKS_FRUSTUM_AVX2)
+			__m256 px[6], py[6], pz[6], pw[6];
+			loadPlanes(px, py, pz, pw);
+			for (; i + 8 <= count; i += 8)
+			{
+				const __m256 minX = _mm256_loadu_ps(boxes.minX + i), maxX = _mm256_loadu_ps(boxes.maxX + i);
+				const __m256 minY = _mm256_loadu_ps(boxes.minY + i), maxY = _mm256_loadu_ps(boxes.maxY + i);
+				const __m256 minZ = _mm256_loadu_ps(boxes.minZ + i), maxZ = _mm256_loadu_ps(boxes.maxZ + i);
+				__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					// The plane is the same for all lanes, so the corner is picked per plane instead of per lane
+					const __m256 x = (planes[p].x >= 0.0f) ? maxX : minX;
+					const __m256 y = (planes[p].y >= 0.0f) ? maxY : minY;
+					const __m256 z = (planes[p].z >= 0.0f) ? maxZ : minZ;
+					const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)), _mm256_add_ps(_mm256_mul_ps(pz[p], z), pw[p]));
+					visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+				}
+				visibilityMask[i >> 5] |= static_cast<uint32_t>(_mm256_movemask_ps(visible)) << (i & 31);
+			}
+#elif defined(VKS_FRUSTUM_SSE2)
+			__m128 px[6], py[6], pz[6], pw[6];
+			loadPlanes(px, py, pz, pw);
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 minX = _mm_loadu_ps(boxes.minX + i), maxX = _mm_loadu_ps(boxes.maxX + i);
+				const __m128 minY = _mm_loadu_ps(boxes.minY + i), maxY = _mm_loadu_ps(boxes.maxY + i);
+				const __m128 minZ = _mm_loadu_ps(boxes.minZ + i), maxZ = _mm_loadu_ps(boxes.maxZ + i);
+				__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					const __m128 x = (planes[p].x >= 0.0f) ? maxX : minX;
+					const __m128 y = (planes[p].y >= 0.0f) ? maxY : minY;
+					const __m128 z = (planes[p].z >= 0.0f) ? maxZ : minZ;
+					const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)), _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+					visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+				}
+				visibilityMask[i >> 5] |= static_cast<uint32_t>(_mm_movemask_ps(visible)) << (i & 31);
+			}
+#elif defined(VKS_FRUSTUM_NEON)
+			float32x4_t px[6], py[6], pz[6], pw[6];
+			loadPlanes(px, py, pz, pw);
+			for (; i + 4 <= count; i += 4)
+			{
+				const float32x4_t minX = vld1q_f32(boxes.minX + i), maxX = vld1q_f32(boxes.maxX + i);
+				const float32x4_t minY = vld1q_f32(boxes.minY + i), maxY = vld1q_f32(boxes.maxY + i);
+				const float32x4_t minZ = vld1q_f32(boxes.minZ + i), maxZ = vld1q_f32(boxes.maxZ + i);
+				uint32x4_t visible = vdupq_n_u32(0xFFFFFFFF);
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					const float32x4_t x = (planes[p].x >= 0.0f) ? maxX : minX;
+					const float32x4_t y = (planes[p].y >= 0.0f) ? maxY : minY;
+					const float32x4_t z = (planes[p].z >= 0.0f) ? maxZ : minZ;
+					const float32x4_t distance = vmlaq_f32(vmlaq_f32(vmlaq_f32(pw[p], px[p], x), py[p], y), pz[p], z);
+					visible = vandq_u32(visible, vcgeq_f32(distance, vdupq_n_f32(0.0f)));
+				}
+				visibilityMask[i >> 5] |= moveMask(visible) << (i & 31);
+			}
+#endif
+			for (; i < count; i++)
+			{
+				if (checkAABB(glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]), glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i])))
+				{
+					visibilityMask[i >> 5] |= 1u << (i & 31);
+				}
+			}
+		}
+
+		uint32_t cullSpheresCompact(const SphereArrays& spheres, uint32_t count, uint32_t* visibleIndices) const
+		{
+			uint32_t visibleCount = 0;
+			for (uint32_t first = 0; first < count; first += 32)
+			{
+				uint32_t visibilityMask;
+				cullSpheres(spheres.offset(first), std::min(count - first, 32u), &visibilityMask);
+				visibleCount += extractIndices(visibilityMask, first, visibleIndices + visibleCount);
+			}
+			return visibleCount;
+		}
+
+		uint32_t cullAABBsCompact(const AABBArrays& boxes, uint32_t count, uint32_t* visibleIndices) const
+		{
+			uint32_t visibleCount = 0;
+			for (uint32_t first = 0; first < count; first += 32)
+			{
+				uint32_t visibilityMask;
+				cullAABBs(boxes.offset(first), std::min(count - first, 32u), &visibilityMask);
+				visibleCount += extractIndices(visibilityMask, first, visibleIndices + visibleCount);
+			}
+			return visibleCount;
+		}
+
+	private:
+#if defined(VKS_FRUSTUM_AVX2)
+		void loadPlanes(__m256* px, __m256* py, __m256* pz, __m256* pw) const
+		{
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				px[p] = _mm256_set1_ps(planes[p].x);
+				py[p] = _mm256_set1_ps(planes[p].y);
+				pz[p] = _mm256_set1_ps(planes[p].z);
+				pw[p] = _mm256_set1_ps(planes[p].w);
+			}
+		}
+#elif defined(VKS_FRUSTUM_SSE2)
+		void loadPlanes(__m128* px, __m128* py, __m128* pz, __m128* pw) const
+		{
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				px[p] = _mm_set1_ps(planes[p].x);
+				py[p] = _mm_set1_ps(planes[p].y);
+				pz[p] = _mm_set1_ps(planes[p].z);
+				pw[p] = _mm_set1_ps(planes[p].w);
+			}
+		}
+#elif defined(VKS_FRUSTUM_NEON)
+		void loadPlanes(float32x4_t* px, float32x4_t* py, float32x4_t* pz, float32x4_t* pw) const
+		{
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				px[p] = vdupq_n_f32(planes[p].x);
+				py[p] = vdupq_n_f32(planes[p].y);
+				pz[p] = vdupq_n_f32(planes[p].z);
+				pw[p] = vdupq_n_f32(planes[p].w);
+			}
+		}
+
+		// Equivalent of _mm_movemask_ps, one bit per lane
+		static uint32_t moveMask(uint32x4_t value)
+		{
+			const uint32_t laneBits[4] = { 1, 2, 4, 8 };
+			const uint32x4_t bits = vandq_u32(value, vld1q_u32(laneBits));
+			const uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+			return vget_lane_u32(vpadd_u32(sum, sum), 0);
+		}
+#endif
+
+		static uint32_t extractIndices(uint32_t visibilityMask, uint32_t first, uint32_t* indices)
+		{
+			uint32_t count = 0;
+			while (visibilityMask != 0)
+			{
+#if defined(_MSC_VER)
+				unsigned long bit;
+				_BitScanForward(&bit, visibilityMask);
+#else
+				const uint32_t bit = __builtin_ctz(visibilityMask);
+#endif
+				indices[count++] = first + static_cast<uint32_t>(bit);
+				visibilityMask &= visibilityMask - 1;
+			}
+			return count;
+		}
 	};
 }
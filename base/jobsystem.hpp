@@ -0,0 +1,370 @@
+/*
+* Work stealing job system with per-worker lock-free job deques
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "tracer.hpp"
+
+namespace vks
+{
+	class JobSystem;
+
+	// Counts the unfinished jobs of a group, so callers can wait for all of them (see JobSystem::wait)
+	class TaskGroup
+	{
+	private:
+		friend class JobSystem;
+		std::atomic<uint32_t> pending{ 0 };
+	public:
+		bool done() const
+		{
+			return pending.load(std::memory_order_acquire) == 0;
+		}
+	};
+
+	// Type erased job that stores its callable inline, so scheduling a job never allocates
+	class Job
+	{
+	public:
+		static const size_t storageSize = 64;
+	private:
+		friend class JobSystem;
+		typename std::aligned_storage<storageSize, alignof(std::max_align_t)>::type storage;
+		void (*invokeFunc)(void*) = nullptr;
+		void (*destroyFunc)(void*) = nullptr;
+		TaskGroup* group = nullptr;
+		// Set while the job is queued or running, the job's slot can't be reused before it's cleared
+		std::atomic<bool> busy{ false };
+
+		template<typename F>
+		void set(F&& function, TaskGroup* taskGroup)
+		{
+			typedef typename std::decay<F>::type Func;
+			static_assert(sizeof(Func) <= storageSize, "Job callable exceeds the inline storage, capture less data or capture by reference");
+			static_assert(alignof(Func) <= alignof(std::max_align_t), "Job callable is over-aligned");
+			new (&storage) Func(std::forward<F>(function));
+			invokeFunc = [](void* callable) { (*static_cast<Func*>(callable))(); };
+			destroyFunc = [](void* callable) { static_cast<Func*>(callable)->~Func(); };
+			group = taskGroup;
+		}
+
+		void execute()
+		{
+			invokeFunc(&storage);
+			destroyFunc(&storage);
+		}
+	};
+
+	// Fixed size Chase-Lev deque
+	// The owning thread pushes and pops jobs at the bottom (LIFO), other threads steal from the top (FIFO)
+	class JobDeque
+	{
+	public:
+		static const int64_t capacity = 4096;
+	private:
+		std::atomic<int64_t> top{ 0 };
+		// Keep top and bottom on separate cache lines, as they're written by different threads
+		char padding[64];
+		std::atomic<int64_t> bottom{ 0 };
+		std::atomic<Job*> jobs[capacity];
+	public:
+		JobDeque()
+		{
+			for (auto& job : jobs) {
+				job.store(nullptr, std::memory_order_relaxed);
+			}
+		}
+
+		// Only called by the owning thread, returns false if the deque is full
+		bool push(Job* job)
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed);
+			const int64_t t = top.load(std::memory_order_acquire);
+			if (b - t >= capacity) {
+				return false;
+			}
+			jobs[b & (capacity - 1)].store(job, std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Only called by the owning thread
+		Job* pop()
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			if (t > b) {
+				// Empty
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			Job* job = jobs[b & (capacity - 1)].load(std::memory_order_relaxed);
+			if (t == b) {
+				// Last job, race against concurrent steals
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					job = nullptr;
+				}
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		// Called by any other thread, returns nullptr if the deque is empty or another thread won the race for the job
+		Job* steal()
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t b = bottom.load(std::memory_order_acquire);
+			if (t >= b) {
+				return nullptr;
+			}
+			Job* job = jobs[t & (capacity - 1)].load(std::memory_order_acquire);
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				return nullptr;
+			}
+			return job;
+		}
+	};
+
+	/*
+		Job system with one worker per thread, each owning a lock-free deque and a ring of job slots
+		Jobs are pushed to the deque of the calling thread and idle workers steal from the others, so work is balanced dynamically
+		The thread that created the job system (e.g. the main thread) gets its own deque and executes jobs while waiting
+		Only worker threads and that one external thread may schedule jobs
+	*/
+	class JobSystem
+	{
+	private:
+		struct Worker {
+			JobDeque deque;
+			Job jobPool[JobDeque::capacity];
+			uint32_t nextJob = 0;
+			uint32_t seed = 0;
+			std::thread thread;
+		};
+		// Worker threads followed by the slot for the external thread
+		std::vector<std::unique_ptr<Worker>> workers;
+		uint32_t threadCount = 0;
+
+		std::atomic<bool> destroying{ false };
+		std::atomic<int64_t> queuedJobs{ 0 };
+		std::atomic<uint32_t> sleepingWorkers{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+
+		struct ThreadContext {
+			const JobSystem* jobSystem;
+			uint32_t index;
+		};
+
+		static ThreadContext& threadContext()
+		{
+			static thread_local ThreadContext context = { nullptr, 0 };
+			return context;
+		}
+
+		Job* allocateJob(uint32_t index)
+		{
+			Worker& worker = *workers[index];
+			Job* job = &worker.jobPool[worker.nextJob++ & (JobDeque::capacity - 1)];
+			// The ring has wrapped around onto a job that is still in flight, help out until it's done
+			while (job->busy.load(std::memory_order_acquire)) {
+				if (!runPendingJob(index)) {
+					std::this_thread::yield();
+				}
+			}
+			job->busy.store(true, std::memory_order_relaxed);
+			return job;
+		}
+
+		Job* findJob(uint32_t index)
+		{
+			Worker& worker = *workers[index];
+			Job* job = worker.deque.pop();
+			if (!job) {
+				// Start stealing at a random victim, so idle workers don't all compete for the same deque
+				const uint32_t count = static_cast<uint32_t>(workers.size());
+				worker.seed = worker.seed * 1664525u + 1013904223u;
+				const uint32_t start = (worker.seed >> 16) % count;
+				for (uint32_t i = 0; (i < count) && !job; i++) {
+					const uint32_t victim = (start + i) % count;
+					if (victim != index) {
+						job = workers[victim]->deque.steal();
+					}
+				}
+			}
+			if (job) {
+				queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		void execute(Job* job)
+		{
+			TaskGroup* group = job->group;
+			{
+				VKS_TRACE_ZONE("vks::JobSystem job");
+				job->execute();
+			}
+			job->busy.store(false, std::memory_order_release);
+			group->pending.fetch_sub(1, std::memory_order_acq_rel);
+		}
+
+		bool runPendingJob(uint32_t index)
+		{
+			Job* job = findJob(index);
+			if (job) {
+				execute(job);
+			}
+			return job != nullptr;
+		}
+
+		void workerLoop(uint32_t index)
+		{
+			threadContext() = { this, index };
+			VKS_TRACE_THREAD_NAME("JobSystem worker " + std::to_string(index));
+			uint32_t idleRounds = 0;
+			while (!destroying.load(std::memory_order_acquire)) {
+				if (runPendingJob(index)) {
+					idleRounds = 0;
+					continue;
+				}
+				if (++idleRounds < 64) {
+					std::this_thread::yield();
+					continue;
+				}
+				// Nothing left to steal, sleep until new jobs are pushed
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+				sleepCondition.wait(lock, [this] { return (queuedJobs.load(std::memory_order_seq_cst) > 0) || destroying.load(); });
+				sleepingWorkers.fetch_sub(1, std::memory_order_seq_cst);
+				idleRounds = 0;
+			}
+		}
+
+		void shutdown()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				destroying = true;
+				sleepCondition.notify_all();
+			}
+			for (auto& worker : workers) {
+				if (worker->thread.joinable()) {
+					worker->thread.join();
+				}
+			}
+			workers.clear();
+			destroying = false;
+		}
+
+		template<typename F>
+		void splitRange(TaskGroup& group, uint32_t begin, uint32_t end, uint32_t grainSize, const F* function)
+		{
+			// Push the upper half of the range, where idle workers can steal it, and keep splitting the lower half
+			while (end - begin > grainSize) {
+				const uint32_t mid = begin + (end - begin) / 2;
+				run(group, [this, &group, mid, end, grainSize, function] { splitRange(group, mid, end, grainSize, function); });
+				end = mid;
+			}
+			for (uint32_t i = begin; i < end; i++) {
+				(*function)(i);
+			}
+		}
+
+	public:
+		~JobSystem()
+		{
+			shutdown();
+		}
+
+		// Sets the number of worker threads (in addition to the calling thread, which also executes jobs while waiting)
+		void setThreadCount(uint32_t count)
+		{
+			shutdown();
+			threadCount = count;
+			for (uint32_t i = 0; i <= count; i++) {
+				workers.push_back(std::unique_ptr<Worker>(new Worker()));
+				workers.back()->seed = i + 1;
+			}
+			for (uint32_t i = 0; i < count; i++) {
+				workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+			}
+		}
+
+		uint32_t getThreadCount() const
+		{
+			return threadCount;
+		}
+
+		// Index of the calling thread, in the range of [0, threadCount] (threadCount being the external thread)
+		// Can be used to index per-thread data like command pools
+		uint32_t currentThreadIndex() const
+		{
+			const ThreadContext& context = threadContext();
+			return (context.jobSystem == this) ? context.index : threadCount;
+		}
+
+		// Schedules a job as part of the given group
+		template<typename F>
+		void run(TaskGroup& group, F&& function)
+		{
+			const uint32_t index = currentThreadIndex();
+			Job* job = allocateJob(index);
+			group.pending.fetch_add(1, std::memory_order_relaxed);
+			job->set(std::forward<F>(function), &group);
+			if (!workers[index]->deque.push(job)) {
+				// Deque is full, run the job right away
+				execute(job);
+				return;
+			}
+			queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+			if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				sleepCondition.notify_one();
+			}
+		}
+
+		// Waits until all jobs of the group have finished, executing pending jobs in the meantime
+		void wait(TaskGroup& group)
+		{
+			const uint32_t index = currentThreadIndex();
+			while (!group.done()) {
+				if (!runPendingJob(index)) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		// Calls function(i) for all i in [0, count) and waits for completion
+		// The range is split into halves down to grainSize indices, so idle threads can steal large parts of it
+		template<typename F>
+		void parallelFor(uint32_t count, uint32_t grainSize, const F& function)
+		{
+			TaskGroup group;
+			splitRange(group, 0, count, std::max(grainSize, 1u), &function);
+			wait(group);
+		}
+	};
+}
@@ -0,0 +1,59 @@
+/*
+* Helpers for writing JSON reports
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <cstdio>
+
+namespace vks
+{
+	namespace json
+	{
+		// Escapes a value for use inside a JSON string literal (quotes, backslashes and all control characters)
+		inline std::string escape(const std::string &value)
+		{
+			std::string escaped;
+			escaped.reserve(value.size());
+			for (char c : value) {
+				switch (c) {
+				case '"':
+					escaped += "\\\"";
+					break;
+				case '\\':
+					escaped += "\\\\";
+					break;
+				case '\b':
+					escaped += "\\b";
+					break;
+				case '\f':
+					escaped += "\\f";
+					break;
+				case '\n':
+					escaped += "\\n";
+					break;
+				case '\r':
+					escaped += "\\r";
+					break;
+				case '\t':
+					escaped += "\\t";
+					break;
+				default:
+					if (static_cast<unsigned char>(c) < 0x20) {
+						char code[7];
+						snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+						escaped += code;
+					} else {
+						escaped += c;
+					}
+				}
+			}
+			return escaped;
+		}
+	}
+}
@@ -0,0 +1,128 @@
+/*
+* Read only memory mapped file
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace vks
+{
+	// Maps a whole file into memory, the mapping is released when the object is destroyed
+	class MappedFile
+	{
+	private:
+#if defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		int file = -1;
+#endif
+		const uint8_t* mappedData = nullptr;
+		size_t mappedSize = 0;
+
+	public:
+		MappedFile() {}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+			close();
+		}
+
+		// Returns false if the file doesn't exist, is empty or can't be mapped
+		bool open(const std::string& fileName)
+		{
+			close();
+#if defined(_WIN32)
+			file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart == 0)) {
+				close();
+				return false;
+			}
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!mapping) {
+				close();
+				return false;
+			}
+			mappedData = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+			file = ::open(fileName.c_str(), O_RDONLY);
+			if (file < 0) {
+				return false;
+			}
+			struct stat fileStat;
+			if ((fstat(file, &fileStat) != 0) || (fileStat.st_size == 0)) {
+				close();
+				return false;
+			}
+			void* data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			mappedData = (data == MAP_FAILED) ? nullptr : static_cast<const uint8_t*>(data);
+			mappedSize = static_cast<size_t>(fileStat.st_size);
+#endif
+			if (!mappedData) {
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		void close()
+		{
+#if defined(_WIN32)
+			if (mappedData) {
+				UnmapViewOfFile(mappedData);
+			}
+			if (mapping) {
+				CloseHandle(mapping);
+				mapping = nullptr;
+			}
+			if (file != INVALID_HANDLE_VALUE) {
+				CloseHandle(file);
+				file = INVALID_HANDLE_VALUE;
+			}
+#else
+			if (mappedData) {
+				munmap(const_cast<uint8_t*>(mappedData), mappedSize);
+			}
+			if (file >= 0) {
+				::close(file);
+				file = -1;
+			}
+#endif
+			mappedData = nullptr;
+			mappedSize = 0;
+		}
+
+		const uint8_t* data() const
+		{
+			return mappedData;
+		}
+
+		size_t size() const
+		{
+			return mappedSize;
+		}
+	};
+}
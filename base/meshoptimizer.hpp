@@ -0,0 +1,397 @@
+/*
+* Mesh optimization
+*
+* Reorders the indices and vertices of indexed triangle lists for the post-transform vertex cache, for less overdraw
+* and for linear vertex fetches, and analyzes the vertex cache efficiency of the result
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/*
+		All functions work on a single triangle list with indices into its own vertex array (starting at zero)
+		The steps are meant to be applied in this order, as each one builds on the ordering of the previous one:
+
+		Usage:
+			vks::MeshOptimizer::deduplicateVertices(vertices, indices);
+			vks::MeshOptimizer::optimizeVertexCache(indices, vertices.size());
+			vks::MeshOptimizer::optimizeOverdraw(indices, &vertices[0].pos, sizeof(Vertex), vertices.size());
+			vks::MeshOptimizer::optimizeVertexFetch(vertices, indices);
+	*/
+	class MeshOptimizer
+	{
+	public:
+		/** @brief Size of the FIFO cache the statistics and the overdraw clustering are based on, close to what current GPUs effectively reuse */
+		static const uint32_t fifoCacheSize = 16;
+		/** @brief Size of the LRU cache modelled by the vertex cache optimization */
+		static const uint32_t lruCacheSize = 32;
+
+		struct VertexCacheStatistics
+		{
+			uint32_t triangleCount = 0;
+			uint32_t vertexCount = 0;
+			// Number of vertex shader invocations
+			uint32_t cacheMisses = 0;
+
+			/** @brief Average cache miss ratio, vertex shader invocations per triangle (0.5 at best for large regular meshes, 3.0 at worst) */
+			float acmr() const
+			{
+				return (triangleCount > 0) ? static_cast<float>(cacheMisses) / static_cast<float>(triangleCount) : 0.0f;
+			}
+
+			/** @brief Average transformed vertex ratio, vertex shader invocations per vertex (1.0 at best) */
+			float atvr() const
+			{
+				return (vertexCount > 0) ? static_cast<float>(cacheMisses) / static_cast<float>(vertexCount) : 0.0f;
+			}
+		};
+
+		/** @brief Simulates a FIFO post-transform vertex cache for the given triangle list */
+		static VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = fifoCacheSize)
+		{
+			VertexCacheStatistics statistics;
+			statistics.triangleCount = static_cast<uint32_t>(indices.size() / 3);
+			statistics.vertexCount = static_cast<uint32_t>(vertexCount);
+			// A vertex is in the cache if less than cacheSize misses happened since it was last loaded
+			std::vector<uint32_t> loadedAt(vertexCount, 0);
+			uint32_t time = cacheSize + 1;
+			for (uint32_t index : indices) {
+				if (time - loadedAt[index] > cacheSize) {
+					loadedAt[index] = time++;
+					statistics.cacheMisses++;
+				}
+			}
+			return statistics;
+		}
+
+		/** @brief Merges vertices with identical contents, unreferenced vertices are removed, returns the new vertex count */
+		template<typename T>
+		static uint32_t deduplicateVertices(std::vector<T> &vertices, std::vector<uint32_t> &indices)
+		{
+			// Vertices are compared bytewise, so the vertex structure must not contain padding
+			static_assert(std::is_trivially_copyable<T>::value, "Vertices are compared bytewise");
+			struct VertexHash
+			{
+				size_t operator()(const T *vertex) const
+				{
+					// 64 bit FNV-1a
+					const uint8_t *bytes = reinterpret_cast<const uint8_t *>(vertex);
+					uint64_t hash = 14695981039346656037ull;
+					for (size_t i = 0; i < sizeof(T); i++) {
+						hash = (hash ^ bytes[i]) * 1099511628211ull;
+					}
+					return static_cast<size_t>(hash);
+				}
+			};
+			struct VertexEqual
+			{
+				bool operator()(const T *a, const T *b) const
+				{
+					return memcmp(a, b, sizeof(T)) == 0;
+				}
+			};
+			std::unordered_map<const T *, uint32_t, VertexHash, VertexEqual> uniqueVertices;
+			uniqueVertices.reserve(vertices.size());
+			std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+			std::vector<T> result;
+			result.reserve(vertices.size());
+			for (auto &index : indices) {
+				if (remap[index] == UINT32_MAX) {
+					auto it = uniqueVertices.find(&vertices[index]);
+					if (it != uniqueVertices.end()) {
+						remap[index] = it->second;
+					} else {
+						remap[index] = static_cast<uint32_t>(result.size());
+						uniqueVertices[&vertices[index]] = remap[index];
+						result.push_back(vertices[index]);
+					}
+				}
+				index = remap[index];
+			}
+			vertices.swap(result);
+			return static_cast<uint32_t>(vertices.size());
+		}
+
+		/*
+			Reorders the triangles for the post-transform vertex cache, based on Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+			Triangles are emitted greedily by a score that prefers vertices recently used (still in a modelled LRU cache)
+			and vertices with few remaining triangles, so vertices are finished off instead of leaving isolated triangles behind
+		*/
+		static void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount)
+		{
+			const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+			if (triangleCount == 0) {
+				return;
+			}
+
+			// Triangles using each vertex, the unemitted ones are kept at the front of each vertex's range
+			std::vector<uint32_t> remaining(vertexCount, 0);
+			for (uint32_t index : indices) {
+				remaining[index]++;
+			}
+			std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+			for (size_t i = 0; i < vertexCount; i++) {
+				firstTriangle[i + 1] = firstTriangle[i] + remaining[i];
+			}
+			std::vector<uint32_t> vertexTriangles(indices.size());
+			{
+				std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+				for (uint32_t i = 0; i < static_cast<uint32_t>(indices.size()); i++) {
+					vertexTriangles[fill[indices[i]]++] = i / 3;
+				}
+			}
+
+			std::vector<int32_t> cachePosition(vertexCount, -1);
+			std::vector<float> vertexScores(vertexCount);
+			for (size_t i = 0; i < vertexCount; i++) {
+				vertexScores[i] = vertexScore(-1, remaining[i]);
+			}
+			std::vector<float> triangleScores(triangleCount);
+			for (uint32_t i = 0; i < triangleCount; i++) {
+				triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+			}
+			std::vector<bool> emitted(triangleCount, false);
+
+			std::vector<uint32_t> result;
+			result.reserve(indices.size());
+			// Three more slots than the modelled cache, for the vertices of the emitted triangle pushing out older ones
+			std::vector<uint32_t> cache, newCache;
+			cache.reserve(lruCacheSize + 3);
+			newCache.reserve(lruCacheSize + 3);
+			uint32_t nextCandidate = 0;
+			int64_t bestTriangle = -1;
+
+			while (result.size() < indices.size()) {
+				// If no triangle touches the cache anymore, continue with the next unemitted triangle in input order
+				if (bestTriangle < 0) {
+					while (emitted[nextCandidate]) {
+						nextCandidate++;
+					}
+					bestTriangle = nextCandidate;
+				}
+				const uint32_t triangle = static_cast<uint32_t>(bestTriangle);
+				emitted[triangle] = true;
+				newCache.clear();
+				for (uint32_t i = 0; i < 3; i++) {
+					const uint32_t vertex = indices[triangle * 3 + i];
+					result.push_back(vertex);
+					newCache.push_back(vertex);
+					// Remove the triangle from the vertex's unemitted triangles
+					uint32_t *triangles = &vertexTriangles[firstTriangle[vertex]];
+					for (uint32_t j = 0; j < remaining[vertex]; j++) {
+						if (triangles[j] == triangle) {
+							std::swap(triangles[j], triangles[remaining[vertex] - 1]);
+							break;
+						}
+					}
+					remaining[vertex]--;
+				}
+				for (uint32_t vertex : cache) {
+					if ((vertex != newCache[0]) && (vertex != newCache[1]) && (vertex != newCache[2])) {
+						newCache.push_back(vertex);
+					}
+				}
+				// Update the scores of all vertices that were or are in the cache and pick the best triangle using any of them
+				float bestScore = -1.0f;
+				bestTriangle = -1;
+				for (uint32_t i = 0; i < static_cast<uint32_t>(newCache.size()); i++) {
+					const uint32_t vertex = newCache[i];
+					cachePosition[vertex] = (i < lruCacheSize) ? static_cast<int32_t>(i) : -1;
+					const float score = vertexScore(cachePosition[vertex], remaining[vertex]);
+					const float delta = score - vertexScores[vertex];
+					vertexScores[vertex] = score;
+					for (uint32_t j = 0; j < remaining[vertex]; j++) {
+						const uint32_t adjacent = vertexTriangles[firstTriangle[vertex] + j];
+						triangleScores[adjacent] += delta;
+					}
+				}
+				for (uint32_t i = 0; i < static_cast<uint32_t>(std::min(newCache.size(), static_cast<size_t>(lruCacheSize))); i++) {
+					const uint32_t vertex = newCache[i];
+					for (uint32_t j = 0; j < remaining[vertex]; j++) {
+						const uint32_t adjacent = vertexTriangles[firstTriangle[vertex] + j];
+						if (triangleScores[adjacent] > bestScore) {
+							bestScore = triangleScores[adjacent];
+							bestTriangle = adjacent;
+						}
+					}
+				}
+				if (newCache.size() > lruCacheSize) {
+					newCache.resize(lruCacheSize);
+				}
+				cache.swap(newCache);
+			}
+			indices.swap(result);
+		}
+
+		/*
+			Reorders clusters of triangles so that triangles likely to occlude others are drawn first, based on the view independent
+			sorting of Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+			The triangle order within clusters is kept, so the indices should already be optimized for the vertex cache
+			Clusters start where the FIFO cache has to reload all vertices of a triangle anyway and are split further
+			as long as their cache miss ratio stays below threshold times that of the original order
+		*/
+		static void optimizeOverdraw(std::vector<uint32_t> &indices, const glm::vec3 *positions, size_t positionStride, size_t vertexCount, float threshold = 1.05f)
+		{
+			const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+			if (triangleCount < 2) {
+				return;
+			}
+			auto position = [&](uint32_t vertex) -> const glm::vec3 & {
+				return *reinterpret_cast<const glm::vec3 *>(reinterpret_cast<const uint8_t *>(positions) + vertex * positionStride);
+			};
+
+			// Hard boundaries: triangles whose vertices all miss the cache
+			std::vector<uint32_t> loadedAt(vertexCount, 0);
+			uint32_t time = fifoCacheSize + 1;
+			auto cacheMisses = [&](uint32_t triangle) {
+				uint32_t misses = 0;
+				for (uint32_t i = 0; i < 3; i++) {
+					const uint32_t vertex = indices[triangle * 3 + i];
+					if (time - loadedAt[vertex] > fifoCacheSize) {
+						loadedAt[vertex] = time++;
+						misses++;
+					}
+				}
+				return misses;
+			};
+			std::vector<uint32_t> hardBoundaries;
+			std::vector<uint32_t> triangleMisses(triangleCount);
+			for (uint32_t i = 0; i < triangleCount; i++) {
+				triangleMisses[i] = cacheMisses(i);
+				if ((i == 0) || (triangleMisses[i] == 3)) {
+					hardBoundaries.push_back(i);
+				}
+			}
+			hardBoundaries.push_back(triangleCount);
+
+			// Soft boundaries: start a new cluster (with a flushed cache) once the current one is efficient enough
+			std::vector<uint32_t> clusters;
+			for (size_t c = 0; c + 1 < hardBoundaries.size(); c++) {
+				const uint32_t start = hardBoundaries[c];
+				const uint32_t end = hardBoundaries[c + 1];
+				uint32_t misses = 0;
+				for (uint32_t i = start; i < end; i++) {
+					misses += triangleMisses[i];
+				}
+				const float maxRatio = threshold * static_cast<float>(misses) / static_cast<float>(end - start);
+				clusters.push_back(start);
+				time += fifoCacheSize + 1;
+				uint32_t clusterMisses = 0;
+				uint32_t clusterTriangles = 0;
+				for (uint32_t i = start; i < end; i++) {
+					clusterMisses += cacheMisses(i);
+					clusterTriangles++;
+					if ((i + 1 < end) && (static_cast<float>(clusterMisses) <= maxRatio * static_cast<float>(clusterTriangles))) {
+						clusters.push_back(i + 1);
+						time += fifoCacheSize + 1;
+						clusterMisses = 0;
+						clusterTriangles = 0;
+					}
+				}
+				// Remaining triangles that didn't reach the ratio are merged into the previous cluster of the same hard cluster
+				if ((clusterTriangles > 0) && (clusters.back() != start)) {
+					clusters.pop_back();
+				}
+			}
+			clusters.push_back(triangleCount);
+
+			// Clusters facing away from the center of the mesh are on its outside and are drawn first
+			glm::vec3 meshCenter(0.0f);
+			float meshArea = 0.0f;
+			const uint32_t clusterCount = static_cast<uint32_t>(clusters.size() - 1);
+			std::vector<glm::vec3> clusterCenters(clusterCount, glm::vec3(0.0f));
+			std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+			std::vector<float> clusterAreas(clusterCount, 0.0f);
+			for (uint32_t c = 0; c < clusterCount; c++) {
+				for (uint32_t i = clusters[c]; i < clusters[c + 1]; i++) {
+					const glm::vec3 &p0 = position(indices[i * 3]);
+					const glm::vec3 &p1 = position(indices[i * 3 + 1]);
+					const glm::vec3 &p2 = position(indices[i * 3 + 2]);
+					// The length of the cross product is twice the triangle's area, so normals and centers are area weighted
+					const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+					const float area = glm::length(normal);
+					const glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+					clusterNormals[c] += normal;
+					clusterCenters[c] += center * area;
+					clusterAreas[c] += area;
+					meshCenter += center * area;
+					meshArea += area;
+				}
+			}
+			if (meshArea > 0.0f) {
+				meshCenter /= meshArea;
+			}
+			std::vector<float> sortKeys(clusterCount, 0.0f);
+			for (uint32_t c = 0; c < clusterCount; c++) {
+				const float normalLength = glm::length(clusterNormals[c]);
+				if ((clusterAreas[c] > 0.0f) && (normalLength > 0.0f)) {
+					sortKeys[c] = glm::dot(clusterCenters[c] / clusterAreas[c] - meshCenter, clusterNormals[c] / normalLength);
+				}
+			}
+			std::vector<uint32_t> order(clusterCount);
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+			std::vector<uint32_t> result;
+			result.reserve(indices.size());
+			for (uint32_t c : order) {
+				result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+			}
+			indices.swap(result);
+		}
+
+		/** @brief Reorders the vertices in the order they are first referenced by the indices, so vertex fetches are as linear as possible, unreferenced vertices are removed */
+		template<typename T>
+		static void optimizeVertexFetch(std::vector<T> &vertices, std::vector<uint32_t> &indices)
+		{
+			std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+			std::vector<T> result;
+			result.reserve(vertices.size());
+			for (auto &index : indices) {
+				if (remap[index] == UINT32_MAX) {
+					remap[index] = static_cast<uint32_t>(result.size());
+					result.push_back(vertices[index]);
+				}
+				index = remap[index];
+			}
+			vertices.swap(result);
+		}
+
+	private:
+		static float vertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+		{
+			// Vertices without remaining triangles are never used again
+			if (remainingTriangles == 0) {
+				return -1.0f;
+			}
+			float score = 0.0f;
+			if (cachePosition >= 0) {
+				// The vertices of the last triangle get a fixed score, so the next triangle doesn't depend on their order
+				if (cachePosition < 3) {
+					score = 0.75f;
+				} else {
+					const float scale = 1.0f / static_cast<float>(lruCacheSize - 3);
+					score = powf(1.0f - static_cast<float>(cachePosition - 3) * scale, 1.5f);
+				}
+			}
+			// Boost vertices with few remaining triangles
+			score += 2.0f / sqrtf(static_cast<float>(remainingTriangles));
+			return score;
+		}
+	};
+}
@@ -0,0 +1,193 @@
+/*
+* Scoped CPU zone tracer with Chrome trace export
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <cstdint>
+
+#include "json.hpp"
+
+/*
+	Usage:
+		VKS_TRACE_ZONE("updateUniformBuffers");		(records the time until the end of the enclosing scope)
+		VKS_TRACE_THREAD_NAME("Worker 0");			(optional, shown as the thread's name in the trace)
+
+	Zone names must be string literals (or otherwise outlive the tracer), only the pointer is stored
+	Zones are only recorded while tracing is enabled at runtime (vks::trace::setEnabled), otherwise a zone costs a single branch
+	Define VKS_DISABLE_TRACING (CMake option DISABLE_TRACING) to compile all zones out
+*/
+#if defined(VKS_DISABLE_TRACING)
+#define VKS_TRACE_ZONE(name)
+#define VKS_TRACE_THREAD_NAME(name)
+#else
+#define VKS_TRACE_CONCAT_INNER(a, b) a##b
+#define VKS_TRACE_CONCAT(a, b) VKS_TRACE_CONCAT_INNER(a, b)
+#define VKS_TRACE_ZONE(name) vks::trace::Zone VKS_TRACE_CONCAT(traceZone, __LINE__)(name)
+#define VKS_TRACE_THREAD_NAME(name) vks::trace::setThreadName(name)
+#endif
+
+namespace vks
+{
+	namespace trace
+	{
+		struct Event
+		{
+			const char* name;
+			// Nanoseconds since the tracer was first used
+			uint64_t start;
+			uint64_t end;
+		};
+
+		// Ring of the most recent events of a single thread
+		// Only the owning thread writes to it, so recording a zone never takes a lock
+		class ThreadBuffer
+		{
+		public:
+			static const uint64_t capacity = 65536;
+			std::unique_ptr<Event[]> events{ new Event[capacity] };
+			// Total number of events written, the ring overwrites the oldest events once it's full
+			std::atomic<uint64_t> count{ 0 };
+			uint32_t threadId = 0;
+			std::string threadName;
+
+			void push(const char* name, uint64_t start, uint64_t end)
+			{
+				const uint64_t index = count.load(std::memory_order_relaxed);
+				Event& event = events[index & (capacity - 1)];
+				event.name = name;
+				event.start = start;
+				event.end = end;
+				count.store(index + 1, std::memory_order_release);
+			}
+		};
+
+		struct Registry
+		{
+			std::mutex mutex;
+			// Buffers are kept after their threads exit, so their events can still be exported
+			std::vector<std::unique_ptr<ThreadBuffer>> threads;
+			std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+			std::atomic<bool> enabled{ false };
+		};
+
+		inline Registry& registry()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		inline bool enabled()
+		{
+			return registry().enabled.load(std::memory_order_relaxed);
+		}
+
+		inline void setEnabled(bool enabled)
+		{
+			registry().enabled.store(enabled, std::memory_order_relaxed);
+		}
+
+		inline uint64_t now()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().epoch).count());
+		}
+
+		// Returns the calling thread's buffer, the registry is only locked the first time a thread records a zone
+		inline ThreadBuffer& threadBuffer()
+		{
+			static thread_local ThreadBuffer* buffer = nullptr;
+			if (!buffer) {
+				Registry& reg = registry();
+				std::lock_guard<std::mutex> lock(reg.mutex);
+				reg.threads.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+				buffer = reg.threads.back().get();
+				buffer->threadId = static_cast<uint32_t>(reg.threads.size());
+			}
+			return *buffer;
+		}
+
+		inline void setThreadName(const std::string& name)
+		{
+			// Avoids allocating a buffer for threads that never record anything
+			if (!enabled()) {
+				return;
+			}
+			ThreadBuffer& buffer = threadBuffer();
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			buffer.threadName = name;
+		}
+
+		class Zone
+		{
+		private:
+			const char* name;
+			uint64_t start = 0;
+			bool active;
+		public:
+			explicit Zone(const char* name) : name(name), active(enabled())
+			{
+				if (active) {
+					start = now();
+				}
+			}
+
+			~Zone()
+			{
+				if (active) {
+					threadBuffer().push(name, start, now());
+				}
+			}
+
+			Zone(const Zone&) = delete;
+			Zone& operator=(const Zone&) = delete;
+		};
+
+		/*
+			Writes all recorded zones in the Chrome trace event format (chrome://tracing, https://ui.perfetto.dev)
+			Should be called while no other thread records zones, as the oldest events of a full ring may be overwritten during the export
+		*/
+		inline bool writeChromeTrace(const std::string& fileName)
+		{
+			std::ofstream file(fileName, std::ios::out);
+			if (!file.is_open()) {
+				return false;
+			}
+			Registry& reg = registry();
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			file << std::fixed << std::setprecision(3);
+			file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+			bool first = true;
+			for (auto& thread : reg.threads) {
+				if (!thread->threadName.empty()) {
+					file << (first ? "" : ",\n");
+					file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << thread->threadId << ", \"args\": {\"name\": \"" << json::escape(thread->threadName) << "\"}}";
+					first = false;
+				}
+				const uint64_t count = thread->count.load(std::memory_order_acquire);
+				const uint64_t oldest = (count > ThreadBuffer::capacity) ? count - ThreadBuffer::capacity : 0;
+				for (uint64_t i = oldest; i < count; i++) {
+					const Event& event = thread->events[i & (ThreadBuffer::capacity - 1)];
+					// Complete events with timestamps in microseconds
+					file << (first ? "" : ",\n");
+					file << "{\"name\": \"" << json::escape(event.name) << "\", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << thread->threadId;
+					file << ", \"ts\": " << event.start / 1000.0 << ", \"dur\": " << (event.end - event.start) / 1000.0 << "}";
+					first = false;
+				}
+			}
+			file << "\n]}\n";
+			return true;
+		}
+	}
+}
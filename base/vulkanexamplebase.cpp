@@ -7,6 +7,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
 
 #if (defined(VK_USE_PLATFORM_MACOS_MVK) && defined(VK_EXAMPLE_XCODE_GENERATED))
 #include <Cocoa/Cocoa.h>
@@ -31,6 +32,7 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	appInfo.pEngineName = name.c_str();
 	appInfo.apiVersion = apiVersion;
 
+	// Also required in headless builds: they create no surface, but enable VK_KHR_swapchain for the present layout used by render passes
 	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
 
 	// Enable surface extensions depending on os
@@ -50,8 +52,6 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_MACOS_MVK)
 	instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
-#elif defined(VK_USE_PLATFORM_HEADLESS_EXT)
-	instanceExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
 #endif
 	
 	// Get extensions supported by the instance and store for later use
@@ -155,7 +155,10 @@ void VulkanExampleBase::renderFrame()
 	VulkanExampleBase::prepareFrame();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	{
+		VKS_TRACE_ZONE("vkQueueSubmit");
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	}
 	VulkanExampleBase::submitFrame();
 }
 
@@ -189,39 +192,192 @@ void VulkanExampleBase::destroyCommandBuffers()
 	vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(drawCmdBuffers.size()), drawCmdBuffers.data());
 }
 
+void VulkanExampleBase::createFrameResources()
+{
+	// Each frame in flight gets its own semaphores, fence and command buffer, so the CPU can record frame n+1 while the GPU still works on frame n
+	frames.resize(framesInFlight);
+	std::vector<VkCommandBuffer> commandBuffers(framesInFlight);
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, framesInFlight);
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, commandBuffers.data()));
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	// Fences are created signaled, so the first wait for each frame returns immediately
+	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		FrameResources& frame = frames[i];
+		if (i == 0) {
+			// The first frame reuses the semaphores created in initVulkan
+			frame.presentComplete = semaphores.presentComplete;
+			frame.renderComplete = semaphores.renderComplete;
+		} else {
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.presentComplete));
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.renderComplete));
+		}
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &frame.fence));
+		frame.commandBuffer = commandBuffers[i];
+	}
+	imageFences.assign(swapChain.imageCount, VK_NULL_HANDLE);
+	currentFrame = 0;
+}
+
+void VulkanExampleBase::destroyFrameResources()
+{
+	for (auto& frame : frames) {
+		vkDestroySemaphore(device, frame.presentComplete, nullptr);
+		vkDestroySemaphore(device, frame.renderComplete, nullptr);
+		vkDestroyFence(device, frame.fence, nullptr);
+	}
+	frames.clear();
+}
+
 std::string VulkanExampleBase::getShadersPath() const
 {
 	return getShaderBasePath() + shaderDir + "/";
 }
 
+std::string VulkanExampleBase::getExampleName() const
+{
+	// Examples don't set a unique name, so the executable name is used to tell them apart
+	std::string exampleName = name;
+	if (!args.empty()) {
+		exampleName = args[0];
+		const size_t pathEnd = exampleName.find_last_of("/\\");
+		if (pathEnd != std::string::npos) {
+			exampleName = exampleName.substr(pathEnd + 1);
+		}
+		const size_t extStart = exampleName.find_last_of('.');
+		if (extStart != std::string::npos) {
+			exampleName = exampleName.substr(0, extStart);
+		}
+	}
+	return exampleName;
+}
+
+std::string VulkanExampleBase::getPipelineCacheFileName() const
+{
+	// Cache data is only valid for the device (and driver) it was created on, so the file name is unique per example and device
+	std::stringstream fileName;
+	fileName << getExampleName() << "_" << std::hex << deviceProperties.vendorID << "_" << deviceProperties.deviceID << ".pipelinecache";
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+	return std::string(androidApp->activity->internalDataPath) + "/" + fileName.str();
+#else
+	return fileName.str();
+#endif
+}
+
 void VulkanExampleBase::createPipelineCache()
 {
+	std::vector<char> cacheData;
+	if (settings.persistentPipelineCache) {
+		const std::string fileName = getPipelineCacheFileName();
+		std::ifstream is(fileName, std::ios::binary | std::ios::ate);
+		if (is.is_open()) {
+			cacheData.resize(static_cast<size_t>(is.tellg()));
+			is.seekg(0, std::ios::beg);
+			is.read(cacheData.data(), cacheData.size());
+			is.close();
+			// Drivers should reject incompatible data on their own, but not all of them do, so we validate the header before passing it on
+			VkPipelineCacheHeaderVersionOne header{};
+			bool valid = cacheData.size() >= sizeof(header);
+			if (valid) {
+				memcpy(&header, cacheData.data(), sizeof(header));
+				valid = (header.headerSize >= sizeof(header)) && (header.headerSize <= cacheData.size()) &&
+					(header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+					(header.vendorID == deviceProperties.vendorID) &&
+					(header.deviceID == deviceProperties.deviceID) &&
+					(memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+			}
+			if (valid) {
+				std::cout << "Pipeline cache: loaded " << cacheData.size() << " bytes from \"" << fileName << "\"\n";
+			} else {
+				std::cout << "Pipeline cache: ignoring incompatible data in \"" << fileName << "\"\n";
+				cacheData.clear();
+			}
+		} else {
+			std::cout << "Pipeline cache: no cache found, starting with an empty cache\n";
+		}
+	}
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+	pipelineCacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
 	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
 }
 
+void VulkanExampleBase::savePipelineCache()
+{
+	size_t dataSize = 0;
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+	if (dataSize == 0) {
+		return;
+	}
+	std::vector<char> cacheData(dataSize);
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, cacheData.data()));
+	// Write to a temporary file first and then replace the old cache, so an interrupted write never leaves a truncated cache behind
+	const std::string fileName = getPipelineCacheFileName();
+	const std::string tempFileName = fileName + ".tmp";
+	std::ofstream os(tempFileName, std::ios::binary | std::ios::trunc);
+	if (!os.is_open()) {
+		std::cerr << "Pipeline cache: could not write \"" << tempFileName << "\"\n";
+		return;
+	}
+	os.write(cacheData.data(), dataSize);
+	os.close();
+	if (os.fail()) {
+		std::remove(tempFileName.c_str());
+		return;
+	}
+#if defined(_WIN32)
+	const bool replaced = MoveFileExA(tempFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	const bool replaced = std::rename(tempFileName.c_str(), fileName.c_str()) == 0;
+#endif
+	if (!replaced) {
+		std::cerr << "Pipeline cache: could not replace \"" << fileName << "\"\n";
+		std::remove(tempFileName.c_str());
+	}
+}
+
 void VulkanExampleBase::prepare()
 {
+	VKS_TRACE_ZONE("VulkanExampleBase::prepare");
 	initSwapchain();
 	createCommandPool();
 	setupSwapChain();
 	createCommandBuffers();
 	createSynchronizationPrimitives();
+	framesInFlight = std::max(1u, std::min(settings.framesInFlight, maxFramesInFlight));
+	if (framesInFlight < settings.framesInFlight) {
+		std::cout << "Requested " << settings.framesInFlight << " frames in flight, but this example supports at most " << maxFramesInFlight << "\n";
+	}
+	benchmark.framesInFlight = framesInFlight;
+	createFrameResources();
+	uniformArena.create(vulkanDevice, uniformArenaSize, framesInFlight);
+	if (parallelRecording) {
+		const uint32_t threadCount = (settings.recordingThreads > 0) ? settings.recordingThreads : std::max(std::thread::hardware_concurrency(), 1u);
+		parallelRecorder.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, threadCount);
+	}
+	if (benchmark.active) {
+		const uint32_t queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
+		benchmark.prepareGpuTimer(device, queueFamilyIndex, vulkanDevice->queueFamilyProperties[queueFamilyIndex].timestampValidBits, deviceProperties.limits.timestampPeriod, framesInFlight);
+	}
+	gpuProfiler.create(vulkanDevice, queue, vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits, settings.pipelineStatistics && enabledFeatures.pipelineStatisticsQuery);
 	setupDepthStencil();
 	setupRenderPass();
 	createPipelineCache();
 	setupFrameBuffer();
-	settings.overlay = settings.overlay && (!benchmark.active);
+	settings.overlay = settings.overlay && (!benchmark.active || benchmark.overlay);
 	if (settings.overlay) {
 		UIOverlay.device = vulkanDevice;
 		UIOverlay.queue = queue;
+		UIOverlay.frameCount = framesInFlight;
 		UIOverlay.shaders = {
 			loadShader(getShadersPath() + "base/uioverlay.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
 			loadShader(getShadersPath() + "base/uioverlay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
 		};
 		UIOverlay.prepareResources();
 		UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		// Command buffers recorded before the first overlay update already contain its draw
+		UIOverlay.resize(width, height);
 	}
 }
 
@@ -243,14 +399,19 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 
 void VulkanExampleBase::nextFrame()
 {
+	VKS_TRACE_ZONE("Frame");
 	auto tStart = std::chrono::high_resolution_clock::now();
 	if (viewUpdated)
 	{
+		VKS_TRACE_ZONE("viewChanged");
 		viewUpdated = false;
 		viewChanged();
 	}
 
-	render();
+	{
+		VKS_TRACE_ZONE("render");
+		render();
+	}
 	frameCounter++;
 	auto tEnd = std::chrono::high_resolution_clock::now();
 #if (defined(VK_USE_PLATFORM_IOS_MVK) || (defined(VK_USE_PLATFORM_MACOS_MVK) && !defined(VK_EXAMPLE_XCODE_GENERATED)))
@@ -295,6 +456,8 @@ void VulkanExampleBase::nextFrame()
 
 void VulkanExampleBase::renderLoop()
 {
+	// Uploads done while preparing the example went through the staging ring (printed before the benchmark path returns)
+	vulkanDevice->stagingRing.printStatistics();
 // SRS - for non-apple plaforms, handle benchmarking here within VulkanExampleBase::renderLoop()
 //     - for macOS, handle benchmarking within NSApp rendering loop via displayLinkOutputCb()
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
@@ -309,11 +472,17 @@ void VulkanExampleBase::renderLoop()
 		wl_display_dispatch_pending(display);
 #endif
 
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
+		benchmark.exampleName = getExampleName();
+		benchmark.width = width;
+		benchmark.height = height;
+		benchmark.run([=] { render(); updateOverlay(); }, vulkanDevice->properties);
 		vkDeviceWaitIdle(device);
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
 		}
+		if (benchmark.jsonFilename != "") {
+			benchmark.saveResultsJson();
+		}
 		return;
 	}
 #endif
@@ -674,6 +843,7 @@ void VulkanExampleBase::renderLoop()
 	if (device != VK_NULL_HANDLE) {
 		vkDeviceWaitIdle(device);
 	}
+	vulkanDevice->memoryAllocator.printStatistics();
 }
 
 void VulkanExampleBase::updateOverlay()
@@ -681,6 +851,8 @@ void VulkanExampleBase::updateOverlay()
 	if (!settings.overlay)
 		return;
 
+	VKS_TRACE_ZONE("updateOverlay");
+
 	ImGuiIO& io = ImGui::GetIO();
 
 	io.DisplaySize = ImVec2((float)width, (float)height);
@@ -707,6 +879,33 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PushItemWidth(110.0f * UIOverlay.scale);
 	OnUpdateUIOverlay(&UIOverlay);
 	ImGui::PopItemWidth();
+	if (!gpuProfiler.passes.empty() && ImGui::CollapsingHeader("GPU profiler")) {
+		for (auto& pass : gpuProfiler.passes) {
+			ImGui::Indent((pass.depth + 1) * 10.0f * UIOverlay.scale);
+			ImGui::TextUnformatted(pass.name.c_str());
+			ImGui::SameLine(180.0f * UIOverlay.scale);
+			ImGui::Text("%.3f ms", pass.averageTime);
+			if (pass.hasStatistics && ImGui::IsItemHovered()) {
+				std::string statistics;
+				for (uint32_t i = 0; i < vks::GpuProfiler::StatisticCount; i++) {
+					statistics += std::string(vks::GpuProfiler::statisticName(static_cast<vks::GpuProfiler::Statistic>(i))) + ": " + std::to_string(pass.statistics[i]) + "\n";
+				}
+				ImGui::SetTooltip("%s", statistics.c_str());
+			}
+			ImGui::Unindent((pass.depth + 1) * 10.0f * UIOverlay.scale);
+		}
+	}
+	if (ImGui::CollapsingHeader("Device memory")) {
+		const std::vector<vks::MemoryAllocator::HeapStatistics> heapStatistics = vulkanDevice->memoryAllocator.getStatistics();
+		for (size_t i = 0; i < heapStatistics.size(); i++) {
+			const vks::MemoryAllocator::HeapStatistics& statistics = heapStatistics[i];
+			if (statistics.peakBytes == 0) {
+				continue;
+			}
+			ImGui::Text("Heap %u: %u allocations, %u blocks", (uint32_t)i, statistics.allocationCount + statistics.dedicatedAllocationCount, statistics.blockCount);
+			ImGui::Text("%.1f / %.1f MB used, %.1f MB dedicated", statistics.usedBytes / (1024.0f * 1024.0f), statistics.blockBytes / (1024.0f * 1024.0f), statistics.dedicatedBytes / (1024.0f * 1024.0f));
+		}
+	}
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PopStyleVar();
 #endif
@@ -715,7 +914,23 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PopStyleVar();
 	ImGui::Render();
 
-	if (UIOverlay.update() || UIOverlay.updated) {
+	// render() has already advanced to the next frame, whose staging slice may still be read by its previous submission
+	if (framesInFlight > 1) {
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &frames[currentFrame].fence, VK_TRUE, UINT64_MAX));
+	}
+
+	// Only a grown geometry buffer or changed widget state require new command buffers
+	const bool geometryBufferGrown = UIOverlay.update(currentFrame);
+	if (geometryBufferGrown || UIOverlay.updated) {
+		VKS_TRACE_ZONE("buildCommandBuffers");
+		// Command buffers of frames in flight may still be executing
+		if (framesInFlight > 1) {
+			std::vector<VkFence> fences;
+			for (auto& frame : frames) {
+				fences.push_back(frame.fence);
+			}
+			VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX));
+		}
 		buildCommandBuffers();
 		UIOverlay.updated = false;
 	}
@@ -741,24 +956,86 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 
 void VulkanExampleBase::prepareFrame()
 {
+	VKS_TRACE_ZONE("prepareFrame");
+	// Time spent waiting for the GPU (or the presentation engine) is reported separately from the CPU time in benchmark mode
+	auto tWaitStart = std::chrono::high_resolution_clock::now();
+	if (framesInFlight > 1) {
+		// Wait until the GPU has finished the frame that last used this slot of the ring, then use that slot's semaphores
+		// The semaphores member and submitInfo (which points at it) always refer to the current frame, so examples using them keep working
+		const FrameResources& frame = frames[currentFrame];
+		{
+			VKS_TRACE_ZONE("Wait for frame fence");
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+		}
+		semaphores.presentComplete = frame.presentComplete;
+		semaphores.renderComplete = frame.renderComplete;
+	}
+	// The GPU has finished the frame that last used this frame's region (without frames in flight, submitFrame waited for the queue to become idle)
+	uniformArena.beginFrame(currentFrame);
 	// Acquire the next image from the swap chain
-	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+	// In benchmark mode the image is acquired with a semaphore of the GPU timer, whose start timestamp submission then signals presentComplete
+	VkSemaphore acquireSemaphore = benchmark.active ? benchmark.getAcquireSemaphore(currentFrame, semaphores.presentComplete) : semaphores.presentComplete;
+	VkResult result;
+	{
+		VKS_TRACE_ZONE("acquireNextImage");
+		result = swapChain.acquireNextImage(acquireSemaphore, &currentBuffer);
+	}
+	benchmark.addWaitTime(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tWaitStart).count());
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
 	// SRS - If no longer optimal (VK_SUBOPTIMAL_KHR), wait until submitFrame() in case number of swapchain images will change on resize
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			windowResize();
+			if (benchmark.active) {
+				benchmark.skipGpuFrame(queue, semaphores.presentComplete);
+			}
+			return;
 		}
-		return;
 	}
 	else {
 		VK_CHECK_RESULT(result);
 	}
+	if (framesInFlight > 1) {
+		// Images may be returned out of order, so the acquired image (and its pre-recorded command buffer) can still be in use by another frame
+		VkFence& imageFence = imageFences[currentBuffer];
+		if ((imageFence != VK_NULL_HANDLE) && (imageFence != frames[currentFrame].fence)) {
+			VKS_TRACE_ZONE("Wait for image fence");
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &imageFence, VK_TRUE, UINT64_MAX));
+		}
+		imageFence = frames[currentFrame].fence;
+	}
+	if (benchmark.active) {
+		benchmark.beginGpuFrame(queue, currentFrame, semaphores.presentComplete);
+	}
+	// Picks up the pass timings of all command buffers the GPU has finished in the meantime
+	gpuProfiler.resolve();
+	if (benchmark.active) {
+		for (auto& result : gpuProfiler.results) {
+			benchmark.addPassTime(result.path, result.time);
+		}
+	}
+	gpuProfiler.results.clear();
 }
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	VKS_TRACE_ZONE("submitFrame");
+	if (benchmark.active) {
+		benchmark.endGpuFrame(queue, currentFrame);
+	}
+	if (framesInFlight > 1) {
+		// An empty submission signals the frame's fence once all work submitted so far has completed
+		// This also covers examples that submit their command buffers without a fence
+		const FrameResources& frame = frames[currentFrame];
+		VK_CHECK_RESULT(vkResetFences(device, 1, &frame.fence));
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 0, nullptr, frame.fence));
+		currentFrame = (currentFrame + 1) % framesInFlight;
+	}
+	VkResult result;
+	{
+		VKS_TRACE_ZONE("queuePresent");
+		result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	}
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -769,7 +1046,13 @@ void VulkanExampleBase::submitFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	// Without frames in flight the CPU waits for the GPU to finish the frame before starting the next one
+	if (framesInFlight == 1) {
+		VKS_TRACE_ZONE("vkQueueWaitIdle");
+		auto tWaitStart = std::chrono::high_resolution_clock::now();
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		benchmark.addWaitTime(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tWaitStart).count());
+	}
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -807,16 +1090,17 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
-
+	commandLineParser.add("benchmarkjsonfile", { "-bj", "--benchjson" }, 1, "Save benchmark results with frame time statistics as JSON to the given file");
+	commandLineParser.add("benchmarkoverlay", { "-bo", "--benchoverlay" }, 0, "Keep the UI overlay enabled in benchmark mode");
+	commandLineParser.add("framesinflight", { "-fif", "--framesinflight" }, 1, "Set the number of frames in flight (if supported by the example)");
+	commandLineParser.add("nopipelinecache", { "-npc", "--nopipelinecache" }, 0, "Disable loading and storing the pipeline cache on disk");
+	commandLineParser.add("gltfcache", { "-gc", "--gltfcache" }, 1, "Store binary geometry caches for glTF models in the given (existing) directory");
+	commandLineParser.add("pipelinestatistics", { "-ps", "--pipelinestatistics" }, 0, "Collect pipeline statistics for GPU profiler passes (if supported)");
+	commandLineParser.add("trace", { "-tr", "--trace" }, 1, "Record CPU zones and save them as a Chrome trace (JSON) to the given file on exit");
+	commandLineParser.add("simulationscale", { "-ss", "--simulationscale" }, 1, "Multiply the particle, grid or instance count of compute workloads (if supported by the example)");
+
+	// Examples may add their own options in their constructor, so help is printed in initVulkan once all options are known
 	commandLineParser.parse(args);
-	if (commandLineParser.isSet("help")) {
-#if defined(_WIN32)
-		setupConsole("Vulkan example");
-#endif
-		commandLineParser.printHelp();
-		std::cin.get();
-		exit(0);
-	}
 	if (commandLineParser.isSet("validation")) {
 		settings.validation = true;
 	}
@@ -860,6 +1144,36 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("benchmarkjsonfile")) {
+		benchmark.jsonFilename = commandLineParser.getValueAsString("benchmarkjsonfile", benchmark.jsonFilename);
+	}
+	if (commandLineParser.isSet("benchmarkoverlay")) {
+		benchmark.overlay = true;
+	}
+	if (commandLineParser.isSet("framesinflight")) {
+		settings.framesInFlight = commandLineParser.getValueAsInt("framesinflight", settings.framesInFlight);
+	}
+	if (commandLineParser.isSet("nopipelinecache")) {
+		settings.persistentPipelineCache = false;
+	}
+	if (commandLineParser.isSet("pipelinestatistics")) {
+		settings.pipelineStatistics = true;
+	}
+	if (commandLineParser.isSet("simulationscale")) {
+		settings.simulationScale = std::max(commandLineParser.getValueAsInt("simulationscale", settings.simulationScale), 1);
+	}
+	if (commandLineParser.isSet("trace")) {
+		traceFileName = commandLineParser.getValueAsString("trace", "trace.json");
+		vks::trace::setEnabled(true);
+		VKS_TRACE_THREAD_NAME("Main");
+	}
+#if !defined(VK_USE_PLATFORM_ANDROID_KHR)
+	// Android loads models from the apk, so the geometry cache is only used on desktop
+	// The cache is opt-in, so examples don't write files to the working directory
+	if (commandLineParser.isSet("gltfcache")) {
+		vkglTF::geometryCachePath = commandLineParser.getValueAsString("gltfcache", "");
+	}
+#endif
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Vulkan library is loaded dynamically on Android
@@ -885,6 +1199,14 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	if (!traceFileName.empty()) {
+		vks::trace::setEnabled(false);
+		if (vks::trace::writeChromeTrace(traceFileName)) {
+			std::cout << "CPU trace written to \"" << traceFileName << "\"\n";
+		} else {
+			std::cerr << "Could not write CPU trace to \"" << traceFileName << "\"\n";
+		}
+	}
 	// Clean up Vulkan resources
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
@@ -909,12 +1231,25 @@ VulkanExampleBase::~VulkanExampleBase()
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.mem, nullptr);
 
+	benchmark.destroyGpuTimer();
+	gpuProfiler.destroy();
+	uniformArena.destroy();
+	parallelRecorder.destroy();
+
+	if (settings.persistentPipelineCache && (pipelineCache != VK_NULL_HANDLE)) {
+		savePipelineCache();
+	}
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
 	vkDestroyCommandPool(device, cmdPool, nullptr);
 
-	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
+	if (frames.empty()) {
+		vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
+		vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
+	} else {
+		// The frame resources also own the semaphores created in initVulkan
+		destroyFrameResources();
+	}
 	for (auto& fence : waitFences) {
 		vkDestroyFence(device, fence, nullptr);
 	}
@@ -969,6 +1304,15 @@ VulkanExampleBase::~VulkanExampleBase()
 
 bool VulkanExampleBase::initVulkan()
 {
+	if (commandLineParser.isSet("help")) {
+#if defined(_WIN32)
+		setupConsole("Vulkan example");
+#endif
+		commandLineParser.printHelp();
+		std::cin.get();
+		exit(0);
+	}
+
 	VkResult err;
 
 	// Vulkan instance
@@ -1041,6 +1385,9 @@ bool VulkanExampleBase::initVulkan()
 
 	// Derived examples can override this to set actual features (based on above readings) to enable for logical device creation
 	getEnabledFeatures();
+	if (settings.pipelineStatistics && deviceFeatures.pipelineStatisticsQuery) {
+		enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+	}
 
 	// Vulkan device creation
 	// This is handled by a separate class that gets a logical device representation
@@ -1882,10 +2229,16 @@ void VulkanExampleBase::displayLinkOutputCb()
 {
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
+		benchmark.exampleName = getExampleName();
+		benchmark.width = width;
+		benchmark.height = height;
+		benchmark.run([=] { render(); updateOverlay(); }, vulkanDevice->properties);
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
 		}
+		if (benchmark.jsonFilename != "") {
+			benchmark.saveResultsJson();
+		}
 		quit = true;	// SRS - quit NSApp rendering loop when benchmarking complete
 		return;
 	}
@@ -2702,7 +3055,7 @@ void VulkanExampleBase::setupDepthStencil()
 	imageCI.arrayLayers = 1;
 	imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	imageCI.usage = depthStencilUsage;
 
 	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &depthStencil.image));
 	VkMemoryRequirements memReqs{};
@@ -2853,6 +3206,7 @@ void VulkanExampleBase::windowResize()
 	{
 		return;
 	}
+	VKS_TRACE_ZONE("windowResize");
 	prepared = false;
 	resized = true;
 
@@ -2893,6 +3247,7 @@ void VulkanExampleBase::windowResize()
 		vkDestroyFence(device, fence, nullptr);
 	}
 	createSynchronizationPrimitives();
+	imageFences.assign(swapChain.imageCount, VK_NULL_HANDLE);
 
 	vkDeviceWaitIdle(device);
 
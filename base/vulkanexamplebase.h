@@ -54,6 +54,8 @@
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <string>
+#include <sstream>
+#include <fstream>
 #include <numeric>
 #include <array>
 
@@ -68,10 +70,14 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanProfiler.h"
+#include "VulkanUniformArena.h"
+#include "VulkanCommandRecorder.h"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
 #include "benchmark.hpp"
+#include "tracer.hpp"
 
 class VulkanExampleBase
 {
@@ -84,13 +90,20 @@ private:
 	void nextFrame();
 	void updateOverlay();
 	void createPipelineCache();
+	std::string getExampleName() const;
+	std::string getPipelineCacheFileName() const;
+	void savePipelineCache();
 	void createCommandPool();
 	void createSynchronizationPrimitives();
 	void initSwapchain();
 	void setupSwapChain();
 	void createCommandBuffers();
 	void destroyCommandBuffers();
+	void createFrameResources();
+	void destroyFrameResources();
 	std::string shaderDir = "glsl";
+	// CPU zones are written to this file on exit if tracing has been enabled via command line
+	std::string traceFileName;
 protected:
 	bool firstframe = true;
 
@@ -125,6 +138,8 @@ protected:
 	VkQueue queue;
 	// Depth buffer format (selected during Vulkan initialization)
 	VkFormat depthFormat;
+	/** @brief Usage flags of the depth stencil image, e.g. add VK_IMAGE_USAGE_SAMPLED_BIT to read the depth buffer in a shader (must be set in the derived constructor) */
+	VkImageUsageFlags depthStencilUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
 	// Command buffer pool
 	VkCommandPool cmdPool;
 	/** @brief Pipeline stages used to wait at for graphics queue submissions */
@@ -138,7 +153,7 @@ protected:
 	// List of shader modules created (stored for cleanup)
 	std::vector<VkShaderModule> shaderModules;
 	// Pipeline cache object
-	VkPipelineCache pipelineCache;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
 	// List of available frame buffers (same as number of swap chain images)
 	std::vector<VkFramebuffer> frameBuffers;
 	// Command buffers used for rendering
@@ -155,6 +170,31 @@ protected:
 		VkSemaphore renderComplete;
 	} semaphores;
 	std::vector<VkFence> waitFences;
+	/** @brief Synchronization primitives and command buffer owned by a single frame in flight */
+	struct FrameResources {
+		VkSemaphore presentComplete = VK_NULL_HANDLE;
+		VkSemaphore renderComplete = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	};
+	/** @brief Ring of per-frame resources, one entry for each frame in flight */
+	std::vector<FrameResources> frames;
+	/** @brief Fence of the frame that last rendered to a swap chain image (indexed by currentBuffer) */
+	std::vector<VkFence> imageFences;
+	/** @brief Index into the frame resource ring for the frame currently being recorded */
+	uint32_t currentFrame = 0;
+	/** @brief Number of frames the CPU may run ahead of the GPU (resolved in prepare() from settings.framesInFlight and maxFramesInFlight) */
+	uint32_t framesInFlight = 1;
+	/** @brief Maximum number of frames in flight supported by the example, examples that keep per-frame resources raise this in their constructor */
+	uint32_t maxFramesInFlight = 1;
+	/** @brief Bump allocator for dynamic uniform blocks written each frame, the current frame's region is reset in prepareFrame */
+	vks::UniformArena uniformArena;
+	/** @brief Size of the uniform arena's region for each frame in flight, examples writing more uniform data per frame raise this in their constructor */
+	VkDeviceSize uniformArenaSize = 256 * 1024;
+	/** @brief Records secondary command buffers on multiple threads, only created for examples that set parallelRecording */
+	vks::ParallelCommandRecorder parallelRecorder;
+	/** @brief Examples recording their command buffers with the parallel recorder set this in their constructor */
+	bool parallelRecording = false;
 	bool requiresStencil{ false };
 public:
 	bool prepared = false;
@@ -171,6 +211,9 @@ public:
 
 	vks::Benchmark benchmark;
 
+	/** @brief Scoped GPU timings of named passes, shown in the UI overlay and added to benchmark reports */
+	vks::GpuProfiler gpuProfiler;
+
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
 
@@ -184,6 +227,16 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Requested number of frames in flight (clamped to the example's maxFramesInFlight) */
+		uint32_t framesInFlight = 1;
+		/** @brief Load the pipeline cache from disk at startup and store it on exit */
+		bool persistentPipelineCache = true;
+		/** @brief Collect pipeline statistics for the top level passes of the GPU profiler */
+		bool pipelineStatistics = false;
+		/** @brief Number of threads used by the parallel command recorder (0 = one per CPU core, set by the examples using the recorder) */
+		uint32_t recordingThreads = 0;
+		/** @brief Multiplier for the particle, grid or instance count of compute workloads (if supported by the example) */
+		uint32_t simulationScale = 1;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
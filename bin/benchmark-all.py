@@ -1,106 +1,83 @@
 # Benchmark all examples
+# Results are stored per example (CSV and JSON) and aggregated into a single JSON file that can be compared against a baseline
+import argparse
+import json
 import subprocess
 import sys
 import os
 import platform
 
-EXAMPLES = [
-	"bloom",
-	"computecloth",
-	"computecullandlod",
-	"computenbody",
-	"computeparticles",
-	"computeraytracing",	
-	"computeshader",
-	"conditionalrender",
-	"conservativeraster",
-	"debugmarker",
-	"deferred",
-	"deferredmultisampling",
-	"deferredshadows",
-	"descriptorindexing",
-	"descriptorsets",
-	"displacement",
-	"distancefieldfonts",
-	"dynamicrendering",	
-	"dynamicuniformbuffer",
-	"gears",
-	"geometryshader",
-	"gltfloading",
-	"gltfscenerendering",
-	"gltfskinning",
-	"graphicspipelinelibrary",
-	"hdr",
-	"imgui",
-	"indirectdraw",
-	"inlineuniformblocks",
-	"inputattachments",
-	"instancing",
-	"multisampling",
-	"multithreading",
-	"multiview",
-	"negativeviewportheight",
-	"occlusionquery",
-	"offscreen",
-	"oit",
-	"parallaxmapping",
-	"particlefire",
-	"pbrbasic",
-	"pbribl",
-	"pbrtexture",
-	"pipelines",
-	"pipelinestatistics",
-	"pushconstants",
-	"pushdescriptors",
-	"radialblur",
-	"rayquery",
-	"raytracingbasic",
-	"raytracingcallable",
-	"raytracingreflections",
-	"raytracingshadows",
-	"shadowmapping",
-	"shadowmappingcascade",
-	"shadowmappingomni",
-	"specializationconstants",
-	"sphericalenvmapping",
-	"ssao",
-	"stencilbuffer",
-	"subpasses",
-	"terraintessellation",
-	"tessellation",
-	"textoverlay",
-	"texture",
-	"texture3d",
-	"texturearray",
-	"texturecubemap",
-	"texturecubemaparray",
-	"texturemipmapgen",
-	"texturesparseresidency",
-	"triangle",
-	"variablerateshading",
-	"vertexattributes",
-	"viewportarray",
-	"vulkanscene"
-]
+from examplelist import EXAMPLES
 
-CURR_INDEX = 0
+# Frame time statistics compared against the baseline
+COMPARED_STATISTICS = ["p50", "p99"]
+
+parser = argparse.ArgumentParser(description="Run all examples in benchmark mode and aggregate the results")
+parser.add_argument("--examples", help="Comma separated list of examples to run (defaults to all)")
+parser.add_argument("--args", default="", help="Additional arguments passed to each example (e.g. \"--framesinflight 2\")")
+parser.add_argument("--output", default="./benchmark/results.json", help="File to store the aggregated results in")
+parser.add_argument("--baseline", help="Aggregated results of a previous run to compare against")
+parser.add_argument("--threshold", type=float, default=5.0, help="Relative frame time increase (in percent) reported as a regression")
+args = parser.parse_args()
 
 ARGS = "-fullscreen -b"
+if args.args:
+	ARGS += " " + args.args
+
+if args.examples:
+	EXAMPLES = [example.strip() for example in args.examples.split(",")]
 
 print("Benchmarking all examples...")
 
 os.makedirs("./benchmark", exist_ok=True)
 
-for example in EXAMPLES:
+RESULTS = {}
+
+for CURR_INDEX, example in enumerate(EXAMPLES):
 	print("---- (%d/%d) Running %s in benchmark mode ----" % (CURR_INDEX+1, len(EXAMPLES), example))
+	json_file = "./benchmark/%s.json" % example
+	if os.path.exists(json_file):
+		os.remove(json_file)
 	if platform.system() == 'Linux' or platform.system() == 'Darwin':
-		RESULT_CODE = subprocess.call("./%s %s -bf ./benchmark/%s.csv 5" % (example, ARGS, example), shell=True)
+		RESULT_CODE = subprocess.call("./%s %s -bf ./benchmark/%s.csv -bj %s" % (example, ARGS, example, json_file), shell=True)
 	else:
-		RESULT_CODE = subprocess.call("%s %s -bf ./benchmark/%s.csv 5" % (example, ARGS, example))
-	if RESULT_CODE == 0:
-		print("Results written to ./benchmark/%s.csv" % example)
+		RESULT_CODE = subprocess.call("%s %s -bf ./benchmark/%s.csv -bj %s" % (example, ARGS, example, json_file))
+	if RESULT_CODE == 0 and os.path.exists(json_file):
+		with open(json_file) as file:
+			RESULTS[example] = json.load(file)
+		print("Results written to ./benchmark/%s.csv and %s" % (example, json_file))
 	else:
 		print("Error, result code = %d" % RESULT_CODE)
-	CURR_INDEX += 1
 
-print("Benchmark run finished")
+with open(args.output, "w") as file:
+	json.dump(RESULTS, file, indent=4)
+print("Benchmark run finished, aggregated results written to %s" % args.output)
+
+if not args.baseline:
+	sys.exit(0)
+
+# Compare frame time statistics against the baseline
+with open(args.baseline) as file:
+	BASELINE = json.load(file)
+
+REGRESSIONS = 0
+print("---- Comparison against %s (threshold %.1f%%) ----" % (args.baseline, args.threshold))
+for example, result in sorted(RESULTS.items()):
+	if example not in BASELINE:
+		print("%-28s no baseline" % example)
+		continue
+	for timing in ["frame", "cpu", "gpu"]:
+		current = result["statistics"].get(timing)
+		previous = BASELINE[example]["statistics"].get(timing)
+		if current is None or previous is None:
+			continue
+		for statistic in COMPARED_STATISTICS:
+			if previous[statistic] <= 0.0:
+				continue
+			change = (current[statistic] - previous[statistic]) / previous[statistic] * 100.0
+			regression = change > args.threshold
+			REGRESSIONS += 1 if regression else 0
+			print("%-28s %-5s %-4s %9.3f ms -> %9.3f ms (%+6.1f%%)%s" % (example, timing, statistic, previous[statistic], current[statistic], change, "  REGRESSION" if regression else ""))
+
+print("%d regression(s) found" % REGRESSIONS)
+sys.exit(1 if REGRESSIONS > 0 else 0)
@@ -0,0 +1,116 @@
+# Headless benchmark driver for continuous integration
+# Runs examples built with USE_HEADLESS (offscreen swap chain, no window system required) for a fixed number of frames,
+# e.g. on a software implementation like lavapipe, and compares the frame time statistics of each example against its stored baseline
+# Exits with a non-zero code if an example fails to run or regresses beyond the threshold
+import argparse
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+
+from examplelist import EXAMPLES
+
+parser = argparse.ArgumentParser(description="Run examples headless for a fixed number of frames and compare the results against per-example baselines")
+parser.add_argument("--bindir", default=".", help="Directory containing the example binaries built with USE_HEADLESS")
+parser.add_argument("--examples", help="Comma separated list of examples to run (defaults to all examples with a baseline, or all examples if there are none)")
+parser.add_argument("--frames", type=int, default=100, help="Number of frames rendered by each example")
+parser.add_argument("--warmup", type=int, default=1, help="Warmup time in seconds before measuring")
+parser.add_argument("--timeout", type=int, default=600, help="Time in seconds after which an example is considered hung")
+parser.add_argument("--icd", help="ICD manifest of the Vulkan implementation to use (e.g. lvp_icd.x86_64.json for lavapipe)")
+parser.add_argument("--args", default="", help="Additional arguments passed to each example")
+parser.add_argument("--output", default="./benchmark/ci", help="Directory to store the results of this run in")
+parser.add_argument("--baseline", default="./benchmark/baseline", help="Directory with the stored per-example baselines (<example>.json)")
+parser.add_argument("--update-baseline", action="store_true", help="Store the results of this run as the new baselines instead of comparing against them")
+parser.add_argument("--threshold", type=float, default=10.0, help="Relative frame time increase (in percent) reported as a regression")
+parser.add_argument("--statistics", default="p50,p99", help="Comma separated list of frame time statistics compared against the baseline")
+args = parser.parse_args()
+
+STATISTICS = [statistic.strip() for statistic in args.statistics.split(",")]
+TIMINGS = ["frame", "cpu", "gpu"]
+
+def baseline_file(example):
+	return os.path.join(args.baseline, "%s.json" % example)
+
+if args.examples:
+	examples = [example.strip() for example in args.examples.split(",")]
+else:
+	examples = EXAMPLES
+	if not args.update_baseline:
+		with_baseline = [example for example in EXAMPLES if os.path.exists(baseline_file(example))]
+		if with_baseline:
+			examples = with_baseline
+
+env = os.environ.copy()
+if args.icd:
+	# VK_DRIVER_FILES replaces VK_ICD_FILENAMES in newer loaders, set both to support older ones
+	env["VK_DRIVER_FILES"] = os.path.abspath(args.icd)
+	env["VK_ICD_FILENAMES"] = os.path.abspath(args.icd)
+
+os.makedirs(args.output, exist_ok=True)
+if args.update_baseline:
+	os.makedirs(args.baseline, exist_ok=True)
+
+# The benchmark ends after the given number of frames, the runtime limit only needs to be large enough to never be hit first
+ARGS = ["-b", "-bw", str(args.warmup), "-br", str(args.timeout), "-bfs", str(args.frames)] + args.args.split()
+
+RESULTS = {}
+FAILURES = []
+REGRESSIONS = 0
+
+for index, example in enumerate(examples):
+	print("---- (%d/%d) Running %s headless for %d frames ----" % (index + 1, len(examples), example, args.frames))
+	json_file = os.path.abspath(os.path.join(args.output, "%s.json" % example))
+	if os.path.exists(json_file):
+		os.remove(json_file)
+	executable = os.path.join(os.path.abspath(args.bindir), example + (".exe" if platform.system() == "Windows" else ""))
+	try:
+		result_code = subprocess.call([executable] + ARGS + ["-bj", json_file], cwd=args.bindir, env=env, timeout=args.timeout)
+	except subprocess.TimeoutExpired:
+		print("Error, %s did not finish within %d seconds" % (example, args.timeout))
+		FAILURES.append(example)
+		continue
+	except OSError as error:
+		print("Error, could not run %s: %s" % (executable, error))
+		FAILURES.append(example)
+		continue
+	if result_code != 0 or not os.path.exists(json_file):
+		print("Error, result code = %d" % result_code)
+		FAILURES.append(example)
+		continue
+	with open(json_file) as file:
+		RESULTS[example] = json.load(file)
+
+	if args.update_baseline:
+		shutil.copyfile(json_file, baseline_file(example))
+		print("Baseline updated")
+		continue
+
+	if not os.path.exists(baseline_file(example)):
+		print("No baseline")
+		continue
+	with open(baseline_file(example)) as file:
+		baseline = json.load(file)
+	for timing in TIMINGS:
+		current = RESULTS[example]["statistics"].get(timing)
+		previous = baseline["statistics"].get(timing)
+		if current is None or previous is None:
+			continue
+		for statistic in STATISTICS:
+			if statistic not in current or statistic not in previous or previous[statistic] <= 0.0:
+				continue
+			change = (current[statistic] - previous[statistic]) / previous[statistic] * 100.0
+			regression = change > args.threshold
+			REGRESSIONS += 1 if regression else 0
+			print("%-5s %-4s %9.3f ms -> %9.3f ms (%+6.1f%%)%s" % (timing, statistic, previous[statistic], current[statistic], change, "  REGRESSION" if regression else ""))
+
+# Aggregated results use the same layout as benchmark-all.py, so they can also be used as its baseline
+with open(os.path.join(args.output, "results.json"), "w") as file:
+	json.dump(RESULTS, file, indent=4)
+
+print("---- Summary ----")
+print("%d example(s) run, %d failed, %d regression(s) found (threshold %.1f%%)" % (len(examples), len(FAILURES), REGRESSIONS, args.threshold))
+if FAILURES:
+	print("Failed: %s" % ", ".join(FAILURES))
+sys.exit(1 if (FAILURES or REGRESSIONS > 0) else 0)
@@ -0,0 +1,80 @@
+# Examples run by the benchmark scripts
+
+EXAMPLES = [
+	"bloom",
+	"computecloth",
+	"computecullandlod",
+	"computenbody",
+	"computeparticles",
+	"computeraytracing",	
+	"computeshader",
+	"conditionalrender",
+	"conservativeraster",
+	"debugmarker",
+	"deferred",
+	"deferredmultisampling",
+	"deferredshadows",
+	"descriptorindexing",
+	"descriptorsets",
+	"displacement",
+	"distancefieldfonts",
+	"dynamicrendering",	
+	"dynamicuniformbuffer",
+	"gears",
+	"geometryshader",
+	"gltfloading",
+	"gltfscenerendering",
+	"gltfskinning",
+	"graphicspipelinelibrary",
+	"hdr",
+	"imgui",
+	"indirectdraw",
+	"inlineuniformblocks",
+	"inputattachments",
+	"instancing",
+	"multisampling",
+	"multithreading",
+	"multiview",
+	"negativeviewportheight",
+	"occlusionquery",
+	"offscreen",
+	"oit",
+	"parallaxmapping",
+	"particlefire",
+	"pbrbasic",
+	"pbribl",
+	"pbrtexture",
+	"pipelines",
+	"pipelinestatistics",
+	"pushconstants",
+	"pushdescriptors",
+	"radialblur",
+	"rayquery",
+	"raytracingbasic",
+	"raytracingcallable",
+	"raytracingreflections",
+	"raytracingshadows",
+	"shadowmapping",
+	"shadowmappingcascade",
+	"shadowmappingomni",
+	"specializationconstants",
+	"sphericalenvmapping",
+	"ssao",
+	"stencilbuffer",
+	"subpasses",
+	"terraintessellation",
+	"tessellation",
+	"textoverlay",
+	"texture",
+	"texture3d",
+	"texturearray",
+	"texturecubemap",
+	"texturecubemaparray",
+	"texturemipmapgen",
+	"texturesparseresidency",
+	"triangle",
+	"variablerateshading",
+	"vertexattributes",
+	"viewportarray",
+	"vulkanscene"
+]
@@ -1,6 +1,9 @@
 /*
 * Vulkan Example - Compute shader cloth simulation
 *
+* With --asynccompute the simulation runs one step ahead on the compute queue, while the graphics queue renders the previous step from a snapshot of the cloth
+* Compute and graphics are synchronized with timeline semaphores
+*
 * Copyright (C) 2016-2017 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -20,6 +23,22 @@ public:
 	bool simulateWind = false;
 	bool specializedComputeQueue = false;
 
+	// Set if the async compute mode has been requested with --asynccompute and timeline semaphores are supported
+	bool asyncCompute = false;
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+	// Number of frames submitted in async compute mode, frame n renders the result of simulation step n
+	uint64_t frameIndex = 0;
+
+	// Timings of the compute queue, the graphics queue is timed by the base class profiler
+	vks::GpuProfiler computeProfiler;
+	struct {
+		// Moving average of the frame time (in ms)
+		double frameTime = 0.0;
+		// Share of the shorter workload (simulation or rendering) that is hidden behind the other one
+		double efficiency = 0.0;
+		bool valid = false;
+	} overlap;
+
 	vks::Texture2D textureCloth;
 	vkglTF::Model modelSphere;
 
@@ -34,6 +53,8 @@ public:
 		} pipelines;
 		vks::Buffer indices;
 		vks::Buffer uniformBuffer;
+		// Async compute: timeline semaphore, the value is the number of frames that have been rendered
+		VkSemaphore timeline{ 0L };
 		struct graphicsUBO {
 			glm::mat4 projection;
 			glm::mat4 view;
@@ -50,7 +71,11 @@ public:
 		struct Semaphores {
 			VkSemaphore ready{ 0L };
 			VkSemaphore complete{ 0L };
+			// Async compute: timeline semaphore, the value is the number of simulation steps that have finished
+			VkSemaphore timeline{ 0L };
 		} semaphores;
+		// Async compute: copies of the cloth written by alternating simulation steps, the graphics queue renders from the one that is not being written
+		std::array<vks::Buffer, 2> snapshots;
 		vks::Buffer uniformBuffer;
 		VkQueue queue;
 		VkCommandPool commandPool;
@@ -96,6 +121,12 @@ public:
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
 		camera.setRotation(glm::vec3(-30.0f, -45.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -5.0f));
+		commandLineParser.add("asynccompute", { "-ac", "--asynccompute" }, 0, "Overlap the simulation with rendering on the compute queue");
+		asyncCompute = commandLineParser.isSet("asynccompute");
+		// Timeline semaphores are only used for async compute, their extension requires VK_KHR_get_physical_device_properties2
+		if (asyncCompute) {
+			enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		}
 	}
 
 	~VulkanExample()
@@ -119,6 +150,18 @@ public:
 		vkDestroySemaphore(device, compute.semaphores.ready, nullptr);
 		vkDestroySemaphore(device, compute.semaphores.complete, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
+		computeProfiler.destroy();
+
+		// Async compute
+		if (asyncCompute) {
+			if (benchmark.active && overlap.valid) {
+				std::cout << "Overlap efficiency: " << overlap.efficiency * 100.0 << " %\n";
+			}
+			compute.snapshots[0].destroy();
+			compute.snapshots[1].destroy();
+			vkDestroySemaphore(device, graphics.timeline, nullptr);
+			vkDestroySemaphore(device, compute.semaphores.timeline, nullptr);
+		}
 	}
 
 	// Enable physical device features required for this example
@@ -129,6 +172,21 @@ public:
 		}
 	};
 
+	// Timeline semaphores are only required for the async compute mode
+	virtual void getEnabledExtensions()
+	{
+		if (asyncCompute && !vulkanDevice->extensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+			asyncCompute = false;
+			std::cout << "Timeline semaphores are not supported, compute and graphics are serialized\n";
+		}
+		if (asyncCompute) {
+			enabledDeviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+			timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+			deviceCreatepNextChain = &timelineSemaphoreFeatures;
+		}
+	}
+
 	void loadAssets()
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
@@ -136,7 +194,8 @@ public:
 		textureCloth.loadFromFile(getAssetPath() + "textures/vulkan_cloth_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
-	void addGraphicsToComputeBarriers(VkCommandBuffer commandBuffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+	// Buffers passed between the queue families every frame: the storage buffers in the serialized mode, the snapshot that is rendered in the async compute mode
+	void addGraphicsToComputeBarriers(VkCommandBuffer commandBuffer, const std::vector<VkBuffer>& buffers, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
 	{
 		if (specializedComputeQueue) {
 			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
@@ -147,10 +206,10 @@ public:
 			bufferBarrier.size = VK_WHOLE_SIZE;
 
 			std::vector<VkBufferMemoryBarrier> bufferBarriers;
-			bufferBarrier.buffer = compute.storageBuffers.input.buffer;
-			bufferBarriers.push_back(bufferBarrier);
-			bufferBarrier.buffer = compute.storageBuffers.output.buffer;
-			bufferBarriers.push_back(bufferBarrier);
+			for (VkBuffer buffer : buffers) {
+				bufferBarrier.buffer = buffer;
+				bufferBarriers.push_back(bufferBarrier);
+			}
 			vkCmdPipelineBarrier(commandBuffer,
 				srcStageMask,
 				dstStageMask,
@@ -184,7 +243,7 @@ public:
 			0, nullptr);
 	}
 
-	void addComputeToGraphicsBarriers(VkCommandBuffer commandBuffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+	void addComputeToGraphicsBarriers(VkCommandBuffer commandBuffer, const std::vector<VkBuffer>& buffers, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
 	{
 		if (specializedComputeQueue) {
 			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
@@ -194,10 +253,10 @@ public:
 			bufferBarrier.dstQueueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
 			bufferBarrier.size = VK_WHOLE_SIZE;
 			std::vector<VkBufferMemoryBarrier> bufferBarriers;
-			bufferBarrier.buffer = compute.storageBuffers.input.buffer;
-			bufferBarriers.push_back(bufferBarrier);
-			bufferBarrier.buffer = compute.storageBuffers.output.buffer;
-			bufferBarriers.push_back(bufferBarrier);
+			for (VkBuffer buffer : buffers) {
+				bufferBarrier.buffer = buffer;
+				bufferBarriers.push_back(bufferBarrier);
+			}
 			vkCmdPipelineBarrier(
 				commandBuffer,
 				srcStageMask,
@@ -209,7 +268,8 @@ public:
 		}
 	}
 
-	void buildCommandBuffers()
+	// Records the scene, vertexBuffer is the output storage buffer in the serialized mode and a snapshot in the async compute mode
+	void recordGraphicsCommandBuffer(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, const vks::Buffer& vertexBuffer)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -225,96 +285,169 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
+		// Set target frame buffer
+		renderPassBeginInfo.framebuffer = framebuffer;
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
+		const std::vector<VkBuffer> sharedBuffers = asyncCompute ? std::vector<VkBuffer>{ vertexBuffer.buffer } : std::vector<VkBuffer>{ compute.storageBuffers.input.buffer, compute.storageBuffers.output.buffer };
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
 
-			// Acquire storage buffers from compute queue
-			addComputeToGraphicsBarriers(drawCmdBuffers[i], 0, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+		// Acquire storage buffers from compute queue
+		addComputeToGraphicsBarriers(commandBuffer, sharedBuffers, 0, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
-			// Draw the particle system using the update vertex buffer
+		// Draw the particle system using the update vertex buffer
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		gpuProfiler.begin(commandBuffer, "Render");
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			VkDeviceSize offsets[1] = { 0 };
+		VkDeviceSize offsets[1] = { 0 };
 
-			// Render sphere
-			if (sceneSetup == 0) {
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.sphere);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
-				modelSphere.draw(drawCmdBuffers[i]);
-			}
+		// Render sphere
+		if (sceneSetup == 0) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.sphere);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
+			modelSphere.draw(commandBuffer);
+		}
 
-			// Render cloth
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.cloth);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], graphics.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &compute.storageBuffers.output.buffer, offsets);
-			vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
+		// Render cloth
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.cloth);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
+		vkCmdBindIndexBuffer(commandBuffer, graphics.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
+		vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
+		drawUI(commandBuffer);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		gpuProfiler.end(commandBuffer);
+		vkCmdEndRenderPass(commandBuffer);
 
-			// release the storage buffers to the compute queue
-			addGraphicsToComputeBarriers(drawCmdBuffers[i], VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		// release the storage buffers to the compute queue
+		addGraphicsToComputeBarriers(commandBuffer, sharedBuffers, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+		gpuProfiler.endFrame(commandBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
 
+	void buildCommandBuffers()
+	{
+		// In the async compute mode the command buffer is recorded every frame, as it renders from a different snapshot each frame
+		if (asyncCompute) {
+			return;
+		}
+		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		{
+			recordGraphicsCommandBuffer(drawCmdBuffers[i], frameBuffers[i], compute.storageBuffers.output);
+		}
 	}
 
 	// todo: check barriers (validation, separate compute queue)
-	void buildComputeCommandBuffer()
+	/*
+		Records a simulation step
+		In the serialized mode the graphics queue renders directly from the output storage buffer, the storage buffers are passed back and forth between the queue families
+		In the async compute mode the storage buffers stay with the compute queue and each step copies its result to a snapshot for the graphics queue
+	*/
+	void recordComputeCommandBuffer(VkCommandBuffer commandBuffer, const vks::Buffer* snapshot)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
 
-		for (uint32_t i = 0; i < 2; i++) {
+		const std::vector<VkBuffer> storageBuffers = { compute.storageBuffers.input.buffer, compute.storageBuffers.output.buffer };
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		computeProfiler.beginFrame(commandBuffer);
+		computeProfiler.begin(commandBuffer, "Simulation");
 
+		if (!snapshot) {
 			// Acquire the storage buffers from the graphics queue
-			addGraphicsToComputeBarriers(compute.commandBuffers[i], 0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			addGraphicsToComputeBarriers(commandBuffer, storageBuffers, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		} else {
+			// Steps are submitted back to back without a semaphore in between, so wait for the previous step's writes (and its copy reading the output buffer)
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_FLAGS_NONE,
+				1, &memoryBarrier,
+				0, nullptr,
+				0, nullptr);
+			// Acquire the snapshot released by the frame that rendered from it, only the copy at the end of the step has to wait for it
+			addGraphicsToComputeBarriers(commandBuffer, { snapshot->buffer }, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		}
 
-			vkCmdBindPipeline(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
 
-			uint32_t calculateNormals = 0;
-			vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
+		uint32_t calculateNormals = 0;
+		vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
 
-			// Dispatch the compute job
-			const uint32_t iterations = 64;
-			for (uint32_t j = 0; j < iterations; j++) {
-				readSet = 1 - readSet;
-				vkCmdBindDescriptorSets(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSets[readSet], 0, 0);
+		// Dispatch the compute job
+		const uint32_t iterations = 64;
+		for (uint32_t j = 0; j < iterations; j++) {
+			readSet = 1 - readSet;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSets[readSet], 0, 0);
 
-				if (j == iterations - 1) {
-					calculateNormals = 1;
-					vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
-				}
-
-				vkCmdDispatch(compute.commandBuffers[i], cloth.gridsize.x / 10, cloth.gridsize.y / 10, 1);
+			if (j == iterations - 1) {
+				calculateNormals = 1;
+				vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
+			}
 
-				// Don't add a barrier on the last iteration of the loop, since we'll have an explicit release to the graphics queue
-				if (j != iterations - 1) {
-					addComputeToComputeBarriers(compute.commandBuffers[i]);
-				}
+			vkCmdDispatch(commandBuffer, cloth.gridsize.x / 10, cloth.gridsize.y / 10, 1);
 
+			// Don't add a barrier on the last iteration of the loop, since we'll have an explicit release to the graphics queue
+			if (j != iterations - 1) {
+				addComputeToComputeBarriers(commandBuffer);
 			}
 
+		}
+
+		if (!snapshot) {
 			// release the storage buffers back to the graphics queue
-			addComputeToGraphicsBarriers(compute.commandBuffers[i], VK_ACCESS_SHADER_WRITE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
-			vkEndCommandBuffer(compute.commandBuffers[i]);
+			addComputeToGraphicsBarriers(commandBuffer, storageBuffers, VK_ACCESS_SHADER_WRITE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		} else {
+			// Copy the result of this step (the last iteration writes to the output buffer) to the snapshot
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = compute.storageBuffers.output.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_FLAGS_NONE,
+				0, nullptr,
+				1, &bufferBarrier,
+				0, nullptr);
+
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = compute.storageBuffers.output.size;
+			vkCmdCopyBuffer(commandBuffer, compute.storageBuffers.output.buffer, snapshot->buffer, 1, &copyRegion);
+
+			// Release the snapshot to the graphics queue (the timeline semaphore signal makes the copy visible if the queue families are the same)
+			addComputeToGraphicsBarriers(commandBuffer, { snapshot->buffer }, VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		}
+
+		computeProfiler.end(commandBuffer);
+		computeProfiler.endFrame(commandBuffer);
+		vkEndCommandBuffer(commandBuffer);
+	}
+
+	void buildComputeCommandBuffer()
+	{
+		// In the async compute mode each of the command buffers writes its own snapshot
+		for (uint32_t i = 0; i < 2; i++) {
+			recordComputeCommandBuffer(compute.commandBuffers[i], asyncCompute ? &compute.snapshots[i] : nullptr);
 		}
 	}
 
@@ -387,6 +520,17 @@ public:
 			&compute.storageBuffers.output,
 			storageBufferSize);
 
+		// Async compute: the graphics queue renders from snapshots of the output buffer, so the compute queue can work on the next step in the meantime
+		if (asyncCompute) {
+			for (auto& snapshot : compute.snapshots) {
+				vulkanDevice->createBuffer(
+					VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+					&snapshot,
+					storageBufferSize);
+			}
+		}
+
 		// Copy from staging buffer
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBufferCopy copyRegion = {};
@@ -395,7 +539,11 @@ public:
 		// Add an initial release barrier to the graphics queue,
 		// so that when the compute command buffer executes for the first time
 		// it doesn't complain about a lack of a corresponding "release" to its "acquire"
-		addGraphicsToComputeBarriers(copyCmd, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		addGraphicsToComputeBarriers(copyCmd, { compute.storageBuffers.input.buffer, compute.storageBuffers.output.buffer }, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		// The same goes for the snapshots, which are acquired by each simulation step before it writes to them
+		if (asyncCompute) {
+			addGraphicsToComputeBarriers(copyCmd, { compute.snapshots[0].buffer, compute.snapshots[1].buffer }, 0, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		}
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		stagingBuffer.destroy();
@@ -630,10 +778,38 @@ public:
 		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphores.ready));
 		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphores.complete));
 
+		// Timestamps may not be supported by a compute only queue family, the overlap efficiency isn't available then
+		computeProfiler.create(vulkanDevice, queue, vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.compute].timestampValidBits, false);
+
+		if (asyncCompute) {
+			compute.semaphores.timeline = createTimelineSemaphore();
+			graphics.timeline = createTimelineSemaphore();
+			// The storage buffers are only used by the compute queue from now on, so they're acquired once instead of in every step
+			if (specializedComputeQueue) {
+				VkCommandBuffer transferCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
+				addGraphicsToComputeBarriers(transferCmd, { compute.storageBuffers.input.buffer, compute.storageBuffers.output.buffer }, 0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+				vulkanDevice->flushCommandBuffer(transferCmd, compute.queue, compute.commandPool);
+			}
+		}
+
 		// Build a single command buffer containing the compute dispatch commands
 		buildComputeCommandBuffer();
 	}
 
+	// Timeline semaphores start at 0, so waits for a value of 0 (e.g. by the first two simulation steps) are satisfied right away
+	VkSemaphore createTimelineSemaphore()
+	{
+		VkSemaphoreTypeCreateInfoKHR semaphoreTypeCreateInfo{};
+		semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		semaphoreTypeCreateInfo.initialValue = 0;
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+		VkSemaphore semaphore;
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+		return semaphore;
+	}
+
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers()
 	{
@@ -744,6 +920,112 @@ public:
 		VulkanExampleBase::submitFrame();
 	}
 
+	// Async compute: submits a simulation step, which writes the snapshot with the index (step % 2)
+	void submitSimulationStep(uint64_t step)
+	{
+		// The snapshot was last rendered by frame (step - 2), only the copy at the end of the step has to wait for that
+		const uint64_t waitValue = (step > 2) ? step - 2 : 0;
+		const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineSubmitInfo.waitSemaphoreValueCount = 1;
+		timelineSubmitInfo.pWaitSemaphoreValues = &waitValue;
+		timelineSubmitInfo.signalSemaphoreValueCount = 1;
+		timelineSubmitInfo.pSignalSemaphoreValues = &step;
+
+		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+		computeSubmitInfo.pNext = &timelineSubmitInfo;
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &compute.commandBuffers[step % 2];
+		computeSubmitInfo.waitSemaphoreCount = 1;
+		computeSubmitInfo.pWaitSemaphores = &graphics.timeline;
+		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
+		computeSubmitInfo.signalSemaphoreCount = 1;
+		computeSubmitInfo.pSignalSemaphores = &compute.semaphores.timeline;
+		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+	}
+
+	// Async compute: frame n renders the result of step n, while step n + 1 runs on the compute queue
+	void drawAsync()
+	{
+		frameIndex++;
+		if (frameIndex == 1) {
+			submitSimulationStep(1);
+		}
+		// Step n + 1 writes the snapshot rendered by frame n - 1, so it doesn't depend on this frame
+		submitSimulationStep(frameIndex + 1);
+
+		VulkanExampleBase::prepareFrame();
+
+		VkCommandBuffer commandBuffer = frames[currentFrame].commandBuffer;
+		recordGraphicsCommandBuffer(commandBuffer, frameBuffers[currentBuffer], compute.snapshots[frameIndex % 2]);
+
+		// Values for binary semaphores are ignored
+		VkPipelineStageFlags waitStageMasks[] = { submitPipelineStages, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT };
+		VkSemaphore waitSemaphores[] = { semaphores.presentComplete, compute.semaphores.timeline };
+		uint64_t waitValues[] = { 0, frameIndex };
+		VkSemaphore signalSemaphores[] = { semaphores.renderComplete, graphics.timeline };
+		uint64_t signalValues[] = { 0, frameIndex };
+
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineSubmitInfo.waitSemaphoreValueCount = 2;
+		timelineSubmitInfo.pWaitSemaphoreValues = waitValues;
+		timelineSubmitInfo.signalSemaphoreValueCount = 2;
+		timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+
+		VkSubmitInfo graphicsSubmitInfo = vks::initializers::submitInfo();
+		graphicsSubmitInfo.pNext = &timelineSubmitInfo;
+		graphicsSubmitInfo.commandBufferCount = 1;
+		graphicsSubmitInfo.pCommandBuffers = &commandBuffer;
+		graphicsSubmitInfo.waitSemaphoreCount = 2;
+		graphicsSubmitInfo.pWaitSemaphores = waitSemaphores;
+		graphicsSubmitInfo.pWaitDstStageMask = waitStageMasks;
+		graphicsSubmitInfo.signalSemaphoreCount = 2;
+		graphicsSubmitInfo.pSignalSemaphores = signalSemaphores;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &graphicsSubmitInfo, VK_NULL_HANDLE));
+
+		VulkanExampleBase::submitFrame();
+	}
+
+	/*
+		Estimates how much of the simulation and the rendering run at the same time
+		Without any overlap a frame takes as long as both workloads together, with perfect overlap as long as the longer one
+		Only meaningful if the frame rate is limited by the GPU (v-sync disabled)
+	*/
+	void updateOverlap()
+	{
+		computeProfiler.resolve();
+		if (benchmark.active) {
+			for (auto& result : computeProfiler.results) {
+				benchmark.addPassTime("Compute queue/" + result.path, result.time);
+			}
+		}
+		computeProfiler.results.clear();
+
+		const double frameTime = frameTimer * 1000.0;
+		overlap.frameTime = (overlap.frameTime == 0.0) ? frameTime : overlap.frameTime * 0.95 + frameTime * 0.05;
+		const vks::GpuProfiler::Pass* simulation = findPass(computeProfiler, "Simulation");
+		const vks::GpuProfiler::Pass* rendering = findPass(gpuProfiler, "Render");
+		overlap.valid = simulation && rendering;
+		if (overlap.valid) {
+			const double shorter = std::min(simulation->averageTime, rendering->averageTime);
+			const double hidden = simulation->averageTime + rendering->averageTime - overlap.frameTime;
+			overlap.efficiency = (shorter > 0.0) ? std::min(std::max(hidden / shorter, 0.0), 1.0) : 0.0;
+		}
+	}
+
+	static const vks::GpuProfiler::Pass* findPass(const vks::GpuProfiler& profiler, const std::string& name)
+	{
+		for (auto& pass : profiler.passes) {
+			if (pass.path == name) {
+				return &pass;
+			}
+		}
+		return nullptr;
+	}
+
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
@@ -753,6 +1035,8 @@ public:
 #endif
 		// Check whether the compute queue family is distinct from the graphics queue family
 		specializedComputeQueue = vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute;
+		// The grid size can be raised with --simulationscale (the compute shader works on blocks of 10 x 10 particles)
+		cloth.gridsize = cloth.gridsize * settings.simulationScale;
 		loadAssets();
 		prepareStorageBuffers();
 		prepareUniformBuffers();
@@ -768,7 +1052,12 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
+		if (asyncCompute) {
+			drawAsync();
+		} else {
+			draw();
+		}
+		updateOverlap();
 
 		updateComputeUBO();
 	}
@@ -783,6 +1072,16 @@ public:
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Simulate wind", &simulateWind);
 		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Grid: %u x %u", cloth.gridsize.x, cloth.gridsize.y);
+			overlay->text("Mode: %s", asyncCompute ? "async compute" : "serialized");
+			if (!specializedComputeQueue) {
+				overlay->text("Compute shares the graphics queue");
+			}
+			if (overlap.valid) {
+				overlay->text("Overlap efficiency: %.1f %%", overlap.efficiency * 100.0);
+			}
+		}
 	}
 };
 
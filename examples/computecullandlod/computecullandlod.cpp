@@ -1,6 +1,12 @@
 /*
 * Vulkan Example - Compute shader culling and LOD using indirect rendering
 *
+* Instances are culled hierarchically on the GPU: clusters of neighbouring instances are tested first,
+* only the instances of visible clusters are tested individually (using an indirect dispatch).
+* Both stages test against the view frustum and a depth pyramid (Hi-Z) built from the previous frame's depth buffer.
+* Visible instances are compacted into one list per level-of-detail, which are drawn with one indirect draw per
+* level-of-detail. The number of draws is written by the GPU too (vkCmdDrawIndexedIndirectCount, if supported).
+*
 * Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -13,22 +19,32 @@
 
 #define ENABLE_VALIDATION false
 
-// Total number of objects (^3) in the scene
+// Number of objects per axis of the grid, the x axis is multiplied by the --simulationscale argument
 #if defined(__ANDROID__)
 #define OBJECT_COUNT 32
 #else
 #define OBJECT_COUNT 64
 #endif
 
+// Instances are culled in clusters of CLUSTER_DIM^3 neighbouring objects
+// The cluster size must match the workgroup size of the instance culling shader
+#define CLUSTER_DIM 4
+#define CLUSTER_SIZE (CLUSTER_DIM * CLUSTER_DIM * CLUSTER_DIM)
+
 #define MAX_LOD_LEVEL 5
 
+// Enough levels for the largest possible depth buffer, descriptor sets for all of them are allocated up front
+#define MAX_DEPTH_PYRAMID_LEVELS 16
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool fixedFrustum = false;
+	bool occlusionCulling = true;
 
 	// The model contains multiple versions of a single object with different levels of detail
 	vkglTF::Model lodModel;
+	uint32_t lodLevelCount = 0;
 
 	// Per-instance data block
 	struct InstanceData {
@@ -36,26 +52,52 @@ public:
 		float scale;
 	};
 
+	// Bounding sphere of a cluster of instances
+	struct Cluster {
+		glm::vec4 sphere;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+		uint32_t _pad0;
+		uint32_t _pad1;
+	};
+
 	// Contains the instanced data
 	vks::Buffer instanceBuffer;
-	// Contains the indirect drawing commands
+	vks::Buffer clusterBuffer;
+	// Indices of the clusters that passed the cluster stage
+	vks::Buffer visibleClustersBuffer;
+	// Indices of the instances that passed the instance stage, one list per level-of-detail
+	vks::Buffer visibleInstancesBuffer;
+	// Contains the indirect drawing commands, one per level-of-detail with visible instances
 	vks::Buffer indirectCommandsBuffer;
-	vks::Buffer indirectDrawCountBuffer;
+	// Counters written by the culling stages, also contains the indirect dispatch of the instance stage and the draw count
+	vks::Buffer counterBuffer;
+	// Host visible copy of the counters
+	vks::Buffer counterReadbackBuffer;
 
-	// Indirect draw statistics (updated via compute)
+	// Indirect draw statistics (updated via compute), same layout as the counter buffer
 	struct {
+		VkDispatchIndirectCommand instanceDispatch;	// Indirect dispatch of the instance stage (x = number of visible clusters)
 		uint32_t drawCount;						// Total number of indirect draw counts to be issued
 		uint32_t lodCount[MAX_LOD_LEVEL + 1];	// Statistics for number of draws per LOD level (written by compute shader)
+		uint32_t clustersFrustumCulled;
+		uint32_t clustersOcclusionCulled;
+		uint32_t instancesFrustumCulled;
+		uint32_t instancesOcclusionCulled;
 	} indirectStats;
 
-	// Store the indirect draw commands containing index offsets and instance count per object
-	std::vector<VkDrawIndexedIndirectCommand> indirectCommands;
-
 	struct {
 		glm::mat4 projection;
 		glm::mat4 modelview;
 		glm::vec4 cameraPos;
 		glm::vec4 frustumPlanes[6];
+		// View projection of the frame the depth pyramid was built from
+		glm::mat4 prevViewProjection;
+		glm::vec2 depthPyramidSize;
+		float instanceRadius;
+		uint32_t occlusionCulling;
+		uint32_t clusterCount;
+		uint32_t instanceCount;
 	} uboScene;
 
 	struct {
@@ -73,21 +115,47 @@ public:
 	// Resources for the compute part of the example
 	struct {
 		vks::Buffer lodLevelsBuffers;				// Contains index start and counts for the different lod levels
-		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
-		VkCommandPool commandPool;					// Use a separate command pool (queue family may differ from the one used for graphics)
-		VkCommandBuffer commandBuffer;				// Command buffer storing the dispatch commands and barriers
-		VkFence fence;								// Synchronization fence to avoid rewriting compute CB if still in use
-		VkSemaphore semaphore;						// Used as a wait semaphore for graphics submission
 		VkDescriptorSetLayout descriptorSetLayout;	// Compute shader binding layout
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
-		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
-		VkPipeline pipeline;						// Compute pipeline for updating particle positions
+		VkPipelineLayout pipelineLayout;			// Layout of the compute pipelines
+		struct {
+			VkPipeline clusters;					// Culls clusters and writes the indirect dispatch for the instance stage
+			VkPipeline instances;					// Culls the instances of visible clusters and compacts them per level-of-detail
+			VkPipeline draws;						// Writes the indirect draws for all levels-of-detail with visible instances
+		} pipelines;
 	} compute;
 
+	// Hierarchical depth buffer used for occlusion culling
+	// Each level stores the farthest depth of the area covered by a texel, built after the scene has been rendered
+	struct {
+		bool supported = false;
+		// Set once the pyramid contains the depth of a previous frame
+		bool valid = false;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		std::vector<VkImageView> levelViews;
+		// View of the depth aspect of the depth stencil image, the source of the first level
+		VkImageView depthView = VK_NULL_HANDLE;
+		VkSampler sampler;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t levelCount = 0;
+		VkDescriptorSetLayout descriptorSetLayout;
+		std::array<VkDescriptorSet, MAX_DEPTH_PYRAMID_LEVELS> descriptorSets;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} depthPyramid;
+
+	// VK_KHR_draw_indirect_count lets the GPU decide the number of draws, otherwise all draw slots are issued (unused ones are empty)
+	bool drawIndirectCount = false;
+	PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR = nullptr;
+
 	// View frustum for culling invisible objects
 	vks::Frustum frustum;
 
 	uint32_t objectCount = 0;
+	uint32_t clusterCount = 0;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -97,24 +165,41 @@ public:
 		camera.setTranslation(glm::vec3(0.5f, 0.0f, 0.0f));
 		camera.movementSpeed = 5.0f;
 		memset(&indirectStats, 0, sizeof(indirectStats));
+		uboScene = {};
+		// The depth buffer is the source of the depth pyramid
+		depthStencilUsage |= VK_IMAGE_USAGE_SAMPLED_BIT;
 	}
 
 	~VulkanExample()
 	{
+		if (benchmark.active) {
+			double cullingTime;
+			if (getCullingTime(cullingTime)) {
+				std::cout << "Culling: " << cullingTime << " ms per million instances\n";
+			}
+		}
 		vkDestroyPipeline(device, pipelines.plants, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		instanceBuffer.destroy();
+		clusterBuffer.destroy();
+		visibleClustersBuffer.destroy();
+		visibleInstancesBuffer.destroy();
 		indirectCommandsBuffer.destroy();
+		counterBuffer.destroy();
+		counterReadbackBuffer.destroy();
 		uniformData.scene.destroy();
-		indirectDrawCountBuffer.destroy();
 		compute.lodLevelsBuffers.destroy();
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
-		vkDestroyPipeline(device, compute.pipeline, nullptr);
-		vkDestroyFence(device, compute.fence, nullptr);
-		vkDestroyCommandPool(device, compute.commandPool, nullptr);
-		vkDestroySemaphore(device, compute.semaphore, nullptr);
+		vkDestroyPipeline(device, compute.pipelines.clusters, nullptr);
+		vkDestroyPipeline(device, compute.pipelines.instances, nullptr);
+		vkDestroyPipeline(device, compute.pipelines.draws, nullptr);
+		destroyDepthPyramid();
+		vkDestroySampler(device, depthPyramid.sampler, nullptr);
+		vkDestroyPipeline(device, depthPyramid.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, depthPyramid.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, depthPyramid.descriptorSetLayout, nullptr);
 	}
 
 	virtual void getEnabledFeatures()
@@ -123,6 +208,171 @@ public:
 		if (deviceFeatures.multiDrawIndirect) {
 			enabledFeatures.multiDrawIndirect = VK_TRUE;
 		}
+		// The draw of each level-of-detail starts at that level's visible instance list
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		} else {
+			vks::tools::exitFatal("Selected GPU does not support indirect draws with a first instance!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+	}
+
+	virtual void getEnabledExtensions()
+	{
+		drawIndirectCount = vulkanDevice->extensionSupported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		if (drawIndirectCount) {
+			enabledDeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		}
+	}
+
+	virtual void getDepthFormat()
+	{
+		VulkanExampleBase::getDepthFormat();
+		// Occlusion culling needs to read the depth buffer in a compute shader
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, depthFormat, &formatProperties);
+		depthPyramid.supported = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+		if (!depthPyramid.supported) {
+			std::cout << "Depth format can't be sampled, occlusion culling is disabled\n";
+			depthStencilUsage &= ~VK_IMAGE_USAGE_SAMPLED_BIT;
+		}
+	}
+
+	// Records the culling stages, results are consumed by the draws of the same command buffer
+	void recordCulling(VkCommandBuffer commandBuffer)
+	{
+		gpuProfiler.begin(commandBuffer, "Culling");
+
+		// The previous frame must have finished reading the counters and draws before they are reset
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_FLAGS_NONE,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		// Clear the counters and draws the culling stages write to, the indirect dispatch of the instance stage starts at 0x1x1
+		vkCmdFillBuffer(commandBuffer, counterBuffer.buffer, 0, sizeof(uint32_t), 0);
+		vkCmdFillBuffer(commandBuffer, counterBuffer.buffer, sizeof(uint32_t), 2 * sizeof(uint32_t), 1);
+		vkCmdFillBuffer(commandBuffer, counterBuffer.buffer, sizeof(VkDispatchIndirectCommand), VK_WHOLE_SIZE, 0);
+		vkCmdFillBuffer(commandBuffer, indirectCommandsBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		// This barrier ensures that the fill commands are finished before the compute shaders can start writing to the buffers
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_FLAGS_NONE,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, nullptr);
+
+		// Cluster stage: one invocation per cluster, appends visible clusters and counts them in the indirect dispatch of the next stage
+		gpuProfiler.begin(commandBuffer, "Clusters");
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelines.clusters);
+		vkCmdDispatch(commandBuffer, (clusterCount + 63) / 64, 1, 1);
+		gpuProfiler.end(commandBuffer);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			VK_FLAGS_NONE,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		// Instance stage: one workgroup per visible cluster
+		// It also selects the level-of-detail and compacts the visible instances into the list of that level
+		gpuProfiler.begin(commandBuffer, "Instances");
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelines.instances);
+		vkCmdDispatchIndirect(commandBuffer, counterBuffer.buffer, 0);
+		gpuProfiler.end(commandBuffer);
+
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_FLAGS_NONE,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		// Draw stage: writes the draws of all levels with visible instances to the front of the draw buffer
+		gpuProfiler.begin(commandBuffer, "Draw compaction");
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelines.draws);
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+		gpuProfiler.end(commandBuffer);
+
+		// Draws (and the draw count) are consumed by the indirect draw, the visible instance lists by the vertex shader
+		// This also makes the depth attachment wait for the previous frame's depth pyramid build to finish reading it
+		memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_FLAGS_NONE,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		gpuProfiler.end(commandBuffer);
+	}
+
+	// Records the depth pyramid build from the depth buffer the scene has just been rendered to
+	void recordDepthPyramid(VkCommandBuffer commandBuffer)
+	{
+		gpuProfiler.begin(commandBuffer, "Depth pyramid");
+
+		VkImageSubresourceRange depthSubresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		if (vks::tools::formatHasStencil(depthFormat)) {
+			depthSubresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		vks::tools::insertImageMemoryBarrier(
+			commandBuffer,
+			depthStencil.image,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			depthSubresourceRange);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramid.pipeline);
+		int32_t sourceSize[2] = { static_cast<int32_t>(width), static_cast<int32_t>(height) };
+		for (uint32_t level = 0; level < depthPyramid.levelCount; level++) {
+			int32_t sizes[4] = { sourceSize[0], sourceSize[1], std::max(1, (sourceSize[0] + 1) / 2), std::max(1, (sourceSize[1] + 1) / 2) };
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramid.pipelineLayout, 0, 1, &depthPyramid.descriptorSets[level], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, depthPyramid.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), sizes);
+			vkCmdDispatch(commandBuffer, (sizes[2] + 7) / 8, (sizes[3] + 7) / 8, 1);
+			// Each level is read by the next one, the last one by the culling of the next frame
+			// This also keeps the next level (or the next frame's culling) from starting before this level has finished reading its source
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_FLAGS_NONE,
+				1, &memoryBarrier,
+				0, nullptr,
+				0, nullptr);
+			sourceSize[0] = sizes[2];
+			sourceSize[1] = sizes[3];
+		}
+
+		gpuProfiler.end(commandBuffer);
 	}
 
 	void buildCommandBuffers()
@@ -147,34 +397,15 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			// Acquire barrier
-			if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
-			{
-				VkBufferMemoryBarrier buffer_barrier =
-				{
-					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-					nullptr,
-					0,
-					VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-					vulkanDevice->queueFamilyIndices.compute,
-					vulkanDevice->queueFamilyIndices.graphics,
-					indirectCommandsBuffer.buffer,
-					0,
-					indirectCommandsBuffer.descriptor.range
-				};
-
-				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
-					0,
-					0, nullptr,
-					1, &buffer_barrier,
-					0, nullptr);
-			}
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
+
+			// Culling is recorded into the same command buffer as the draws, as it depends on the depth pyramid built at the end of the previous frame
+			recordCulling(drawCmdBuffers[i]);
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
+			gpuProfiler.begin(drawCmdBuffers[i], "Scene");
+
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 
@@ -187,53 +418,54 @@ public:
 			// Mesh containing the LODs
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.plants);
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &lodModel.vertices.buffer, offsets);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 1, 1, &instanceBuffer.buffer, offsets);
 
 			vkCmdBindIndexBuffer(drawCmdBuffers[i], lodModel.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 
-			if (vulkanDevice->features.multiDrawIndirect)
+			if (drawIndirectCount)
+			{
+				// Only the draws written by the draw stage are issued
+				vkCmdDrawIndexedIndirectCountKHR(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, counterBuffer.buffer, offsetof(decltype(indirectStats), drawCount), lodLevelCount, sizeof(VkDrawIndexedIndirectCommand));
+			}
+			else if (vulkanDevice->features.multiDrawIndirect)
 			{
-				vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, static_cast<uint32_t>(indirectCommands.size()), sizeof(VkDrawIndexedIndirectCommand));
+				// Draw slots that haven't been written by the draw stage have been cleared and draw nothing
+				vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, lodLevelCount, sizeof(VkDrawIndexedIndirectCommand));
 			}
 			else
 			{
 				// If multi draw is not available, we must issue separate draw commands
-				for (auto j = 0; j < indirectCommands.size(); j++)
+				for (uint32_t j = 0; j < lodLevelCount; j++)
 				{
 					vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, j * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
 				}
 			}
 
+			gpuProfiler.end(drawCmdBuffers[i]);
+
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
-			// Release barrier
-			if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
-			{
-				VkBufferMemoryBarrier buffer_barrier =
-				{
-					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-					nullptr,
-					VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-					0,
-					vulkanDevice->queueFamilyIndices.graphics,
-					vulkanDevice->queueFamilyIndices.compute,
-					indirectCommandsBuffer.buffer,
-					0,
-					indirectCommandsBuffer.descriptor.range
-				};
-
-				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
-					VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-					0,
-					0, nullptr,
-					1, &buffer_barrier,
-					0, nullptr);
+			if (depthPyramid.supported) {
+				recordDepthPyramid(drawCmdBuffers[i]);
 			}
 
+			// Copy the counters for the statistics, they're read on the host after the frame has finished
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			bufferBarrier.buffer = counterBuffer.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+			VkBufferCopy copyRegion = { 0, 0, sizeof(indirectStats) };
+			vkCmdCopyBuffer(drawCmdBuffers[i], counterBuffer.buffer, counterReadbackBuffer.buffer, 1, &copyRegion);
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			bufferBarrier.buffer = counterReadbackBuffer.buffer;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+			gpuProfiler.endFrame(drawCmdBuffers[i]);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -242,105 +474,18 @@ public:
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
 		lodModel.loadFromFile(getAssetPath() + "models/suzanne_lods.gltf", vulkanDevice, queue, glTFLoadingFlags);
-	}
-
-	void buildComputeCommandBuffer()
-	{
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
-
-		// Acquire barrier
-		// Add memory barrier to ensure that the indirect commands have been consumed before the compute shader updates them
-		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				vulkanDevice->queueFamilyIndices.graphics,
-				vulkanDevice->queueFamilyIndices.compute,
-				indirectCommandsBuffer.buffer,
-				0,
-				indirectCommandsBuffer.descriptor.range
-			};
-
-			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
-		}
-
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-
-		// Clear the buffer that the compute shader pass will write statistics and draw calls to
-		vkCmdFillBuffer(compute.commandBuffer, indirectDrawCountBuffer.buffer, 0, indirectCommandsBuffer.descriptor.range, 0);
-
-		// This barrier ensures that the fill command is finished before the compute shader can start writing to the buffer
-		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
-		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		vkCmdPipelineBarrier(
-			compute.commandBuffer,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_FLAGS_NONE,
-			1, &memoryBarrier,
-			0, nullptr,
-			0, nullptr);
-
-		// Dispatch the compute job
-		// The compute shader will do the frustum culling and adjust the indirect draw calls depending on object visibility.
-		// It also determines the lod to use depending on distance to the viewer.
-		vkCmdDispatch(compute.commandBuffer, objectCount / 16, 1, 1);
-
-		// Release barrier
-		// Add memory barrier to ensure that the compute shader has finished writing the indirect command buffer before it's consumed
-		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				vulkanDevice->queueFamilyIndices.compute,
-				vulkanDevice->queueFamilyIndices.graphics,
-				indirectCommandsBuffer.buffer,
-				0,
-				indirectCommandsBuffer.descriptor.range
-			};
-
-			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
-		}
-
-		// todo: barrier for indirect stats buffer?
-
-		vkEndCommandBuffer(compute.commandBuffer);
+		lodLevelCount = std::min(static_cast<uint32_t>(lodModel.nodes.size()), static_cast<uint32_t>(MAX_LOD_LEVEL + 1));
 	}
 
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 9),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + MAX_DEPTH_PYRAMID_LEVELS),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_DEPTH_PYRAMID_LEVELS)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2 + MAX_DEPTH_PYRAMID_LEVELS);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -348,12 +493,16 @@ public:
 	{
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 			// Binding 0: Vertex shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT,0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+			// Binding 1: Instance data
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1),
+			// Binding 2: Visible instance lists
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 2),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
-		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);		 
+		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
@@ -365,24 +514,25 @@ public:
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			// Binding 0: Vertex shader uniform buffer
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformData.scene.descriptor),
+			// Binding 1: Instance data
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &instanceBuffer.descriptor),
+			// Binding 2: Visible instance lists
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &visibleInstancesBuffer.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
 
 	void preparePipelines()
 	{
-		// This example uses two different input states, one for the instanced part and one for non-instanced rendering
+		// Instance data is fetched by the vertex shader through the visible instance lists, so there is only a per-vertex binding
 		VkPipelineVertexInputStateCreateInfo inputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 
 		// Vertex input bindings
-		// The instancing pipeline uses a vertex input state with two bindings
 		bindingDescriptions = {
 		    // Binding point 0: Mesh vertex layout description at per-vertex rate
 		    vks::initializers::vertexInputBindingDescription(0, sizeof(vkglTF::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
-		    // Binding point 1: Instanced data at per-instance rate
-		    vks::initializers::vertexInputBindingDescription(1, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE)
 		};
 
 		// Vertex attribute bindings
@@ -392,10 +542,6 @@ public:
 		    vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, pos)),	// Location 0: Position
 		    vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, normal)),	// Location 1: Normal
 		    vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, color)),	// Location 2: Texture coordinates
-		    // Per-Instance attributes
-		    // These are fetched for each instance rendered
-		    vks::initializers::vertexInputAttributeDescription(1, 4, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceData, pos)),	// Location 4: Position
-		    vks::initializers::vertexInputAttributeDescription(1, 5, VK_FORMAT_R32_SFLOAT, offsetof(InstanceData, scale)),		// Location 5: Scale
 		};
 		inputState.pVertexBindingDescriptions = bindingDescriptions.data();
 		inputState.pVertexAttributeDescriptions = attributeDescriptions.data();
@@ -431,119 +577,116 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.plants));
 	}
 
-	void prepareBuffers()
+	// Creates a device local buffer and uploads the given data to it through a staging buffer
+	void createDeviceBuffer(vks::Buffer* buffer, VkBufferUsageFlags usageFlags, VkDeviceSize size, void* data)
 	{
-		objectCount = OBJECT_COUNT * OBJECT_COUNT * OBJECT_COUNT;
-
 		vks::Buffer stagingBuffer;
-
-		std::vector<InstanceData> instanceData(objectCount);
-		indirectCommands.resize(objectCount);
-
-		// Indirect draw commands
-		for (uint32_t x = 0; x < OBJECT_COUNT; x++)
-		{
-			for (uint32_t y = 0; y < OBJECT_COUNT; y++)
-			{
-				for (uint32_t z = 0; z < OBJECT_COUNT; z++)
-				{
-					uint32_t index = x + y * OBJECT_COUNT + z * OBJECT_COUNT * OBJECT_COUNT;
-					indirectCommands[index].instanceCount = 1;
-					indirectCommands[index].firstInstance = index;
-					// firstIndex and indexCount are written by the compute shader
-				}
-			}
-		}
-
-		indirectStats.drawCount = static_cast<uint32_t>(indirectCommands.size());
-
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&stagingBuffer,
-			indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand),
-			indirectCommands.data()));
+			size,
+			data));
 
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			usageFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&indirectCommandsBuffer,
-			stagingBuffer.size));
+			buffer,
+			size));
 
-		vulkanDevice->copyBuffer(&stagingBuffer, &indirectCommandsBuffer, queue);
+		vulkanDevice->copyBuffer(&stagingBuffer, buffer, queue);
 
 		stagingBuffer.destroy();
+	}
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&indirectDrawCountBuffer,
-			sizeof(indirectStats)));
+	void prepareBuffers()
+	{
+		// The grid is extended along the x axis to scale the number of instances
+		const VkPhysicalDeviceLimits& limits = vulkanDevice->properties.limits;
+		const uint32_t clustersPerScale = (OBJECT_COUNT / CLUSTER_DIM) * (OBJECT_COUNT / CLUSTER_DIM) * (OBJECT_COUNT / CLUSTER_DIM);
+		// The instance stage is dispatched with one workgroup per visible cluster
+		const uint32_t maxScale = std::max(limits.maxComputeWorkGroupCount[0] / clustersPerScale, 1u);
+		uint32_t scale = settings.simulationScale;
+		if (scale > maxScale) {
+			std::cout << "Instance count is limited by the maximum compute workgroup count, using a scale of " << maxScale << "\n";
+			scale = maxScale;
+		}
+		const glm::uvec3 gridSize(OBJECT_COUNT * scale, OBJECT_COUNT, OBJECT_COUNT);
+		const glm::uvec3 clusterGridSize = gridSize / glm::uvec3(CLUSTER_DIM);
+		objectCount = gridSize.x * gridSize.y * gridSize.z;
+		clusterCount = clusterGridSize.x * clusterGridSize.y * clusterGridSize.z;
 
-		// Map for host access
-		VK_CHECK_RESULT(indirectDrawCountBuffer.map());
+		// Bounding sphere around the model's origin, so it can be placed at the instance positions
+		const float instanceScale = 2.0f;
+		const float instanceRadius = glm::length(glm::max(glm::abs(lodModel.dimensions.min), glm::abs(lodModel.dimensions.max)));
 
-		// Instance data
-		for (uint32_t x = 0; x < OBJECT_COUNT; x++)
+		// Instance data, the instances of a cluster are stored next to each other
+		std::vector<InstanceData> instanceData(objectCount);
+		std::vector<Cluster> clusters(clusterCount);
+		for (uint32_t cz = 0; cz < clusterGridSize.z; cz++)
 		{
-			for (uint32_t y = 0; y < OBJECT_COUNT; y++)
+			for (uint32_t cy = 0; cy < clusterGridSize.y; cy++)
 			{
-				for (uint32_t z = 0; z < OBJECT_COUNT; z++)
+				for (uint32_t cx = 0; cx < clusterGridSize.x; cx++)
 				{
-					uint32_t index = x + y * OBJECT_COUNT + z * OBJECT_COUNT * OBJECT_COUNT;
-					instanceData[index].pos = glm::vec3((float)x, (float)y, (float)z) - glm::vec3((float)OBJECT_COUNT / 2.0f);
-					instanceData[index].scale = 2.0f;
+					const uint32_t clusterIndex = cx + cy * clusterGridSize.x + cz * clusterGridSize.x * clusterGridSize.y;
+					Cluster& cluster = clusters[clusterIndex];
+					cluster.firstInstance = clusterIndex * CLUSTER_SIZE;
+					cluster.instanceCount = CLUSTER_SIZE;
+					glm::vec3 boundsMin(FLT_MAX);
+					glm::vec3 boundsMax(-FLT_MAX);
+					for (uint32_t i = 0; i < CLUSTER_SIZE; i++)
+					{
+						const glm::uvec3 gridPos = glm::uvec3(cx, cy, cz) * glm::uvec3(CLUSTER_DIM) + glm::uvec3(i % CLUSTER_DIM, (i / CLUSTER_DIM) % CLUSTER_DIM, i / (CLUSTER_DIM * CLUSTER_DIM));
+						InstanceData& instance = instanceData[cluster.firstInstance + i];
+						instance.pos = glm::vec3(gridPos) - glm::vec3(gridSize) / 2.0f;
+						instance.scale = instanceScale;
+						boundsMin = glm::min(boundsMin, instance.pos);
+						boundsMax = glm::max(boundsMax, instance.pos);
+					}
+					cluster.sphere = glm::vec4((boundsMin + boundsMax) / 2.0f, glm::distance(boundsMin, boundsMax) / 2.0f + instanceRadius * instanceScale);
 				}
 			}
 		}
 
+		createDeviceBuffer(&instanceBuffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instanceData.size() * sizeof(InstanceData), instanceData.data());
+		createDeviceBuffer(&clusterBuffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, clusters.size() * sizeof(Cluster), clusters.data());
+
+		// Buffers written by the culling stages
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			instanceData.size() * sizeof(InstanceData),
-			instanceData.data()));
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&visibleClustersBuffer,
+			clusterCount * sizeof(uint32_t)));
 
+		// Each level-of-detail has a list that can hold all instances
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&instanceBuffer,
-			stagingBuffer.size));
-
-		// Copy from staging buffer to instance buffer
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = stagingBuffer.size;
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, instanceBuffer.buffer, 1, &copyRegion);
-		// Add an initial release barrier to the graphics queue,
-		// so that when the compute command buffer executes for the first time
-		// it doesn't complain about a lack of a corresponding "release" to its "acquire"
-		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
-		{			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-				0,
-				vulkanDevice->queueFamilyIndices.graphics,
-				vulkanDevice->queueFamilyIndices.compute,
-				indirectCommandsBuffer.buffer,
-				0,
-				indirectCommandsBuffer.descriptor.range
-			};
+			&visibleInstancesBuffer,
+			static_cast<VkDeviceSize>(lodLevelCount) * objectCount * sizeof(uint32_t)));
 
-			vkCmdPipelineBarrier(
-				copyCmd,
-				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
-				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
-		}
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&indirectCommandsBuffer,
+			lodLevelCount * sizeof(VkDrawIndexedIndirectCommand)));
 
-		stagingBuffer.destroy();
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&counterBuffer,
+			sizeof(indirectStats)));
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&counterReadbackBuffer,
+			sizeof(indirectStats)));
+
+		// Map for host access
+		VK_CHECK_RESULT(counterReadbackBuffer.map());
+		memset(counterReadbackBuffer.mapped, 0, sizeof(indirectStats));
 
 		// Shader storage buffer containing index offsets and counts for the LODs
 		struct LOD
@@ -554,33 +697,17 @@ public:
 			float _pad0;
 		};
 		std::vector<LOD> LODLevels;
-		uint32_t n = 0;
-		for (auto node : lodModel.nodes)
+		for (uint32_t n = 0; n < lodLevelCount; n++)
 		{
+			vkglTF::Node* node = lodModel.nodes[n];
 			LOD lod;
 			lod.firstIndex = node->mesh->primitives[0]->firstIndex;	// First index for this LOD
 			lod.indexCount = node->mesh->primitives[0]->indexCount;	// Index count for this LOD
 			lod.distance = 5.0f + n * 5.0f;							// Starting distance (to viewer) for this LOD
-			n++;
 			LODLevels.push_back(lod);
 		}
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			LODLevels.size() * sizeof(LOD),
-			LODLevels.data()));
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.lodLevelsBuffers,
-			stagingBuffer.size));
-
-		vulkanDevice->copyBuffer(&stagingBuffer, &compute.lodLevelsBuffers, queue);
-
-		stagingBuffer.destroy();
+		createDeviceBuffer(&compute.lodLevelsBuffers, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, LODLevels.size() * sizeof(LOD), LODLevels.data());
 
 		// Scene uniform buffer
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
@@ -591,106 +718,215 @@ public:
 
 		VK_CHECK_RESULT(uniformData.scene.map());
 
+		uboScene.instanceRadius = instanceRadius;
+		uboScene.clusterCount = clusterCount;
+		uboScene.instanceCount = objectCount;
+
 		updateUniformBuffer();
 	}
 
-	void prepareCompute()
+	// Creates the depth pyramid for the current size of the depth buffer
+	void createDepthPyramid()
+	{
+		// The first level has half the size of the depth buffer (rounded up), each following level halves that again down to 1x1
+		depthPyramid.width = std::max((width + 1) / 2, 1u);
+		depthPyramid.height = std::max((height + 1) / 2, 1u);
+		depthPyramid.levelCount = 1;
+		for (uint32_t w = depthPyramid.width, h = depthPyramid.height; (w > 1) || (h > 1); w = (w + 1) / 2, h = (h + 1) / 2) {
+			depthPyramid.levelCount++;
+		}
+		depthPyramid.levelCount = std::min(depthPyramid.levelCount, static_cast<uint32_t>(MAX_DEPTH_PYRAMID_LEVELS));
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = VK_FORMAT_R32_SFLOAT;
+		imageCI.extent = { depthPyramid.width, depthPyramid.height, 1 };
+		imageCI.mipLevels = depthPyramid.levelCount;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &depthPyramid.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, depthPyramid.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &depthPyramid.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, depthPyramid.image, depthPyramid.memory, 0));
+
+		// All levels are sampled by the culling stages, each level is written through its own view
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = VK_FORMAT_R32_SFLOAT;
+		viewCI.image = depthPyramid.image;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, depthPyramid.levelCount, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &depthPyramid.view));
+		depthPyramid.levelViews.resize(depthPyramid.levelCount);
+		for (uint32_t level = 0; level < depthPyramid.levelCount; level++) {
+			viewCI.subresourceRange.baseMipLevel = level;
+			viewCI.subresourceRange.levelCount = 1;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &depthPyramid.levelViews[level]));
+		}
+
+		if (depthPyramid.supported) {
+			// The view of the depth stencil image created by the base class may include the stencil aspect, which can't be sampled
+			viewCI.format = depthFormat;
+			viewCI.image = depthStencil.image;
+			viewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &depthPyramid.depthView));
+		}
+
+		// The pyramid stays in the general layout, as it's written and sampled by compute shaders only
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(layoutCmd, depthPyramid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, { VK_IMAGE_ASPECT_COLOR_BIT, 0, depthPyramid.levelCount, 0, 1 });
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+
+		uboScene.depthPyramidSize = glm::vec2(static_cast<float>(depthPyramid.width), static_cast<float>(depthPyramid.height));
+		depthPyramid.valid = false;
+	}
+
+	void destroyDepthPyramid()
 	{
-		// Get a compute capable device queue
-		vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.compute, 0, &compute.queue);
+		for (auto& view : depthPyramid.levelViews) {
+			vkDestroyImageView(device, view, nullptr);
+		}
+		depthPyramid.levelViews.clear();
+		vkDestroyImageView(device, depthPyramid.view, nullptr);
+		vkDestroyImageView(device, depthPyramid.depthView, nullptr);
+		vkDestroyImage(device, depthPyramid.image, nullptr);
+		vkFreeMemory(device, depthPyramid.memory, nullptr);
+		depthPyramid.depthView = VK_NULL_HANDLE;
+	}
 
+	void updateDepthPyramidDescriptors()
+	{
+		std::vector<VkDescriptorImageInfo> sourceDescriptors(depthPyramid.levelCount);
+		std::vector<VkDescriptorImageInfo> destinationDescriptors(depthPyramid.levelCount);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		// Levels are only built if the depth buffer can be sampled
+		const uint32_t builtLevels = depthPyramid.supported ? depthPyramid.levelCount : 0;
+		for (uint32_t level = 0; level < builtLevels; level++) {
+			if (level == 0) {
+				sourceDescriptors[level] = vks::initializers::descriptorImageInfo(depthPyramid.sampler, depthPyramid.depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+			} else {
+				sourceDescriptors[level] = vks::initializers::descriptorImageInfo(depthPyramid.sampler, depthPyramid.levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+			}
+			destinationDescriptors[level] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, depthPyramid.levelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+			// Binding 0: Source level (or depth buffer)
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(depthPyramid.descriptorSets[level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sourceDescriptors[level]));
+			// Binding 1: Destination level
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(depthPyramid.descriptorSets[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &destinationDescriptors[level]));
+		}
+		// Binding 8: All levels of the pyramid for the culling stages
+		VkDescriptorImageInfo pyramidDescriptor = vks::initializers::descriptorImageInfo(depthPyramid.sampler, depthPyramid.view, VK_IMAGE_LAYOUT_GENERAL);
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8, &pyramidDescriptor));
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void prepareDepthPyramid()
+	{
+		// Nearest filtering, the levels already store the farthest depth of each texel's area
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_NEAREST;
+		samplerCI.minFilter = VK_FILTER_NEAREST;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = static_cast<float>(MAX_DEPTH_PYRAMID_LEVELS);
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &depthPyramid.sampler));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Source level (or depth buffer)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Destination level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &depthPyramid.descriptorSetLayout));
+
+		// Source and destination size
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 4 * sizeof(int32_t), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&depthPyramid.descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &depthPyramid.pipelineLayout));
+
+		std::array<VkDescriptorSetLayout, MAX_DEPTH_PYRAMID_LEVELS> setLayouts;
+		setLayouts.fill(depthPyramid.descriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts.data(), MAX_DEPTH_PYRAMID_LEVELS);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, depthPyramid.descriptorSets.data()));
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(depthPyramid.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/depthpyramid.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &depthPyramid.pipeline));
+
+		createDepthPyramid();
+	}
+
+	void prepareCompute()
+	{
 		// Create compute pipeline
 		// Compute pipelines are created separate from graphics pipelines even if they use the same queue (family index)
 
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 			// Binding 0: Instance input data buffer
-			vks::initializers::descriptorSetLayoutBinding(
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				VK_SHADER_STAGE_COMPUTE_BIT,
-				0),
-			// Binding 1: Indirect draw command output buffer (input)
-			vks::initializers::descriptorSetLayoutBinding(
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				VK_SHADER_STAGE_COMPUTE_BIT,
-				1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Cluster bounding spheres (input)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
 			// Binding 2: Uniform buffer with global matrices (input)
-			vks::initializers::descriptorSetLayoutBinding(
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				VK_SHADER_STAGE_COMPUTE_BIT,
-				2),
-			// Binding 3: Indirect draw stats (output)
-			vks::initializers::descriptorSetLayoutBinding(
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				VK_SHADER_STAGE_COMPUTE_BIT,
-				3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3: Counters, indirect dispatch and draw count (output)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
 			// Binding 4: LOD info (input)
-			vks::initializers::descriptorSetLayoutBinding(
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				VK_SHADER_STAGE_COMPUTE_BIT,
-				4),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			// Binding 5: Visible clusters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+			// Binding 6: Visible instance lists (output)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6),
+			// Binding 7: Indirect draw command output buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 7),
+			// Binding 8: Depth pyramid (input)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 8),
 		};
 
-		VkDescriptorSetLayoutCreateInfo descriptorLayout =
-			vks::initializers::descriptorSetLayoutCreateInfo(
-				setLayoutBindings.data(),
-				static_cast<uint32_t>(setLayoutBindings.size()));
-
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &compute.descriptorSetLayout));
 
-		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
-			vks::initializers::pipelineLayoutCreateInfo(
-				&compute.descriptorSetLayout,
-				1);
-
+		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 
-		VkDescriptorSetAllocateInfo allocInfo =
-			vks::initializers::descriptorSetAllocateInfo(
-				descriptorPool,
-				&compute.descriptorSetLayout,
-				1);
-
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
 
 		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets =
 		{
 			// Binding 0: Instance input data buffer
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				0,
-				&instanceBuffer.descriptor),
-			// Binding 1: Indirect draw command output buffer
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				1,
-				&indirectCommandsBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &instanceBuffer.descriptor),
+			// Binding 1: Cluster bounding spheres
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &clusterBuffer.descriptor),
 			// Binding 2: Uniform buffer with global matrices
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				2,
-				&uniformData.scene.descriptor),
-			// Binding 3: Atomic counter (written in shader)
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				3,
-				&indirectDrawCountBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformData.scene.descriptor),
+			// Binding 3: Atomic counters (written in shader)
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &counterBuffer.descriptor),
 			// Binding 4: LOD info
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				4,
-				&compute.lodLevelsBuffers.descriptor)
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.lodLevelsBuffers.descriptor),
+			// Binding 5: Visible clusters
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &visibleClustersBuffer.descriptor),
+			// Binding 6: Visible instance lists
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &visibleInstancesBuffer.descriptor),
+			// Binding 7: Indirect draw command output buffer
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &indirectCommandsBuffer.descriptor),
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
 
-		// Create pipeline
-		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
-		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		// Binding 8 and the depth pyramid build are updated whenever the pyramid is recreated
+		updateDepthPyramidDescriptors();
 
 		// Use specialization constants to pass max. level of detail (determined by no. of meshes)
 		VkSpecializationMapEntry specializationEntry{};
@@ -698,7 +934,7 @@ public:
 		specializationEntry.offset = 0;
 		specializationEntry.size = sizeof(uint32_t);
 
-		uint32_t specializationData = static_cast<uint32_t>(lodModel.nodes.size()) - 1;
+		uint32_t specializationData = lodLevelCount - 1;
 
 		VkSpecializationInfo specializationInfo;
 		specializationInfo.mapEntryCount = 1;
@@ -706,39 +942,24 @@ public:
 		specializationInfo.dataSize = sizeof(specializationData);
 		specializationInfo.pData = &specializationData;
 
-		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
-
-		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
-
-		// Separate command pool as queue family for compute may be different than graphics
-		VkCommandPoolCreateInfo cmdPoolInfo = {};
-		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		cmdPoolInfo.queueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
-		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &compute.commandPool));
-
-		// Create a command buffer for compute operations
-		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-			vks::initializers::commandBufferAllocateInfo(
-				compute.commandPool,
-				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-				1);
-
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &compute.commandBuffer));
-
-		// Fence for compute CB sync
-		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &compute.fence));
+		// Create pipelines
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/cullclusters.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelines.clusters));
 
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/cullinstances.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelines.instances));
 
-		// Build a single command buffer containing the compute dispatch commands
-		buildComputeCommandBuffer();
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/builddraws.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelines.draws));
 	}
 
 	void updateUniformBuffer()
 	{
+		// The depth pyramid is built from the frame rendered with the current matrices, which the next frame tests against
+		uboScene.prevViewProjection = uboScene.projection * uboScene.modelview;
 		uboScene.projection = camera.matrices.perspective;
 		uboScene.modelview = camera.matrices.view;
 		if (!fixedFrustum)
@@ -747,6 +968,7 @@ public:
 			frustum.update(uboScene.projection * uboScene.modelview);
 			memcpy(uboScene.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
 		}
+		uboScene.occlusionCulling = (occlusionCulling && depthPyramid.valid) ? 1 : 0;
 		memcpy(uniformData.scene.mapped, &uboScene, sizeof(uboScene));
 	}
 
@@ -754,57 +976,32 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
-		// Submit compute shader for frustum culling
-
-		// Wait for fence to ensure that compute buffer writes have finished
-		vkWaitForFences(device, 1, &compute.fence, VK_TRUE, UINT64_MAX);
-		vkResetFences(device, 1, &compute.fence);
-
-		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
-		computeSubmitInfo.commandBufferCount = 1;
-		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
-		computeSubmitInfo.signalSemaphoreCount = 1;
-		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
-
-		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
-
-		// Submit graphics command buffer
-
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
-		// Wait on present and compute semaphores
-		std::array<VkPipelineStageFlags,2> stageFlags = {
-			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-		};
-		std::array<VkSemaphore,2> waitSemaphores = {
-			semaphores.presentComplete,						// Wait for presentation to finished
-			compute.semaphore								// Wait for compute to finish
-		};
-
-		submitInfo.pWaitSemaphores = waitSemaphores.data();
-		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
-		submitInfo.pWaitDstStageMask = stageFlags.data();
-
-		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, compute.fence));
+		// The next frame can test against this frame's depth (unless the window is resized in submitFrame)
+		depthPyramid.valid = depthPyramid.supported;
 
 		VulkanExampleBase::submitFrame();
 
-		// Get draw count from compute
-		memcpy(&indirectStats, indirectDrawCountBuffer.mapped, sizeof(indirectStats));
+		// Get draw count and culling statistics from compute
+		memcpy(&indirectStats, counterReadbackBuffer.mapped, sizeof(indirectStats));
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		if (drawIndirectCount) {
+			vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+		}
 		loadAssets();
 		prepareBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
+		prepareDepthPyramid();
 		prepareCompute();
 		buildCommandBuffers();
 		prepared = true;
@@ -820,16 +1017,56 @@ public:
 		updateUniformBuffer();
 	}
 
+	virtual void windowResized()
+	{
+		// The depth pyramid depends on the size of the depth buffer (and references it)
+		destroyDepthPyramid();
+		createDepthPyramid();
+		updateDepthPyramidDescriptors();
+		buildCommandBuffers();
+		updateUniformBuffer();
+	}
+
+	// Average GPU time of all culling stages per million instances
+	bool getCullingTime(double& time)
+	{
+		for (auto& pass : gpuProfiler.passes) {
+			if (pass.path == "Culling") {
+				time = pass.averageTime / (static_cast<double>(objectCount) / 1000000.0);
+				return true;
+			}
+		}
+		return false;
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Freeze frustum", &fixedFrustum);
+			if (depthPyramid.supported) {
+				overlay->checkBox("Occlusion culling", &occlusionCulling);
+			}
 		}
 		if (overlay->header("Statistics")) {
-			overlay->text("Visible objects: %d", indirectStats.drawCount);
-			for (uint32_t i = 0; i < MAX_LOD_LEVEL + 1; i++) {
+			const uint32_t visibleClusters = indirectStats.instanceDispatch.x;
+			uint32_t visibleInstances = 0;
+			for (uint32_t i = 0; i < lodLevelCount; i++) {
+				visibleInstances += indirectStats.lodCount[i];
+			}
+			overlay->text("Instances: %u (%u clusters)", objectCount, clusterCount);
+			overlay->text("Clusters visible: %u", visibleClusters);
+			overlay->text("Clusters culled: %u frustum, %u occlusion", indirectStats.clustersFrustumCulled, indirectStats.clustersOcclusionCulled);
+			overlay->text("Instances tested: %u", visibleClusters * CLUSTER_SIZE);
+			overlay->text("Instances culled: %u frustum, %u occlusion", indirectStats.instancesFrustumCulled, indirectStats.instancesOcclusionCulled);
+			overlay->text("Visible objects: %u", visibleInstances);
+			overlay->text("Indirect draws: %u", indirectStats.drawCount);
+			for (uint32_t i = 0; i < lodLevelCount; i++) {
 				overlay->text("LOD %d: %d", i, indirectStats.lodCount[i]);
 			}
+			double cullingTime;
+			if (getCullingTime(cullingTime)) {
+				overlay->text("Culling: %.3f ms per million instances", cullingTime);
+			}
 		}
 	}
 };
@@ -23,6 +23,12 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <array>
+#include <limits>
 
 #if defined(VK_USE_PLATFORM_MACOS_MVK)
 #define VK_ENABLE_BETA_EXTENSIONS
@@ -68,17 +74,23 @@ public:
 	VkPhysicalDevice physicalDevice;
 	VkDevice device;
 	uint32_t queueFamilyIndex;
-	VkPipelineCache pipelineCache;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
 	VkQueue queue;
 	VkCommandPool commandPool;
 	VkCommandBuffer commandBuffer;
-	VkFence fence;
-	VkDescriptorPool descriptorPool;
-	VkDescriptorSetLayout descriptorSetLayout;
+	VkFence fence = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
 	VkDescriptorSet descriptorSet;
-	VkPipelineLayout pipelineLayout;
-	VkPipeline pipeline;
-	VkShaderModule shaderModule;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
+
+	// Separate transfer queue used by the benchmark (same as the compute queue if the implementation has no other queue)
+	uint32_t transferQueueFamilyIndex;
+	VkQueue transferQueue;
+	// Buffers are shared between these queue families if they differ
+	std::vector<uint32_t> sharedQueueFamilies;
 
 	VkDebugReportCallbackEXT debugReportCallback{};
 
@@ -87,6 +99,11 @@ public:
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (sharedQueueFamilies.size() > 1) {
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+			bufferCreateInfo.pQueueFamilyIndices = sharedQueueFamilies.data();
+		}
 		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, buffer));
 
 		// Create the memory backing up the buffer handle
@@ -123,6 +140,463 @@ public:
 		return VK_SUCCESS;
 	}
 
+	/*
+		Compute throughput benchmark
+
+		Streams buffers of different sizes through a compute shader in chunks and measures the achieved bandwidth
+		Device local: Chunks are uploaded on the transfer queue, processed on the compute queue and read back on the transfer queue
+		Two chunks are in flight at the same time (double buffered staging), so transfers overlap with the dispatches of the previous chunk
+		Host visible: The compute shader works directly on host visible memory, the host fills the next chunk while the previous one is processed
+	*/
+
+	struct BenchmarkResult {
+		std::string memory;
+		VkDeviceSize size;
+		VkDeviceSize chunkSize;
+		double minTime;
+		double avgTime;
+		bool valid;
+	};
+
+	struct BenchmarkSlot {
+		VkBuffer uploadBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory uploadMemory = VK_NULL_HANDLE;
+		VkBuffer readbackBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory readbackMemory = VK_NULL_HANDLE;
+		uint32_t* uploadData = nullptr;
+		uint32_t* readbackData = nullptr;
+		VkCommandBuffer uploadCmd;
+		VkCommandBuffer computeCmd;
+		VkCommandBuffer readbackCmd;
+		VkSemaphore uploadComplete;
+		VkSemaphore computeComplete;
+		VkFence fence;
+		// Chunk that is currently processed using this slot (-1 if none)
+		int64_t chunk = -1;
+		uint32_t elementCount = 0;
+	};
+
+	struct Benchmark {
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSetLayout descriptorSetLayout;
+		// Dynamic offsets are 32 bit, so buffers larger than 4 GiB are bound with one descriptor set per window of the buffer
+		std::vector<VkDescriptorSet> descriptorSets;
+		VkDeviceSize windowSize;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+		VkShaderModule shaderModule;
+		VkCommandPool transferCommandPool;
+		std::array<BenchmarkSlot, 2> slots;
+		// Input of every chunk and the expected output of the shader for it
+		std::vector<uint32_t> input;
+		std::vector<uint32_t> expected;
+		bool valid;
+	} bench;
+
+	// Parses sizes like "64K", "16M" or "1G"
+	static VkDeviceSize parseSize(const std::string& value)
+	{
+		char* suffix = nullptr;
+		VkDeviceSize size = static_cast<VkDeviceSize>(strtoull(value.c_str(), &suffix, 10));
+		switch (suffix ? toupper(*suffix) : 0) {
+		case 'K': size *= 1024ull; break;
+		case 'M': size *= 1024ull * 1024ull; break;
+		case 'G': size *= 1024ull * 1024ull * 1024ull; break;
+		}
+		return size;
+	}
+
+	static std::string formatSize(VkDeviceSize size)
+	{
+		std::stringstream ss;
+		if (size >= 1024ull * 1024ull * 1024ull) {
+			ss << size / (1024ull * 1024ull * 1024ull) << "G";
+		} else if (size >= 1024ull * 1024ull) {
+			ss << size / (1024ull * 1024ull) << "M";
+		} else if (size >= 1024ull) {
+			ss << size / 1024ull << "K";
+		} else {
+			ss << size;
+		}
+		return ss.str();
+	}
+
+	// Windows are the largest multiple of the chunk size that can be addressed with a 32 bit dynamic offset
+	static VkDeviceSize getWindowSize(VkDeviceSize chunkSize)
+	{
+		return ((1ull << 32) / chunkSize) * chunkSize;
+	}
+
+	void recordDispatch(VkCommandBuffer cmdBuffer, VkDeviceSize offset, uint32_t elementCount)
+	{
+		// The descriptor set selects the window that contains the chunk, the dynamic offset selects the chunk within that window
+		const VkDeviceSize window = offset / bench.windowSize;
+		const uint32_t dynamicOffset = static_cast<uint32_t>(offset - window * bench.windowSize);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bench.pipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bench.pipelineLayout, 0, 1, &bench.descriptorSets[window], 1, &dynamicOffset);
+		vkCmdPushConstants(cmdBuffer, bench.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &elementCount);
+		vkCmdDispatch(cmdBuffer, (elementCount + 255) / 256, 1, 1);
+	}
+
+	void recordHostReadBarrier(VkCommandBuffer cmdBuffer, VkBuffer buffer, VkAccessFlags srcAccessMask, VkPipelineStageFlags srcStageMask)
+	{
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = srcAccessMask;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.buffer = buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vkCmdPipelineBarrier(cmdBuffer, srcStageMask, VK_PIPELINE_STAGE_HOST_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
+
+	void submit(VkQueue submitQueue, VkCommandBuffer cmdBuffer, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStageMask, VkSemaphore signalSemaphore, VkFence submitFence)
+	{
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &cmdBuffer;
+		if (waitSemaphore != VK_NULL_HANDLE) {
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStageMask;
+		}
+		if (signalSemaphore != VK_NULL_HANDLE) {
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &signalSemaphore;
+		}
+		VK_CHECK_RESULT(vkQueueSubmit(submitQueue, 1, &submitInfo, submitFence));
+	}
+
+	// Waits until the slot's chunk has been processed and compares the results against the expected output
+	void finishSlot(BenchmarkSlot& slot, const uint32_t* results)
+	{
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+		if (slot.chunk >= 0) {
+			bench.valid = bench.valid && (memcmp(results, bench.expected.data(), slot.elementCount * sizeof(uint32_t)) == 0);
+			slot.chunk = -1;
+		}
+	}
+
+	// Returns the time in ms it took to stream the whole buffer through the compute shader
+	double runDeviceLocal(VkBuffer deviceBuffer, VkDeviceSize size, VkDeviceSize chunkSize)
+	{
+		const uint64_t chunkCount = (size + chunkSize - 1) / chunkSize;
+		auto tStart = std::chrono::high_resolution_clock::now();
+		for (uint64_t chunk = 0; chunk <= chunkCount; chunk++) {
+			// Read back the previous chunk, its upload already overlaps with the dispatch of the current one
+			if (chunk > 0) {
+				BenchmarkSlot& previous = bench.slots[(chunk - 1) % 2];
+				const VkDeviceSize offset = (chunk - 1) * chunkSize;
+				const VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+				VK_CHECK_RESULT(vkBeginCommandBuffer(previous.readbackCmd, &cmdBufInfo));
+				VkBufferCopy copyRegion = { offset, 0, previous.elementCount * sizeof(uint32_t) };
+				vkCmdCopyBuffer(previous.readbackCmd, deviceBuffer, previous.readbackBuffer, 1, &copyRegion);
+				recordHostReadBarrier(previous.readbackCmd, previous.readbackBuffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+				VK_CHECK_RESULT(vkEndCommandBuffer(previous.readbackCmd));
+				VK_CHECK_RESULT(vkResetFences(device, 1, &previous.fence));
+				submit(transferQueue, previous.readbackCmd, previous.computeComplete, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_NULL_HANDLE, previous.fence);
+			}
+			if (chunk == chunkCount) {
+				break;
+			}
+			BenchmarkSlot& slot = bench.slots[chunk % 2];
+			finishSlot(slot, slot.readbackData);
+			const VkDeviceSize offset = chunk * chunkSize;
+			slot.chunk = static_cast<int64_t>(chunk);
+			slot.elementCount = static_cast<uint32_t>(std::min(chunkSize, size - offset) / sizeof(uint32_t));
+			memcpy(slot.uploadData, bench.input.data(), slot.elementCount * sizeof(uint32_t));
+
+			const VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			VK_CHECK_RESULT(vkBeginCommandBuffer(slot.uploadCmd, &cmdBufInfo));
+			VkBufferCopy copyRegion = { 0, offset, slot.elementCount * sizeof(uint32_t) };
+			vkCmdCopyBuffer(slot.uploadCmd, slot.uploadBuffer, deviceBuffer, 1, &copyRegion);
+			VK_CHECK_RESULT(vkEndCommandBuffer(slot.uploadCmd));
+			submit(transferQueue, slot.uploadCmd, VK_NULL_HANDLE, 0, slot.uploadComplete, VK_NULL_HANDLE);
+
+			// The semaphores make the transfer writes visible to the compute queue and vice versa, buffers are shared concurrently between the queue families
+			VK_CHECK_RESULT(vkBeginCommandBuffer(slot.computeCmd, &cmdBufInfo));
+			recordDispatch(slot.computeCmd, offset, slot.elementCount);
+			VK_CHECK_RESULT(vkEndCommandBuffer(slot.computeCmd));
+			submit(queue, slot.computeCmd, slot.uploadComplete, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, slot.computeComplete, VK_NULL_HANDLE);
+		}
+		for (auto& slot : bench.slots) {
+			finishSlot(slot, slot.readbackData);
+		}
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	double runHostVisible(uint32_t* mapped, VkBuffer hostBuffer, VkDeviceSize size, VkDeviceSize chunkSize)
+	{
+		const uint64_t chunkCount = (size + chunkSize - 1) / chunkSize;
+		const VkDeviceSize chunkElements = chunkSize / sizeof(uint32_t);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		for (uint64_t chunk = 0; chunk < chunkCount; chunk++) {
+			BenchmarkSlot& slot = bench.slots[chunk % 2];
+			finishSlot(slot, (slot.chunk >= 0) ? mapped + slot.chunk * chunkElements : nullptr);
+			const VkDeviceSize offset = chunk * chunkSize;
+			slot.chunk = static_cast<int64_t>(chunk);
+			slot.elementCount = static_cast<uint32_t>(std::min(chunkSize, size - offset) / sizeof(uint32_t));
+			memcpy(mapped + chunk * chunkElements, bench.input.data(), slot.elementCount * sizeof(uint32_t));
+
+			const VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			VK_CHECK_RESULT(vkBeginCommandBuffer(slot.computeCmd, &cmdBufInfo));
+			recordDispatch(slot.computeCmd, offset, slot.elementCount);
+			recordHostReadBarrier(slot.computeCmd, hostBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			VK_CHECK_RESULT(vkEndCommandBuffer(slot.computeCmd));
+			VK_CHECK_RESULT(vkResetFences(device, 1, &slot.fence));
+			submit(queue, slot.computeCmd, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, slot.fence);
+		}
+		for (auto& slot : bench.slots) {
+			finishSlot(slot, (slot.chunk >= 0) ? mapped + slot.chunk * chunkElements : nullptr);
+		}
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	void prepareBenchmark(VkDeviceSize chunkSize, VkDeviceSize maxBufferSize)
+	{
+		// Every chunk gets the same input, so results can be compared against a single precomputed chunk
+		const VkDeviceSize chunkElements = chunkSize / sizeof(uint32_t);
+		bench.input.resize(chunkElements);
+		bench.expected.resize(chunkElements);
+		for (uint32_t i = 0; i < chunkElements; i++) {
+			bench.input[i] = i;
+			bench.expected[i] = i * 1664525u + 1013904223u;
+		}
+
+		// The chunk processed by a dispatch is selected with a dynamic offset (and the descriptor set of the window containing it)
+		const uint32_t windowCount = static_cast<uint32_t>((maxBufferSize + getWindowSize(chunkSize) - 1) / getWindowSize(chunkSize));
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, windowCount),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), windowCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &bench.descriptorPool));
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &bench.descriptorSetLayout));
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&bench.descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &bench.pipelineLayout));
+		std::vector<VkDescriptorSetLayout> setLayouts(windowCount, bench.descriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(bench.descriptorPool, setLayouts.data(), windowCount);
+		bench.descriptorSets.resize(windowCount);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, bench.descriptorSets.data()));
+
+		std::string shaderDir = "glsl";
+		if (commandLineParser.isSet("shaders")) {
+			shaderDir = commandLineParser.getValueAsString("shaders", "glsl");
+		}
+		const std::string shadersPath = getShaderBasePath() + shaderDir + "/computeheadless/";
+		VkPipelineShaderStageCreateInfo shaderStage = {};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStage.module = vks::tools::loadShader((shadersPath + "throughput.comp.spv").c_str(), device);
+		shaderStage.pName = "main";
+		assert(shaderStage.module != VK_NULL_HANDLE);
+		bench.shaderModule = shaderStage.module;
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(bench.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = shaderStage;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &bench.pipeline));
+
+		VkCommandPoolCreateInfo cmdPoolInfo = {};
+		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		cmdPoolInfo.queueFamilyIndex = transferQueueFamilyIndex;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &bench.transferCommandPool));
+
+		for (auto& slot : bench.slots) {
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(bench.transferCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &slot.uploadCmd));
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &slot.readbackCmd));
+			cmdBufAllocateInfo.commandPool = commandPool;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &slot.computeCmd));
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &slot.uploadComplete));
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &slot.computeComplete));
+			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &slot.fence));
+		}
+	}
+
+	void destroyBenchmark()
+	{
+		for (auto& slot : bench.slots) {
+			vkDestroySemaphore(device, slot.uploadComplete, nullptr);
+			vkDestroySemaphore(device, slot.computeComplete, nullptr);
+			vkDestroyFence(device, slot.fence, nullptr);
+		}
+		vkDestroyCommandPool(device, bench.transferCommandPool, nullptr);
+		vkDestroyPipeline(device, bench.pipeline, nullptr);
+		vkDestroyShaderModule(device, bench.shaderModule, nullptr);
+		vkDestroyPipelineLayout(device, bench.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, bench.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device, bench.descriptorPool, nullptr);
+	}
+
+	void setBenchmarkBuffer(VkBuffer buffer, VkDeviceSize bufferSize, VkDeviceSize chunkSize)
+	{
+		// Window sizes are a multiple of the chunk size, so the base offset of each window stays aligned
+		bench.windowSize = getWindowSize(chunkSize);
+		const size_t windowCount = static_cast<size_t>((bufferSize + bench.windowSize - 1) / bench.windowSize);
+		assert(windowCount <= bench.descriptorSets.size());
+		std::vector<VkDescriptorBufferInfo> bufferDescriptors(windowCount);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets(windowCount);
+		for (size_t i = 0; i < windowCount; i++) {
+			bufferDescriptors[i] = { buffer, i * bench.windowSize, chunkSize };
+			writeDescriptorSets[i] = vks::initializers::writeDescriptorSet(bench.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 0, &bufferDescriptors[i]);
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void runBenchmark(const VkPhysicalDeviceProperties& deviceProperties)
+	{
+		std::vector<VkDeviceSize> sizes;
+		std::stringstream sizeList(commandLineParser.getValueAsString("sizes", "64K,1M,16M,256M"));
+		std::string sizeValue;
+		while (std::getline(sizeList, sizeValue, ',')) {
+			// Sizes are rounded up to whole elements
+			const VkDeviceSize size = (parseSize(sizeValue) + sizeof(uint32_t) - 1) / sizeof(uint32_t) * sizeof(uint32_t);
+			if (size > 0) {
+				sizes.push_back(size);
+			}
+		}
+		const uint32_t iterations = static_cast<uint32_t>(commandLineParser.getValueAsInt("iterations", 5));
+		const std::string memory = commandLineParser.getValueAsString("memory", "both");
+		const bool benchDeviceLocal = (memory == "both") || (memory == "devicelocal");
+		const bool benchHostVisible = (memory == "both") || (memory == "hostvisible");
+
+		// Chunks must be aligned for dynamic offsets and small enough to be processed by a single dispatch
+		const VkDeviceSize alignment = std::max<VkDeviceSize>(deviceProperties.limits.minStorageBufferOffsetAlignment, 256 * sizeof(uint32_t));
+		VkDeviceSize maxChunkSize = std::min<VkDeviceSize>(static_cast<VkDeviceSize>(deviceProperties.limits.maxComputeWorkGroupCount[0]) * 256 * sizeof(uint32_t), deviceProperties.limits.maxStorageBufferRange);
+		maxChunkSize = maxChunkSize / alignment * alignment;
+		VkDeviceSize chunkSize = parseSize(commandLineParser.getValueAsString("chunksize", "4M"));
+		chunkSize = std::min(std::max((chunkSize + alignment - 1) / alignment * alignment, alignment), maxChunkSize);
+
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		VkDeviceSize largestHeap = 0;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			largestHeap = std::max(largestHeap, memoryProperties.memoryHeaps[i].size);
+		}
+
+		LOG("Compute throughput benchmark: chunk size %s, %d iterations, transfer queue family %d (compute queue family %d)\n", formatSize(chunkSize).c_str(), iterations, transferQueueFamilyIndex, queueFamilyIndex);
+		// Buffers cover whole chunks
+		VkDeviceSize maxBufferSize = 0;
+		for (auto size : sizes) {
+			maxBufferSize = std::max(maxBufferSize, (size + chunkSize - 1) / chunkSize * chunkSize);
+		}
+		prepareBenchmark(chunkSize, maxBufferSize);
+
+		std::vector<BenchmarkResult> results;
+		for (auto size : sizes) {
+			const VkDeviceSize bufferChunkSize = std::min(chunkSize, (size + alignment - 1) / alignment * alignment);
+			// Buffers cover whole chunks, so the descriptor range of the last chunk stays inside the buffer
+			const VkDeviceSize bufferSize = (size + bufferChunkSize - 1) / bufferChunkSize * bufferChunkSize;
+			if (bufferSize > largestHeap / 2) {
+				LOG("Skipping %s, exceeds half of the largest memory heap\n", formatSize(size).c_str());
+				continue;
+			}
+			for (uint32_t variant = 0; variant < 2; variant++) {
+				const bool deviceLocal = (variant == 0);
+				if ((deviceLocal && !benchDeviceLocal) || (!deviceLocal && !benchHostVisible)) {
+					continue;
+				}
+				VkBuffer buffer;
+				VkDeviceMemory bufferMemory;
+				uint32_t* mapped = nullptr;
+				if (deviceLocal) {
+					createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, &bufferMemory, bufferSize);
+					for (auto& slot : bench.slots) {
+						createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &slot.uploadBuffer, &slot.uploadMemory, bufferChunkSize);
+						createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &slot.readbackBuffer, &slot.readbackMemory, bufferChunkSize);
+						VK_CHECK_RESULT(vkMapMemory(device, slot.uploadMemory, 0, VK_WHOLE_SIZE, 0, (void**)&slot.uploadData));
+						VK_CHECK_RESULT(vkMapMemory(device, slot.readbackMemory, 0, VK_WHOLE_SIZE, 0, (void**)&slot.readbackData));
+					}
+				} else {
+					createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, &bufferMemory, bufferSize);
+					VK_CHECK_RESULT(vkMapMemory(device, bufferMemory, 0, VK_WHOLE_SIZE, 0, (void**)&mapped));
+				}
+				setBenchmarkBuffer(buffer, bufferSize, bufferChunkSize);
+
+				BenchmarkResult result{};
+				result.memory = deviceLocal ? "devicelocal" : "hostvisible";
+				result.size = size;
+				result.chunkSize = bufferChunkSize;
+				result.minTime = std::numeric_limits<double>::max();
+				bench.valid = true;
+				// The first run is not measured, as it includes first touches of the memory
+				for (uint32_t i = 0; i <= iterations; i++) {
+					const double time = deviceLocal ? runDeviceLocal(buffer, size, bufferChunkSize) : runHostVisible(mapped, buffer, size, bufferChunkSize);
+					if (i > 0) {
+						result.minTime = std::min(result.minTime, time);
+						result.avgTime += time / iterations;
+					}
+				}
+				result.valid = bench.valid;
+				results.push_back(result);
+
+				// Bandwidth counts the data read and written by the shader (and transferred to and from the device for device local memory)
+				const double gigabytes = (2.0 * size) / (1024.0 * 1024.0 * 1024.0);
+				LOG("%-12s %6s: %10.3f ms (min %10.3f ms) %8.3f GB/s %12.0f elements/s%s\n", result.memory.c_str(), formatSize(size).c_str(), result.avgTime, result.minTime,
+					gigabytes / (result.minTime / 1000.0), (size / sizeof(uint32_t)) / (result.minTime / 1000.0), result.valid ? "" : " (INVALID RESULTS)");
+
+				if (deviceLocal) {
+					for (auto& slot : bench.slots) {
+						vkUnmapMemory(device, slot.uploadMemory);
+						vkUnmapMemory(device, slot.readbackMemory);
+						vkDestroyBuffer(device, slot.uploadBuffer, nullptr);
+						vkFreeMemory(device, slot.uploadMemory, nullptr);
+						vkDestroyBuffer(device, slot.readbackBuffer, nullptr);
+						vkFreeMemory(device, slot.readbackMemory, nullptr);
+					}
+				} else {
+					vkUnmapMemory(device, bufferMemory);
+				}
+				vkDestroyBuffer(device, buffer, nullptr);
+				vkFreeMemory(device, bufferMemory, nullptr);
+			}
+		}
+		destroyBenchmark();
+
+		if (commandLineParser.isSet("benchmarkjson")) {
+			const std::string fileName = commandLineParser.getValueAsString("benchmarkjson", "");
+			std::ofstream json(fileName, std::ios::out);
+			if (!json.is_open()) {
+				LOG("Could not write benchmark results to \"%s\"\n", fileName.c_str());
+				return;
+			}
+			json << std::fixed << std::setprecision(4);
+			json << "{\n";
+			json << "\t\"example\": \"computeheadless\",\n";
+			json << "\t\"device\": \"" << deviceProperties.deviceName << "\",\n";
+			json << "\t\"vendorid\": " << deviceProperties.vendorID << ",\n";
+			json << "\t\"deviceid\": " << deviceProperties.deviceID << ",\n";
+			json << "\t\"driverversion\": " << deviceProperties.driverVersion << ",\n";
+			json << "\t\"separatetransferqueue\": " << ((transferQueue != queue) ? "true" : "false") << ",\n";
+			json << "\t\"iterations\": " << iterations << ",\n";
+			json << "\t\"results\": [\n";
+			for (size_t i = 0; i < results.size(); i++) {
+				const BenchmarkResult& result = results[i];
+				const double seconds = result.minTime / 1000.0;
+				json << "\t\t{ ";
+				json << "\"memory\": \"" << result.memory << "\", ";
+				json << "\"size\": " << result.size << ", ";
+				json << "\"chunksize\": " << result.chunkSize << ", ";
+				json << "\"time\": { \"min\": " << result.minTime << ", \"avg\": " << result.avgTime << " }, ";
+				json << "\"bandwidth\": " << (2.0 * result.size) / (1024.0 * 1024.0 * 1024.0) / seconds << ", ";
+				json << "\"elementspersecond\": " << (result.size / sizeof(uint32_t)) / seconds << ", ";
+				json << "\"valid\": " << (result.valid ? "true" : "false");
+				json << " }" << ((i + 1 < results.size()) ? "," : "") << "\n";
+			}
+			json << "\t]\n";
+			json << "}\n";
+			LOG("Results written to %s\n", fileName.c_str());
+		}
+	}
+
 	VulkanExample()
 	{
 		LOG("Running headless compute example\n");
@@ -238,7 +712,7 @@ public:
 		LOG("GPU: %s\n", deviceProperties.deviceName);
 
 		// Request a single compute queue
-		const float defaultQueuePriority(0.0f);
+		const float queuePriorities[2] = { 0.0f, 0.0f };
 		VkDeviceQueueCreateInfo queueCreateInfo = {};
 		uint32_t queueFamilyCount;
 		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
@@ -250,15 +724,38 @@ public:
 				queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 				queueCreateInfo.queueFamilyIndex = i;
 				queueCreateInfo.queueCount = 1;
-				queueCreateInfo.pQueuePriorities = &defaultQueuePriority;
+				queueCreateInfo.pQueuePriorities = queuePriorities;
 				break;
 			}
 		}
+		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos = { queueCreateInfo };
+		// The benchmark uploads and reads back on a dedicated transfer queue if there is one, so transfers can overlap with compute work
+		const bool benchmark = commandLineParser.isSet("benchmark");
+		transferQueueFamilyIndex = queueFamilyIndex;
+		uint32_t transferQueueIndex = 0;
+		if (benchmark) {
+			for (uint32_t i = 0; i < static_cast<uint32_t>(queueFamilyProperties.size()); i++) {
+				if ((queueFamilyProperties[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilyProperties[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+					transferQueueFamilyIndex = i;
+					break;
+				}
+			}
+			if (transferQueueFamilyIndex != queueFamilyIndex) {
+				VkDeviceQueueCreateInfo transferQueueCreateInfo = queueCreateInfo;
+				transferQueueCreateInfo.queueFamilyIndex = transferQueueFamilyIndex;
+				queueCreateInfos.push_back(transferQueueCreateInfo);
+				sharedQueueFamilies = { queueFamilyIndex, transferQueueFamilyIndex };
+			} else if (queueFamilyProperties[queueFamilyIndex].queueCount > 1) {
+				// Otherwise use a second queue of the compute queue family
+				queueCreateInfos[0].queueCount = 2;
+				transferQueueIndex = 1;
+			}
+		}
 		// Create logical device
 		VkDeviceCreateInfo deviceCreateInfo = {};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		deviceCreateInfo.queueCreateInfoCount = 1;
-		deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+		deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 		std::vector<const char*> deviceExtensions = {};
 #if defined(VK_USE_PLATFORM_MACOS_MVK) && defined(VK_KHR_portability_subset)
 		// SRS - When running on macOS with MoltenVK and VK_KHR_portability_subset is defined and supported by the device, enable the extension
@@ -286,6 +783,7 @@ public:
 
 		// Get a compute queue
 		vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
+		vkGetDeviceQueue(device, transferQueueFamilyIndex, transferQueueIndex, &transferQueue);
 
 		// Compute command pool
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -294,6 +792,11 @@ public:
 		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
 
+		if (benchmark) {
+			runBenchmark(deviceProperties);
+			return;
+		}
+
 		/*
 			Prepare storage buffers
 		*/
@@ -608,6 +1111,12 @@ void android_main(android_app* state) {
 int main(int argc, char* argv[]) {
 	commandLineParser.add("help", { "--help" }, 0, "Show help");
 	commandLineParser.add("shaders", { "-s", "--shaders" }, 1, "Select shader type to use (glsl or hlsl)");
+	commandLineParser.add("benchmark", { "-b", "--benchmark" }, 0, "Run the compute throughput benchmark instead of the example");
+	commandLineParser.add("sizes", { "--sizes" }, 1, "Comma separated list of buffer sizes to benchmark (e.g. 64K,16M,1G)");
+	commandLineParser.add("chunksize", { "--chunksize" }, 1, "Size of the chunks that are uploaded, processed and read back (default 4M)");
+	commandLineParser.add("iterations", { "--iterations" }, 1, "Number of measured runs per buffer size (default 5)");
+	commandLineParser.add("memory", { "--memory" }, 1, "Benchmarked memory (devicelocal, hostvisible or both)");
+	commandLineParser.add("benchmarkjson", { "-bj", "--benchjson" }, 1, "Save benchmark results as JSON to the given file");
 	commandLineParser.parse(argc, argv);
 	if (commandLineParser.isSet("help")) {
 		commandLineParser.printHelp();
@@ -615,8 +1124,11 @@ int main(int argc, char* argv[]) {
 		return 0;
 	}
 	VulkanExample *vulkanExample = new VulkanExample();
-	std::cout << "Finished. Press enter to terminate...";
-	std::cin.get();
+	// Benchmark runs are usually automated, so don't wait for input
+	if (!commandLineParser.isSet("benchmark")) {
+		std::cout << "Finished. Press enter to terminate...";
+		std::cin.get();
+	}
 	delete(vulkanExample);
 	return 0;
 }
@@ -1,6 +1,9 @@
 /*
 * Vulkan Example - Compute shader N-body simulation using two passes and shared compute shader memory
 *
+* With --asynccompute the simulation runs one step ahead on the compute queue, while the graphics queue renders the previous step from a snapshot of the particles
+* Compute and graphics are synchronized with timeline semaphores
+*
 * Copyright (C) by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -22,6 +25,22 @@ class VulkanExample : public VulkanExampleBase
 public:
 	uint32_t numParticles;
 
+	// Set if the async compute mode has been requested with --asynccompute and timeline semaphores are supported
+	bool asyncCompute = false;
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+	// Number of frames submitted in async compute mode, frame n renders the result of simulation step n
+	uint64_t frameIndex = 0;
+
+	// Timings of the compute queue, the graphics queue is timed by the base class profiler
+	vks::GpuProfiler computeProfiler;
+	struct {
+		// Moving average of the frame time (in ms)
+		double frameTime = 0.0;
+		// Share of the shorter workload (simulation or rendering) that is hidden behind the other one
+		double efficiency = 0.0;
+		bool valid = false;
+	} overlap;
+
 	struct {
 		vks::Texture2D particle;
 		vks::Texture2D gradient;
@@ -42,6 +61,7 @@ public:
 		VkPipelineLayout pipelineLayout;			// Layout of the graphics pipeline
 		VkPipeline pipeline;						// Particle rendering pipeline
 		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
+		VkSemaphore timeline;						// Async compute: timeline semaphore, the value is the number of frames that have been rendered
 		struct {
 			glm::mat4 projection;
 			glm::mat4 view;
@@ -58,6 +78,9 @@ public:
 		VkCommandPool commandPool;					// Use a separate command pool (queue family may differ from the one used for graphics)
 		VkCommandBuffer commandBuffer;				// Command buffer storing the dispatch commands and barriers
 		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
+		std::array<vks::Buffer, 2> snapshots;		// Async compute: copies of the particles written by alternating simulation steps, the graphics queue renders from the one that is not being written
+		std::array<VkCommandBuffer, 2> asyncCommandBuffers;	// Async compute: simulation step that writes the snapshot with the same index
+		VkSemaphore timeline;						// Async compute: timeline semaphore, the value is the number of simulation steps that have finished
 		VkDescriptorSetLayout descriptorSetLayout;	// Compute shader binding layout
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
@@ -87,6 +110,12 @@ public:
 		camera.setRotation(glm::vec3(-26.0f, 75.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -14.0f));
 		camera.movementSpeed = 2.5f;
+		commandLineParser.add("asynccompute", { "-ac", "--asynccompute" }, 0, "Overlap the simulation with rendering on the compute queue");
+		asyncCompute = commandLineParser.isSet("asynccompute");
+		// Timeline semaphores are only used for async compute, their extension requires VK_KHR_get_physical_device_properties2
+		if (asyncCompute) {
+			enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		}
 	}
 
 	~VulkanExample()
@@ -107,18 +136,48 @@ public:
 		vkDestroyPipeline(device, compute.pipelineIntegrate, nullptr);
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
+		computeProfiler.destroy();
+
+		// Async compute
+		if (asyncCompute) {
+			if (benchmark.active && overlap.valid) {
+				std::cout << "Overlap efficiency: " << overlap.efficiency * 100.0 << " %\n";
+			}
+			compute.snapshots[0].destroy();
+			compute.snapshots[1].destroy();
+			vkDestroySemaphore(device, graphics.timeline, nullptr);
+			vkDestroySemaphore(device, compute.timeline, nullptr);
+		}
 
 		textures.particle.destroy();
 		textures.gradient.destroy();
 	}
 
+	// Timeline semaphores are only required for the async compute mode
+	virtual void getEnabledExtensions()
+	{
+		if (asyncCompute && !vulkanDevice->extensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+			asyncCompute = false;
+			std::cout << "Timeline semaphores are not supported, compute and graphics are serialized\n";
+		}
+		if (asyncCompute) {
+			enabledDeviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+			timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+			deviceCreatepNextChain = &timelineSemaphoreFeatures;
+		}
+	}
+
 	void loadAssets()
 	{
+		vulkanDevice->stagingRing.beginBatch();
 		textures.particle.loadFromFile(getAssetPath() + "textures/particle01_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 		textures.gradient.loadFromFile(getAssetPath() + "textures/particle_gradient_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+		vulkanDevice->stagingRing.endBatch();
 	}
 
-	void buildCommandBuffers()
+	// Records the particle rendering, particleBuffer is the storage buffer in the serialized mode and a snapshot in the async compute mode
+	void recordGraphicsCommandBuffer(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, const vks::Buffer& particleBuffer)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -134,14 +193,121 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
+		// Set target frame buffer
+		renderPassBeginInfo.framebuffer = framebuffer;
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
+
+		// Acquire barrier
+		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		{
+			VkBufferMemoryBarrier buffer_barrier =
+			{
+				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				nullptr,
+				0,
+				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+				compute.queueFamilyIndex,
+				graphics.queueFamilyIndex,
+				particleBuffer.buffer,
+				0,
+				particleBuffer.size
+			};
+
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				0,
+				0, nullptr,
+				1, &buffer_barrier,
+				0, nullptr);
+		}
+
+		// Draw the particle system using the update vertex buffer
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		gpuProfiler.begin(commandBuffer, "Render");
+
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, nullptr);
+
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &particleBuffer.buffer, offsets);
+		vkCmdDraw(commandBuffer, numParticles, 1, 0, 0);
+
+		drawUI(commandBuffer);
+
+		gpuProfiler.end(commandBuffer);
+		vkCmdEndRenderPass(commandBuffer);
+
+		// Release barrier
+		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		{
+			VkBufferMemoryBarrier buffer_barrier =
+			{
+				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				nullptr,
+				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+				0,
+				graphics.queueFamilyIndex,
+				compute.queueFamilyIndex,
+				particleBuffer.buffer,
+				0,
+				particleBuffer.size
+			};
+
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0,
+				0, nullptr,
+				1, &buffer_barrier,
+				0, nullptr);
+		}
+
+		gpuProfiler.endFrame(commandBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
 
+	void buildCommandBuffers()
+	{
+		// In the async compute mode the command buffer is recorded every frame, as it renders from a different snapshot each frame
+		if (asyncCompute) {
+			return;
+		}
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
+			recordGraphicsCommandBuffer(drawCmdBuffers[i], frameBuffers[i], compute.storageBuffer);
+		}
+	}
+
+	/*
+		Records a simulation step
+		In the serialized mode the graphics queue renders directly from the storage buffer, which is passed back and forth between the queue families
+		In the async compute mode the storage buffer stays with the compute queue and each step copies its result to a snapshot for the graphics queue
+	*/
+	void recordComputeCommandBuffer(VkCommandBuffer commandBuffer, const vks::Buffer* snapshot)
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		// Async compute: the step for a snapshot may be submitted again before its previous execution has finished on the GPU (it waits on the GPU)
+		if (snapshot) {
+			cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+		}
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		computeProfiler.beginFrame(commandBuffer);
+		computeProfiler.begin(commandBuffer, "Simulation");
 
+		if (!snapshot)
+		{
 			// Acquire barrier
 			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
 			{
@@ -150,112 +316,71 @@ public:
 					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
 					nullptr,
 					0,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-					compute.queueFamilyIndex,
+					VK_ACCESS_SHADER_WRITE_BIT,
 					graphics.queueFamilyIndex,
+					compute.queueFamilyIndex,
 					compute.storageBuffer.buffer,
 					0,
 					compute.storageBuffer.size
 				};
 
 				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
+					commandBuffer,
 					VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 					0,
 					0, nullptr,
 					1, &buffer_barrier,
 					0, nullptr);
 			}
+		}
+		else
+		{
+			// Steps are submitted back to back without a semaphore in between, so wait for the previous step's writes (and its copy reading the storage buffer)
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0,
+				1, &memoryBarrier,
+				0, nullptr,
+				0, nullptr);
 
-			// Draw the particle system using the update vertex buffer
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, nullptr);
-
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &compute.storageBuffer.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], numParticles, 1, 0, 0);
-
-			drawUI(drawCmdBuffers[i]);
-
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-			// Release barrier
+			// Acquire the snapshot released by the frame that rendered from it, only the copy at the end of the step has to wait for it
 			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
 			{
 				VkBufferMemoryBarrier buffer_barrier =
 				{
 					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
 					nullptr,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
 					0,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
 					graphics.queueFamilyIndex,
 					compute.queueFamilyIndex,
-					compute.storageBuffer.buffer,
+					snapshot->buffer,
 					0,
-					compute.storageBuffer.size
+					snapshot->size
 				};
 
 				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-					VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+					commandBuffer,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
 					0,
 					0, nullptr,
 					1, &buffer_barrier,
 					0, nullptr);
 			}
-
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
-
-	}
-
-	void buildComputeCommandBuffer()
-	{
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
-
-		// Acquire barrier
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-
-			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
 		}
 
 		// First pass: Calculate particle movement
 		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
+		vkCmdDispatch(commandBuffer, numParticles / 256, 1, 1);
 
 		// Add memory barrier to ensure that the computer shader has finished writing to the buffer
 		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
@@ -268,7 +393,7 @@ public:
 		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
 		vkCmdPipelineBarrier(
-			compute.commandBuffer,
+			commandBuffer,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			VK_FLAGS_NONE,
@@ -278,36 +403,94 @@ public:
 
 		// Second pass: Integrate particles
 		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
+		vkCmdDispatch(commandBuffer, numParticles / 256, 1, 1);
 
-		// Release barrier
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		if (!snapshot)
 		{
-			VkBufferMemoryBarrier buffer_barrier =
+			// Release barrier
+			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
 			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
+				VkBufferMemoryBarrier buffer_barrier =
+				{
+					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+					nullptr,
+					VK_ACCESS_SHADER_WRITE_BIT,
+					0,
+					compute.queueFamilyIndex,
+					graphics.queueFamilyIndex,
+					compute.storageBuffer.buffer,
+					0,
+					compute.storageBuffer.size
+				};
 
+				vkCmdPipelineBarrier(
+					commandBuffer,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+					0,
+					0, nullptr,
+					1, &buffer_barrier,
+					0, nullptr);
+			}
+		}
+		else
+		{
+			// Copy the result of this step to the snapshot
+			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 			vkCmdPipelineBarrier(
-				compute.commandBuffer,
+				commandBuffer,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-				0,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_FLAGS_NONE,
 				0, nullptr,
-				1, &buffer_barrier,
+				1, &bufferBarrier,
 				0, nullptr);
+
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = compute.storageBuffer.size;
+			vkCmdCopyBuffer(commandBuffer, compute.storageBuffer.buffer, snapshot->buffer, 1, &copyRegion);
+
+			// Release the snapshot to the graphics queue (the timeline semaphore signal makes the copy visible if the queue families are the same)
+			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+			{
+				VkBufferMemoryBarrier buffer_barrier =
+				{
+					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+					nullptr,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
+					0,
+					compute.queueFamilyIndex,
+					graphics.queueFamilyIndex,
+					snapshot->buffer,
+					0,
+					snapshot->size
+				};
+
+				vkCmdPipelineBarrier(
+					commandBuffer,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+					0,
+					0, nullptr,
+					1, &buffer_barrier,
+					0, nullptr);
+			}
 		}
 
-		vkEndCommandBuffer(compute.commandBuffer);
+		computeProfiler.end(commandBuffer);
+		computeProfiler.endFrame(commandBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	void buildComputeCommandBuffer()
+	{
+		if (asyncCompute) {
+			recordComputeCommandBuffer(compute.asyncCommandBuffers[0], &compute.snapshots[0]);
+			recordComputeCommandBuffer(compute.asyncCommandBuffers[1], &compute.snapshots[1]);
+		} else {
+			recordComputeCommandBuffer(compute.commandBuffer, nullptr);
+		}
 	}
 
 	// Setup and fill the compute shader storage buffers containing the particles
@@ -329,7 +512,9 @@ public:
 		};
 #endif
 
-		numParticles = static_cast<uint32_t>(attractors.size()) * PARTICLES_PER_ATTRACTOR;
+		// The particle count can be raised with --simulationscale, the cost of the simulation grows quadratically with it
+		const uint32_t particlesPerAttractor = PARTICLES_PER_ATTRACTOR * settings.simulationScale;
+		numParticles = static_cast<uint32_t>(attractors.size()) * particlesPerAttractor;
 
 		// Initial particle positions
 		std::vector<Particle> particleBuffer(numParticles);
@@ -339,9 +524,9 @@ public:
 
 		for (uint32_t i = 0; i < static_cast<uint32_t>(attractors.size()); i++)
 		{
-			for (uint32_t j = 0; j < PARTICLES_PER_ATTRACTOR; j++)
+			for (uint32_t j = 0; j < particlesPerAttractor; j++)
 			{
-				Particle &particle = particleBuffer[i * PARTICLES_PER_ATTRACTOR + j];
+				Particle &particle = particleBuffer[i * particlesPerAttractor + j];
 
 				// First particle in group as heavy center of gravity
 				if (j == 0)
@@ -393,6 +578,19 @@ public:
 			&compute.storageBuffer,
 			storageBufferSize);
 
+		// Async compute: the graphics queue renders from snapshots of the storage buffer, so the compute queue can work on the next step in the meantime
+		if (asyncCompute)
+		{
+			for (auto& snapshot : compute.snapshots)
+			{
+				vulkanDevice->createBuffer(
+					VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+					&snapshot,
+					storageBufferSize);
+			}
+		}
+
 		// Copy from staging buffer to storage buffer
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBufferCopy copyRegion = {};
@@ -422,6 +620,25 @@ public:
 				0, nullptr,
 				1, &buffer_barrier,
 				0, nullptr);
+
+			// The first two simulation steps acquire the snapshots from the graphics queue, just like the later ones that write a snapshot after it has been rendered
+			if (asyncCompute)
+			{
+				for (auto& snapshot : compute.snapshots)
+				{
+					buffer_barrier.srcAccessMask = 0;
+					buffer_barrier.buffer = snapshot.buffer;
+					buffer_barrier.size = snapshot.size;
+					vkCmdPipelineBarrier(
+						copyCmd,
+						VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+						VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+						0,
+						0, nullptr,
+						1, &buffer_barrier,
+						0, nullptr);
+				}
+			}
 		}
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
@@ -621,12 +838,30 @@ public:
 		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
 		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &graphics.semaphore));
 
-		// Signal the semaphore
-		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &graphics.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		if (asyncCompute) {
+			graphics.timeline = createTimelineSemaphore();
+		} else {
+			// Signal the semaphore
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &graphics.semaphore;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		}
+	}
+
+	// Timeline semaphores start at 0, so waits for a value of 0 (e.g. by the first two simulation steps) are satisfied right away
+	VkSemaphore createTimelineSemaphore()
+	{
+		VkSemaphoreTypeCreateInfoKHR semaphoreTypeCreateInfo{};
+		semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		semaphoreTypeCreateInfo.initialValue = 0;
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+		VkSemaphore semaphore;
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+		return semaphore;
 	}
 
 	void prepareCompute()
@@ -743,6 +978,44 @@ public:
 		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
 		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
 
+		// Timestamps may not be supported by a compute only queue family, the overlap efficiency isn't available then
+		computeProfiler.create(vulkanDevice, queue, vulkanDevice->queueFamilyProperties[compute.queueFamilyIndex].timestampValidBits, false);
+
+		if (asyncCompute)
+		{
+			// One command buffer per snapshot
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(compute.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 2);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, compute.asyncCommandBuffers.data()));
+			compute.timeline = createTimelineSemaphore();
+
+			// The storage buffer is only used by the compute queue from now on, so it's acquired once instead of in every step
+			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+			{
+				VkCommandBuffer transferCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
+				VkBufferMemoryBarrier acquire_buffer_barrier =
+				{
+					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+					nullptr,
+					0,
+					VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+					graphics.queueFamilyIndex,
+					compute.queueFamilyIndex,
+					compute.storageBuffer.buffer,
+					0,
+					compute.storageBuffer.size
+				};
+				vkCmdPipelineBarrier(
+					transferCmd,
+					VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					0,
+					0, nullptr,
+					1, &acquire_buffer_barrier,
+					0, nullptr);
+				vulkanDevice->flushCommandBuffer(transferCmd, compute.queue, compute.commandPool);
+			}
+		}
+
 		// Build a single command buffer containing the compute dispatch commands
 		buildComputeCommandBuffer();
 
@@ -877,6 +1150,112 @@ public:
 		VulkanExampleBase::submitFrame();
 	}
 
+	// Async compute: submits a simulation step, which writes the snapshot with the index (step % 2)
+	void submitSimulationStep(uint64_t step)
+	{
+		// The snapshot was last rendered by frame (step - 2), only the copy at the end of the step has to wait for that
+		const uint64_t waitValue = (step > 2) ? step - 2 : 0;
+		const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineSubmitInfo.waitSemaphoreValueCount = 1;
+		timelineSubmitInfo.pWaitSemaphoreValues = &waitValue;
+		timelineSubmitInfo.signalSemaphoreValueCount = 1;
+		timelineSubmitInfo.pSignalSemaphoreValues = &step;
+
+		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+		computeSubmitInfo.pNext = &timelineSubmitInfo;
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &compute.asyncCommandBuffers[step % 2];
+		computeSubmitInfo.waitSemaphoreCount = 1;
+		computeSubmitInfo.pWaitSemaphores = &graphics.timeline;
+		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
+		computeSubmitInfo.signalSemaphoreCount = 1;
+		computeSubmitInfo.pSignalSemaphores = &compute.timeline;
+		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+	}
+
+	// Async compute: frame n renders the result of step n, while step n + 1 runs on the compute queue
+	void drawAsync()
+	{
+		frameIndex++;
+		if (frameIndex == 1) {
+			submitSimulationStep(1);
+		}
+		// Step n + 1 writes the snapshot rendered by frame n - 1, so it doesn't depend on this frame
+		submitSimulationStep(frameIndex + 1);
+
+		VulkanExampleBase::prepareFrame();
+
+		VkCommandBuffer commandBuffer = frames[currentFrame].commandBuffer;
+		recordGraphicsCommandBuffer(commandBuffer, frameBuffers[currentBuffer], compute.snapshots[frameIndex % 2]);
+
+		// Values for binary semaphores are ignored
+		VkPipelineStageFlags waitStageMasks[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT };
+		VkSemaphore waitSemaphores[] = { semaphores.presentComplete, compute.timeline };
+		uint64_t waitValues[] = { 0, frameIndex };
+		VkSemaphore signalSemaphores[] = { semaphores.renderComplete, graphics.timeline };
+		uint64_t signalValues[] = { 0, frameIndex };
+
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineSubmitInfo.waitSemaphoreValueCount = 2;
+		timelineSubmitInfo.pWaitSemaphoreValues = waitValues;
+		timelineSubmitInfo.signalSemaphoreValueCount = 2;
+		timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+
+		VkSubmitInfo graphicsSubmitInfo = vks::initializers::submitInfo();
+		graphicsSubmitInfo.pNext = &timelineSubmitInfo;
+		graphicsSubmitInfo.commandBufferCount = 1;
+		graphicsSubmitInfo.pCommandBuffers = &commandBuffer;
+		graphicsSubmitInfo.waitSemaphoreCount = 2;
+		graphicsSubmitInfo.pWaitSemaphores = waitSemaphores;
+		graphicsSubmitInfo.pWaitDstStageMask = waitStageMasks;
+		graphicsSubmitInfo.signalSemaphoreCount = 2;
+		graphicsSubmitInfo.pSignalSemaphores = signalSemaphores;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &graphicsSubmitInfo, VK_NULL_HANDLE));
+
+		VulkanExampleBase::submitFrame();
+	}
+
+	/*
+		Estimates how much of the simulation and the rendering run at the same time
+		Without any overlap a frame takes as long as both workloads together, with perfect overlap as long as the longer one
+		Only meaningful if the frame rate is limited by the GPU (v-sync disabled)
+	*/
+	void updateOverlap()
+	{
+		computeProfiler.resolve();
+		if (benchmark.active) {
+			for (auto& result : computeProfiler.results) {
+				benchmark.addPassTime("Compute queue/" + result.path, result.time);
+			}
+		}
+		computeProfiler.results.clear();
+
+		const double frameTime = frameTimer * 1000.0;
+		overlap.frameTime = (overlap.frameTime == 0.0) ? frameTime : overlap.frameTime * 0.95 + frameTime * 0.05;
+		const vks::GpuProfiler::Pass* simulation = findPass(computeProfiler, "Simulation");
+		const vks::GpuProfiler::Pass* rendering = findPass(gpuProfiler, "Render");
+		overlap.valid = simulation && rendering;
+		if (overlap.valid) {
+			const double shorter = std::min(simulation->averageTime, rendering->averageTime);
+			const double hidden = simulation->averageTime + rendering->averageTime - overlap.frameTime;
+			overlap.efficiency = (shorter > 0.0) ? std::min(std::max(hidden / shorter, 0.0), 1.0) : 0.0;
+		}
+	}
+
+	static const vks::GpuProfiler::Pass* findPass(const vks::GpuProfiler& profiler, const std::string& name)
+	{
+		for (auto& pass : profiler.passes) {
+			if (pass.path == name) {
+				return &pass;
+			}
+		}
+		return nullptr;
+	}
+
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
@@ -896,7 +1275,12 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
+		if (asyncCompute) {
+			drawAsync();
+		} else {
+			draw();
+		}
+		updateOverlap();
 		updateComputeUniformBuffers();
 		if (camera.updated) {
 			updateGraphicsUniformBuffers();
@@ -907,6 +1291,20 @@ public:
 	{
 		updateGraphicsUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Statistics")) {
+			overlay->text("Particles: %u", numParticles);
+			overlay->text("Mode: %s", asyncCompute ? "async compute" : "serialized");
+			if (graphics.queueFamilyIndex == compute.queueFamilyIndex) {
+				overlay->text("Compute shares the graphics queue");
+			}
+			if (overlap.valid) {
+				overlay->text("Overlap efficiency: %.1f %%", overlap.efficiency * 100.0);
+			}
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
@@ -103,8 +103,10 @@ public:
 
 	void loadAssets()
 	{
+		vulkanDevice->stagingRing.beginBatch();
 		textures.particle.loadFromFile(getAssetPath() + "textures/particle01_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 		textures.gradient.loadFromFile(getAssetPath() + "textures/particle_gradient_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+		vulkanDevice->stagingRing.endBatch();
 	}
 
 	void buildCommandBuffers()
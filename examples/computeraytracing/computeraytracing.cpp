@@ -1,22 +1,34 @@
 /*
 * Vulkan Example - Compute shader ray tracing
 *
+* Spheres are intersected through a bounding volume hierarchy that is built on the CPU and traversed in the compute shader
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <random>
+#include <chrono>
 #include "vulkanexamplebase.h"
+#include "bvh.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
 #if defined(__ANDROID__)
 #define TEX_DIM 1024
+// Number of generated spheres, multiplied by the --simulationscale argument
+#define SPHERE_COUNT 1024
 #else
 #define TEX_DIM 2048
+#define SPHERE_COUNT 4096
 #endif
 
+// Maximum number of closest hit rays traced per pixel (primary ray and reflections), must match 1 + RAYBOUNCES of the compute shader
+// After a miss the remaining reflection rays repeat the missed ray, so the number of distinct rays per pixel can be lower (shadow rays are not counted)
+#define MAX_RAYS_PER_PIXEL 3
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -36,6 +48,7 @@ public:
 		struct {
 			vks::Buffer spheres;						// (Shader) storage buffer object with scene spheres
 			vks::Buffer planes;						// (Shader) storage buffer object with scene planes
+			vks::Buffer nodes;						// (Shader) storage buffer object with the bounding volume hierarchy of the spheres
 		} storageBuffers;
 		vks::Buffer uniformBuffer;					// Uniform buffer object containing scene data
 		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
@@ -60,13 +73,12 @@ public:
 	} compute;
 
 	// SSBO sphere declaration
+	// Objects are identified by their index, spheres come first followed by the planes
 	struct Sphere {									// Shader uses std140 layout (so we only use vec4 instead of vec3)
 		glm::vec3 pos;
 		float radius;
 		glm::vec3 diffuse;
 		float specular;
-		uint32_t id;								// Id used to identify sphere for raytracing
-		glm::ivec3 _pad;
 	};
 
 	// SSBO plane declaration
@@ -75,10 +87,20 @@ public:
 		float distance;
 		glm::vec3 diffuse;
 		float specular;
-		uint32_t id;
-		glm::ivec3 _pad;
 	};
 
+	// Timestamps of the ray tracing dispatch on the compute queue
+	vks::GpuProfiler computeProfiler;
+
+	struct {
+		uint32_t sphereCount = 0;
+		double buildTime = 0.0;
+		size_t nodeCount = 0;
+		uint32_t leafCount = 0;
+		uint32_t depth = 0;
+		float cost = 0.0f;
+	} bvhStats;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Compute shader ray tracing";
@@ -100,6 +122,13 @@ public:
 
 	~VulkanExample()
 	{
+		if (benchmark.active) {
+			double raysPerSecond;
+			if (getMaxRaysPerSecond(raysPerSecond)) {
+				std::cout << "Ray tracing: " << raysPerSecond / 1000000.0 << " max Mrays/s\n";
+			}
+		}
+
 		// Graphics
 		vkDestroyPipeline(device, graphics.pipeline, nullptr);
 		vkDestroyPipelineLayout(device, graphics.pipelineLayout, nullptr);
@@ -114,6 +143,8 @@ public:
 		compute.uniformBuffer.destroy();
 		compute.storageBuffers.spheres.destroy();
 		compute.storageBuffers.planes.destroy();
+		compute.storageBuffers.nodes.destroy();
+		computeProfiler.destroy();
 
 		textureComputeTarget.destroy();
 	}
@@ -330,11 +361,17 @@ public:
 				1, &imageMemoryBarrier);
 		}
 
+		computeProfiler.beginFrame(compute.commandBuffer);
+		computeProfiler.begin(compute.commandBuffer, "Ray tracing");
+
 		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
 		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
 
 		vkCmdDispatch(compute.commandBuffer, textureComputeTarget.width / 16, textureComputeTarget.height / 16, 1);
 
+		computeProfiler.end(compute.commandBuffer);
+		computeProfiler.endFrame(compute.commandBuffer);
+
 		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
 		{
 			// Release barrier from compute queue
@@ -355,12 +392,9 @@ public:
 		vkEndCommandBuffer(compute.commandBuffer);
 	}
 
-	uint32_t currentId = 0;	// Id used to identify objects by the ray tracing shader
-
 	Sphere newSphere(glm::vec3 pos, float radius, glm::vec3 diffuse, float specular)
 	{
 		Sphere sphere;
-		sphere.id = currentId++;
 		sphere.pos = pos;
 		sphere.radius = radius;
 		sphere.diffuse = diffuse;
@@ -371,7 +405,6 @@ public:
 	Plane newPlane(glm::vec3 normal, float distance, glm::vec3 diffuse, float specular)
 	{
 		Plane plane;
-		plane.id = currentId++;
 		plane.normal = normal;
 		plane.distance = distance;
 		plane.diffuse = diffuse;
@@ -379,43 +412,101 @@ public:
 		return plane;
 	}
 
-	// Setup and fill the compute shader storage buffers containing primitives for the raytraced scene
-	void prepareStorageBuffers()
+	// Scatters small spheres through the room, around the three large ones
+	void generateSpheres(std::vector<Sphere>& spheres, uint32_t count)
 	{
-		// Spheres
-		std::vector<Sphere> spheres;
-		spheres.push_back(newSphere(glm::vec3(1.75f, -0.5f, 0.0f), 1.0f, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
-		spheres.push_back(newSphere(glm::vec3(0.0f, 1.0f, -0.5f), 1.0f, glm::vec3(0.65f, 0.77f, 0.97f), 32.0f));
-		spheres.push_back(newSphere(glm::vec3(-1.75f, -0.75f, -0.5f), 1.25f, glm::vec3(0.9f, 0.76f, 0.46f), 32.0f));
-		VkDeviceSize storageBufferSize = spheres.size() * sizeof(Sphere);
+		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::uniform_real_distribution<float> rndX(-3.8f, 3.8f);
+		// Keep some distance to the camera, which sits at the back wall of the room
+		std::uniform_real_distribution<float> rndZ(-3.8f, 2.5f);
+		std::uniform_real_distribution<float> rndRadius(0.03f, 0.1f);
+		std::uniform_real_distribution<float> rndColor(0.2f, 1.0f);
+		const size_t fixedSphereCount = spheres.size();
+		while (spheres.size() < fixedSphereCount + count)
+		{
+			const glm::vec3 pos(rndX(rndEngine), rndX(rndEngine), rndZ(rndEngine));
+			const float radius = rndRadius(rndEngine);
+			bool overlaps = false;
+			for (size_t i = 0; i < fixedSphereCount; i++)
+			{
+				overlaps |= glm::distance(pos, spheres[i].pos) < spheres[i].radius + radius;
+			}
+			if (!overlaps)
+			{
+				spheres.push_back(newSphere(pos, radius, glm::vec3(rndColor(rndEngine), rndColor(rndEngine), rndColor(rndEngine)), 32.0f));
+			}
+		}
+	}
 
-		// Stage
+	// Creates a device local storage buffer and uploads the given data to it using a staging buffer
+	void createStorageBuffer(vks::Buffer* buffer, VkDeviceSize size, void* data)
+	{
 		vks::Buffer stagingBuffer;
 
 		vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&stagingBuffer,
-			storageBufferSize,
-			spheres.data());
+			size,
+			data);
 
 		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.storageBuffers.spheres,
-			storageBufferSize);
+			buffer,
+			size);
 
 		// Copy to staging buffer
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBufferCopy copyRegion = {};
-		copyRegion.size = storageBufferSize;
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffers.spheres.buffer, 1, &copyRegion);
+		copyRegion.size = size;
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, buffer->buffer, 1, &copyRegion);
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		stagingBuffer.destroy();
+	}
+
+	// Setup and fill the compute shader storage buffers containing primitives for the raytraced scene
+	void prepareStorageBuffers()
+	{
+		// Spheres
+		std::vector<Sphere> spheres;
+		spheres.push_back(newSphere(glm::vec3(1.75f, -0.5f, 0.0f), 1.0f, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
+		spheres.push_back(newSphere(glm::vec3(0.0f, 1.0f, -0.5f), 1.0f, glm::vec3(0.65f, 0.77f, 0.97f), 32.0f));
+		spheres.push_back(newSphere(glm::vec3(-1.75f, -0.75f, -0.5f), 1.25f, glm::vec3(0.9f, 0.76f, 0.46f), 32.0f));
+		generateSpheres(spheres, SPHERE_COUNT * settings.simulationScale);
+
+		// Build the bounding volume hierarchy for the spheres
+		auto tStart = std::chrono::high_resolution_clock::now();
+		std::vector<vks::BVH::AABB> sphereBounds(spheres.size());
+		for (size_t i = 0; i < spheres.size(); i++)
+		{
+			sphereBounds[i].min = spheres[i].pos - glm::vec3(spheres[i].radius);
+			sphereBounds[i].max = spheres[i].pos + glm::vec3(spheres[i].radius);
+		}
+		vks::BVH bvh;
+		bvh.build(sphereBounds);
+		// Leaves reference contiguous ranges of spheres, so the spheres are stored in leaf order
+		std::vector<Sphere> orderedSpheres(spheres.size());
+		for (size_t i = 0; i < spheres.size(); i++)
+		{
+			orderedSpheres[i] = spheres[bvh.primitiveIndices[i]];
+		}
+		auto tEnd = std::chrono::high_resolution_clock::now();
+
+		bvhStats.sphereCount = static_cast<uint32_t>(spheres.size());
+		bvhStats.buildTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		bvhStats.nodeCount = bvh.nodes.size();
+		bvhStats.leafCount = bvh.leafCount;
+		bvhStats.depth = bvh.depth;
+		bvhStats.cost = bvh.cost();
+		std::cout << "BVH build: " << bvhStats.buildTime << " ms for " << bvhStats.sphereCount << " spheres (" << bvhStats.nodeCount << " nodes, depth " << bvhStats.depth << ")\n";
+
+		createStorageBuffer(&compute.storageBuffers.spheres, orderedSpheres.size() * sizeof(Sphere), orderedSpheres.data());
+		createStorageBuffer(&compute.storageBuffers.nodes, bvh.nodes.size() * sizeof(vks::BVH::Node), bvh.nodes.data());
 
 		// Planes
+		// Planes are unbounded, so they're not part of the hierarchy and are tested by every ray
 		std::vector<Plane> planes;
 		const float roomDim = 4.0f;
 		planes.push_back(newPlane(glm::vec3(0.0f, 1.0f, 0.0f), roomDim, glm::vec3(1.0f), 32.0f));
@@ -424,32 +515,14 @@ public:
 		planes.push_back(newPlane(glm::vec3(0.0f, 0.0f, -1.0f), roomDim, glm::vec3(0.0f), 32.0f));
 		planes.push_back(newPlane(glm::vec3(-1.0f, 0.0f, 0.0f), roomDim, glm::vec3(1.0f, 0.0f, 0.0f), 32.0f));
 		planes.push_back(newPlane(glm::vec3(1.0f, 0.0f, 0.0f), roomDim, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
-		storageBufferSize = planes.size() * sizeof(Plane);
-
-		// Stage
-		vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			storageBufferSize,
-			planes.data());
+		createStorageBuffer(&compute.storageBuffers.planes, planes.size() * sizeof(Plane), planes.data());
 
-		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.storageBuffers.planes,
-			storageBufferSize);
-
-		// Copy to staging buffer
-		copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		copyRegion.size = storageBufferSize;
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffers.planes.buffer, 1, &copyRegion);
 		// Add an initial release barrier to the graphics queue,
 		// so that when the compute command buffer executes for the first time
 		// it doesn't complain about a lack of a corresponding "release" to its "acquire"
 		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
 		{
+			VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 			VkImageMemoryBarrier imageMemoryBarrier = {};
 			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
@@ -468,10 +541,8 @@ public:
 				0, nullptr,
 				0, nullptr,
 				1, &imageMemoryBarrier);
+			vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 		}
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-
-		stagingBuffer.destroy();
 	}
 
 	void setupDescriptorPool()
@@ -481,7 +552,7 @@ public:
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),			// Compute UBO
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4),	// Graphics image samplers
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),				// Storage image for ray traced image output
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),			// Storage buffer for the scene primitives
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),			// Storage buffers for the scene primitives and the sphere hierarchy
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -659,7 +730,12 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
-				3)
+				3),
+			// Binding 4: Shader storage buffer for the bounding volume hierarchy nodes
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				4)
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -709,7 +785,13 @@ public:
 				compute.descriptorSet,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				3,
-				&compute.storageBuffers.planes.descriptor)
+				&compute.storageBuffers.planes.descriptor),
+			// Binding 4: Shader storage buffer for the bounding volume hierarchy nodes
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				4,
+				&compute.storageBuffers.nodes.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, computeWriteDescriptorSets.size(), computeWriteDescriptorSets.data(), 0, NULL);
@@ -743,6 +825,9 @@ public:
 		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
 		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &compute.fence));
 
+		// Timestamps may not be supported by a compute only queue family, the ray throughput isn't available then
+		computeProfiler.create(vulkanDevice, queue, vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.compute].timestampValidBits, false);
+
 		// Build a single command buffer containing the compute dispatch commands
 		buildComputeCommandBuffer();
 	}
@@ -814,12 +899,53 @@ public:
 		if (!prepared)
 			return;
 		draw();
+		updateProfiler();
 		if (!paused)
 		{
 			updateUniformBuffers();
 		}
 	}
 
+	void updateProfiler()
+	{
+		computeProfiler.resolve();
+		if (benchmark.active) {
+			for (auto& result : computeProfiler.results) {
+				benchmark.addPassTime("Compute queue/" + result.path, result.time);
+			}
+		}
+		computeProfiler.results.clear();
+	}
+
+	// Upper bound of the closest hit rays per second, based on the average GPU time of the ray tracing dispatch
+	// This assumes that every pixel traces the maximum number of distinct rays, rays actually traced are not counted
+	bool getMaxRaysPerSecond(double& raysPerSecond)
+	{
+		for (auto& pass : computeProfiler.passes) {
+			if ((pass.path == "Ray tracing") && (pass.averageTime > 0.0)) {
+				const double raysPerFrame = static_cast<double>(textureComputeTarget.width) * textureComputeTarget.height * MAX_RAYS_PER_PIXEL;
+				raysPerSecond = raysPerFrame / (pass.averageTime / 1000.0);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Statistics")) {
+			overlay->text("Spheres: %u", bvhStats.sphereCount);
+			overlay->text("BVH nodes: %u (%u leaves)", static_cast<uint32_t>(bvhStats.nodeCount), bvhStats.leafCount);
+			overlay->text("BVH depth: %u", bvhStats.depth);
+			overlay->text("BVH SAH cost: %.2f", bvhStats.cost);
+			overlay->text("BVH build: %.2f ms", bvhStats.buildTime);
+			double raysPerSecond;
+			if (getMaxRaysPerSecond(raysPerSecond)) {
+				overlay->text("Rays: %.1f max Mrays/s", raysPerSecond / 1000000.0);
+			}
+		}
+	}
+
 	virtual void viewChanged()
 	{
 		compute.ubo.aspectRatio = (float)width / (float)height;
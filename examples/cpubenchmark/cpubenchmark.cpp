@@ -0,0 +1,519 @@
+/*
+* Vulkan Example - CPU benchmarks for framework code
+*
+* Runs without a Vulkan device and prints the results to the command line
+* Select benchmarks with their command line options, all benchmarks are run if none is selected
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
+#include <memory>
+
+#include "CommandLineParser.hpp"
+#include "frustum.hpp"
+#include "VulkanglTFModel.h"
+#include "jobsystem.hpp"
+#include "threadpool.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+CommandLineParser commandLineParser;
+
+class CpuBenchmark
+{
+public:
+	uint32_t numThreads;
+	std::default_random_engine rndEngine;
+
+	CpuBenchmark()
+	{
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		// Fixed seed, so runs are comparable
+		rndEngine.seed(0);
+	}
+
+	float rnd(float range)
+	{
+		std::uniform_real_distribution<float> rndDist(0.0f, range);
+		return rndDist(rndEngine);
+	}
+
+	/*
+		Frustum culling
+	*/
+
+	// Measures the throughput of the batch culling kernels against per-object checks for a large number of random bounds
+	void runCullingBenchmark()
+	{
+		// Same view as the multithreading example
+		vks::Frustum frustum;
+		frustum.update(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 256.0f) * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -32.5f)));
+		const uint32_t count = 1024 * 1024;
+		const uint32_t iterations = 16;
+		std::vector<float> x(count), y(count), z(count), radius(count), extent(count);
+		for (uint32_t i = 0; i < count; i++) {
+			x[i] = rnd(256.0f) - 128.0f;
+			y[i] = rnd(256.0f) - 128.0f;
+			z[i] = rnd(256.0f) - 128.0f;
+			radius[i] = 0.5f + rnd(4.0f);
+		}
+		std::vector<float> minX(count), minY(count), minZ(count), maxX(count), maxY(count), maxZ(count);
+		for (uint32_t i = 0; i < count; i++) {
+			minX[i] = x[i] - radius[i]; maxX[i] = x[i] + radius[i];
+			minY[i] = y[i] - radius[i]; maxY[i] = y[i] + radius[i];
+			minZ[i] = z[i] - radius[i]; maxZ[i] = z[i] + radius[i];
+		}
+		const vks::Frustum::SphereArrays spheres = { x.data(), y.data(), z.data(), radius.data() };
+		const vks::Frustum::AABBArrays boxes = { minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data() };
+		std::vector<uint32_t> mask((count + 31) / 32);
+		std::vector<uint32_t> indices(count);
+
+		// Runs the given culling function and returns the throughput in millions of bounds per second
+		auto measure = [&](std::function<uint32_t()> cull, uint32_t& visible) {
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < iterations; i++) {
+				visible = cull();
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+			return (double(count) * iterations) / seconds / 1.0e6;
+		};
+		auto countBits = [&]() {
+			uint32_t visible = 0;
+			for (uint32_t word : mask) {
+				for (; word != 0; word &= word - 1) {
+					visible++;
+				}
+			}
+			return visible;
+		};
+
+		struct Result {
+			std::string name;
+			double throughput;
+			uint32_t visible;
+		};
+		std::vector<Result> results(6);
+		results[0].name = "Spheres, per object";
+		results[0].throughput = measure([&]() {
+			uint32_t visible = 0;
+			for (uint32_t i = 0; i < count; i++) {
+				visible += frustum.checkSphere(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+			}
+			return visible;
+		}, results[0].visible);
+		results[1].name = "Spheres, batch mask";
+		results[1].throughput = measure([&]() { frustum.cullSpheres(spheres, count, mask.data()); return countBits(); }, results[1].visible);
+		results[2].name = "Spheres, batch compact";
+		results[2].throughput = measure([&]() { return frustum.cullSpheresCompact(spheres, count, indices.data()); }, results[2].visible);
+		results[3].name = "AABBs, per object";
+		results[3].throughput = measure([&]() {
+			uint32_t visible = 0;
+			for (uint32_t i = 0; i < count; i++) {
+				visible += frustum.checkAABB(glm::vec3(minX[i], minY[i], minZ[i]), glm::vec3(maxX[i], maxY[i], maxZ[i])) ? 1 : 0;
+			}
+			return visible;
+		}, results[3].visible);
+		results[4].name = "AABBs, batch mask";
+		results[4].throughput = measure([&]() { frustum.cullAABBs(boxes, count, mask.data()); return countBits(); }, results[4].visible);
+		results[5].name = "AABBs, batch compact";
+		results[5].throughput = measure([&]() { return frustum.cullAABBsCompact(boxes, count, indices.data()); }, results[5].visible);
+
+		std::stringstream ss;
+		ss << "Frustum culling benchmark (" << vks::Frustum::kernelName() << " kernel, " << count << " bounds, " << iterations << " iterations)\n";
+		for (auto& result : results) {
+			ss << std::left << std::setw(24) << result.name << std::fixed << std::setprecision(1) << std::setw(10) << result.throughput << " M bounds/s, " << result.visible << " visible\n";
+		}
+		std::cout << ss.str();
+	}
+
+	/*
+		glTF node transforms
+	*/
+
+	// Skeletons used by the transform and animation benchmarks
+	static const uint32_t benchmarkSpineLength = 24;
+	static const uint32_t benchmarkLimbLength = 6;
+
+	// Creates a skeleton with a long spine and a pair of limbs at every fourth spine joint, all nodes are joints of the skin
+	vkglTF::Node* createBenchmarkCharacter(vkglTF::Skin& skin)
+	{
+		auto addJoint = [&](vkglTF::Node* parent) {
+			vkglTF::Node* node = new vkglTF::Node{};
+			node->parent = parent;
+			node->matrix = glm::mat4(1.0f);
+			node->translation = glm::vec3(0.0f, 0.25f, 0.0f);
+			if (parent) {
+				parent->children.push_back(node);
+			}
+			skin.joints.push_back(node);
+			return node;
+		};
+		vkglTF::Node* root = addJoint(nullptr);
+		vkglTF::Node* spine = root;
+		for (uint32_t i = 1; i < benchmarkSpineLength; i++) {
+			spine = addJoint(spine);
+			if (i % 4 == 0) {
+				for (uint32_t side = 0; side < 2; side++) {
+					vkglTF::Node* limb = spine;
+					for (uint32_t j = 0; j < benchmarkLimbLength; j++) {
+						limb = addJoint(limb);
+					}
+				}
+			}
+		}
+		skin.inverseBindMatrices.resize(skin.joints.size());
+		for (size_t i = 0; i < skin.joints.size(); i++) {
+			skin.inverseBindMatrices[i] = glm::inverse(skin.joints[i]->getMatrix());
+		}
+		return root;
+	}
+
+	// Measures the joint matrix calculation of many animated skinned characters with deep skeletons
+	// Walking up the hierarchy for every joint (as vkglTF::Node::getMatrix did) is compared against flattened node transforms updated in a single pass
+	void runTransformBenchmark()
+	{
+		const uint32_t characterCount = 256;
+		const uint32_t iterations = 32;
+
+		// Two identical sets of characters, the nodes of the second set are flattened
+		std::vector<vkglTF::Skin> hierarchySkins(characterCount);
+		std::vector<vkglTF::Skin> flattenedSkins(characterCount);
+		std::vector<vkglTF::Node*> hierarchyRoots;
+		std::vector<vkglTF::Node*> flattenedRoots;
+		for (uint32_t i = 0; i < characterCount; i++) {
+			hierarchyRoots.push_back(createBenchmarkCharacter(hierarchySkins[i]));
+			flattenedRoots.push_back(createBenchmarkCharacter(flattenedSkins[i]));
+		}
+		vkglTF::NodeTransforms transforms;
+		transforms.build(flattenedRoots);
+		const size_t jointCount = hierarchySkins[0].joints.size();
+		std::vector<glm::mat4> jointMatrices(jointCount);
+
+		auto pose = [&](uint32_t frame, size_t joint) {
+			return glm::angleAxis(0.05f * sinf(0.1f * float(frame) + float(joint)), glm::vec3(0.0f, 0.0f, 1.0f));
+		};
+
+		// Runs the given frame update and returns the average time per frame in milliseconds
+		auto measure = [&](std::function<void(uint32_t)> updateFrame) {
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t frame = 0; frame < iterations; frame++) {
+				updateFrame(frame);
+			}
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count() / iterations;
+		};
+		float checksum[2] = { 0.0f, 0.0f };
+		const double hierarchyTime = measure([&](uint32_t frame) {
+			for (auto& skin : hierarchySkins) {
+				for (size_t i = 0; i < jointCount; i++) {
+					skin.joints[i]->rotation = pose(frame, i);
+				}
+				for (size_t i = 0; i < jointCount; i++) {
+					jointMatrices[i] = skin.joints[i]->getMatrix() * skin.inverseBindMatrices[i];
+				}
+				checksum[0] += jointMatrices[jointCount - 1][3].x;
+			}
+		});
+		const double flattenedTime = measure([&](uint32_t frame) {
+			for (auto& skin : flattenedSkins) {
+				for (size_t i = 0; i < jointCount; i++) {
+					transforms.setRotation(skin.joints[i]->transformIndex, pose(frame, i));
+				}
+			}
+			transforms.update();
+			for (auto& skin : flattenedSkins) {
+				for (size_t i = 0; i < jointCount; i++) {
+					jointMatrices[i] = transforms.worldMatrices[skin.joints[i]->transformIndex] * skin.inverseBindMatrices[i];
+				}
+				checksum[1] += jointMatrices[jointCount - 1][3].x;
+			}
+			transforms.clearUpdated();
+		});
+
+		const double joints = double(characterCount) * jointCount;
+		std::stringstream ss;
+		ss << "Node transform benchmark (" << characterCount << " characters, " << jointCount << " joints, spine depth " << benchmarkSpineLength << ", " << iterations << " frames)\n";
+		ss << std::left << std::setw(24) << "Hierarchy walk" << std::fixed << std::setprecision(3) << std::setw(10) << hierarchyTime << " ms/frame, " << std::setprecision(1) << joints / hierarchyTime / 1.0e3 << " M joints/s\n";
+		ss << std::left << std::setw(24) << "Flattened transforms" << std::fixed << std::setprecision(3) << std::setw(10) << flattenedTime << " ms/frame, " << std::setprecision(1) << joints / flattenedTime / 1.0e3 << " M joints/s\n";
+		ss << "Checksums " << checksum[0] << " / " << checksum[1] << "\n";
+		std::cout << ss.str();
+
+		for (auto root : hierarchyRoots) {
+			delete root;
+		}
+		for (auto root : flattenedRoots) {
+			delete root;
+		}
+	}
+
+	/*
+		glTF animations
+	*/
+
+	// Measures the number of animation channels evaluated per second for many characters playing a long clip
+	// The linear keyframe search updateAnimation used to do is compared against cached keyframes, also with seeking and with the characters split across threads
+	void runAnimationBenchmark()
+	{
+		const uint32_t characterCount = 64;
+		const uint32_t keyCount = 240;
+		const float keyInterval = 1.0f / 30.0f;
+		const uint32_t frames = 240;
+
+		// Every character is a model without a device that only contains the skeleton and a single animation
+		// Every joint gets a linearly interpolated rotation, every fourth joint also gets a cubic spline translation
+		std::vector<std::unique_ptr<vkglTF::Model>> characters(characterCount);
+		for (auto& character : characters) {
+			character.reset(new vkglTF::Model());
+			vkglTF::Skin* skin = new vkglTF::Skin{};
+			character->skins.push_back(skin);
+			character->nodes.push_back(createBenchmarkCharacter(*skin));
+			character->linearNodes = skin->joints;
+			character->transforms.build(character->nodes);
+			vkglTF::Animation animation{};
+			for (size_t i = 0; i < skin->joints.size(); i++) {
+				vkglTF::Node* joint = skin->joints[i];
+				for (uint32_t path = 0; path < ((i % 4 == 0) ? 2u : 1u); path++) {
+					vkglTF::AnimationSampler sampler{};
+					sampler.interpolation = (path == 0) ? vkglTF::AnimationSampler::InterpolationType::LINEAR : vkglTF::AnimationSampler::InterpolationType::CUBICSPLINE;
+					for (uint32_t key = 0; key < keyCount; key++) {
+						sampler.inputs.push_back(float(key) * keyInterval);
+						if (path == 0) {
+							const glm::quat q = glm::angleAxis(rnd(0.5f) - 0.25f, glm::normalize(glm::vec3(rnd(1.0f), rnd(1.0f), 1.0f)));
+							sampler.outputsVec4.push_back(glm::vec4(q.x, q.y, q.z, q.w));
+						} else {
+							const glm::vec4 value(0.0f, 0.25f + rnd(0.05f), 0.0f, 0.0f);
+							sampler.outputsVec4.push_back(glm::vec4(0.0f));
+							sampler.outputsVec4.push_back(value);
+							sampler.outputsVec4.push_back(glm::vec4(0.0f));
+						}
+					}
+					vkglTF::AnimationChannel channel{};
+					channel.path = (path == 0) ? vkglTF::AnimationChannel::PathType::ROTATION : vkglTF::AnimationChannel::PathType::TRANSLATION;
+					channel.node = joint;
+					channel.samplerIndex = static_cast<uint32_t>(animation.samplers.size());
+					animation.samplers.push_back(sampler);
+					animation.channels.push_back(channel);
+				}
+			}
+			character->animations.push_back(animation);
+		}
+		const size_t channelCount = characters[0]->animations[0].channels.size();
+
+		// Each character plays the clip with a different offset
+		auto frameTime = [&](uint32_t character, uint32_t frame) {
+			return fmodf(float(character) * 0.37f + float(frame) / 60.0f, float(keyCount - 1) * keyInterval);
+		};
+		// Runs the given frame update for all frames and returns the throughput in millions of channels per second
+		auto measure = [&](std::function<void(uint32_t)> updateFrame) {
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t frame = 0; frame < frames; frame++) {
+				updateFrame(frame);
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+			return (double(characterCount) * channelCount * frames) / seconds / 1.0e6;
+		};
+
+		struct Result {
+			std::string name;
+			double throughput;
+		};
+		std::vector<Result> results(4);
+		results[0].name = "Linear key search";
+		results[0].throughput = measure([&](uint32_t frame) {
+			for (uint32_t c = 0; c < characterCount; c++) {
+				const float time = frameTime(c, frame);
+				vkglTF::Model* character = characters[c].get();
+				vkglTF::Animation& animation = character->animations[0];
+				for (auto& channel : animation.channels) {
+					const vkglTF::AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
+					for (size_t i = 0; i < sampler.inputs.size() - 1; i++) {
+						if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
+							const float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
+							if (channel.path == vkglTF::AnimationChannel::PathType::ROTATION) {
+								glm::quat q1;
+								q1.x = sampler.outputsVec4[i].x;
+								q1.y = sampler.outputsVec4[i].y;
+								q1.z = sampler.outputsVec4[i].z;
+								q1.w = sampler.outputsVec4[i].w;
+								glm::quat q2;
+								q2.x = sampler.outputsVec4[i + 1].x;
+								q2.y = sampler.outputsVec4[i + 1].y;
+								q2.z = sampler.outputsVec4[i + 1].z;
+								q2.w = sampler.outputsVec4[i + 1].w;
+								character->transforms.setRotation(channel.node->transformIndex, glm::normalize(glm::slerp(q1, q2, u)));
+							} else {
+								character->transforms.setTranslation(channel.node->transformIndex, glm::vec3(glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u)));
+							}
+						}
+					}
+				}
+				character->updateNodes();
+			}
+		});
+		results[1].name = "Cached keys";
+		results[1].throughput = measure([&](uint32_t frame) {
+			for (uint32_t c = 0; c < characterCount; c++) {
+				characters[c]->updateAnimation(0, frameTime(c, frame));
+			}
+		});
+		results[2].name = "Cached keys, seeking";
+		results[2].throughput = measure([&](uint32_t frame) {
+			for (uint32_t c = 0; c < characterCount; c++) {
+				characters[c]->updateAnimation(0, rnd(float(keyCount - 1) * keyInterval));
+			}
+		});
+		vks::JobSystem jobSystem;
+		jobSystem.setThreadCount(numThreads - 1);
+		std::vector<vkglTF::Model::AnimationUpdate> updates(characterCount);
+		results[3].name = "Cached keys, " + std::to_string(jobSystem.getThreadCount() + 1) + " threads";
+		results[3].throughput = measure([&](uint32_t frame) {
+			for (uint32_t c = 0; c < characterCount; c++) {
+				updates[c] = { characters[c].get(), 0, frameTime(c, frame) };
+			}
+			vkglTF::Model::updateAnimations(jobSystem, updates);
+		});
+
+		std::stringstream ss;
+		ss << "Animation benchmark (" << characterCount << " characters, " << channelCount << " channels, " << keyCount << " keyframes, " << frames << " frames)\n";
+		for (auto& result : results) {
+			ss << std::left << std::setw(28) << result.name << std::fixed << std::setprecision(2) << std::setw(10) << result.throughput << " M channels/s\n";
+		}
+		std::cout << ss.str();
+	}
+
+	/*
+		Job dispatch
+	*/
+
+	// Compares the cost of dispatching and waiting for many small jobs with the thread pool (statically partitioned per-thread queues)
+	// and the work stealing job system, once with jobs of equal cost and once with a few expensive jobs (like objects that pass culling)
+	void runJobBenchmark()
+	{
+		const uint32_t jobCount = 16384;
+		const uint32_t iterations = 64;
+
+		// Per-job amount of work, the results are written to memory so the work can't be optimized out
+		struct Workload {
+			std::string name;
+			std::vector<uint32_t> cost;
+		};
+		std::vector<Workload> workloads = {
+			{ "Empty", std::vector<uint32_t>(jobCount, 0) },
+			{ "Uniform", std::vector<uint32_t>(jobCount, 64) },
+			{ "Imbalanced", std::vector<uint32_t>(jobCount) }
+		};
+		for (uint32_t i = 0; i < jobCount; i++) {
+			// Expensive jobs are clustered, so a static partitioning gives a few threads most of the work
+			workloads[2].cost[i] = (i < jobCount / 8) ? 1024 : 16;
+		}
+		std::vector<uint32_t> output(jobCount);
+		auto work = [&output](const std::vector<uint32_t>& cost, uint32_t job) {
+			uint32_t value = job;
+			for (uint32_t i = 0; i < cost[job]; i++) {
+				value = value * 1664525u + 1013904223u;
+			}
+			output[job] = value;
+		};
+
+		// Runs the given dispatch for all iterations and returns the average time in milliseconds
+		auto measure = [&](std::function<void()> dispatch) {
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < iterations; i++) {
+				dispatch();
+			}
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count() / iterations;
+		};
+
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(numThreads);
+		vks::JobSystem jobSystem;
+		// The thread waiting for the jobs also executes them, so one worker less is required
+		jobSystem.setThreadCount(numThreads - 1);
+
+		struct Result {
+			std::string name;
+			double time;
+		};
+		std::vector<Result> results;
+		for (auto& workload : workloads) {
+			const std::vector<uint32_t>* cost = &workload.cost;
+			const std::string& workloadName = workload.name;
+			// Same partitioning as the multithreading example: contiguous ranges, one queued job per index
+			results.push_back({ workloadName + ", thread pool", measure([&]() {
+				for (uint32_t t = 0; t < numThreads; t++) {
+					const uint32_t first = (jobCount * t) / numThreads;
+					const uint32_t last = (jobCount * (t + 1)) / numThreads;
+					for (uint32_t i = first; i < last; i++) {
+						threadPool.threads[t]->addJob([&, cost, i] { work(*cost, i); });
+					}
+				}
+				threadPool.wait();
+			}) });
+			// One job per index, scheduled from the calling thread
+			results.push_back({ workloadName + ", job system run", measure([&]() {
+				vks::TaskGroup group;
+				for (uint32_t i = 0; i < jobCount; i++) {
+					jobSystem.run(group, [&, cost, i] { work(*cost, i); });
+				}
+				jobSystem.wait(group);
+			}) });
+			results.push_back({ workloadName + ", job system parallelFor", measure([&]() {
+				jobSystem.parallelFor(jobCount, 64, [&](uint32_t i) { work(*cost, i); });
+			}) });
+		}
+
+		std::stringstream ss;
+		ss << "Job dispatch benchmark (" << jobCount << " jobs, " << numThreads << " threads, " << iterations << " iterations)\n";
+		for (auto& result : results) {
+			ss << std::left << std::setw(36) << result.name << std::fixed << std::setprecision(3) << std::setw(10) << result.time << " ms, " << std::setprecision(1) << double(jobCount) / result.time / 1.0e3 << " M jobs/s\n";
+		}
+		std::cout << ss.str();
+	}
+};
+
+int main(int argc, char* argv[]) {
+	commandLineParser.add("help", { "--help" }, 0, "Show help");
+	commandLineParser.add("culling", { "--culling" }, 0, "Compare the batch frustum culling kernels against per-object checks");
+	commandLineParser.add("transforms", { "--transforms" }, 0, "Compare flattened glTF node transforms against walking the node hierarchy for many skinned characters");
+	commandLineParser.add("animation", { "--animation" }, 0, "Measure the glTF animation channels evaluated per second for many characters");
+	commandLineParser.add("jobs", { "--jobs" }, 0, "Compare job dispatch of the thread pool and the work stealing job system");
+	commandLineParser.parse(argc, argv);
+	if (commandLineParser.isSet("help")) {
+		commandLineParser.printHelp();
+		std::cin.get();
+		return 0;
+	}
+	// Run all benchmarks if none has been selected
+	bool runAll = true;
+	for (auto& option : commandLineParser.options) {
+		runAll = runAll && !option.second.set;
+	}
+	CpuBenchmark cpuBenchmark;
+	if (runAll || commandLineParser.isSet("culling")) {
+		cpuBenchmark.runCullingBenchmark();
+	}
+	if (runAll || commandLineParser.isSet("transforms")) {
+		cpuBenchmark.runTransformBenchmark();
+	}
+	if (runAll || commandLineParser.isSet("animation")) {
+		cpuBenchmark.runAnimationBenchmark();
+	}
+	if (runAll || commandLineParser.isSet("jobs")) {
+		cpuBenchmark.runJobBenchmark();
+	}
+	return 0;
+}
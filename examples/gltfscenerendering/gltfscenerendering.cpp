@@ -29,10 +29,7 @@ VulkanglTFScene::~VulkanglTFScene()
 	vkDestroyBuffer(vulkanDevice->logicalDevice, indices.buffer, nullptr);
 	vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
 	for (Image image : images) {
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+		image.texture.destroy();
 	}
 	for (Material material : materials) {
 		vkDestroyPipeline(vulkanDevice->logicalDevice, material.pipeline, nullptr);
@@ -235,48 +232,50 @@ VkDescriptorImageInfo VulkanglTFScene::getTextureDescriptor(const size_t index)
 	glTF rendering functions
 */
 
-// Draw a single node including child nodes (if present)
-void VulkanglTFScene::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node* node)
+// Append the draws of a visible node and its children
+void VulkanglTFScene::getDrawItems(VulkanglTFScene::Node* node, const glm::mat4& parentMatrix, std::vector<DrawItem>& drawItems)
 {
 	if (!node->visible) {
 		return;
 	}
-	if (node->mesh.primitives.size() > 0) {
-		// Pass the node's matrix via push constants
-		// Traverse the node hierarchy to the top-most parent to get the final matrix of the current node
-		glm::mat4 nodeMatrix = node->matrix;
-		VulkanglTFScene::Node* currentParent = node->parent;
-		while (currentParent) {
-			nodeMatrix = currentParent->matrix * nodeMatrix;
-			currentParent = currentParent->parent;
-		}
-		// Pass the final matrix to the vertex shader using push constants
-		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &nodeMatrix);
-		for (VulkanglTFScene::Primitive& primitive : node->mesh.primitives) {
-			if (primitive.indexCount > 0) {
-				VulkanglTFScene::Material& material = materials[primitive.materialIndex];
-				// POI: Bind the pipeline for the node's material
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &material.descriptorSet, 0, nullptr);
-				vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
-			}
+	const glm::mat4 nodeMatrix = parentMatrix * node->matrix;
+	for (VulkanglTFScene::Primitive& primitive : node->mesh.primitives) {
+		if (primitive.indexCount > 0) {
+			drawItems.push_back({ nodeMatrix, &primitive });
 		}
 	}
 	for (auto& child : node->children) {
-		drawNode(commandBuffer, pipelineLayout, child);
+		getDrawItems(child, nodeMatrix, drawItems);
+	}
+}
+
+// Flatten the visible nodes of the scene into a list of draws
+void VulkanglTFScene::getDrawItems(std::vector<DrawItem>& drawItems)
+{
+	drawItems.clear();
+	for (auto& node : nodes) {
+		getDrawItems(node, glm::mat4(1.0f), drawItems);
 	}
 }
 
-// Draw the glTF scene starting at the top-level-nodes
-void VulkanglTFScene::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+// Draw a range of the flattened draw list, this can be called from multiple threads at once as it doesn't modify the scene
+void VulkanglTFScene::drawItems(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const DrawItem* items, uint32_t count)
 {
-	// All vertices and indices are stored in single buffers, so we only need to bind once
 	VkDeviceSize offsets[1] = { 0 };
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
 	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-	// Render all nodes at top-level
-	for (auto& node : nodes) {
-		drawNode(commandBuffer, pipelineLayout, node);
+	// Consecutive draws often share a material, so only bind its pipeline and descriptor set if it changes
+	int32_t boundMaterial = -1;
+	for (uint32_t i = 0; i < count; i++) {
+		const DrawItem& item = items[i];
+		if (item.primitive->materialIndex != boundMaterial) {
+			const VulkanglTFScene::Material& material = materials[item.primitive->materialIndex];
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &material.descriptorSet, 0, nullptr);
+			boundMaterial = item.primitive->materialIndex;
+		}
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &item.matrix);
+		vkCmdDrawIndexed(commandBuffer, item.primitive->indexCount, 1, item.primitive->firstIndex, 0, 0);
 	}
 }
 
@@ -292,6 +291,12 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	camera.setPosition(glm::vec3(0.0f, 1.0f, 0.0f));
 	camera.setRotation(glm::vec3(0.0f, -90.0f, 0.0f));
 	camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+	// The scene's draws are recorded into secondary command buffers on multiple threads
+	parallelRecording = true;
+	commandLineParser.add("recordthreads", { "-rt", "--recordthreads" }, 1, "Set the number of threads for parallel command buffer recording (1 records on the main thread only)");
+	if (commandLineParser.isSet("recordthreads")) {
+		settings.recordingThreads = commandLineParser.getValueAsInt("recordthreads", settings.recordingThreads);
+	}
 }
 
 VulkanExample::~VulkanExample()
@@ -328,20 +333,42 @@ void VulkanExample::buildCommandBuffers()
 	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 
+	// The visible nodes are flattened once, the resulting draw list is then split into ranges that are recorded on all threads
+	std::vector<VulkanglTFScene::DrawItem> drawList;
+	glTFScene.getDrawItems(drawList);
+	const std::vector<vks::ParallelCommandRecorder::Range> ranges = parallelRecorder.partition(static_cast<uint32_t>(drawList.size()), 16);
+
 	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-		// Bind scene matrices descriptor to set 0
-		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		// The render pass' contents are recorded to secondary command buffers
+		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-		// POI: Draw the glTF scene
-		glTFScene.draw(drawCmdBuffers[i], pipelineLayout);
+		// Each swap chain image has its own slot of secondary command buffers, command buffers are only rebuilt while the GPU is idle
+		parallelRecorder.beginSlot(i);
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.framebuffer = frameBuffers[i];
 
-		drawUI(drawCmdBuffers[i]);
+		// POI: Draw the glTF scene
+		std::vector<VkCommandBuffer> secondaryCommandBuffers;
+		parallelRecorder.record(inheritanceInfo, ranges, [&](VkCommandBuffer commandBuffer, uint32_t first, uint32_t last) {
+			// Secondary command buffers don't inherit any state from the primary command buffer
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+			// Bind scene matrices descriptor to set 0
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			glTFScene.drawItems(commandBuffer, pipelineLayout, drawList.data() + first, last - first);
+		}, secondaryCommandBuffers);
+
+		// The UI overlay is recorded on the main thread
+		VkCommandBuffer uiCommandBuffer = parallelRecorder.begin(inheritanceInfo);
+		drawUI(uiCommandBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(uiCommandBuffer));
+		secondaryCommandBuffers.push_back(uiCommandBuffer);
+
+		vkCmdExecuteCommands(drawCmdBuffers[i], static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
@@ -112,6 +112,13 @@ public:
 		int32_t imageIndex;
 	};
 
+	// A single draw of a primitive with the global matrix of its node
+	// The visible nodes are flattened into a list of these, so the draws can be split across multiple threads
+	struct DrawItem {
+		glm::mat4 matrix;
+		const Primitive* primitive;
+	};
+
 	/*
 		Model data
 	*/
@@ -128,8 +135,9 @@ public:
 	void loadTextures(tinygltf::Model& input);
 	void loadMaterials(tinygltf::Model& input);
 	void loadNode(const tinygltf::Node& inputNode, const tinygltf::Model& input, VulkanglTFScene::Node* parent, std::vector<uint32_t>& indexBuffer, std::vector<VulkanglTFScene::Vertex>& vertexBuffer);
-	void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node* node);
-	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+	void getDrawItems(VulkanglTFScene::Node* node, const glm::mat4& parentMatrix, std::vector<DrawItem>& drawItems);
+	void getDrawItems(std::vector<DrawItem>& drawItems);
+	void drawItems(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const DrawItem* items, uint32_t count);
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -46,15 +46,9 @@ VulkanglTFModel::~VulkanglTFModel()
 	vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
 	for (Image image : images)
 	{
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
-	}
-	for (Skin skin : skins)
-	{
-		skin.ssbo.destroy();
+		image.texture.destroy();
 	}
+	jointMatrices.destroy();
 }
 
 /*
@@ -198,18 +192,35 @@ void VulkanglTFModel::loadSkins(tinygltf::Model &input)
 			const tinygltf::Buffer &    buffer     = input.buffers[bufferView.buffer];
 			skins[i].inverseBindMatrices.resize(accessor.count);
 			memcpy(skins[i].inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
-
-			// Store inverse bind matrices for this skin in a shader storage buffer object
-			// To keep this sample simple, we create a host visible shader storage buffer
-			VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			    &skins[i].ssbo,
-			    sizeof(glm::mat4) * skins[i].inverseBindMatrices.size(),
-			    skins[i].inverseBindMatrices.data()));
-			VK_CHECK_RESULT(skins[i].ssbo.map());
 		}
 	}
+
+	// Store the joint matrices of all skins in a single shader storage buffer object
+	// Each skin gets its own range, aligned so it can be bound at its offset into the buffer
+	const VkDeviceSize alignment  = vulkanDevice->properties.limits.minStorageBufferOffsetAlignment;
+	VkDeviceSize       bufferSize = 0;
+	for (auto &skin : skins)
+	{
+		skin.jointOffset = bufferSize;
+		bufferSize += sizeof(glm::mat4) * std::max(skin.joints.size(), static_cast<size_t>(1));
+		bufferSize = (bufferSize + alignment - 1) & ~(alignment - 1);
+	}
+	if (bufferSize == 0)
+	{
+		return;
+	}
+	// To keep this sample simple, we create a host visible shader storage buffer
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+	    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	    &jointMatrices,
+	    bufferSize));
+	VK_CHECK_RESULT(jointMatrices.map());
+	// Start with the inverse bind matrices until the first pose is calculated
+	for (auto &skin : skins)
+	{
+		memcpy(static_cast<char *>(jointMatrices.mapped) + skin.jointOffset, skin.inverseBindMatrices.data(), sizeof(glm::mat4) * skin.inverseBindMatrices.size());
+	}
 }
 
 // POI: Load the animations from the glTF model
@@ -342,6 +353,7 @@ void VulkanglTFModel::loadNode(const tinygltf::Node &inputNode, const tinygltf::
 	if (inputNode.mesh > -1)
 	{
 		const tinygltf::Mesh mesh = input.meshes[inputNode.mesh];
+		node->mesh.firstVertex    = static_cast<uint32_t>(vertexBuffer.size());
 		// Iterate through all primitives of this node's mesh
 		for (size_t i = 0; i < mesh.primitives.size(); i++)
 		{
@@ -460,6 +472,11 @@ void VulkanglTFModel::loadNode(const tinygltf::Node &inputNode, const tinygltf::
 			primitive.materialIndex = glTFPrimitive.material;
 			node->mesh.primitives.push_back(primitive);
 		}
+		node->mesh.vertexCount = static_cast<uint32_t>(vertexBuffer.size()) - node->mesh.firstVertex;
+		if (node->skin > -1)
+		{
+			skinnedVertexCount += node->mesh.vertexCount;
+		}
 	}
 
 	if (parent)
@@ -504,8 +521,8 @@ void VulkanglTFModel::updateJoints(VulkanglTFModel::Node *node)
 			jointMatrices[i] = getNodeMatrix(skin.joints[i]) * skin.inverseBindMatrices[i];
 			jointMatrices[i] = inverseTransform * jointMatrices[i];
 		}
-		// Update ssbo
-		skin.ssbo.copyTo(jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
+		// Update the skin's range of the joint matrix ssbo
+		memcpy(static_cast<char *>(this->jointMatrices.mapped) + skin.jointOffset, jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
 	}
 
 	for (auto &child : node->children)
@@ -577,6 +594,38 @@ void VulkanglTFModel::updateAnimation(float deltaTime)
 	}
 }
 
+/*
+	glTF compute skinning functions
+*/
+
+// POI: Skin the vertices of a node's mesh (and its children) in a compute shader
+void VulkanglTFModel::skinNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node *node)
+{
+	if ((node->skin > -1) && (node->mesh.vertexCount > 0))
+	{
+		// Bind the range of the joint matrix ssbo for this node's skin to set 1
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 1, 1, &skins[node->skin].descriptorSet, 0, nullptr);
+		// Pass the range of vertices to skin via push constants
+		const uint32_t vertexRange[2] = {node->mesh.firstVertex, node->mesh.vertexCount};
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vertexRange), vertexRange);
+		// The compute shader skins 64 vertices per work group
+		vkCmdDispatch(commandBuffer, (node->mesh.vertexCount + 63) / 64, 1, 1);
+	}
+	for (auto &child : node->children)
+	{
+		skinNode(commandBuffer, pipelineLayout, child);
+	}
+}
+
+// Skin all meshes of the glTF scene starting at the top-level-nodes
+void VulkanglTFModel::skin(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+{
+	for (auto &node : nodes)
+	{
+		skinNode(commandBuffer, pipelineLayout, node);
+	}
+}
+
 /*
 	glTF rendering functions
 */
@@ -618,11 +667,13 @@ void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 }
 
 // Draw the glTF scene starting at the top-level-nodes
-void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+// If skinned vertices are passed, they're bound to the second vertex buffer binding to replace the positions and normals of the model's vertices
+void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkBuffer skinnedVertices)
 {
 	// All vertices and indices are stored in single buffers, so we only need to bind once
-	VkDeviceSize offsets[1] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	const VkBuffer     buffers[2] = {vertices.buffer, skinnedVertices};
+	const VkDeviceSize offsets[2] = {0, 0};
+	vkCmdBindVertexBuffers(commandBuffer, 0, (skinnedVertices != VK_NULL_HANDLE) ? 2 : 1, buffers, offsets);
 	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	// Render all nodes at top-level
 	for (auto &node : nodes)
@@ -650,10 +701,25 @@ VulkanExample::VulkanExample() :
 
 VulkanExample::~VulkanExample()
 {
+	if (benchmark.active)
+	{
+		double time;
+		if (getPassTime("Skinning", time))
+		{
+			std::cout << "Skinning: " << time << " ms per 1k skinned vertices\n";
+		}
+		if (getPassTime("Scene", time))
+		{
+			std::cout << "Scene: " << time << " ms per 1k skinned vertices\n";
+		}
+	}
+
 	vkDestroyPipeline(device, pipelines.solid, nullptr);
+	vkDestroyPipeline(device, pipelines.skinnedSolid, nullptr);
 	if (pipelines.wireframe != VK_NULL_HANDLE)
 	{
 		vkDestroyPipeline(device, pipelines.wireframe, nullptr);
+		vkDestroyPipeline(device, pipelines.skinnedWireframe, nullptr);
 	}
 
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
@@ -661,6 +727,11 @@ VulkanExample::~VulkanExample()
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.textures, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.jointMatrices, nullptr);
 
+	vkDestroyPipeline(device, compute.pipeline, nullptr);
+	vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
+	compute.vertices.destroy();
+
 	shaderData.buffer.destroy();
 }
 
@@ -694,19 +765,56 @@ void VulkanExample::buildCommandBuffers()
 	const VkViewport viewport = vks::initializers::viewport((float) width, (float) height, 0.0f, 1.0f);
 	const VkRect2D   scissor  = vks::initializers::rect2D(width, height, 0, 0);
 
+	VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+	bufferBarrier.buffer                = compute.vertices.buffer;
+	bufferBarrier.size                  = compute.vertices.size;
+	bufferBarrier.srcQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+
 	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		gpuProfiler.beginFrame(drawCmdBuffers[i]);
+
+		// POI: Skin all vertices once, every pass that follows reads the skinned positions and normals instead of skinning them again
+		if (computeSkinning)
+		{
+			gpuProfiler.begin(drawCmdBuffers[i], "Skinning");
+			// The previous frame must have finished reading the skinned vertices before they're overwritten
+			bufferBarrier.srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, nullptr);
+			glTFModel.skin(drawCmdBuffers[i], compute.pipelineLayout);
+			// Make the skinned vertices visible to the vertex input stage
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+			gpuProfiler.end(drawCmdBuffers[i]);
+		}
+
 		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		gpuProfiler.begin(drawCmdBuffers[i], "Scene");
 		// Bind scene matrices descriptor to set 0
 		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
-		glTFModel.draw(drawCmdBuffers[i], pipelineLayout);
+		if (computeSkinning)
+		{
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.skinnedWireframe : pipelines.skinnedSolid);
+			glTFModel.draw(drawCmdBuffers[i], pipelineLayout, compute.vertices.buffer);
+		}
+		else
+		{
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
+			glTFModel.draw(drawCmdBuffers[i], pipelineLayout);
+		}
+		gpuProfiler.end(drawCmdBuffers[i]);
 		drawUI(drawCmdBuffers[i]);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
+		gpuProfiler.endFrame(drawCmdBuffers[i]);
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 }
@@ -761,7 +869,8 @@ void VulkanExample::loadglTFFile(std::string filename)
 	// Create and upload vertex and index buffer
 	size_t vertexBufferSize = vertexBuffer.size() * sizeof(VulkanglTFModel::Vertex);
 	size_t indexBufferSize  = indexBuffer.size() * sizeof(uint32_t);
-	glTFModel.indices.count = static_cast<uint32_t>(indexBuffer.size());
+	glTFModel.vertices.count = static_cast<uint32_t>(vertexBuffer.size());
+	glTFModel.indices.count  = static_cast<uint32_t>(indexBuffer.size());
 
 	struct StagingBuffer
 	{
@@ -787,8 +896,9 @@ void VulkanExample::loadglTFFile(std::string filename)
 	    indexBuffer.data()));
 
 	// Create device local buffers (target)
+	// The vertex buffer is also read as a storage buffer by the compute skinning shader
 	VK_CHECK_RESULT(vulkanDevice->createBuffer(
-	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 	    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 	    vertexBufferSize,
 	    &glTFModel.vertices.buffer,
@@ -826,11 +936,11 @@ void VulkanExample::setupDescriptors()
 	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
 	    // One combined image sampler per material image/texture
 	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(glTFModel.images.size())),
-	    // One ssbo per skin
-	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(glTFModel.skins.size())),
+	    // One ssbo per skin + source and skinned vertices for compute skinning
+	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(glTFModel.skins.size()) + 2),
 	};
-	// Number of descriptor sets = One for the scene ubo + one per image + one per skin
-	const uint32_t             maxSetCount        = static_cast<uint32_t>(glTFModel.images.size()) + static_cast<uint32_t>(glTFModel.skins.size()) + 1;
+	// Number of descriptor sets = One for the scene ubo + one per image + one per skin + one for compute skinning
+	const uint32_t             maxSetCount        = static_cast<uint32_t>(glTFModel.images.size()) + static_cast<uint32_t>(glTFModel.skins.size()) + 2;
 	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxSetCount);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
@@ -846,8 +956,8 @@ void VulkanExample::setupDescriptors()
 	setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
 	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.textures));
 
-	// Descriptor set layout for passing skin joint matrices
-	setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+	// Descriptor set layout for passing skin joint matrices (used by the vertex shader and the compute skinning shader)
+	setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0);
 	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.jointMatrices));
 
 	// The pipeline layout uses three sets:
@@ -874,11 +984,13 @@ void VulkanExample::setupDescriptors()
 	vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 
 	// Descriptor set for glTF model skin joint matrices
+	// All skins share one buffer, each descriptor points to the skin's range of that buffer
 	for (auto &skin : glTFModel.skins)
 	{
 		const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.jointMatrices, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &skin.descriptorSet));
-		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(skin.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &skin.ssbo.descriptor);
+		VkDescriptorBufferInfo jointMatricesDescriptor = {glTFModel.jointMatrices.buffer, skin.jointOffset, sizeof(glm::mat4) * std::max(skin.joints.size(), static_cast<size_t>(1))};
+		VkWriteDescriptorSet   writeDescriptorSet      = vks::initializers::writeDescriptorSet(skin.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &jointMatricesDescriptor);
 		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 	}
 
@@ -949,6 +1061,79 @@ void VulkanExample::preparePipelines()
 		rasterizationStateCI.lineWidth   = 1.0f;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
 	}
+
+	// POI: Pipelines for rendering the vertices skinned by the compute shader
+	// Positions and normals are read from the skinned vertex buffer bound to binding 1, the remaining attributes still come from the model's vertex buffer
+	const std::vector<VkVertexInputBindingDescription> skinnedVertexInputBindings = {
+	    vks::initializers::vertexInputBindingDescription(0, sizeof(VulkanglTFModel::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
+	    vks::initializers::vertexInputBindingDescription(1, sizeof(SkinnedVertex), VK_VERTEX_INPUT_RATE_VERTEX),
+	};
+	const std::vector<VkVertexInputAttributeDescription> skinnedVertexInputAttributes = {
+	    {0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(SkinnedVertex, pos)},
+	    {1, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(SkinnedVertex, normal)},
+	    {2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(VulkanglTFModel::Vertex, uv)},
+	    {3, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VulkanglTFModel::Vertex, color)},
+	};
+	vertexInputStateCI.vertexBindingDescriptionCount   = static_cast<uint32_t>(skinnedVertexInputBindings.size());
+	vertexInputStateCI.pVertexBindingDescriptions      = skinnedVertexInputBindings.data();
+	vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(skinnedVertexInputAttributes.size());
+	vertexInputStateCI.pVertexAttributeDescriptions    = skinnedVertexInputAttributes.data();
+
+	const std::array<VkPipelineShaderStageCreateInfo, 2> skinnedShaderStages = {
+	    loadShader(getShadersPath() + "gltfskinning/model.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+	    loadShader(getShadersPath() + "gltfskinning/skinnedmodel.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)};
+	pipelineCI.pStages = skinnedShaderStages.data();
+
+	rasterizationStateCI.polygonMode = VK_POLYGON_MODE_FILL;
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skinnedSolid));
+	if (deviceFeatures.fillModeNonSolid)
+	{
+		rasterizationStateCI.polygonMode = VK_POLYGON_MODE_LINE;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skinnedWireframe));
+	}
+}
+
+// POI: Prepare the resources for skinning the vertices in a compute shader
+void VulkanExample::prepareComputeSkinning()
+{
+	// The skinned vertices are written by the compute shader and read as vertex attributes by all passes
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	    &compute.vertices,
+	    glTFModel.vertices.count * sizeof(SkinnedVertex)));
+
+	// Set 0 = Source vertices and skinned vertices
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+	    vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+	    vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &compute.descriptorSetLayout));
+
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
+	VkDescriptorBufferInfo            sourceVerticesDescriptor = {glTFModel.vertices.buffer, 0, VK_WHOLE_SIZE};
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets      = {
+	    vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &sourceVerticesDescriptor),
+	    vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.vertices.descriptor),
+	};
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	// Set 1 = Joint matrices of the skin, same layout as used by the vertex shader
+	std::array<VkDescriptorSetLayout, 2> setLayouts = {
+	    compute.descriptorSetLayout,
+	    descriptorSetLayouts.jointMatrices};
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+	// The range of vertices to skin is passed via push constants
+	VkPushConstantRange pushConstantRange   = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 2 * sizeof(uint32_t), 0);
+	pipelineLayoutCI.pushConstantRangeCount = 1;
+	pipelineLayoutCI.pPushConstantRanges    = &pushConstantRange;
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &compute.pipelineLayout));
+
+	VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
+	computePipelineCI.stage                       = loadShader(getShadersPath() + "gltfskinning/skinning.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+	VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &compute.pipeline));
 }
 
 void VulkanExample::prepareUniformBuffers()
@@ -977,6 +1162,7 @@ void VulkanExample::prepare()
 	prepareUniformBuffers();
 	setupDescriptors();
 	preparePipelines();
+	prepareComputeSkinning();
 	buildCommandBuffers();
 	prepared = true;
 }
@@ -1000,6 +1186,24 @@ void VulkanExample::viewChanged()
 	updateUniformBuffers();
 }
 
+// Returns the average GPU time of a pass per 1k skinned vertices
+bool VulkanExample::getPassTime(const std::string &name, double &time)
+{
+	if (glTFModel.skinnedVertexCount == 0)
+	{
+		return false;
+	}
+	for (auto &pass : gpuProfiler.passes)
+	{
+		if (pass.path == name)
+		{
+			time = pass.averageTime / (static_cast<double>(glTFModel.skinnedVertexCount) / 1000.0);
+			return true;
+		}
+	}
+	return false;
+}
+
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay *overlay)
 {
 	if (overlay->header("Settings"))
@@ -1008,6 +1212,23 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay *overlay)
 		{
 			buildCommandBuffers();
 		}
+		if (overlay->checkBox("Compute skinning", &computeSkinning))
+		{
+			buildCommandBuffers();
+		}
+	}
+	if (overlay->header("Statistics"))
+	{
+		overlay->text("Skinned vertices: %u", glTFModel.skinnedVertexCount);
+		double time;
+		if (computeSkinning && getPassTime("Skinning", time))
+		{
+			overlay->text("Skinning: %.4f ms per 1k vertices", time);
+		}
+		if (getPassTime("Scene", time))
+		{
+			overlay->text("Scene: %.4f ms per 1k vertices", time);
+		}
 	}
 }
 
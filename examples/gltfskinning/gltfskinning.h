@@ -54,6 +54,7 @@ class VulkanglTFModel
 
 	struct Vertices
 	{
+		int            count;
 		VkBuffer       buffer;
 		VkDeviceMemory memory;
 	} vertices;
@@ -94,6 +95,9 @@ class VulkanglTFModel
 	struct Mesh
 	{
 		std::vector<Primitive> primitives;
+		// Range of the mesh's vertices in the vertex buffer, used for compute skinning
+		uint32_t firstVertex = 0;
+		uint32_t vertexCount = 0;
 	};
 
 	struct Node
@@ -130,7 +134,8 @@ class VulkanglTFModel
 		Node *                 skeletonRoot = nullptr;
 		std::vector<glm::mat4> inverseBindMatrices;
 		std::vector<Node *>    joints;
-		vks::Buffer            ssbo;
+		// Offset of the skin's joint matrices into the joint buffer shared by all skins
+		VkDeviceSize           jointOffset = 0;
 		VkDescriptorSet        descriptorSet;
 	};
 
@@ -169,6 +174,11 @@ class VulkanglTFModel
 	std::vector<Skin>      skins;
 	std::vector<Animation> animations;
 
+	// Joint matrices of all skins in a single storage buffer, so the number of joints per skin isn't limited
+	vks::Buffer jointMatrices;
+	// Number of vertices that belong to skinned meshes
+	uint32_t    skinnedVertexCount = 0;
+
 	uint32_t activeAnimation = 0;
 
 	~VulkanglTFModel();
@@ -183,14 +193,18 @@ class VulkanglTFModel
 	glm::mat4 getNodeMatrix(VulkanglTFModel::Node *node);
 	void      updateJoints(VulkanglTFModel::Node *node);
 	void      updateAnimation(float deltaTime);
+	void      skinNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node *node);
+	void      skin(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
 	void      drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node);
-	void      draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+	void      draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkBuffer skinnedVertices = VK_NULL_HANDLE);
 };
 
 class VulkanExample : public VulkanExampleBase
 {
   public:
 	bool wireframe = false;
+	// Skin the vertices once per frame in a compute shader instead of in the vertex shader of every pass
+	bool computeSkinning = true;
 
 	struct ShaderData
 	{
@@ -208,8 +222,29 @@ class VulkanExample : public VulkanExampleBase
 	{
 		VkPipeline solid;
 		VkPipeline wireframe = VK_NULL_HANDLE;
+		// Variants reading the vertices written by the compute skinning pass
+		VkPipeline skinnedSolid;
+		VkPipeline skinnedWireframe = VK_NULL_HANDLE;
 	} pipelines;
 
+	// Resources for skinning the vertices in a compute shader
+	struct ComputeSkinning
+	{
+		// Skinned positions and normals, indexed like the model's vertex buffer
+		vks::Buffer           vertices;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet       descriptorSet;
+		VkPipelineLayout      pipelineLayout;
+		VkPipeline            pipeline;
+	} compute;
+
+	// Layout of a vertex written by the compute skinning shader
+	struct SkinnedVertex
+	{
+		glm::vec4 pos;
+		glm::vec4 normal;
+	};
+
 	struct DescriptorSetLayouts
 	{
 		VkDescriptorSetLayout matrices;
@@ -228,6 +263,8 @@ class VulkanExample : public VulkanExampleBase
 	void         loadAssets();
 	void         setupDescriptors();
 	void         preparePipelines();
+	void         prepareComputeSkinning();
+	bool         getPassTime(const std::string &name, double &time);
 	void         prepareUniformBuffers();
 	void         updateUniformBuffers();
 	void         prepare();
@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 
+#include "jobsystem.hpp"
 #include "threadpool.hpp"
 #include "frustum.hpp"
 
@@ -48,12 +49,16 @@ public:
 
 	// Number of animated objects to be renderer
 	// by using threads and secondary command buffers
-	uint32_t numObjectsPerThread;
+	uint32_t numObjects;
 
 	// Multi threaded stuff
 	// Max. number of concurrent threads
 	uint32_t numThreads;
 
+	// Use the thread pool with statically partitioned per-thread job queues instead of the work stealing job system
+	// Can be toggled with --threadpool for comparing both with --benchmark
+	bool useThreadPool = false;
+
 	// Use push constants to update shader
 	// parameters on a per-thread base
 	struct ThreadPushConstantBlock {
@@ -71,19 +76,23 @@ public:
 		float deltaT;
 		float stateT = 0;
 		bool visible = true;
+		ThreadPushConstantBlock pushConstBlock;
+		// Secondary command buffer the object has been recorded to in the current frame
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
 	};
+	// Per object information (position, rotation, etc.)
+	std::vector<ObjectData> objectData;
 
+	// Command pools must not be used by multiple threads at the same time, so each thread records to its own pool
+	// With work stealing the number of objects a thread picks up changes per frame, so command buffers are allocated on demand
 	struct ThreadData {
 		VkCommandPool commandPool;
-		// One command buffer per render object
-		std::vector<VkCommandBuffer> commandBuffer;
-		// One push constant block per render object
-		std::vector<ThreadPushConstantBlock> pushConstBlock;
-		// Per object information (position, rotation, etc.)
-		std::vector<ObjectData> objectData;
+		std::vector<VkCommandBuffer> commandBuffers;
+		uint32_t usedCommandBuffers = 0;
 	};
 	std::vector<ThreadData> threadData;
 
+	vks::JobSystem jobSystem;
 	vks::ThreadPool threadPool;
 
 	// Fence to wait for all command buffers to finish before
@@ -93,6 +102,17 @@ public:
 	// View frustum for culling invisible objects
 	vks::Frustum frustum;
 
+	// Cull all objects in one batch before recording instead of checking each object on the thread that records it
+	// Only the visible objects are then distributed to the threads
+	bool batchCulling = true;
+	// Object bounding spheres as structure of arrays for the batch culling kernel
+	struct {
+		std::vector<float> x, y, z, radius;
+	} objectBounds;
+	std::vector<uint32_t> visibleObjects;
+	uint32_t visibleObjectCount = 0;
+	float cullingTime = 0.0f;
+
 	std::default_random_engine rndEngine;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -111,8 +131,15 @@ public:
 #else
 		std::cout << "numThreads = " << numThreads << std::endl;
 #endif
-		threadPool.setThreadCount(numThreads);
-		numObjectsPerThread = 512 / numThreads;
+		commandLineParser.add("threadpool", { "--threadpool" }, 0, "Use the thread pool with per-thread job queues instead of the work stealing job system");
+		useThreadPool = commandLineParser.isSet("threadpool");
+		if (useThreadPool) {
+			threadPool.setThreadCount(numThreads);
+		} else {
+			// The thread waiting for the jobs also executes them, so one worker less is required
+			jobSystem.setThreadCount(numThreads - 1);
+		}
+		numObjects = (512 / numThreads) * numThreads;
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
 	}
 
@@ -126,7 +153,7 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
 		for (auto& thread : threadData) {
-			vkFreeCommandBuffers(device, thread.commandPool, thread.commandBuffer.size(), thread.commandBuffer.data());
+			vkFreeCommandBuffers(device, thread.commandPool, static_cast<uint32_t>(thread.commandBuffers.size()), thread.commandBuffers.data());
 			vkDestroyCommandPool(device, thread.commandPool, nullptr);
 		}
 
@@ -157,12 +184,9 @@ public:
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.background));
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.ui));
 
+		// The job system uses its worker threads plus the calling thread, the thread pool only its own threads
 		threadData.resize(numThreads);
 
-		float maxX = std::floor(std::sqrt(numThreads * numObjectsPerThread));
-		uint32_t posX = 0;
-		uint32_t posZ = 0;
-
 		for (uint32_t i = 0; i < numThreads; i++) {
 			ThreadData *thread = &threadData[i];
 
@@ -172,55 +196,89 @@ public:
 			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread->commandPool));
 
-			// One secondary command buffer per object that is updated by this thread
-			thread->commandBuffer.resize(numObjectsPerThread);
-			// Generate secondary command buffers for each thread
+			// Allocate enough secondary command buffers for an even share of the objects up front, more are allocated if a thread picks up more objects
+			thread->commandBuffers.resize(numObjects / numThreads);
 			VkCommandBufferAllocateInfo secondaryCmdBufAllocateInfo =
 				vks::initializers::commandBufferAllocateInfo(
 					thread->commandPool,
 					VK_COMMAND_BUFFER_LEVEL_SECONDARY,
-					thread->commandBuffer.size());
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, thread->commandBuffer.data()));
+					static_cast<uint32_t>(thread->commandBuffers.size()));
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, thread->commandBuffers.data()));
+		}
 
-			thread->pushConstBlock.resize(numObjectsPerThread);
-			thread->objectData.resize(numObjectsPerThread);
+		objectData.resize(numObjects);
+		for (auto& object : objectData) {
+			float theta = 2.0f * float(M_PI) * rnd(1.0f);
+			float phi = acos(1.0f - 2.0f * rnd(1.0f));
+			object.pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
 
-			for (uint32_t j = 0; j < numObjectsPerThread; j++) {
-				float theta = 2.0f * float(M_PI) * rnd(1.0f);
-				float phi = acos(1.0f - 2.0f * rnd(1.0f));
-				thread->objectData[j].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
+			object.rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
+			object.deltaT = rnd(1.0f);
+			object.rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
+			object.rotationSpeed = (2.0f + rnd(4.0f)) * object.rotationDir;
+			object.scale = 0.75f + rnd(0.5f);
 
-				thread->objectData[j].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
-				thread->objectData[j].deltaT = rnd(1.0f);
-				thread->objectData[j].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
-				thread->objectData[j].rotationSpeed = (2.0f + rnd(4.0f)) * thread->objectData[j].rotationDir;
-				thread->objectData[j].scale = 0.75f + rnd(0.5f);
+			object.pushConstBlock.color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
+		}
 
-				thread->pushConstBlock[j].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
-			}
+		objectBounds.x.resize(numObjects);
+		objectBounds.y.resize(numObjects);
+		objectBounds.z.resize(numObjects);
+		objectBounds.radius.resize(numObjects, models.ufo.dimensions.radius * 0.5f);
+		for (uint32_t i = 0; i < numObjects; i++) {
+			objectBounds.x[i] = objectData[i].pos.x;
+			objectBounds.y[i] = objectData[i].pos.y;
+			objectBounds.z[i] = objectData[i].pos.z;
 		}
+		visibleObjects.resize(numObjects);
+	}
 
+	// Culls all objects against the view frustum and stores the indices of the visible ones
+	void cullObjects()
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		const vks::Frustum::SphereArrays bounds = { objectBounds.x.data(), objectBounds.y.data(), objectBounds.z.data(), objectBounds.radius.data() };
+		visibleObjectCount = frustum.cullSpheresCompact(bounds, numObjects, visibleObjects.data());
+		for (auto& object : objectData) {
+			object.visible = false;
+		}
+		for (uint32_t i = 0; i < visibleObjectCount; i++) {
+			objectData[visibleObjects[i]].visible = true;
+		}
+		cullingTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 	}
 
-	// Builds the secondary command buffer for each thread
-	void threadRenderCode(uint32_t threadIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
+	// Builds the secondary command buffer for an object on the given thread
+	void threadRenderCode(uint32_t threadIndex, uint32_t objectIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
 	{
 		ThreadData *thread = &threadData[threadIndex];
-		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
+		ObjectData *objectData = &this->objectData[objectIndex];
 
 		// Check visibility against view frustum using a simple sphere check based on the radius of the mesh
-		objectData->visible = frustum.checkSphere(objectData->pos, models.ufo.dimensions.radius * 0.5f);
+		// With batch culling this has already been done for all objects before recording
+		if (!batchCulling) {
+			objectData->visible = frustum.checkSphere(objectData->pos, models.ufo.dimensions.radius * 0.5f);
+		}
 
 		if (!objectData->visible)
 		{
 			return;
 		}
 
+		// Take the next unused command buffer of this thread's pool
+		if (thread->usedCommandBuffers == thread->commandBuffers.size()) {
+			VkCommandBufferAllocateInfo secondaryCmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(thread->commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VkCommandBuffer commandBuffer;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, &commandBuffer));
+			thread->commandBuffers.push_back(commandBuffer);
+		}
+		objectData->commandBuffer = thread->commandBuffers[thread->usedCommandBuffers++];
+
 		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
 		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
 		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-		VkCommandBuffer cmdBuffer = thread->commandBuffer[cmdBufferIndex];
+		VkCommandBuffer cmdBuffer = objectData->commandBuffer;
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
 
@@ -242,6 +300,7 @@ public:
 			if (objectData->deltaT > 1.0f)
 				objectData->deltaT -= 1.0f;
 			objectData->pos.y = sin(glm::radians(objectData->deltaT * 360.0f)) * 2.5f;
+			objectBounds.y[objectIndex] = objectData->pos.y;
 		}
 
 		objectData->model = glm::translate(glm::mat4(1.0f), objectData->pos);
@@ -250,7 +309,7 @@ public:
 		objectData->model = glm::rotate(objectData->model, glm::radians(objectData->deltaT * 360.0f), glm::vec3(0.0f, objectData->rotationDir, 0.0f));
 		objectData->model = glm::scale(objectData->model, glm::vec3(objectData->scale));
 
-		thread->pushConstBlock[cmdBufferIndex].mvp = matrices.projection * matrices.view * objectData->model;
+		objectData->pushConstBlock.mvp = matrices.projection * matrices.view * objectData->model;
 
 		// Update shader push constant block
 		// Contains model view matrix
@@ -260,7 +319,7 @@ public:
 			VK_SHADER_STAGE_VERTEX_BIT,
 			0,
 			sizeof(ThreadPushConstantBlock),
-			&thread->pushConstBlock[cmdBufferIndex]);
+			&objectData->pushConstBlock);
 
 		VkDeviceSize offsets[1] = { 0 };
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
@@ -371,26 +430,43 @@ public:
 			commandBuffers.push_back(secondaryCommandBuffers.background);
 		}
 
-		// Add a job to the thread's queue for each object to be rendered
-		for (uint32_t t = 0; t < numThreads; t++)
-		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
+		for (auto& thread : threadData) {
+			thread.usedCommandBuffers = 0;
+		}
+
+		// With batch culling only the visible objects are recorded
+		if (batchCulling) {
+			cullObjects();
+		}
+		const uint32_t jobCount = batchCulling ? visibleObjectCount : numObjects;
+		auto jobObjectIndex = [&](uint32_t job) { return batchCulling ? visibleObjects[job] : job; };
+
+		if (useThreadPool) {
+			// Objects are partitioned up front into contiguous ranges, with one job per object added to each thread's queue
+			for (uint32_t t = 0; t < numThreads; t++)
 			{
-				threadPool.threads[t]->addJob([=] { threadRenderCode(t, i, inheritanceInfo); });
+				const uint32_t first = (jobCount * t) / numThreads;
+				const uint32_t last = (jobCount * (t + 1)) / numThreads;
+				for (uint32_t i = first; i < last; i++)
+				{
+					const uint32_t objectIndex = jobObjectIndex(i);
+					threadPool.threads[t]->addJob([=] { threadRenderCode(t, objectIndex, inheritanceInfo); });
+				}
 			}
+			threadPool.wait();
+		} else {
+			// Objects are split into ranges that idle threads steal from busy ones, so culled objects don't leave threads without work
+			jobSystem.parallelFor(jobCount, 8, [&](uint32_t job) {
+				threadRenderCode(jobSystem.currentThreadIndex(), jobObjectIndex(job), inheritanceInfo);
+			});
 		}
 
-		threadPool.wait();
-
 		// Only submit if object is within the current view frustum
-		for (uint32_t t = 0; t < numThreads; t++)
+		for (auto& object : objectData)
 		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
+			if (object.visible)
 			{
-				if (threadData[t].objectData[i].visible)
-				{
-					commandBuffers.push_back(threadData[t].commandBuffer[i]);
-				}
+				commandBuffers.push_back(object.commandBuffer);
 			}
 		}
 
@@ -534,9 +610,15 @@ public:
 	{
 		if (overlay->header("Statistics")) {
 			overlay->text("Active threads: %d", numThreads);
+			overlay->text("Scheduler: %s", useThreadPool ? "thread pool" : "job system");
+			if (batchCulling) {
+				overlay->text("Culling (%s): %.3f ms", vks::Frustum::kernelName(), cullingTime);
+				overlay->text("Visible objects: %u / %u", visibleObjectCount, numObjects);
+			}
 		}
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Stars", &displayStarSphere);
+			overlay->checkBox("Batch culling", &batchCulling);
 		}
 
 	}
@@ -17,8 +17,12 @@ class VulkanExample : public VulkanExampleBase
 public:
 	struct Models {
 		std::vector<vkglTF::Model> objects;
+		// Same objects loaded with deduplicated vertices and indices reordered for the vertex cache
+		std::vector<vkglTF::Model> optimizedObjects;
 		int32_t objectIndex = 3;
+		bool optimized = false;
 		std::vector<std::string> names;
+		vkglTF::Model& current() { return optimized ? optimizedObjects[objectIndex] : objects[objectIndex]; }
 	} models;
 
 	struct UniformBuffers {
@@ -181,14 +185,14 @@ public:
 
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &models.objects[models.objectIndex].vertices.buffer, offsets);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], models.objects[models.objectIndex].indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &models.current().vertices.buffer, offsets);
+			vkCmdBindIndexBuffer(drawCmdBuffers[i], models.current().indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 
 			for (int32_t y = 0; y < gridSize; y++) {
 				for (int32_t x = 0; x < gridSize; x++) {
 					glm::vec3 pos = glm::vec3(float(x - (gridSize / 2.0f)) * 2.5f, 0.0f, float(y - (gridSize / 2.0f)) * 2.5f);
 					vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec3), &pos);
-					models.objects[models.objectIndex].draw(drawCmdBuffers[i]);
+					models.current().draw(drawCmdBuffers[i]);
 				}
 			}
 
@@ -223,8 +227,11 @@ public:
 		std::vector<std::string> filenames = { "sphere.gltf", "teapot.gltf", "torusknot.gltf", "venus.gltf" };
 		models.names = { "Sphere", "Teapot", "Torusknot", "Venus" };
 		models.objects.resize(filenames.size());
+		models.optimizedObjects.resize(filenames.size());
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY;
 		for (size_t i = 0; i < filenames.size(); i++) {
-			models.objects[i].loadFromFile(getAssetPath() + "models/" + filenames[i], vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY);
+			models.objects[i].loadFromFile(getAssetPath() + "models/" + filenames[i], vulkanDevice, queue, glTFLoadingFlags);
+			models.optimizedObjects[i].loadFromFile(getAssetPath() + "models/" + filenames[i], vulkanDevice, queue, glTFLoadingFlags | vkglTF::FileLoadingFlags::OptimizeMeshes);
 		}
 	}
 
@@ -385,6 +392,9 @@ public:
 				updateUniformBuffers();
 				buildCommandBuffers();
 			}
+			if (overlay->checkBox("Optimize meshes", &models.optimized)) {
+				buildCommandBuffers();
+			}
 			if (overlay->sliderInt("Grid size", &gridSize, 1, 10)) {
 				buildCommandBuffers();
 			}
@@ -422,6 +432,14 @@ public:
 				}
 			}
 		}
+		// Vertex shader invocations per triangle (ACMR) and per vertex (ATVR) for a simulated 16 entry FIFO vertex cache
+		if (overlay->header("Vertex cache")) {
+			const vkglTF::Model::MeshOptimizationStatistics& statistics = models.optimizedObjects[models.objectIndex].meshOptimizationStatistics;
+			overlay->text("Triangles: %u", statistics.triangleCount);
+			overlay->text("Vertices: %u / %u", statistics.vertexCountBefore, statistics.vertexCountAfter);
+			overlay->text("ACMR: %.3f / %.3f", statistics.acmrBefore(), statistics.acmrAfter());
+			overlay->text("ATVR: %.3f / %.3f", statistics.atvrBefore(), statistics.atvrAfter());
+		}
 	}
 
 };
@@ -486,7 +486,10 @@ public:
 	void loadAssets()
 	{
 		vkglTF::descriptorBindingFlags  = vkglTF::DescriptorBindingFlags::ImageBaseColor;
-		const uint32_t gltfLoadingFlags = vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PreTransformVertices;
+		// Images are loaded in the background, see render()
+		const uint32_t gltfLoadingFlags = vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::LoadImagesAsync;
+		// Only the components used by the G-Buffer pass are uploaded, in packed formats and with quantized positions
+		scene.vertexLayout = vkglTF::VertexLayout({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal }, true);
 		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, gltfLoadingFlags);
 	}
 
@@ -498,6 +501,8 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
+
 			/*
 				Offscreen SSAO generation
 			*/
@@ -521,6 +526,8 @@ public:
 					First pass: Fill G-Buffer components (positions+depth, normals, albedo) using MRT
 				*/
 
+				gpuProfiler.begin(drawCmdBuffers[i], "G-Buffer");
+
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)frameBuffers.offscreen.width, (float)frameBuffers.offscreen.height, 0.0f, 1.0f);
@@ -536,6 +543,8 @@ public:
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+				gpuProfiler.end(drawCmdBuffers[i]);
+
 				/*
 					Second pass: SSAO generation
 				*/
@@ -543,6 +552,9 @@ public:
 				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
 				clearValues[1].depthStencil = { 1.0f, 0 };
 
+				gpuProfiler.begin(drawCmdBuffers[i], "SSAO");
+				gpuProfiler.begin(drawCmdBuffers[i], "Generation");
+
 				renderPassBeginInfo.framebuffer = frameBuffers.ssao.frameBuffer;
 				renderPassBeginInfo.renderPass = frameBuffers.ssao.renderPass;
 				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssao.width;
@@ -563,10 +575,14 @@ public:
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+				gpuProfiler.end(drawCmdBuffers[i]);
+
 				/*
 					Third pass: SSAO blur
 				*/
 
+				gpuProfiler.begin(drawCmdBuffers[i], "Blur");
+
 				renderPassBeginInfo.framebuffer = frameBuffers.ssaoBlur.frameBuffer;
 				renderPassBeginInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
 				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
@@ -584,6 +600,9 @@ public:
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+				gpuProfiler.end(drawCmdBuffers[i]);
+				gpuProfiler.end(drawCmdBuffers[i]);
 			}
 
 			/*
@@ -617,14 +636,20 @@ public:
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &descriptorSets.composition, 0, NULL);
 
 				// Final composition pass
+				gpuProfiler.begin(drawCmdBuffers[i], "Composition");
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				gpuProfiler.end(drawCmdBuffers[i]);
 
+				gpuProfiler.begin(drawCmdBuffers[i], "UI overlay");
 				drawUI(drawCmdBuffers[i]);
+				gpuProfiler.end(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
+			gpuProfiler.endFrame(drawCmdBuffers[i]);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -808,8 +833,8 @@ public:
 
 		// Fill G-Buffer pipeline
 		{
-			// Vertex input state from glTF model loader
-			pipelineCreateInfo.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal });
+			// Vertex input state for the packed vertices of the glTF model
+			pipelineCreateInfo.pVertexInputState = scene.vertexLayout.getPipelineVertexInputState();
 			pipelineCreateInfo.renderPass = frameBuffers.offscreen.renderPass;
 			pipelineCreateInfo.layout = pipelineLayouts.gBuffer;
 			// Blend attachment states required for all color attachments
@@ -893,7 +918,8 @@ public:
 	{
 		uboSceneParams.projection = camera.matrices.perspective;
 		uboSceneParams.view = camera.matrices.view;
-		uboSceneParams.model = glm::mat4(1.0f);
+		// The vertices are pre-transformed, so the model matrix only has to map the quantized positions back
+		uboSceneParams.model = scene.vertexLayout.dequantizationMatrix;
 
 		VK_CHECK_RESULT(uniformBuffers.sceneParams.map());
 		uniformBuffers.sceneParams.copyTo(&uboSceneParams, sizeof(uboSceneParams));
@@ -941,6 +967,11 @@ public:
 			updateUniformBufferMatrices();
 			updateUniformBufferSSAOParams();
 		}
+		// Materials are drawn with a placeholder texture until all of their images are resident
+		// The command buffers reference the materials' descriptor sets, so they need to be rebuilt when these change
+		if (scene.updateAsyncLoading()) {
+			buildCommandBuffers();
+		}
 	}
 
 	virtual void viewChanged()
@@ -962,6 +993,10 @@ public:
 				updateUniformBufferSSAOParams();
 			}
 		}
+		if (overlay->header("Vertices")) {
+			overlay->text("Vertex size: %u bytes (unpacked %u)", scene.vertexLayout.stride, (uint32_t)sizeof(vkglTF::Vertex));
+			overlay->text("Vertex buffer: %.2f MB (unpacked %.2f)", (float)(scene.vertices.count * scene.vertexLayout.stride) / (1024.0f * 1024.0f), (float)(scene.vertices.count * sizeof(vkglTF::Vertex)) / (1024.0f * 1024.0f));
+		}
 	}
 };
 
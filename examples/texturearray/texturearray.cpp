@@ -500,9 +500,10 @@ public:
 		uint8_t *pData;
 		uint32_t dataOffset = sizeof(uboVS.matrices);
 		uint32_t dataSize = layerCount * sizeof(UboInstanceData);
-		VK_CHECK_RESULT(vkMapMemory(device, uniformBufferVS.memory, dataOffset, dataSize, 0, (void **)&pData));
+		VK_CHECK_RESULT(uniformBufferVS.map(dataSize, dataOffset));
+		pData = static_cast<uint8_t*>(uniformBufferVS.mapped);
 		memcpy(pData, uboVS.instance, dataSize);
-		vkUnmapMemory(device, uniformBufferVS.memory);
+		uniformBufferVS.unmap();
 
 		// Map persistent
 		VK_CHECK_RESULT(uniformBufferVS.map());
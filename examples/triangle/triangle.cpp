@@ -909,7 +909,12 @@ public:
 		// Get the next swap chain image from the implementation
 		// Note that the implementation is free to return the images in any order, so we must use the acquire function and can't just cycle through the images
 		uint32_t imageIndex;
+#if defined(VK_USE_PLATFORM_HEADLESS_EXT)
+		// Headless builds have no presentation engine, so the swap chain wrapper hands out its offscreen images instead
+		VkResult result = swapChain.acquireNextImage(presentCompleteSemaphores[currentFrame], &imageIndex);
+#else
 		VkResult result = vkAcquireNextImageKHR(device, swapChain.swapChain, UINT64_MAX, presentCompleteSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+#endif
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			windowResize();
 			return;
@@ -1017,6 +1022,9 @@ public:
 		// Pass the semaphore signaled by the command buffer submission from the submit info as the wait semaphore for swap chain presentation
 		// This ensures that the image is not presented to the windowing system until all commands have been submitted
 
+#if defined(VK_USE_PLATFORM_HEADLESS_EXT)
+		result = swapChain.queuePresent(queue, imageIndex, renderCompleteSemaphores[currentFrame]);
+#else
 		VkPresentInfoKHR presentInfo{};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		presentInfo.waitSemaphoreCount = 1;
@@ -1025,6 +1033,7 @@ public:
 		presentInfo.pSwapchains = &swapChain.swapChain;
 		presentInfo.pImageIndices = &imageIndex;
 		result = vkQueuePresentKHR(queue, &presentInfo);
+#endif
 
 		if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 			windowResize();
@@ -1,5 +1,7 @@
 #include "Material.h"
 
+VkPipelineCache Material::pipelineCache = VK_NULL_HANDLE;
+
 Material::Material():widthScale(1.0f), heightScale(1.0f)
 {
 	pipeline = NULL;
@@ -306,7 +308,7 @@ void ObjectDrawMaterial::createGraphicsPipeline(VkExtent2D swapChainExtent)
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = &depthStencil;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -653,7 +655,7 @@ void VoxelizeMaterial::createGraphicsPipeline(VkExtent2D swapChainExtent)
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = NULL;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -1203,7 +1205,7 @@ void VoxelTagMaterial::createComputePipeline()
 	computePipelineInfo.basePipelineHandle = 0;
 	computePipelineInfo.basePipelineIndex = 0;
 
-	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -1405,7 +1407,7 @@ void VoxelAllocationMaterial::createComputePipeline()
 	computePipelineInfo.basePipelineHandle = 0;
 	computePipelineInfo.basePipelineIndex = 0;
 
-	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -1630,7 +1632,7 @@ void VoxelMipmapMaterial::createComputePipeline()
 	computePipelineInfo.basePipelineHandle = 0;
 	computePipelineInfo.basePipelineIndex = 0;
 
-	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -1820,7 +1822,7 @@ void VoxelTextureMaterial::createComputePipeline()
 	computePipelineInfo.basePipelineHandle = 0;
 	computePipelineInfo.basePipelineIndex = 0;
 
-	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -2033,7 +2035,7 @@ void VoxelOctreeMaterial::createComputePipeline()
 	computePipelineInfo.basePipelineHandle = 0;
 	computePipelineInfo.basePipelineIndex = 0;
 
-	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -2598,7 +2600,7 @@ void VoxelRenderMaterial::createGraphicsPipeline(glm::vec2 Extent, glm::vec2 Scr
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = &depthStencil;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -3125,7 +3127,7 @@ void LightingMaterial::createGraphicsPipeline(VkExtent2D swapChainExtent)
 	pipelineInfo.pDepthStencilState = NULL;
 	//pipelineInfo.pDepthStencilState = &depthStencil;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -3768,7 +3770,7 @@ void DebugDisplayMaterial::createGraphicsPipeline(glm::vec2 Extent, glm::vec2 Sc
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = NULL;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -3799,7 +3801,7 @@ void DebugDisplayMaterial::createGraphicsPipeline(glm::vec2 Extent, glm::vec2 Sc
 	pipelineInfo2.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo2.pDepthStencilState = NULL;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo2, nullptr, &pipeline2) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo2, nullptr, &pipeline2) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline2!");
 	}
 
@@ -4345,7 +4347,7 @@ void FinalRenderingMaterial::createGraphicsPipeline(glm::vec2 Extent, glm::vec2
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = NULL;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -4376,7 +4378,7 @@ void FinalRenderingMaterial::createGraphicsPipeline(glm::vec2 Extent, glm::vec2
 	pipelineInfo2.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo2.pDepthStencilState = NULL;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo2, nullptr, &pipeline2) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo2, nullptr, &pipeline2) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline2!");
 	}
 
@@ -5132,7 +5134,7 @@ void VoxelConetracingMaterial::createGraphicsPipeline(glm::vec2 Extent, glm::vec
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = NULL;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -5522,7 +5524,7 @@ void HDRHighlightMaterial::createGraphicsPipeline(glm::vec2 Extent, glm::vec2 Sc
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = NULL;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -5912,7 +5914,7 @@ void BlurMaterial::createGraphicsPipeline(glm::vec2 Extent, glm::vec2 ScreenOffs
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = NULL;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -6215,7 +6217,7 @@ void ComputeBlurMaterial::createComputePipeline()
 	computePipelineInfo.basePipelineHandle = 0;
 	computePipelineInfo.basePipelineIndex = 0;
 
-	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -6643,7 +6645,7 @@ void LastPostProcessgMaterial::createGraphicsPipeline(glm::vec2 Extent, glm::vec
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = NULL;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -6937,7 +6939,7 @@ void StandardShadowMaterial::createGraphicsPipeline(glm::vec2 Extent, glm::vec2
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = &depthStencil;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
@@ -143,6 +143,9 @@ public:
 
 	glm::ivec3 computeDispatchSize;
 
+	// Pipeline cache shared by all materials (owned by the example base class)
+	static VkPipelineCache pipelineCache;
+
 private:
 	
 };
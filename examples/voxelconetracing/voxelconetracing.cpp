@@ -365,6 +365,7 @@ public:
 		// Initialize asset database instance
 		AssetDatabase::GetInstance();
 		AssetDatabase::SetDevice(device, physicalDevice, cmdPool /*deferredCommandPool*/, queue /*objectDrawQueue*/);
+		Material::pipelineCache = pipelineCache;
 
 		LoadTextures();
 		LoadObjectMaterials();
@@ -10,6 +10,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -52,6 +53,11 @@ public:
 
 	glm::vec4 lightPos = glm::vec4(1.0f, 4.0f, 0.0f, 0.0f);
 
+	// Primitives outside of the view frustum are skipped using the glTF models' bounding volume hierarchies
+	// As culling is done while recording, command buffers are rebuilt whenever the view changes
+	bool frustumCulling = true;
+	vks::Frustum frustum;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Vulkan Demo Scene - (c) by Sascha Willems";
@@ -134,7 +140,12 @@ public:
 
 			for (auto model : demoModels) {
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, *model.pipeline);
-				model.glTF->draw(drawCmdBuffers[i]);
+				// The skybox surrounds the camera and is never culled
+				if (frustumCulling && (model.pipeline != &pipelines.skybox)) {
+					model.glTF->draw(drawCmdBuffers[i], frustum);
+				} else {
+					model.glTF->draw(drawCmdBuffers[i]);
+				}
 			}
 
 			drawUI(drawCmdBuffers[i]);
@@ -287,6 +298,7 @@ public:
 		uboVS.normal = glm::inverseTranspose(uboVS.view * uboVS.model);
 		uboVS.lightPos = lightPos;
 		memcpy(uniformData.meshVS.mapped, &uboVS, sizeof(uboVS));
+		frustum.update(uboVS.projection * uboVS.view * uboVS.model);
 	}
 
 	void draw()
@@ -321,6 +333,30 @@ public:
 	virtual void viewChanged()
 	{
 		updateUniformBuffers();
+		if (frustumCulling) {
+			buildCommandBuffers();
+		}
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			if (overlay->checkBox("Frustum culling", &frustumCulling)) {
+				buildCommandBuffers();
+			}
+		}
+		if (frustumCulling && overlay->header("Statistics")) {
+			uint32_t drawnPrimitives = 0;
+			uint32_t culledPrimitives = 0;
+			for (auto& model : demoModels) {
+				if (model.pipeline != &pipelines.skybox) {
+					drawnPrimitives += model.glTF->cullingStatistics.drawnPrimitives;
+					culledPrimitives += model.glTF->cullingStatistics.culledPrimitives;
+				}
+			}
+			overlay->text("Drawn primitives: %u", drawnPrimitives);
+			overlay->text("Culled primitives: %u", culledPrimitives);
+		}
 	}
 
 };
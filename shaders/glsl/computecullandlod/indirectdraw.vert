@@ -5,16 +5,31 @@ layout (location = 0) in vec4 inPos;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec3 inColor;
 
-// Instanced attributes
-layout (location = 4) in vec3 instancePos;
-layout (location = 5) in float instanceScale;
-
 layout (binding = 0) uniform UBO 
 {
 	mat4 projection;
 	mat4 modelview;
 } ubo;
 
+struct InstanceData 
+{
+	vec3 pos;
+	float scale;
+};
+
+// Binding 1: Instance data
+layout (binding = 1, std430) readonly buffer Instances 
+{
+	InstanceData instances[ ];
+};
+
+// Binding 2: Instance indices written by the culling stages
+// The draw of each level-of-detail starts at that level's list with its first instance
+layout (binding = 2, std430) readonly buffer VisibleInstances 
+{
+	uint visibleInstances[ ];
+};
+
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec3 outColor;
 layout (location = 2) out vec3 outViewVec;
@@ -30,8 +45,10 @@ void main()
 	outColor = inColor;
 		
 	outNormal = inNormal;
+
+	InstanceData instance = instances[visibleInstances[gl_InstanceIndex]];
 	
-	vec4 pos = vec4((inPos.xyz * instanceScale) + instancePos, 1.0);
+	vec4 pos = vec4((inPos.xyz * instance.scale) + instance.pos, 1.0);
 
 	gl_Position = ubo.projection * ubo.modelview * pos;
 	
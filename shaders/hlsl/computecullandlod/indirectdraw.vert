@@ -5,9 +5,6 @@ struct VSInput
 [[vk::location(0)]] float4 Pos : POSITION0;
 [[vk::location(1)]] float3 Normal : NORMAL0;
 [[vk::location(2)]] float3 Color : COLOR0;
-// Instanced attributes
-[[vk::location(4)]] float3 instancePos : TEXCOORD0;
-[[vk::location(5)]] float instanceScale : TEXCOORD1;
 };
 
 struct UBO
@@ -18,6 +15,19 @@ struct UBO
 
 cbuffer ubo : register(b0) { UBO ubo; }
 
+struct InstanceData
+{
+	float3 pos;
+	float scale;
+};
+
+// Binding 1: Instance data
+StructuredBuffer<InstanceData> instances : register(t1);
+
+// Binding 2: Instance indices written by the culling stages
+// The draw of each level-of-detail starts at that level's list with its first instance
+StructuredBuffer<uint> visibleInstances : register(t2);
+
 struct VSOutput
 {
 	float4 Pos : SV_POSITION;
@@ -27,14 +37,17 @@ struct VSOutput
 [[vk::location(3)]] float3 LightVec : TEXCOORD2;
 };
 
-VSOutput main(VSInput input)
+// SV_InstanceID starts at zero for each draw, the first instance of the draw has to be added explicitly
+VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID, [[vk::builtin("BaseInstance")]] uint BaseInstance : BaseInstance)
 {
 	VSOutput output = (VSOutput)0;
 	output.Color = input.Color;
 
 	output.Normal = input.Normal;
 
-	float4 pos = float4((input.Pos.xyz * input.instanceScale) + input.instancePos, 1.0);
+	InstanceData instance = instances[visibleInstances[BaseInstance + InstanceIndex]];
+
+	float4 pos = float4((input.Pos.xyz * instance.scale) + instance.pos, 1.0);
 
 	output.Pos = mul(ubo.projection, mul(ubo.modelview, pos));
 